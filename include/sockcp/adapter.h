@@ -1,15 +1,33 @@
 #ifndef SOCKCP_SOCKCP_ADAPTER_H_
 #define SOCKCP_SOCKCP_ADAPTER_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
+#include "error.h"
 #include "inet_address.h"
 
 #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__)
 
 #include <sys/types.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
 #include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
 #include <netinet/in.h>
+#include <unistd.h>
+
+#if defined(__linux__)
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#endif
 
 #elif defined(_WIN32)
 #error Adapter settings are not supported outside linux environment
@@ -23,16 +41,367 @@ template <typename ProtocolFamily>
 struct adapter final {
   std::string name;
   ProtocolFamily addr;
+  unsigned prefix_length = 0;
+  unsigned index = 0;
+  unsigned mtu = 0;
+  int numa_node = -1;  // -1 when the device has no NUMA affinity
 };
 
+// Cached view of the host's interface addresses. The snapshot is taken
+// once with getifaddrs(); on Linux it is then kept current from an
+// rtnetlink socket: attach the provider to socket_observer with event::in
+// and call dispatch() when fd() is readable. Elsewhere call refresh().
+// Not thread safe, the provider belongs to one event loop.
 class adapter_provider final {
+  struct link_info {
+    std::string name;
+    unsigned mtu = 0;
+    int numa_node = -1;
+  };
+
  public:
+  adapter_provider() {
+#if defined(__linux__)
+    // Subscribe before the dump so no change falls between the two
+    nl_fd_ = ::socket(AF_NETLINK, SOCK_RAW | SOCK_NONBLOCK | SOCK_CLOEXEC, NETLINK_ROUTE);
+    SOCKCP_ASSERT(nl_fd_ >= 0, socket_error("adapter_provider"));
+    ::sockaddr_nl local{};
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (::bind(nl_fd_, reinterpret_cast<::sockaddr*>(&local), sizeof(local))) {
+      socket_error error("adapter_provider");
+      ::close(nl_fd_);
+      throw error;
+    }
+#endif
+    try {
+      refresh();
+    } catch (...) {
+      close();
+      throw;
+    }
+  }
+
+  adapter_provider(const adapter_provider&) = delete;
+  adapter_provider& operator=(const adapter_provider&) = delete;
+
+  ~adapter_provider() noexcept {
+    close();
+  }
+
+  template <typename ProtocolFamily>
+  const std::vector<adapter<ProtocolFamily>>& adapters() const noexcept;
+
+  template <typename ProtocolFamily>
+  const adapter<ProtocolFamily>* find(const std::string& name) const noexcept {
+    for (const auto& a : adapters<ProtocolFamily>()) {
+      if (a.name == name) {
+        return &a;
+      }
+    }
+    return nullptr;
+  }
+
+  // Bumped on every change to the snapshot
+  uint64_t generation() const noexcept { return generation_; }
+
+  // Rebuilds the snapshot from getifaddrs()
+  void refresh() {
+    ::ifaddrs* list = nullptr;
+    SOCKCP_ASSERT(!::getifaddrs(&list), socket_error("getifaddrs"));
+    links_.clear();
+    v4_.clear();
+    v6_.clear();
+    for (::ifaddrs* p = list; p; p = p->ifa_next) {
+      if (!p->ifa_addr) {
+        continue;
+      }
+      unsigned index = ::if_nametoindex(p->ifa_name);
+      if (p->ifa_addr->sa_family == AF_INET) {
+        auto& a = insert(v4_, index, ipv4(*reinterpret_cast<const ::sockaddr_in*>(p->ifa_addr)));
+        a.prefix_length = mask_length(p->ifa_netmask, 4);
+        fill(a, link(index, p->ifa_name));
+      } else if (p->ifa_addr->sa_family == AF_INET6) {
+        auto& a = insert(v6_, index, ipv6(*reinterpret_cast<const ::sockaddr_in6*>(p->ifa_addr)));
+        a.prefix_length = mask_length(p->ifa_netmask, 16);
+        fill(a, link(index, p->ifa_name));
+      }
+    }
+    ::freeifaddrs(list);
+    ++generation_;
+  }
+
+#if defined(__linux__)
+  int fd() const noexcept { return nl_fd_; }
+
+  // Applies every queued rtnetlink notification and returns how many
+  // changed the snapshot. A lost notification (ENOBUFS) falls back to a
+  // full refresh().
+  std::size_t dispatch() {
+    alignas(::nlmsghdr) char buf[16384];
+    std::size_t changes = 0;
+    for (;;) {
+      ssize_t n = ::recv(nl_fd_, buf, sizeof(buf), 0);
+      if (n < 0 && errno == ENOBUFS) {
+        refresh();
+        ++changes;
+        continue;
+      }
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return changes;
+      }
+      SOCKCP_ASSERT(n >= 0, socket_error("adapter_provider"));
+      changes += apply(buf, static_cast<std::size_t>(n));
+    }
+  }
+
+  // Applies a buffer of RTM_{NEW,DEL}{LINK,ADDR} messages, the form the
+  // kernel sends them in. Returns how many changed the snapshot.
+  std::size_t apply(const void* data, std::size_t len) {
+    std::size_t changes = 0;
+    int remaining = static_cast<int>(len);
+    for (auto* h = static_cast<const ::nlmsghdr*>(data);
+         NLMSG_OK(h, remaining);
+         h = NLMSG_NEXT(h, remaining)) {
+      switch (h->nlmsg_type) {
+        case RTM_NEWLINK:
+        case RTM_DELLINK:
+          changes += apply_link(h);
+          break;
+        case RTM_NEWADDR:
+        case RTM_DELADDR:
+          changes += apply_addr(h);
+          break;
+        default:
+          break;
+      }
+    }
+    generation_ += changes;
+    return changes;
+  }
+#endif
 
  private:
-  ifaddrs* adapters = nullptr;
+  template <typename ProtocolFamily>
+  static adapter<ProtocolFamily>& insert(std::vector<adapter<ProtocolFamily>>& list,
+                                         unsigned index, const ProtocolFamily& addr) {
+    for (auto& a : list) {
+      if (a.index == index && a.addr == addr) {
+        return a;
+      }
+    }
+    list.emplace_back();
+    list.back().index = index;
+    list.back().addr = addr;
+    return list.back();
+  }
+
+  template <typename ProtocolFamily>
+  static void fill(adapter<ProtocolFamily>& a, const link_info& info) {
+    a.name = info.name;
+    a.mtu = info.mtu;
+    a.numa_node = info.numa_node;
+  }
+
+  static unsigned mask_length(const ::sockaddr* mask, std::size_t bytes) {
+    if (!mask) {
+      return 0;
+    }
+    const uint8_t* p = mask->sa_family == AF_INET6
+      ? reinterpret_cast<const ::sockaddr_in6*>(mask)->sin6_addr.s6_addr
+      : reinterpret_cast<const uint8_t*>(&reinterpret_cast<const ::sockaddr_in*>(mask)->sin_addr);
+    unsigned length = 0;
+    for (std::size_t i = 0; i < bytes; ++i) {
+      for (uint8_t b = p[i]; b & 0x80; b <<= 1) {
+        ++length;
+      }
+    }
+    return length;
+  }
+
+  // Link attributes are looked up once per interface and shared by all of
+  // its addresses.
+  const link_info& link(unsigned index, const char* name) {
+    auto it = links_.find(index);
+    if (it != links_.end()) {
+      return it->second;
+    }
+    link_info& info = links_[index];
+    info.name = name;
+    info.mtu = query_mtu(name);
+    info.numa_node = query_numa_node(name);
+    return info;
+  }
+
+  static unsigned query_mtu(const std::string& name) {
+    int fd = ::socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+      return 0;
+    }
+    ::ifreq req{};
+    name.copy(req.ifr_name, IFNAMSIZ - 1);
+    int r = ::ioctl(fd, SIOCGIFMTU, &req);
+    ::close(fd);
+    return r ? 0 : static_cast<unsigned>(req.ifr_mtu);
+  }
+
+  static int query_numa_node(const std::string& name) {
+    int node = -1;
+#if defined(__linux__)
+    std::ifstream in("/sys/class/net/" + name + "/device/numa_node");
+    if (!(in >> node)) {
+      node = -1;
+    }
+#endif
+    return node;
+  }
+
+#if defined(__linux__)
+  std::size_t apply_link(const ::nlmsghdr* h) {
+    auto* info = static_cast<const ::ifinfomsg*>(NLMSG_DATA(h));
+    unsigned index = static_cast<unsigned>(info->ifi_index);
+    if (h->nlmsg_type == RTM_DELLINK) {
+      std::size_t removed = erase_index(v4_, index) + erase_index(v6_, index);
+      return (links_.erase(index) + removed) ? 1 : 0;
+    }
+    std::string name;
+    unsigned mtu = 0;
+    int len = static_cast<int>(IFLA_PAYLOAD(h));
+    for (auto* a = IFLA_RTA(info); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+      if (a->rta_type == IFLA_IFNAME) {
+        name = static_cast<const char*>(RTA_DATA(a));
+      } else if (a->rta_type == IFLA_MTU) {
+        mtu = *static_cast<const uint32_t*>(RTA_DATA(a));
+      }
+    }
+    auto it = links_.find(index);
+    if (it == links_.end()) {
+      // Addresses of a link we have not seen yet will query it on demand
+      return 0;
+    }
+    link_info& link = it->second;
+    if ((name.empty() || link.name == name) && (!mtu || link.mtu == mtu)) {
+      return 0;
+    }
+    if (!name.empty() && link.name != name) {
+      link.name = name;
+      link.numa_node = query_numa_node(name);
+    }
+    if (mtu) {
+      link.mtu = mtu;
+    }
+    refill(v4_, index, link);
+    refill(v6_, index, link);
+    return 1;
+  }
+
+  std::size_t apply_addr(const ::nlmsghdr* h) {
+    auto* msg = static_cast<const ::ifaddrmsg*>(NLMSG_DATA(h));
+    const void* address = nullptr;
+    const void* local = nullptr;
+    int len = static_cast<int>(IFA_PAYLOAD(h));
+    for (auto* a = IFA_RTA(msg); RTA_OK(a, len); a = RTA_NEXT(a, len)) {
+      if (a->rta_type == IFA_ADDRESS) {
+        address = RTA_DATA(a);
+      } else if (a->rta_type == IFA_LOCAL) {
+        local = RTA_DATA(a);
+      }
+    }
+    // On point to point links IFA_ADDRESS is the peer, IFA_LOCAL is ours
+    const void* ours = local ? local : address;
+    if (!ours) {
+      return 0;
+    }
+    bool add = h->nlmsg_type == RTM_NEWADDR;
+    if (msg->ifa_family == AF_INET) {
+      uint32_t binary;
+      std::memcpy(&binary, ours, 4);
+      return update(v4_, msg->ifa_index, ipv4(ntohl(binary)), msg->ifa_prefixlen, add);
+    } else if (msg->ifa_family == AF_INET6) {
+      uint8_t bytes[16];
+      std::memcpy(bytes, ours, 16);
+      return update(v6_, msg->ifa_index, ipv6(bytes), msg->ifa_prefixlen, add);
+    }
+    return 0;
+  }
+
+  template <typename ProtocolFamily>
+  std::size_t update(std::vector<adapter<ProtocolFamily>>& list, unsigned index,
+                     const ProtocolFamily& addr, unsigned prefix_length, bool add) {
+    auto it = std::find_if(list.begin(), list.end(), [&](const adapter<ProtocolFamily>& a) {
+      return a.index == index && a.addr == addr;
+    });
+    if (!add) {
+      if (it == list.end()) {
+        return 0;
+      }
+      list.erase(it);
+      return 1;
+    }
+    if (it != list.end() && it->prefix_length == prefix_length) {
+      return 0;
+    }
+    auto l = links_.find(index);
+    if (l == links_.end()) {
+      char name[IF_NAMESIZE] = {};
+      if (!::if_indextoname(index, name)) {
+        return 0;
+      }
+      l = links_.emplace(index, link_info{name, query_mtu(name), query_numa_node(name)}).first;
+    }
+    auto& a = insert(list, index, addr);
+    a.prefix_length = prefix_length;
+    fill(a, l->second);
+    return 1;
+  }
+
+  template <typename ProtocolFamily>
+  static std::size_t erase_index(std::vector<adapter<ProtocolFamily>>& list, unsigned index) {
+    std::size_t before = list.size();
+    list.erase(std::remove_if(list.begin(), list.end(), [&](const adapter<ProtocolFamily>& a) {
+      return a.index == index;
+    }), list.end());
+    return before - list.size();
+  }
+
+  template <typename ProtocolFamily>
+  static void refill(std::vector<adapter<ProtocolFamily>>& list, unsigned index, const link_info& info) {
+    for (auto& a : list) {
+      if (a.index == index) {
+        fill(a, info);
+      }
+    }
+  }
+#endif
+
+  void close() noexcept {
+#if defined(__linux__)
+    if (nl_fd_ >= 0) {
+      ::close(nl_fd_);
+      nl_fd_ = -1;
+    }
+#endif
+  }
+
+#if defined(__linux__)
+  int nl_fd_ = -1;
+#endif
+  uint64_t generation_ = 0;
+  std::unordered_map<unsigned, link_info> links_;
+  std::vector<adapter<ipv4>> v4_;
+  std::vector<adapter<ipv6>> v6_;
+};
+
+template <>
+inline const std::vector<adapter<ipv4>>& adapter_provider::adapters<ipv4>() const noexcept {
+  return v4_;
+}
+
+template <>
+inline const std::vector<adapter<ipv6>>& adapter_provider::adapters<ipv6>() const noexcept {
+  return v6_;
 }
 
 }  // namespace sockcp
 
 #endif  // SOCKCP_SOCKCP_ADAPTER_H_
-
@@ -0,0 +1,264 @@
+#ifndef SOCKCP_SOCKCP_ADDRESS_MAP_H_
+#define SOCKCP_SOCKCP_ADDRESS_MAP_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+#include "inet_address.h"
+
+namespace sockcp {
+  namespace detail {
+    template <typename ProtocolFamily>
+    struct address_key;
+
+    template <>
+    struct address_key<ipv4> {
+      using type = uint64_t;
+
+      static constexpr type make(const ipv4& ip) noexcept { return pack(ip); }
+
+      static ipv4 unpack(type key) noexcept {
+        return ipv4(static_cast<uint32_t>(key >> 16), static_cast<uint16_t>(key));
+      }
+
+      static constexpr uint64_t hash(type key) noexcept { return key*hash_k0; }
+    };
+
+    template <>
+    struct address_key<ipv6> {
+      struct type {
+        uint64_t hi;
+        uint64_t lo;
+        uint64_t port;
+
+        constexpr bool operator==(const type& other) const noexcept {
+          return hi == other.hi && lo == other.lo && port == other.port;
+        }
+      };
+
+      static constexpr type make(const ipv6& ip) noexcept {
+        return type{
+          load_be64(ip.addr.sin6_addr.s6_addr),
+          load_be64(ip.addr.sin6_addr.s6_addr + 8),
+          host_to_net16(ip.addr.sin6_port)
+        };
+      }
+
+      static ipv6 unpack(const type& key) noexcept {
+        uint8_t bytes[16];
+        for (int i = 0; i < 8; ++i) {
+          bytes[i] = static_cast<uint8_t>(key.hi >> (56 - 8*i));
+          bytes[8 + i] = static_cast<uint8_t>(key.lo >> (56 - 8*i));
+        }
+        return ipv6(bytes, static_cast<uint16_t>(key.port));
+      }
+
+      // Same value as hash_value(const ipv6&)
+      static constexpr uint64_t hash(const type& key) noexcept {
+        uint64_t h = mul_fold(key.hi ^ hash_k1, key.lo ^ hash_k2);
+        return mul_fold(h ^ key.port, hash_k0);
+      }
+    };
+  }  // namespace detail
+
+  // Open addressing hash map keyed by ipv4 or ipv6 address and port.
+  // Keys are stored packed (8 bytes for ipv4) next to the value, and a
+  // separate byte per slot holds 7 hash bits so most probes never touch the
+  // slot array. Linear probing with backward shift deletion keeps lookups
+  // short without tombstones, which matters for long lived tables with
+  // millions of entries and constant churn.
+  //
+  // T must be default constructible and move assignable. Pointers returned
+  // by find() and emplace() are invalidated by any insertion or erase.
+  template <typename ProtocolFamily, typename T>
+  class address_map final {
+    using traits = detail::address_key<ProtocolFamily>;
+    using key_type = typename traits::type;
+
+    struct slot {
+      key_type key;
+      T value;
+    };
+
+   public:
+    address_map() = default;
+
+    explicit address_map(std::size_t expected) {
+      reserve(expected);
+    }
+
+    address_map(const address_map&) = delete;
+    address_map& operator=(const address_map&) = delete;
+
+    // Leave other empty; a defaulted move would keep its size and mask
+    // next to null arrays
+    address_map(address_map&& other) noexcept
+        : ctrl_(std::move(other.ctrl_)),
+          slots_(std::move(other.slots_)),
+          mask_(std::exchange(other.mask_, 0)),
+          size_(std::exchange(other.size_, 0)),
+          shift_(std::exchange(other.shift_, 64)) {}
+
+    address_map& operator=(address_map&& other) noexcept {
+      if (this != &other) {
+        ctrl_ = std::move(other.ctrl_);
+        slots_ = std::move(other.slots_);
+        mask_ = std::exchange(other.mask_, 0);
+        size_ = std::exchange(other.size_, 0);
+        shift_ = std::exchange(other.shift_, 64);
+      }
+      return *this;
+    }
+
+    std::size_t size() const noexcept { return size_; }
+
+    bool empty() const noexcept { return !size_; }
+
+    std::size_t capacity() const noexcept { return mask_ ? mask_ + 1 : 0; }
+
+    std::size_t memory_usage() const noexcept {
+      return capacity()*(sizeof(slot) + 1);
+    }
+
+    T* find(const ProtocolFamily& addr) noexcept {
+      std::size_t i = locate(traits::make(addr));
+      return i != npos ? &slots_[i].value : nullptr;
+    }
+
+    const T* find(const ProtocolFamily& addr) const noexcept {
+      std::size_t i = locate(traits::make(addr));
+      return i != npos ? &slots_[i].value : nullptr;
+    }
+
+    bool contains(const ProtocolFamily& addr) const noexcept {
+      return find(addr) != nullptr;
+    }
+
+    // Returns the value for addr and whether it was inserted. Existing
+    // values are left untouched.
+    template <typename... Args>
+    std::pair<T*, bool> emplace(const ProtocolFamily& addr, Args&&... args) {
+      key_type key = traits::make(addr);
+      std::size_t found = locate(key);
+      if (found != npos) {
+        return {&slots_[found].value, false};
+      }
+      if ((size_ + 1)*4 > capacity()*3) {
+        rehash(capacity() ? capacity()*2 : 16);
+      }
+      uint64_t h = traits::hash(key);
+      std::size_t i = h >> shift_;
+      for (; ctrl_[i]; i = (i + 1) & mask_);
+      ctrl_[i] = tag(h);
+      slots_[i].key = key;
+      slots_[i].value = T(std::forward<Args>(args)...);
+      ++size_;
+      return {&slots_[i].value, true};
+    }
+
+    T& operator[](const ProtocolFamily& addr) {
+      return *emplace(addr).first;
+    }
+
+    bool erase(const ProtocolFamily& addr) {
+      std::size_t hole = locate(traits::make(addr));
+      if (hole == npos) {
+        return false;
+      }
+      for (std::size_t j = (hole + 1) & mask_; ctrl_[j]; j = (j + 1) & mask_) {
+        std::size_t ideal = traits::hash(slots_[j].key) >> shift_;
+        if (((j - ideal) & mask_) >= ((j - hole) & mask_)) {
+          ctrl_[hole] = ctrl_[j];
+          slots_[hole] = std::move(slots_[j]);
+          hole = j;
+        }
+      }
+      ctrl_[hole] = 0;
+      slots_[hole].value = T();
+      --size_;
+      return true;
+    }
+
+    void reserve(std::size_t count) {
+      std::size_t cap = 16;
+      for (; cap*3 < count*4; cap <<= 1);
+      if (cap > capacity()) {
+        rehash(cap);
+      }
+    }
+
+    void clear() {
+      ctrl_.reset();
+      slots_.reset();
+      mask_ = size_ = 0;
+      shift_ = 64;
+    }
+
+    // Calls func(const ProtocolFamily&, T&) for every entry in table order.
+    template <typename Func>
+    void for_each(Func func) {
+      for (std::size_t i = 0; i < capacity(); ++i) {
+        if (ctrl_[i]) {
+          func(traits::unpack(slots_[i].key), slots_[i].value);
+        }
+      }
+    }
+
+   private:
+    static constexpr std::size_t npos = std::size_t(-1);
+
+    // 7 hash bits just below the index bits, high bit marks the slot used
+    uint8_t tag(uint64_t h) const noexcept {
+      return static_cast<uint8_t>(0x80 | ((h >> (shift_ - 7)) & 0x7f));
+    }
+
+    std::size_t locate(const key_type& key) const noexcept {
+      if (!size_) {
+        return npos;
+      }
+      uint64_t h = traits::hash(key);
+      uint8_t t = tag(h);
+      for (std::size_t i = h >> shift_;; i = (i + 1) & mask_) {
+        uint8_t c = ctrl_[i];
+        if (!c) {
+          return npos;
+        }
+        if (c == t && slots_[i].key == key) {
+          return i;
+        }
+      }
+    }
+
+    void rehash(std::size_t cap) {
+      std::unique_ptr<uint8_t[]> ctrl(new uint8_t[cap]());
+      std::unique_ptr<slot[]> slots(new slot[cap]);
+      unsigned shift = 64;
+      for (std::size_t c = cap; c > 1; c >>= 1, --shift);
+      std::size_t mask = cap - 1;
+      for (std::size_t i = 0; i < capacity(); ++i) {
+        if (!ctrl_[i]) {
+          continue;
+        }
+        uint64_t h = traits::hash(slots_[i].key);
+        std::size_t j = h >> shift;
+        for (; ctrl[j]; j = (j + 1) & mask);
+        ctrl[j] = static_cast<uint8_t>(0x80 | ((h >> (shift - 7)) & 0x7f));
+        slots[j] = std::move(slots_[i]);
+      }
+      ctrl_ = std::move(ctrl);
+      slots_ = std::move(slots);
+      mask_ = mask;
+      shift_ = shift;
+    }
+
+    std::unique_ptr<uint8_t[]> ctrl_;
+    std::unique_ptr<slot[]> slots_;
+    std::size_t mask_ = 0;
+    std::size_t size_ = 0;
+    unsigned shift_ = 64;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_ADDRESS_MAP_H_
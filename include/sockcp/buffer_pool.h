@@ -0,0 +1,64 @@
+#ifndef SOCKCP_SOCKCP_BUFFER_POOL_H_
+#define SOCKCP_SOCKCP_BUFFER_POOL_H_
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "error.h"
+
+namespace sockcp {
+  // Pool of fixed-size receive blocks shared between socket buffers.
+  // Buffers borrow a block only while they hold unread data, so resident
+  // memory follows the number of active connections, not total ones.
+  // Not thread safe: keep one pool per event loop thread.
+  class buffer_pool final {
+   public:
+    explicit buffer_pool(std::size_t block_size = 512u, std::size_t max_cached = 1024u)
+        : block_size_(block_size), max_cached_(max_cached) {}
+
+    buffer_pool(const buffer_pool&) = delete;
+    buffer_pool& operator=(const buffer_pool&) = delete;
+
+    char* acquire() {
+      char* block;
+      if (free_.empty()) {
+        block = new char[block_size_];
+      } else {
+        block = free_.back().release();
+        free_.pop_back();
+      }
+      ++in_use_;
+      return block;
+    }
+
+    void release(char* block) noexcept {
+      if (!block) {
+        return;
+      }
+      --in_use_;
+      if (free_.size() < max_cached_) {
+        SOCKCP_WRAP_NOEXCEPT(free_.emplace_back(block); return;)
+      }
+      delete[] block;
+    }
+
+    std::size_t block_size() const noexcept { return block_size_; }
+
+    std::size_t in_use() const noexcept { return in_use_; }
+
+    std::size_t cached() const noexcept { return free_.size(); }
+
+    std::size_t resident_bytes() const noexcept {
+      return (in_use_ + free_.size())*block_size_;
+    }
+
+   private:
+    std::size_t block_size_;
+    std::size_t max_cached_;
+    std::size_t in_use_ = 0;
+    std::vector<std::unique_ptr<char[]>> free_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_BUFFER_POOL_H_
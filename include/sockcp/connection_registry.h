@@ -0,0 +1,239 @@
+#ifndef SOCKCP_SOCKCP_CONNECTION_REGISTRY_H_
+#define SOCKCP_SOCKCP_CONNECTION_REGISTRY_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "socket.h"
+#include "socket_observer.h"
+
+namespace sockcp {
+  // Reference to a registry slot. The generation changes every time the
+  // slot is reused, so a handle kept past remove() is detected as stale
+  // even when the kernel hands the same fd to a new connection.
+  struct connection_handle {
+    uint32_t index = 0;
+    uint32_t generation = 0;  // 0 is never live
+
+    constexpr bool operator==(const connection_handle& other) const noexcept {
+      return index == other.index && generation == other.generation;
+    }
+
+    constexpr bool operator!=(const connection_handle& other) const noexcept {
+      return !(*this == other);
+    }
+
+    explicit constexpr operator bool() const noexcept { return generation != 0; }
+  };
+
+  enum class connection_state : uint8_t {
+    free,
+    connecting,
+    open,
+    closing
+  };
+
+  struct connection_stats {
+    uint64_t bytes_in = 0;
+    uint64_t bytes_out = 0;
+    std::chrono::steady_clock::time_point opened;
+  };
+
+  // Connection table laid out as parallel arrays. Hot fields touched on
+  // every event (fd, state, readiness, generation) sit in their own dense
+  // arrays; the peer address and Stats, read rarely, live apart and stay
+  // out of the cache during dispatch. Live slots are also kept in a dense
+  // list, so iteration never visits free ones. The registry owns the
+  // descriptors it holds and closes them in remove() and on destruction.
+  //
+  // Per connection this costs 19 bytes of hot and dense data plus the
+  // peer address and Stats, about 63 bytes for ipv4, with no per
+  // connection heap allocation.
+  template <typename ProtocolFamily, typename Stats = connection_stats>
+  class basic_connection_registry final {
+    static constexpr uint32_t no_slot = std::numeric_limits<uint32_t>::max();
+
+   public:
+    explicit basic_connection_registry(std::size_t reserve = 0) {
+      fds_.reserve(reserve);
+      generations_.reserve(reserve);
+      states_.reserve(reserve);
+      readiness_.reserve(reserve);
+      dense_pos_.reserve(reserve);
+      peers_.reserve(reserve);
+      stats_.reserve(reserve);
+      dense_.reserve(reserve);
+    }
+
+    basic_connection_registry(const basic_connection_registry&) = delete;
+    basic_connection_registry& operator=(const basic_connection_registry&) = delete;
+
+    ~basic_connection_registry() noexcept {
+      for (uint32_t index : dense_) {
+        sock_close(fds_[index]);
+      }
+    }
+
+    // Takes ownership of sock; the peer is sock.name(), which accept()
+    // and adopt() set to the remote address.
+    connection_handle add(basic_socket<ProtocolFamily>&& sock, connection_state state = connection_state::open) {
+      ProtocolFamily peer = sock.name();
+      fd_type fd = sock.release();
+      return add(fd, peer, state);
+    }
+
+    connection_handle add(fd_type fd, const ProtocolFamily& peer, connection_state state = connection_state::open) {
+      SOCKCP_ASSERT(fd != fd_invalid, std::invalid_argument("connection_registry: invalid descriptor"));
+      SOCKCP_ASSERT(state != connection_state::free, std::invalid_argument("connection_registry: free state"));
+      uint32_t index;
+      if (free_.empty()) {
+        SOCKCP_ASSERT(fds_.size() < no_slot, std::length_error("connection_registry: full"));
+        index = static_cast<uint32_t>(fds_.size());
+        fds_.push_back(fd);
+        generations_.push_back(1);
+        states_.push_back(state);
+        readiness_.push_back(0);
+        dense_pos_.push_back(0);
+        peers_.push_back(peer);
+        stats_.emplace_back();
+      } else {
+        index = free_.back();
+        free_.pop_back();
+        fds_[index] = fd;
+        states_[index] = state;
+        readiness_[index] = 0;
+        peers_[index] = peer;
+        stats_[index] = Stats();
+      }
+      if constexpr (std::is_same_v<Stats, connection_stats>) {
+        stats_[index].opened = std::chrono::steady_clock::now();
+      }
+      dense_pos_[index] = static_cast<uint32_t>(dense_.size());
+      dense_.push_back(index);
+      map_fd(fd, index);
+      return connection_handle{index, generations_[index]};
+    }
+
+    bool contains(connection_handle h) const noexcept {
+      return h.index < generations_.size() && generations_[h.index] == h.generation
+        && states_[h.index] != connection_state::free;
+    }
+
+    // Handle of the live connection on fd, e.g. for an observer event;
+    // a null handle if none.
+    connection_handle find(fd_type fd) const noexcept {
+      if (static_cast<std::size_t>(fd) >= fd_slots_.size()) {
+        return connection_handle{};
+      }
+      uint32_t index = fd_slots_[static_cast<std::size_t>(fd)];
+      return index == no_slot ? connection_handle{} : connection_handle{index, generations_[index]};
+    }
+
+    fd_type fd(connection_handle h) const { return fds_[checked(h)]; }
+
+    connection_state state(connection_handle h) const { return states_[checked(h)]; }
+
+    void set_state(connection_handle h, connection_state state) {
+      SOCKCP_ASSERT(state != connection_state::free, std::invalid_argument("connection_registry: use remove()"));
+      states_[checked(h)] = state;
+    }
+
+    // Last readiness reported for the connection, kept for the owner
+    event readiness(connection_handle h) const { return static_cast<event>(readiness_[checked(h)]); }
+
+    void set_readiness(connection_handle h, event ready) {
+      readiness_[checked(h)] = static_cast<uint16_t>(ready);
+    }
+
+    const ProtocolFamily& peer(connection_handle h) const { return peers_[checked(h)]; }
+
+    Stats& stats(connection_handle h) { return stats_[checked(h)]; }
+
+    const Stats& stats(connection_handle h) const { return stats_[checked(h)]; }
+
+    // Closes the connection's descriptor and frees its slot
+    void remove(connection_handle h) {
+      sock_close(release(h));
+    }
+
+    // Frees the slot without closing the descriptor, which is returned
+    fd_type release(connection_handle h) {
+      uint32_t index = checked(h);
+      fd_type fd = fds_[index];
+      fd_slots_[static_cast<std::size_t>(fd)] = no_slot;
+      fds_[index] = fd_invalid;
+      states_[index] = connection_state::free;
+      uint32_t pos = dense_pos_[index];
+      dense_[pos] = dense_.back();
+      dense_pos_[dense_[pos]] = pos;
+      dense_.pop_back();
+      // A slot whose generation would wrap is retired instead of reused
+      if (++generations_[index] != 0) {
+        free_.push_back(index);
+      }
+      return fd;
+    }
+
+    // Calls func(connection_handle) for every live connection. func may
+    // remove the connection it is given, but no other.
+    template <typename Func>
+    void for_each(Func&& func) {
+      for (std::size_t i = dense_.size(); i--;) {
+        uint32_t index = dense_[i];
+        func(connection_handle{index, generations_[index]});
+      }
+    }
+
+    std::size_t size() const noexcept { return dense_.size(); }
+
+    bool empty() const noexcept { return dense_.empty(); }
+
+    // Heap bytes held, free slots included
+    std::size_t memory_usage() const noexcept {
+      return fds_.capacity()*sizeof(fd_type) + generations_.capacity()*sizeof(uint32_t)
+        + states_.capacity()*sizeof(connection_state) + readiness_.capacity()*sizeof(uint16_t)
+        + dense_pos_.capacity()*sizeof(uint32_t) + peers_.capacity()*sizeof(ProtocolFamily)
+        + stats_.capacity()*sizeof(Stats) + dense_.capacity()*sizeof(uint32_t)
+        + free_.capacity()*sizeof(uint32_t) + fd_slots_.capacity()*sizeof(uint32_t);
+    }
+
+   private:
+    uint32_t checked(connection_handle h) const {
+      SOCKCP_ASSERT(contains(h), std::out_of_range("connection_registry: stale handle"));
+      return h.index;
+    }
+
+    void map_fd(fd_type fd, uint32_t index) {
+      auto slot = static_cast<std::size_t>(fd);
+      if (slot >= fd_slots_.size()) {
+        fd_slots_.resize(std::max(slot + 1, fd_slots_.size()*2), no_slot);
+      }
+      fd_slots_[slot] = index;
+    }
+
+    // Hot
+    std::vector<fd_type> fds_;
+    std::vector<uint32_t> generations_;
+    std::vector<connection_state> states_;
+    std::vector<uint16_t> readiness_;  // event bits, all below 1 << 16
+    // Iteration
+    std::vector<uint32_t> dense_;
+    std::vector<uint32_t> dense_pos_;
+    // Cold
+    std::vector<ProtocolFamily> peers_;
+    std::vector<Stats> stats_;
+    // Bookkeeping
+    std::vector<uint32_t> free_;
+    std::vector<uint32_t> fd_slots_;  // fd -> slot, descriptors are small integers
+  };
+
+  using connection_registry = basic_connection_registry<ipv4>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_CONNECTION_REGISTRY_H_
@@ -0,0 +1,134 @@
+#ifndef SOCKCP_SOCKCP_CRC32C_H_
+#define SOCKCP_SOCKCP_CRC32C_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <nmmintrin.h>
+#define SOCKCP_CRC32C_SSE42 1
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define SOCKCP_CRC32C_ARMV8 1
+#endif
+
+namespace sockcp {
+  namespace detail {
+    // Castagnoli polynomial, reflected
+    constexpr uint32_t crc32c_poly = 0x82f63b78u;
+
+    // Slicing-by-8 tables: table[k][b] is the CRC of byte b followed by k
+    // zero bytes, so eight input bytes cost eight lookups and no shifts
+    // through the dependency chain.
+    constexpr std::array<std::array<uint32_t, 256>, 8> make_crc32c_table() {
+      std::array<std::array<uint32_t, 256>, 8> table{};
+      for (uint32_t b = 0; b < 256; ++b) {
+        uint32_t crc = b;
+        for (int i = 0; i < 8; ++i) {
+          crc = crc & 1 ? (crc >> 1) ^ crc32c_poly : crc >> 1;
+        }
+        table[0][b] = crc;
+      }
+      for (uint32_t b = 0; b < 256; ++b) {
+        for (std::size_t k = 1; k < 8; ++k) {
+          table[k][b] = (table[k - 1][b] >> 8) ^ table[0][table[k - 1][b] & 0xff];
+        }
+      }
+      return table;
+    }
+
+    inline constexpr auto crc32c_table = make_crc32c_table();
+
+    inline uint32_t crc32c_software(uint32_t crc, const unsigned char* p, std::size_t size) noexcept {
+      const auto& t = crc32c_table;
+      for (; size >= 8; p += 8, size -= 8) {
+        uint32_t lo;
+        uint32_t hi;
+        std::memcpy(&lo, p, 4);
+        std::memcpy(&hi, p + 4, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+        lo ^= crc;
+        crc = t[7][lo & 0xff] ^ t[6][(lo >> 8) & 0xff] ^ t[5][(lo >> 16) & 0xff] ^ t[4][lo >> 24]
+            ^ t[3][hi & 0xff] ^ t[2][(hi >> 8) & 0xff] ^ t[1][(hi >> 16) & 0xff] ^ t[0][hi >> 24];
+      }
+      for (; size; ++p, --size) {
+        crc = (crc >> 8) ^ t[0][(crc ^ *p) & 0xff];
+      }
+      return crc;
+    }
+
+#if defined(SOCKCP_CRC32C_SSE42)
+    __attribute__((target("sse4.2")))
+    inline uint32_t crc32c_hardware(uint32_t crc, const unsigned char* p, std::size_t size) noexcept {
+#if defined(__x86_64__)
+      uint64_t crc64 = crc;
+      for (; size >= 8; p += 8, size -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        crc64 = _mm_crc32_u64(crc64, v);
+      }
+      crc = static_cast<uint32_t>(crc64);
+#endif
+      for (; size >= 4; p += 4, size -= 4) {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        crc = _mm_crc32_u32(crc, v);
+      }
+      for (; size; ++p, --size) {
+        crc = _mm_crc32_u8(crc, *p);
+      }
+      return crc;
+    }
+
+    inline bool crc32c_hardware_available() noexcept {
+      static const bool available = __builtin_cpu_supports("sse4.2");
+      return available;
+    }
+#elif defined(SOCKCP_CRC32C_ARMV8)
+    inline uint32_t crc32c_hardware(uint32_t crc, const unsigned char* p, std::size_t size) noexcept {
+      for (; size >= 8; p += 8, size -= 8) {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        crc = __crc32cd(crc, v);
+      }
+      for (; size; ++p, --size) {
+        crc = __crc32cb(crc, *p);
+      }
+      return crc;
+    }
+
+    // The compiler was told the target has the CRC extension
+    inline bool crc32c_hardware_available() noexcept { return true; }
+#else
+    inline uint32_t crc32c_hardware(uint32_t crc, const unsigned char* p, std::size_t size) noexcept {
+      return crc32c_software(crc, p, size);
+    }
+
+    inline bool crc32c_hardware_available() noexcept { return false; }
+#endif
+  }  // namespace detail
+
+  // CRC-32C (Castagnoli, as in iSCSI and ext4) of size bytes. Pass the
+  // previous result as crc to continue a checksum over several pieces.
+  // Uses the SSE4.2 crc32 instruction when the CPU has it, the ARMv8 CRC
+  // extension when compiled for it, and slicing-by-8 tables otherwise.
+  inline uint32_t crc32c(const void* data, std::size_t size, uint32_t crc = 0) noexcept {
+    auto p = static_cast<const unsigned char*>(data);
+    if (detail::crc32c_hardware_available()) {
+      return ~detail::crc32c_hardware(~crc, p, size);
+    }
+    return ~detail::crc32c_software(~crc, p, size);
+  }
+
+  // Table driven CRC-32C regardless of the CPU, for tests and benchmarks
+  inline uint32_t crc32c_portable(const void* data, std::size_t size, uint32_t crc = 0) noexcept {
+    return ~detail::crc32c_software(~crc, static_cast<const unsigned char*>(data), size);
+  }
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_CRC32C_H_
@@ -0,0 +1,93 @@
+#ifndef SOCKCP_SOCKCP_DRAIN_POLICY_H_
+#define SOCKCP_SOCKCP_DRAIN_POLICY_H_
+
+#include <cstddef>
+#include <deque>
+#include <unordered_set>
+
+#include "socket.h"
+
+namespace sockcp {
+  struct drain_budget {
+    std::size_t bytes = 64*1024;  // per socket per tick
+    std::size_t ops = 16;         // reads per socket per tick
+  };
+
+  // Fair reading for edge triggered observers. Sockets reported readable
+  // are queued with ready(); run() visits each queued socket once, reading
+  // until it would block or its budget is spent. A socket that ran out of
+  // budget is still readable but will not be reported again by the kernel,
+  // so it is re-queued behind the others for the next tick. One flooding
+  // peer therefore costs every other socket at most one budget of delay.
+  //
+  // While pending() is true the owner should poll with a zero timeout.
+  class drain_policy final {
+   public:
+    explicit drain_policy(drain_budget budget = drain_budget()) : budget_(budget) {}
+
+    // Queues fd unless it is queued already
+    void ready(fd_type fd) {
+      if (queued_.insert(fd).second) {
+        queue_.push_back(fd);
+      }
+    }
+
+    // Forgets fd, e.g. before closing it
+    void remove(fd_type fd) {
+      if (queued_.erase(fd)) {
+        for (auto it = queue_.begin(); it != queue_.end(); ++it) {
+          if (*it == fd) {
+            queue_.erase(it);
+            break;
+          }
+        }
+      }
+    }
+
+    bool pending() const noexcept { return !queue_.empty(); }
+
+    std::size_t size() const noexcept { return queue_.size(); }
+
+    // read(fd, max_bytes) performs one nonblocking read of at most max_bytes
+    // and returns the bytes read, 0 at end of stream, or a negative value
+    // once the socket would block. Returns the number of reads performed.
+    template <typename Read>
+    std::size_t run(Read&& read) {
+      std::size_t ops = 0;
+      for (std::size_t n = queue_.size(); n; --n) {
+        fd_type fd = queue_.front();
+        queue_.pop_front();
+        std::size_t bytes = 0;
+        std::size_t reads = 0;
+        bool drained = false;
+        while (reads < budget_.ops && bytes < budget_.bytes) {
+          auto got = read(fd, budget_.bytes - bytes);
+          ++reads;
+          if (got <= 0) {
+            drained = true;
+            break;
+          }
+          bytes += static_cast<std::size_t>(got);
+        }
+        ops += reads;
+        // The callback may have removed fd while closing it
+        if (!queued_.count(fd)) {
+          continue;
+        }
+        if (drained) {
+          queued_.erase(fd);
+        } else {
+          queue_.push_back(fd);
+        }
+      }
+      return ops;
+    }
+
+   private:
+    drain_budget budget_;
+    std::deque<fd_type> queue_;
+    std::unordered_set<fd_type> queued_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_DRAIN_POLICY_H_
@@ -0,0 +1,324 @@
+#ifndef SOCKCP_SOCKCP_EVENT_LOOP_H_
+#define SOCKCP_SOCKCP_EVENT_LOOP_H_
+
+#if !(defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__))
+#error Event loop is not supported on Windows
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <utility>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <sys/socket.h>
+
+#if defined(__linux__)
+#include <sys/eventfd.h>
+#endif
+
+#include "socket.h"
+#include "socket_observer.h"
+
+namespace sockcp {
+  // Unbounded multi-producer single-consumer queue (Vyukov). push() is one
+  // exchange and one store, wait free for producers; pop() is for the single
+  // consumer thread only. A push in progress may hide the entries behind it
+  // until it completes, so consumers must not treat an empty pop() as final
+  // without a wakeup protocol like event_loop's.
+  template <typename T>
+  class mpsc_queue final {
+    struct node {
+      std::atomic<node*> next{nullptr};
+      T value;
+    };
+
+   public:
+    mpsc_queue() : head_(new node()), tail_(head_.load(std::memory_order_relaxed)) {}
+
+    mpsc_queue(const mpsc_queue&) = delete;
+    mpsc_queue& operator=(const mpsc_queue&) = delete;
+
+    ~mpsc_queue() noexcept {
+      for (node* n = tail_; n;) {
+        node* next = n->next.load(std::memory_order_relaxed);
+        delete n;
+        n = next;
+      }
+    }
+
+    void push(T value) {
+      node* n = new node();
+      n->value = std::move(value);
+      node* prev = head_.exchange(n, std::memory_order_acq_rel);
+      prev->next.store(n, std::memory_order_release);
+    }
+
+    bool pop(T& out) {
+      node* next = tail_->next.load(std::memory_order_acquire);
+      if (!next) {
+        return false;
+      }
+      out = std::move(next->value);
+      next->value = T();
+      delete tail_;
+      tail_ = next;
+      return true;
+    }
+
+   private:
+    alignas(64) std::atomic<node*> head_;
+    alignas(64) node* tail_;
+  };
+
+  // Busy polling trades a core for wakeup latency: run_once() first spins
+  // on nonblocking readiness checks for up to spin before it sleeps in
+  // poll(). Zero, the default, never spins.
+  struct busy_poll {
+    std::chrono::microseconds spin{0};
+  };
+
+  // What spinning cost a loop. spin_time is CPU burnt in nonblocking polls;
+  // idle_spin_time is the part that found nothing and ended in a blocking
+  // poll anyway. hits/(hits + fallbacks) is how often the spin paid off.
+  struct busy_poll_stats {
+    uint64_t polls = 0;
+    uint64_t hits = 0;
+    uint64_t fallbacks = 0;
+    std::chrono::nanoseconds spin_time{0};
+    std::chrono::nanoseconds idle_spin_time{0};
+  };
+
+  // Asks the kernel to busy poll the device queue for up to timeout on
+  // blocking reads and polls of sock (SO_BUSY_POLL), and with prefer to
+  // keep device interrupts deferred while the application keeps polling
+  // (SO_PREFER_BUSY_POLL, Linux 5.11). Raising timeout above the
+  // net.core.busy_read sysctl needs CAP_NET_ADMIN. Returns false, leaving
+  // the socket as it was, where the kernel or permissions refuse.
+  template <typename ProtocolFamily>
+  bool set_busy_poll(basic_socket<ProtocolFamily>& sock, std::chrono::microseconds timeout, bool prefer = true) {
+#if defined(SO_BUSY_POLL)
+#if !defined(SO_PREFER_BUSY_POLL)
+    if (prefer) {
+      return false;
+    }
+#endif
+    int previous = 0;
+    socklen_t len = sizeof(previous);
+    if (::getsockopt(sock.fd(), SOL_SOCKET, SO_BUSY_POLL, &previous, &len)) {
+      return false;
+    }
+    int usecs = static_cast<int>(timeout.count());
+    if (::setsockopt(sock.fd(), SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs))) {
+      return false;
+    }
+#if defined(SO_PREFER_BUSY_POLL)
+    int on = prefer;
+    if (::setsockopt(sock.fd(), SOL_SOCKET, SO_PREFER_BUSY_POLL, &on, sizeof(on)) && prefer) {
+      ::setsockopt(sock.fd(), SOL_SOCKET, SO_BUSY_POLL, &previous, sizeof(previous));
+      return false;
+    }
+#endif
+    return true;
+#else
+    (void)sock;
+    (void)timeout;
+    (void)prefer;
+    return false;
+#endif
+  }
+
+  // socket_observer driven by one thread, which other threads feed through
+  // a lock free submission queue. post(), attach() and detach() may be
+  // called from any thread; their work runs on the loop thread inside
+  // run_once(), so handlers and the observer never need locks. Producers
+  // wake a sleeping loop through an eventfd (a pipe outside Linux), and
+  // only the first submission after the loop drains pays for the write.
+  class event_loop final {
+   public:
+    using task = std::function<void()>;
+    using handler = std::function<void(event)>;
+
+    event_loop() {
+#if defined(__linux__)
+      wake_rd_ = wake_wr_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      SOCKCP_ASSERT(wake_rd_ >= 0, socket_error("event_loop"));
+#else
+      int fds[2];
+      SOCKCP_ASSERT(!::pipe(fds), socket_error("event_loop"));
+      wake_rd_ = fds[0];
+      wake_wr_ = fds[1];
+      ::fcntl(wake_rd_, F_SETFL, O_NONBLOCK);
+      ::fcntl(wake_wr_, F_SETFL, O_NONBLOCK);
+#endif
+      observer_.attach_socket(*this, event::in);
+    }
+
+    event_loop(const event_loop&) = delete;
+    event_loop& operator=(const event_loop&) = delete;
+
+    ~event_loop() noexcept {
+      ::close(wake_rd_);
+      if (wake_wr_ != wake_rd_) {
+        ::close(wake_wr_);
+      }
+    }
+
+    // Wakeup descriptor, watched by the loop's own observer
+    fd_type fd() const noexcept { return wake_rd_; }
+
+    // Runs func on the loop thread
+    void post(task func) {
+      tasks_.push(std::move(func));
+      if (!signaled_.exchange(true, std::memory_order_acq_rel)) {
+        wake();
+      }
+    }
+
+    // Watches sock for events, calling on_event(ready) on the loop thread.
+    // Attaching an fd again replaces its events and handler.
+    template <typename Socket>
+    void attach(const Socket& sock, event events, handler on_event) {
+      fd_type fd = sock.fd();
+      post([this, fd, events, on_event = std::move(on_event)]() mutable {
+        fd_handle h{fd};
+        if (handlers_.count(fd)) {
+          observer_.modify_socket(h, events);
+        } else {
+          observer_.attach_socket(h, events);
+        }
+        handlers_[fd] = std::move(on_event);
+      });
+    }
+
+    template <typename Socket>
+    void detach(const Socket& sock) {
+      fd_type fd = sock.fd();
+      post([this, fd] {
+        if (handlers_.erase(fd)) {
+          observer_.detach_socket(fd_handle{fd});
+        }
+      });
+    }
+
+    // Changes the events watched for an attached socket. Loop thread only,
+    // takes effect at once, e.g. to follow a send_queue's interest().
+    template <typename Socket>
+    void modify(const Socket& sock, event events) {
+      observer_.modify_socket(sock, events);
+    }
+
+    // Sets the spin budget of every later run_once(). Loop thread only,
+    // or before the loop runs.
+    void set_busy_poll(busy_poll config) noexcept { busy_ = config; }
+
+    const busy_poll_stats& stats() const noexcept { return stats_; }
+
+    void reset_stats() noexcept { stats_ = busy_poll_stats(); }
+
+    // Polls once and runs everything that became ready. Returns the number
+    // of handlers and tasks run. With busy polling enabled and a nonzero
+    // timeout the spin comes first; timeout only bounds the blocking poll.
+    std::size_t run_once(std::chrono::milliseconds timeout) {
+      std::unordered_map<fd_type, event> events;
+      if (busy_.spin.count() > 0 && timeout.count() != 0) {
+        events = spin();
+      }
+      if (events.empty()) {
+        events = observer_.poll(timeout);
+      }
+      std::size_t ran = 0;
+      for (auto& [fd, ready] : events) {
+        if (fd == wake_rd_) {
+          ran += drain();
+          continue;
+        }
+        auto it = handlers_.find(fd);
+        if (it != handlers_.end()) {
+          SOCKCP_TRACE(span, handler, "handler", fd);
+          SOCKCP_TRACE_RESULT(span, static_cast<int>(ready));
+          it->second(ready);
+          ++ran;
+        }
+      }
+      return ran;
+    }
+
+    void run() {
+      stopped_.store(false, std::memory_order_relaxed);
+      while (!stopped_.load(std::memory_order_relaxed)) {
+        run_once(std::chrono::milliseconds(-1));
+      }
+    }
+
+    // Makes run() return after the current iteration; callable from any thread
+    void stop() {
+      post([this] { stopped_.store(true, std::memory_order_relaxed); });
+    }
+
+   private:
+    struct fd_handle {
+      fd_type fd() const noexcept { return value; }
+      fd_type value;
+    };
+
+    void wake() noexcept {
+      uint64_t one = 1;
+      ssize_t r = ::write(wake_wr_, &one, wake_rd_ == wake_wr_ ? sizeof(one) : 1);
+      (void)r;
+    }
+
+    std::unordered_map<fd_type, event> spin() {
+      using clock = std::chrono::steady_clock;
+      auto start = clock::now();
+      auto deadline = start + busy_.spin;
+      for (;;) {
+        auto events = observer_.poll(std::chrono::milliseconds(0));
+        ++stats_.polls;
+        auto now = clock::now();
+        if (!events.empty()) {
+          ++stats_.hits;
+          stats_.spin_time += now - start;
+          return events;
+        }
+        if (now >= deadline) {
+          ++stats_.fallbacks;
+          stats_.spin_time += now - start;
+          stats_.idle_spin_time += now - start;
+          return events;
+        }
+      }
+    }
+
+    std::size_t drain() {
+      char buf[64];
+      while (::read(wake_rd_, buf, sizeof(buf)) > 0) {
+      }
+      // Acquires the release of every producer that saw the flag set, so
+      // their nodes are linked before the queue is drained below.
+      signaled_.exchange(false, std::memory_order_acq_rel);
+      std::size_t ran = 0;
+      for (task t; tasks_.pop(t); ++ran) {
+        SOCKCP_TRACE(span, task, "task", 0);
+        t();
+      }
+      return ran;
+    }
+
+    fd_type wake_rd_;
+    fd_type wake_wr_;
+    alignas(64) std::atomic<bool> signaled_{false};
+    std::atomic<bool> stopped_{false};
+    mpsc_queue<task> tasks_;
+    socket_observer observer_;
+    std::unordered_map<fd_type, handler> handlers_;
+    busy_poll busy_;
+    busy_poll_stats stats_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_EVENT_LOOP_H_
@@ -0,0 +1,219 @@
+#ifndef SOCKCP_SOCKCP_FILTER_PIPELINE_H_
+#define SOCKCP_SOCKCP_FILTER_PIPELINE_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "crc32c.h"
+#include "error.h"
+#include "socket.h"
+
+namespace sockcp {
+  // Framing stage for length prefixed, CRC-32C checked frames:
+  //   [payload size: uint32 LE][payload][crc32c(payload): uint32 LE]
+  // frame() finds one frame at the front of the buffered bytes, verifies
+  // it and reports where its payload lies, without copying anything.
+  class crc32c_framer final {
+   public:
+    static constexpr std::size_t header_size = 4;
+    static constexpr std::size_t trailer_size = 4;
+    static constexpr std::size_t overhead = header_size + trailer_size;
+
+    explicit crc32c_framer(std::size_t max_payload = 1u << 20) noexcept : max_payload_(max_payload) {}
+
+    std::size_t max_frame() const noexcept { return max_payload_ + overhead; }
+
+    // Returns the size of the complete frame at data, or 0 while more
+    // bytes are needed. payload and size are set to the verified payload.
+    std::size_t frame(char* data, std::size_t avail, char*& payload, std::size_t& size) const {
+      if (avail < header_size) {
+        return 0;
+      }
+      size = load(data);
+      SOCKCP_ASSERT(
+        size <= max_payload_,
+        protocol_error("Frame exceeds the maximum payload", typeid(crc32c_framer))
+      );
+      if (avail < size + overhead) {
+        return 0;
+      }
+      payload = data + header_size;
+      SOCKCP_ASSERT(
+        crc32c(payload, size) == load(payload + size),
+        protocol_error("Frame checksum mismatch", typeid(crc32c_framer))
+      );
+      return size + overhead;
+    }
+
+    // Writes the framed payload to out, which must hold size + overhead
+    // bytes. Returns the end of the frame.
+    static char* encode(const char* payload, std::size_t size, char* out) noexcept {
+      store(out, static_cast<uint32_t>(size));
+      std::memcpy(out + header_size, payload, size);
+      store(out + header_size + size, crc32c(payload, size));
+      return out + size + overhead;
+    }
+
+    static std::string encode(std::string_view payload) {
+      std::string res(payload.size() + overhead, '\0');
+      encode(payload.data(), payload.size(), &res[0]);
+      return res;
+    }
+
+   private:
+    static uint32_t load(const char* p) noexcept {
+      auto u = reinterpret_cast<const unsigned char*>(p);
+      return uint32_t(u[0]) | uint32_t(u[1]) << 8 | uint32_t(u[2]) << 16 | uint32_t(u[3]) << 24;
+    }
+
+    static void store(char* p, uint32_t v) noexcept {
+      for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<char>(v >> (8*i));
+      }
+    }
+
+    std::size_t max_payload_;
+  };
+
+  // Compile time chain of filters applied to received frames in place.
+  // Framer splits the stream into frames (see crc32c_framer); each of
+  // Stages is then called in order as
+  //   std::size_t stage(char* data, std::size_t size)
+  // on the frame's payload, may rewrite it in place, shrink it by
+  // returning a smaller size, or reject it by throwing. Stages are plain
+  // members called directly, so the compiler sees through the whole chain.
+  template <typename Framer, typename... Stages>
+  class filter_pipeline final {
+   public:
+    filter_pipeline() = default;
+
+    explicit filter_pipeline(Framer framer, Stages... stages)
+        : framer_(std::move(framer)), stages_(std::move(stages)...) {}
+
+    // Custom framer, default constructed stages
+    template <typename F = Framer, typename = std::enable_if_t<(sizeof...(Stages) > 0), F>>
+    explicit filter_pipeline(Framer framer) : framer_(std::move(framer)) {}
+
+    // Filters every complete frame in [data, data + size), calling
+    // on_message(char* payload, std::size_t size) for each. Returns the
+    // bytes consumed; what remains is the start of an incomplete frame.
+    template <typename Func>
+    std::size_t process(char* data, std::size_t size, Func&& on_message) {
+      std::size_t consumed = 0;
+      process(data, size, consumed, std::forward<Func>(on_message));
+      return consumed;
+    }
+
+    // As above, starting at data + consumed and moving consumed past each
+    // frame before its stages run. When a stage or on_message throws,
+    // consumed covers that frame and every one before it, so none of
+    // them is filtered or delivered twice.
+    template <typename Func>
+    void process(char* data, std::size_t size, std::size_t& consumed, Func&& on_message) {
+      for (;;) {
+        char* payload = nullptr;
+        std::size_t length = 0;
+        std::size_t n = framer_.frame(data + consumed, size - consumed, payload, length);
+        if (!n) {
+          return;
+        }
+        consumed += n;
+        std::apply([&](auto&... stage) { ((length = stage(payload, length)), ...); }, stages_);
+        on_message(payload, length);
+      }
+    }
+
+    std::size_t max_frame() const noexcept { return framer_.max_frame(); }
+
+    Framer& framer() noexcept { return framer_; }
+
+    template <std::size_t I>
+    auto& stage() noexcept { return std::get<I>(stages_); }
+
+   private:
+    Framer framer_;
+    std::tuple<Stages...> stages_;
+  };
+
+  // Receives from a stream socket straight into one buffer and runs the
+  // pipeline over it there. Payloads handed to the callback point into
+  // that buffer and stay valid until the next read(); the only copy
+  // after recv() moves the tail of a partly received frame to the front.
+  // recv() goes through the socket's Syscalls policy.
+  template <typename ProtocolFamily, typename Pipeline, typename Syscalls = system_calls>
+  class basic_frame_reader final {
+   public:
+    explicit basic_frame_reader(basic_socket<ProtocolFamily, Syscalls>& sock, Pipeline pipeline = Pipeline(),
+                                std::size_t capacity = 0)
+        : sock_(sock), pipeline_(std::move(pipeline)),
+          capacity_(capacity ? capacity : pipeline_.max_frame()),
+          buf_(new char[capacity_]) {
+      SOCKCP_ASSERT(
+        capacity_ >= pipeline_.max_frame(),
+        std::invalid_argument("frame_reader: capacity below the largest frame")
+      );
+    }
+
+    basic_frame_reader(const basic_frame_reader&) = delete;
+    basic_frame_reader& operator=(const basic_frame_reader&) = delete;
+
+    // One recv() followed by every frame it completed. Returns the number
+    // of messages delivered, 0 when a nonblocking socket had nothing.
+    // Throws disconnect_error at end of stream. When a stage or on_message
+    // throws, the frames up to and including the failing one are dropped
+    // from the buffer; the next read() resumes after them.
+    template <typename Func>
+    std::size_t read(Func&& on_message) {
+      errno = 0;
+      auto rd = Syscalls::recv(sock_.fd(), buf_.get() + end_, capacity_ - end_, 0);
+      if (rd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      SOCKCP_ASSERT(rd >= 0, socket_error("read"));
+      SOCKCP_ASSERT(rd > 0, disconnect_error());
+      end_ += static_cast<std::size_t>(rd);
+      std::size_t messages = 0;
+      compactor consumed{this, 0};
+      pipeline_.process(buf_.get(), end_, consumed.pos, [&](char* data, std::size_t size) {
+        ++messages;
+        on_message(data, size);
+      });
+      return messages;
+    }
+
+    // Bytes of an incomplete frame waiting for the rest
+    std::size_t buffered() const noexcept { return end_; }
+
+    Pipeline& pipeline() noexcept { return pipeline_; }
+
+   private:
+    // Drops the frames handled so far from the buffer, also when a stage
+    // or the callback throws
+    struct compactor {
+      ~compactor() {
+        reader->end_ -= pos;
+        if (reader->end_ && pos) {
+          std::memmove(reader->buf_.get(), reader->buf_.get() + pos, reader->end_);
+        }
+      }
+
+      basic_frame_reader* reader;
+      std::size_t pos;
+    };
+
+    basic_socket<ProtocolFamily, Syscalls>& sock_;
+    Pipeline pipeline_;
+    std::size_t capacity_;
+    std::unique_ptr<char[]> buf_;
+    std::size_t end_ = 0;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_FILTER_PIPELINE_H_
@@ -0,0 +1,183 @@
+#ifndef SOCKCP_SOCKCP_HAPPY_EYEBALLS_H_
+#define SOCKCP_SOCKCP_HAPPY_EYEBALLS_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+#include "error.h"
+#include "inet_address.h"
+#include "socket.h"
+#include "socket_observer.h"
+
+namespace sockcp {
+  // A connected socket of either inet family
+  using inet_socket = std::variant<basic_socket<ipv4>, basic_socket<ipv6>>;
+
+  struct happy_eyeballs_options {
+    // Head start of each attempt before the next candidate is tried in
+    // parallel (RFC 8305 Connection Attempt Delay). A failed attempt
+    // starts the next one at once.
+    std::chrono::milliseconds attempt_delay{250};
+    // An attempt still pending this long is abandoned
+    std::chrono::milliseconds attempt_timeout{5000};
+    // Deadline of the whole call
+    std::chrono::milliseconds timeout{10000};
+    // Family tried first, the two alternate after it
+    bool prefer_ipv6 = true;
+    // Leaves the winner nonblocking, for use with an event loop
+    bool nonblocking = false;
+  };
+
+  namespace detail {
+    // Candidates alternating between the families, preferred one first
+    // (RFC 8305, section 4), each family keeping its own order
+    inline std::vector<std::variant<ipv4, ipv6>> interleave(const std::vector<ipv6>& v6, const std::vector<ipv4>& v4,
+                                                            bool prefer_ipv6) {
+      std::vector<std::variant<ipv4, ipv6>> order;
+      order.reserve(v6.size() + v4.size());
+      for (std::size_t i = 0; i < std::max(v6.size(), v4.size()); ++i) {
+        if (prefer_ipv6 && i < v6.size()) {
+          order.emplace_back(v6[i]);
+        }
+        if (i < v4.size()) {
+          order.emplace_back(v4[i]);
+        }
+        if (!prefer_ipv6 && i < v6.size()) {
+          order.emplace_back(v6[i]);
+        }
+      }
+      return order;
+    }
+  }  // namespace detail
+
+  // Connects to the first of several candidate addresses to answer, in the
+  // manner of RFC 8305 "happy eyeballs". Nonblocking connects start one
+  // attempt_delay apart in interleaved family order and race on one
+  // socket_observer, so an unresponsive address, commonly a broken IPv6
+  // path, costs one attempt_delay instead of a full connect timeout. The
+  // outcome of each attempt is read from SO_ERROR once it turns writable.
+  // Losing attempts are closed; the winner's name() is its peer. Throws
+  // socket_error with the error of the last failed attempt, or ETIMEDOUT
+  // when the deadline passes.
+  inline inet_socket happy_eyeballs_connect(const std::vector<ipv6>& v6, const std::vector<ipv4>& v4,
+                                            const happy_eyeballs_options& options = happy_eyeballs_options()) {
+    using clock = std::chrono::steady_clock;
+    struct attempt {
+      inet_socket sock;
+      clock::time_point deadline;
+
+      fd_type fd() const noexcept {
+        return std::visit([](const auto& s) { return s.fd(); }, sock);
+      }
+    };
+
+    auto candidates = detail::interleave(v6, v4, options.prefer_ipv6);
+    SOCKCP_ASSERT(!candidates.empty(), std::invalid_argument("happy_eyeballs_connect: no candidates"));
+    auto start = clock::now();
+    auto deadline = start + options.timeout;
+    auto next_start = start;
+    std::size_t next = 0;
+    int last_error = ETIMEDOUT;
+    std::vector<attempt> attempts;
+    socket_observer observer;
+
+    auto drop = [&](std::size_t i, int error) {
+      observer.detach_socket(attempts[i]);
+      attempts.erase(attempts.begin() + static_cast<std::ptrdiff_t>(i));
+      last_error = error;
+      next_start = clock::now();
+    };
+
+    for (;;) {
+      auto now = clock::now();
+      if (now >= deadline) {
+        break;
+      }
+      if (next < candidates.size() && (attempts.empty() || now >= next_start)) {
+        try {
+          attempt a{std::visit([](const auto& addr) -> inet_socket {
+            using family = std::decay_t<decltype(addr)>;
+            basic_socket<family> sock(socktype::stream);
+            sock.set_block(false);
+            sock.connect(addr);
+            return sock;
+          }, candidates[next]), std::min(now + options.attempt_timeout, deadline)};
+          observer.attach_socket(a, event::out);
+          attempts.push_back(std::move(a));
+          next_start = now + options.attempt_delay;
+        } catch (const socket_error& e) {
+          // Refused before leaving the host, e.g. no route for the family
+          last_error = e.code();
+          next_start = now;
+        }
+        ++next;
+        continue;
+      }
+      if (attempts.empty()) {
+        break;
+      }
+
+      auto wake = deadline;
+      for (auto& a : attempts) {
+        wake = std::min(wake, a.deadline);
+      }
+      if (next < candidates.size()) {
+        wake = std::min(wake, next_start);
+      }
+      auto wait = std::chrono::ceil<std::chrono::milliseconds>(std::max(wake - now, clock::duration::zero()));
+      auto ready = observer.poll(wait);
+      for (std::size_t i = attempts.size(); i--;) {
+        auto it = ready.find(attempts[i].fd());
+        if (it == ready.end()) {
+          if (clock::now() >= attempts[i].deadline) {
+            drop(i, ETIMEDOUT);
+          }
+          continue;
+        }
+        int error = std::visit([](const auto& s) { return s.template get_option<int>(SOL_SOCKET, SO_ERROR); },
+                               attempts[i].sock);
+        if (error) {
+          drop(i, error);
+          continue;
+        }
+        // Adopted again so name() reports the peer, as after accept()
+        return std::visit([&options](auto& s) -> inet_socket {
+          auto winner = std::decay_t<decltype(s)>::adopt(s.release());
+          if (!options.nonblocking) {
+            winner.set_block(true);
+          }
+          return winner;
+        }, attempts[i].sock);
+      }
+    }
+    errno = clock::now() >= deadline ? ETIMEDOUT : last_error;
+    throw socket_error("happy_eyeballs_connect");
+  }
+
+  // Connects to the addresses of a lookup, all on port; Result is a
+  // resolve_result or anything with the same v6 and v4 lists
+  template <typename Result>
+  inet_socket happy_eyeballs_connect(const Result& resolved, uint16_t port,
+                                     const happy_eyeballs_options& options = happy_eyeballs_options()) {
+    std::vector<ipv6> v6;
+    std::vector<ipv4> v4;
+    for (const auto& addr : resolved.v6) {
+      v6.push_back(addr);
+      v6.back().set_port(port);
+    }
+    for (const auto& addr : resolved.v4) {
+      v4.push_back(addr);
+      v4.back().set_port(port);
+    }
+    return happy_eyeballs_connect(v6, v4, options);
+  }
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_HAPPY_EYEBALLS_H_
@@ -3,7 +3,9 @@
 
 #include <array>
 #include <cstdint>
+#include <functional>
 #include <string>
+#include <string_view>
 #include <limits>
 // #include <charconv>
 
@@ -24,10 +26,251 @@
 #include "error.h"
 
 namespace sockcp {
+  namespace detail {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    constexpr bool big_endian = true;
+#else
+    constexpr bool big_endian = false;
+#endif
+
+    // constexpr replacements for htons/htonl, which are macros or plain
+    // functions depending on the platform
+    constexpr uint16_t host_to_net16(uint16_t v) noexcept {
+      return big_endian ? v : static_cast<uint16_t>((v >> 8) | (v << 8));
+    }
+
+    constexpr uint32_t host_to_net32(uint32_t v) noexcept {
+      return big_endian ? v : ((v >> 24) | ((v >> 8) & 0xff00) | ((v << 8) & 0xff0000) | (v << 24));
+    }
+
+    constexpr int hex_digit(char c) noexcept {
+      if (c >= '0' && c <= '9') {
+        return c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+      }
+      return -1;
+    }
+
+    // Decimal without sign or leading zeros, at most max.
+    constexpr bool parse_decimal(std::string_view text, uint32_t max, uint32_t& value) noexcept {
+      if (text.empty() || text.size() > 5 || (text.size() > 1 && text[0] == '0')) {
+        return false;
+      }
+      value = 0;
+      for (char c : text) {
+        if (c < '0' || c > '9') {
+          return false;
+        }
+        value = value*10 + (c - '0');
+      }
+      return value <= max;
+    }
+
+    // Strict dotted quad, as accepted by inet_pton.
+    constexpr bool parse_ipv4(std::string_view text, uint32_t& binary) noexcept {
+      binary = 0;
+      uint32_t byte = 0;
+      int digits = 0;
+      int dots = 0;
+      for (char c : text) {
+        if (c >= '0' && c <= '9') {
+          if (digits == 3 || (digits && !byte)) {
+            return false;
+          }
+          byte = byte*10 + (c - '0');
+          ++digits;
+        } else if (c == '.' && digits && dots < 3) {
+          if (byte > 255) {
+            return false;
+          }
+          binary = (binary << 8) | byte;
+          byte = digits = 0;
+          ++dots;
+        } else {
+          return false;
+        }
+      }
+      if (!digits || dots != 3 || byte > 255) {
+        return false;
+      }
+      binary = (binary << 8) | byte;
+      return true;
+    }
+
+    // RFC 4291 text form, including :: compression and a dotted quad tail.
+    constexpr bool parse_ipv6(std::string_view text, uint8_t (&bytes)[16]) noexcept {
+      uint16_t words[8] = {};
+      int count = 0;
+      int gap = -1;
+      if (text.substr(0, 2) == "::") {
+        gap = 0;
+        text.remove_prefix(2);
+      } else if (text.empty() || text[0] == ':') {
+        return false;
+      }
+      while (!text.empty()) {
+        if (count == 8) {
+          return false;
+        }
+        std::size_t end = text.find(':');
+        std::string_view group = text.substr(0, end);
+        if (group.find('.') != std::string_view::npos) {
+          uint32_t tail = 0;
+          if (end != std::string_view::npos || count > 6 || !parse_ipv4(group, tail)) {
+            return false;
+          }
+          words[count++] = static_cast<uint16_t>(tail >> 16);
+          words[count++] = static_cast<uint16_t>(tail);
+          break;
+        }
+        if (group.empty() || group.size() > 4) {
+          return false;
+        }
+        uint16_t word = 0;
+        for (char c : group) {
+          int digit = hex_digit(c);
+          if (digit < 0) {
+            return false;
+          }
+          word = static_cast<uint16_t>((word << 4) | digit);
+        }
+        words[count++] = word;
+        if (end == std::string_view::npos) {
+          break;
+        }
+        text.remove_prefix(end + 1);
+        if (!text.empty() && text[0] == ':') {
+          if (gap >= 0) {
+            return false;
+          }
+          gap = count;
+          text.remove_prefix(1);
+        } else if (text.empty()) {
+          return false;
+        }
+      }
+      if ((gap < 0 && count != 8) || (gap >= 0 && count == 8)) {
+        return false;
+      }
+      uint16_t expanded[8] = {};
+      int shift = gap < 0 ? 0 : 8 - count;
+      for (int i = 0; i < count; ++i) {
+        expanded[gap >= 0 && i >= gap ? i + shift : i] = words[i];
+      }
+      for (int i = 0; i < 8; ++i) {
+        bytes[2*i] = static_cast<uint8_t>(expanded[i] >> 8);
+        bytes[2*i + 1] = static_cast<uint8_t>(expanded[i]);
+      }
+      return true;
+    }
+
+    inline char* format_decimal(char* out, uint32_t value) noexcept {
+      char digits[10];
+      int n = 0;
+      do {
+        digits[n++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+      } while (value);
+      for (; n; *out++ = digits[--n]);
+      return out;
+    }
+
+    inline char* format_ipv4(char* out, uint32_t binary) noexcept {
+      out = format_decimal(out, binary >> 24);
+      for (int shift = 16; shift >= 0; shift -= 8) {
+        *out++ = '.';
+        out = format_decimal(out, (binary >> shift) & 0xff);
+      }
+      return out;
+    }
+
+    // RFC 5952 canonical form, with the same dotted quad tail rules as
+    // inet_ntop.
+    inline char* format_ipv6(char* out, const uint8_t* bytes) noexcept {
+      static constexpr char kHex[] = "0123456789abcdef";
+      uint16_t words[8];
+      for (int i = 0; i < 8; ++i) {
+        words[i] = static_cast<uint16_t>((bytes[2*i] << 8) | bytes[2*i + 1]);
+      }
+      int best = -1, best_len = 0;
+      for (int i = 0; i < 8;) {
+        int j = i;
+        for (; j < 8 && !words[j]; ++j);
+        if (j - i > best_len) {
+          best = i;
+          best_len = j - i;
+        }
+        i = j == i ? i + 1 : j;
+      }
+      if (best_len < 2) {
+        best = -1;
+      }
+      for (int i = 0; i < 8; ++i) {
+        if (i == best) {
+          *out++ = ':';
+          if (i == 0) {
+            *out++ = ':';
+          }
+          i += best_len - 1;
+          continue;
+        }
+        if (i == 6 && best == 0 && (best_len == 6 || (best_len == 5 && words[5] == 0xffff))) {
+          return format_ipv4(out, (uint32_t(words[6]) << 16) | words[7]);
+        }
+        int shift = 12;
+        for (; shift > 0 && !((words[i] >> shift) & 0xf); shift -= 4);
+        for (; shift >= 0; shift -= 4) {
+          *out++ = kHex[(words[i] >> shift) & 0xf];
+        }
+        if (i != 7) {
+          *out++ = ':';
+        }
+      }
+      return out;
+    }
+
+#if defined(__SIZEOF_INT128__)
+    __extension__ typedef unsigned __int128 uint128_t;
+#endif
+
+    // 64x64 -> 128 bit multiply folded back to 64 bits
+    constexpr uint64_t mul_fold(uint64_t a, uint64_t b) noexcept {
+#if defined(__SIZEOF_INT128__)
+      uint128_t r = static_cast<uint128_t>(a)*b;
+      return static_cast<uint64_t>(r) ^ static_cast<uint64_t>(r >> 64);
+#else
+      uint64_t a_lo = a & 0xffffffff, a_hi = a >> 32;
+      uint64_t b_lo = b & 0xffffffff, b_hi = b >> 32;
+      uint64_t lo_lo = a_lo*b_lo, hi_lo = a_hi*b_lo, lo_hi = a_lo*b_hi, hi_hi = a_hi*b_hi;
+      uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffff) + lo_hi;
+      uint64_t lo = (cross << 32) | (lo_lo & 0xffffffff);
+      uint64_t hi = hi_hi + (hi_lo >> 32) + (cross >> 32);
+      return lo ^ hi;
+#endif
+    }
+
+    constexpr uint64_t load_be64(const uint8_t* bytes) noexcept {
+      uint64_t v = 0;
+      for (int i = 0; i < 8; ++i) {
+        v = (v << 8) | bytes[i];
+      }
+      return v;
+    }
+
+    constexpr uint64_t hash_k0 = 0x9e3779b97f4a7c15ull;
+    constexpr uint64_t hash_k1 = 0xa0761d6478bd642full;
+    constexpr uint64_t hash_k2 = 0xe7037ed1a0b428dbull;
+  }  // namespace detail
+
   struct ipv4 final {
     static constexpr int family = AF_INET;
+    // "255.255.255.255:65535", format_to() never writes more than this
+    static constexpr std::size_t max_string_size = 21;
 
-    ipv4() noexcept : addr(::sockaddr_in{}) {
+    constexpr ipv4() noexcept : addr() {
       addr.sin_family = family;
     }
 
@@ -50,16 +293,34 @@ namespace sockcp {
       set_port(p);
     }
 
-    std::string to_string() const {
-      std::string res('a', 22);
-      ::inet_ntop(family, &addr.sin_addr, res.data(), 22);
-      std::size_t p = res.find('\0');
-      res[p] = ':';
-      res.resize(++p);
-      res += std::to_string(::ntohs(addr.sin_port));
+    // Parses "a.b.c.d" or "a.b.c.d:port", usable in constant expressions.
+    static constexpr ipv4 from_string(std::string_view text) {
+      ipv4 res;
+      std::size_t colon = text.find(':');
+      uint32_t binary = 0;
+      uint32_t port = 0;
+      SOCKCP_ASSERT(
+        detail::parse_ipv4(text.substr(0, colon), binary)
+          && (colon == std::string_view::npos || detail::parse_decimal(text.substr(colon + 1), 65535, port)),
+        protocol_error("Invalid address provided", typeid(ipv4))
+      );
+      res.addr.sin_addr.s_addr = detail::host_to_net32(binary);
+      res.addr.sin_port = detail::host_to_net16(static_cast<uint16_t>(port));
       return res;
     }
 
+    // Writes "a.b.c.d:port" without a terminating zero, returns the end.
+    char* format_to(char* out) const noexcept {
+      out = detail::format_ipv4(out, detail::host_to_net32(addr.sin_addr.s_addr));
+      *out++ = ':';
+      return detail::format_decimal(out, detail::host_to_net16(addr.sin_port));
+    }
+
+    std::string to_string() const {
+      char buf[max_string_size];
+      return std::string(buf, format_to(buf));
+    }
+
     constexpr int size() const noexcept {
       return sizeof(::sockaddr_in);
     }
@@ -67,10 +328,10 @@ namespace sockcp {
     std::array<uint8_t, 4> address() const noexcept {
       std::array<uint8_t, 4> res{};
       uint32_t bn = binary();
-      res[0] = bn & 0xff000000;
-      res[1] = bn & 0x00ff0000;
-      res[2] = bn & 0x0000ff00;
-      res[3] = bn & 0x000000ff;
+      res[0] = bn >> 24;
+      res[1] = bn >> 16;
+      res[2] = bn >> 8;
+      res[3] = bn;
       return res;
     }
 
@@ -79,7 +340,7 @@ namespace sockcp {
       return 0;  // std::unreachable
     }
 
-    uint16_t port() noexcept {
+    uint16_t port() const noexcept {
       SOCKCP_WRAP_NOEXCEPT(return ::ntohs(addr.sin_port););
       return 0;  // std::unreachable
     }
@@ -120,10 +381,48 @@ namespace sockcp {
     ::sockaddr_in addr;
   };
 
+  // Address and port in host order, packed as (address << 16) | port.
+  // Orders the same way as the numeric address followed by the port.
+  constexpr uint64_t pack(const ipv4& ip) noexcept {
+    return (uint64_t(detail::host_to_net32(ip.addr.sin_addr.s_addr)) << 16)
+      | detail::host_to_net16(ip.addr.sin_port);
+  }
+
+  constexpr bool operator==(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) == pack(rhs);
+  }
+
+  constexpr bool operator!=(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) != pack(rhs);
+  }
+
+  constexpr bool operator<(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) < pack(rhs);
+  }
+
+  constexpr bool operator>(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) > pack(rhs);
+  }
+
+  constexpr bool operator<=(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) <= pack(rhs);
+  }
+
+  constexpr bool operator>=(const ipv4& lhs, const ipv4& rhs) noexcept {
+    return pack(lhs) >= pack(rhs);
+  }
+
+  // Fibonacci hashing: a single multiply, the entropy ends up in the high bits.
+  constexpr uint64_t hash_value(const ipv4& ip) noexcept {
+    return pack(ip)*detail::hash_k0;
+  }
+
   struct ipv6 final {
     static constexpr int family = AF_INET6;
+    // "[" + 45 characters of address + "]:65535"
+    static constexpr std::size_t max_string_size = 53;
 
-    ipv6() noexcept : addr(::sockaddr_in6{}) {
+    constexpr ipv6() noexcept : addr() {
       addr.sin6_family = family;
     }
 
@@ -141,23 +440,46 @@ namespace sockcp {
     ipv6(const char* address, uint16_t port = 0) : ipv6() {
       SOCKCP_ASSERT(
         ::inet_pton(family, address, &addr.sin6_addr) > 0, 
-        protocol_error("Invalid address provided", typeid(ipv4))
+        protocol_error("Invalid address provided", typeid(ipv6))
       )
       addr.sin6_port = ::htons(port);
     }
 
-    std::string to_string() const {
-      std::string res('a', 47);
-      res[0] = '[';
-      ::inet_ntop(AF_INET6, &addr.sin6_addr, res.data() + 1, 22);
-      std::size_t p = res.find('\0');
-      res[p] = ']';
-      res[++p] = ':';
-      res.resize(++p);
-      res += std::to_string(::ntohs(addr.sin6_port));
+    // Parses "addr", "[addr]" or "[addr]:port", usable in constant
+    // expressions.
+    static constexpr ipv6 from_string(std::string_view text) {
+      ipv6 res;
+      uint32_t port = 0;
+      bool valid = true;
+      if (!text.empty() && text[0] == '[') {
+        std::size_t close = text.find(']');
+        valid = close != std::string_view::npos
+          && (close + 1 == text.size()
+              || (text[close + 1] == ':' && detail::parse_decimal(text.substr(close + 2), 65535, port)));
+        text = text.substr(1, close - 1);
+      }
+      SOCKCP_ASSERT(
+        valid && detail::parse_ipv6(text, res.addr.sin6_addr.s6_addr),
+        protocol_error("Invalid address provided", typeid(ipv6))
+      );
+      res.addr.sin6_port = detail::host_to_net16(static_cast<uint16_t>(port));
       return res;
     }
 
+    // Writes "[addr]:port" without a terminating zero, returns the end.
+    char* format_to(char* out) const noexcept {
+      *out++ = '[';
+      out = detail::format_ipv6(out, addr.sin6_addr.s6_addr);
+      *out++ = ']';
+      *out++ = ':';
+      return detail::format_decimal(out, detail::host_to_net16(addr.sin6_port));
+    }
+
+    std::string to_string() const {
+      char buf[max_string_size];
+      return std::string(buf, format_to(buf));
+    }
+
     constexpr int size() const noexcept {
       return sizeof(::sockaddr_in6);
     }
@@ -168,7 +490,7 @@ namespace sockcp {
       return res;
     }
 
-    uint16_t port() noexcept {
+    uint16_t port() const noexcept {
       SOCKCP_WRAP_NOEXCEPT(return ::ntohs(addr.sin6_port););
       return 0;  // std::unreachable
     }
@@ -186,7 +508,7 @@ namespace sockcp {
     void set_address(const char* address)  {
       SOCKCP_ASSERT(
         ::inet_pton(family, address, &addr.sin6_addr) > 0,
-        protocol_error("Invalid address provided", typeid(ipv4))
+        protocol_error("Invalid address provided", typeid(ipv6))
       );
     }
 
@@ -204,7 +526,80 @@ namespace sockcp {
 
     ::sockaddr_in6 addr;
   };
+
+  // Flow label and scope id do not take part in comparison or hashing.
+  constexpr int compare(const ipv6& lhs, const ipv6& rhs) noexcept {
+    for (int i = 0; i < 16; ++i) {
+      if (lhs.addr.sin6_addr.s6_addr[i] != rhs.addr.sin6_addr.s6_addr[i]) {
+        return lhs.addr.sin6_addr.s6_addr[i] < rhs.addr.sin6_addr.s6_addr[i] ? -1 : 1;
+      }
+    }
+    uint16_t lport = detail::host_to_net16(lhs.addr.sin6_port);
+    uint16_t rport = detail::host_to_net16(rhs.addr.sin6_port);
+    return lport == rport ? 0 : (lport < rport ? -1 : 1);
+  }
+
+  constexpr bool operator==(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return lhs.addr.sin6_port == rhs.addr.sin6_port && !compare(lhs, rhs);
+  }
+
+  constexpr bool operator!=(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return !(lhs == rhs);
+  }
+
+  constexpr bool operator<(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return compare(lhs, rhs) < 0;
+  }
+
+  constexpr bool operator>(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return compare(lhs, rhs) > 0;
+  }
+
+  constexpr bool operator<=(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return compare(lhs, rhs) <= 0;
+  }
+
+  constexpr bool operator>=(const ipv6& lhs, const ipv6& rhs) noexcept {
+    return compare(lhs, rhs) >= 0;
+  }
+
+  // Both address halves go through one 128 bit multiply, then the port is
+  // folded in with a second one.
+  constexpr uint64_t hash_value(const ipv6& ip) noexcept {
+    uint64_t hi = detail::load_be64(ip.addr.sin6_addr.s6_addr);
+    uint64_t lo = detail::load_be64(ip.addr.sin6_addr.s6_addr + 8);
+    uint64_t h = detail::mul_fold(hi ^ detail::hash_k1, lo ^ detail::hash_k2);
+    return detail::mul_fold(h ^ detail::host_to_net16(ip.addr.sin6_port), detail::hash_k0);
+  }
+
+  inline namespace literals {
+    // "10.0.0.1:80"_ipv4, parsed at compile time in constant expressions
+    constexpr ipv4 operator""_ipv4(const char* text, std::size_t len) {
+      return ipv4::from_string(std::string_view(text, len));
+    }
+
+    // "[fd00::1]:80"_ipv6 or "fd00::1"_ipv6
+    constexpr ipv6 operator""_ipv6(const char* text, std::size_t len) {
+      return ipv6::from_string(std::string_view(text, len));
+    }
+  }  // namespace literals
 }  // namespace sockcp
 
-#endif  // SOCKCP_SOCKCP_INET_ADDRESS_H_
+namespace std {
+  template <>
+  struct hash<sockcp::ipv4> {
+    std::size_t operator()(const sockcp::ipv4& ip) const noexcept {
+      uint64_t h = sockcp::hash_value(ip);
+      return static_cast<std::size_t>(h ^ (h >> 32));
+    }
+  };
 
+  template <>
+  struct hash<sockcp::ipv6> {
+    std::size_t operator()(const sockcp::ipv6& ip) const noexcept {
+      return static_cast<std::size_t>(sockcp::hash_value(ip));
+    }
+  };
+}  // namespace std
+
+#endif  // SOCKCP_SOCKCP_INET_ADDRESS_H_
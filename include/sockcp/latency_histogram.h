@@ -0,0 +1,114 @@
+#ifndef SOCKCP_SOCKCP_LATENCY_HISTOGRAM_H_
+#define SOCKCP_SOCKCP_LATENCY_HISTOGRAM_H_
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <limits>
+
+namespace sockcp {
+  // Fixed size log-linear histogram of nanosecond latencies. Every power of
+  // two range is split into 16 buckets, so any recorded value is reported
+  // within 1/16 (6.25%) of itself, from 1 ns up to about 18 minutes; larger
+  // values land in the last bucket. Recording is a few shifts and an add,
+  // cheap enough to keep one histogram per connection and stage.
+  class latency_histogram final {
+    static constexpr unsigned sub_bits = 4;
+    static constexpr unsigned sub_count = 1u << sub_bits;
+    static constexpr unsigned max_bits = 40;
+    static constexpr unsigned bucket_count = (max_bits - sub_bits + 1)*sub_count;
+
+   public:
+    void record(std::chrono::nanoseconds value) noexcept {
+      uint64_t v = value.count() > 0 ? static_cast<uint64_t>(value.count()) : 0;
+      ++buckets_[index(v)];
+      ++count_;
+      sum_ += v;
+      min_ = std::min(min_, v);
+      max_ = std::max(max_, v);
+    }
+
+    uint64_t count() const noexcept { return count_; }
+
+    std::chrono::nanoseconds min() const noexcept {
+      return std::chrono::nanoseconds(count_ ? min_ : 0);
+    }
+
+    std::chrono::nanoseconds max() const noexcept {
+      return std::chrono::nanoseconds(max_);
+    }
+
+    std::chrono::nanoseconds mean() const noexcept {
+      return std::chrono::nanoseconds(count_ ? sum_/count_ : 0);
+    }
+
+    // Upper bound of the bucket holding quantile q in [0, 1], clamped to
+    // the largest recorded value.
+    std::chrono::nanoseconds percentile(double q) const noexcept {
+      if (!count_) {
+        return std::chrono::nanoseconds(0);
+      }
+      q = std::clamp(q, 0.0, 1.0);
+      uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(q*count_ + 0.5));
+      uint64_t seen = 0;
+      for (unsigned i = 0; i < bucket_count; ++i) {
+        seen += buckets_[i];
+        if (seen >= rank) {
+          // The last bucket is open ended
+          return std::chrono::nanoseconds(i == bucket_count - 1 ? max_ : std::min(upper_bound(i), max_));
+        }
+      }
+      return max();
+    }
+
+    void merge(const latency_histogram& other) noexcept {
+      for (unsigned i = 0; i < bucket_count; ++i) {
+        buckets_[i] += other.buckets_[i];
+      }
+      count_ += other.count_;
+      sum_ += other.sum_;
+      min_ = std::min(min_, other.min_);
+      max_ = std::max(max_, other.max_);
+    }
+
+    void reset() noexcept {
+      *this = latency_histogram();
+    }
+
+   private:
+    static unsigned index(uint64_t v) noexcept {
+      if (v < sub_count) {
+        return static_cast<unsigned>(v);
+      }
+      unsigned msb = 0;
+      for (unsigned step = 32; step; step >>= 1) {
+        if (v >> (msb + step)) {
+          msb += step;
+        }
+      }
+      if (msb >= max_bits) {
+        return bucket_count - 1;
+      }
+      unsigned shift = msb - sub_bits;
+      return (shift + 1)*sub_count + static_cast<unsigned>((v >> shift) & (sub_count - 1));
+    }
+
+    static uint64_t upper_bound(unsigned i) noexcept {
+      if (i < sub_count) {
+        return i;
+      }
+      unsigned shift = i/sub_count - 1;
+      uint64_t base = uint64_t(sub_count + i % sub_count) << shift;
+      return base + (uint64_t(1) << shift) - 1;
+    }
+
+    std::array<uint32_t, bucket_count> buckets_{};
+    uint64_t count_ = 0;
+    uint64_t sum_ = 0;
+    uint64_t min_ = std::numeric_limits<uint64_t>::max();
+    uint64_t max_ = 0;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_LATENCY_HISTOGRAM_H_
@@ -0,0 +1,237 @@
+#ifndef SOCKCP_SOCKCP_LISTENER_H_
+#define SOCKCP_SOCKCP_LISTENER_H_
+
+#if !(defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__))
+#error Listeners are only supported on Unix
+#endif
+
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "event_loop.h"
+#include "socket.h"
+
+namespace sockcp {
+  struct listener_options {
+    // Accept queue length; the kernel caps it at net.core.somaxconn
+    int backlog = SOMAXCONN;
+    // TCP_DEFER_ACCEPT (Linux): connections stay off the accept queue
+    // until their first data arrives or this long has passed, so a
+    // storm of idle connects wakes nobody. Zero disables it.
+    std::chrono::seconds defer_accept{0};
+    // TCP_FASTOPEN: length of the queue of connections whose SYN carried
+    // data not yet accepted; zero disables it. Takes effect only where the
+    // net.ipv4.tcp_fastopen sysctl enables server support (bit 1).
+    int fastopen_queue = 0;
+    bool reuse_address = true;
+    // Connections accepted per readiness event before returning to the
+    // loop, so one busy listener cannot starve its other sockets
+    std::size_t accept_batch = 64;
+  };
+
+  // Stream listening socket configured for connection storms. The socket
+  // is nonblocking and accept_all() drains the accept queue in batches,
+  // handing out nonblocking connections (accept4() on Linux), the form an
+  // event loop wants. Options the platform lacks throw invalid_argument
+  // instead of being ignored.
+  template <typename ProtocolFamily>
+  class basic_listener final {
+   public:
+    // Called with every accepted connection
+    using accept_handler = std::function<void(basic_socket<ProtocolFamily>&&)>;
+    // Called with accept() failures other than a connection lost before
+    // it was accepted, typically EMFILE or ENFILE when descriptors run out
+    using error_handler = std::function<void(const socket_error&)>;
+
+    explicit basic_listener(const ProtocolFamily& addr, const listener_options& options = listener_options())
+        : basic_listener(addr, options, false) {}
+
+    // Not movable: attach() registers this object with the loop
+    basic_listener(const basic_listener&) = delete;
+    basic_listener& operator=(const basic_listener&) = delete;
+
+    // Bound address, with the port the kernel chose if addr had none
+    const ProtocolFamily& address() const noexcept { return address_; }
+
+    const listener_options& options() const noexcept { return options_; }
+
+    fd_type fd() const noexcept { return sock_.fd(); }
+
+    basic_socket<ProtocolFamily>& socket() noexcept { return sock_; }
+
+    // Makes up to options().accept_batch accept attempts, calling
+    // on_accept(basic_socket&&) for each connection. A connection reset or
+    // aborted while queued is skipped; any other failure ends the batch
+    // and goes to on_error(const socket_error&). Returns the number
+    // accepted, 0 once the queue is empty.
+    template <typename Func, typename ErrorFunc>
+    std::size_t accept_all(Func&& on_accept, ErrorFunc&& on_error) {
+      std::size_t accepted = 0;
+      for (std::size_t tries = 0; tries < options_.accept_batch; ++tries) {
+        std::optional<basic_socket<ProtocolFamily>> sock;
+        try {
+          sock.emplace(sock_.accept_nonblocking());
+        } catch (const socket_error& e) {
+          if (skippable(e.code())) {
+            continue;
+          }
+          on_error(e);
+          break;
+        }
+        if (sock->fd() == fd_invalid) {
+          break;
+        }
+        ++accepted;
+        on_accept(std::move(*sock));
+      }
+      return accepted;
+    }
+
+    // As above, throwing socket_error on failures that are not skipped
+    template <typename Func>
+    std::size_t accept_all(Func&& on_accept) {
+      return accept_all(std::forward<Func>(on_accept), [](const socket_error& e) { throw e; });
+    }
+
+    // Accepts on loop's thread whenever connections are pending. Accept
+    // failures go to on_error instead of out of the loop, and are dropped
+    // without one; the next readiness event retries, so keep spare
+    // descriptors or detach the listener while they run out. The
+    // listener must outlive the attachment.
+    void attach(event_loop& loop, accept_handler on_accept, error_handler on_error = error_handler()) {
+      loop.attach(sock_, event::in,
+                  [this, on_accept = std::move(on_accept), on_error = std::move(on_error)](event) {
+        accept_all(on_accept, [&on_error](const socket_error& e) {
+          if (on_error) {
+            on_error(e);
+          }
+        });
+      });
+    }
+
+   private:
+    template <typename>
+    friend class basic_listener_group;
+
+    // Failures of one queued connection rather than of the listener; Linux
+    // also passes pending network errors of the new connection to accept()
+    static bool skippable(int error) noexcept {
+      switch (error) {
+        case ECONNABORTED:
+        case EINTR:
+        case EPROTO:
+#if defined(__linux__)
+        case ENETDOWN:
+        case ENOPROTOOPT:
+        case EHOSTDOWN:
+        case ENONET:
+        case EHOSTUNREACH:
+        case EOPNOTSUPP:
+        case ENETUNREACH:
+#endif
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    basic_listener(const ProtocolFamily& addr, const listener_options& options, bool reuse_port)
+        : sock_(socktype::stream), options_(options) {
+      if (options_.reuse_address) {
+        sock_.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+      }
+      if (reuse_port) {
+#if defined(SO_REUSEPORT)
+        sock_.set_option(SOL_SOCKET, SO_REUSEPORT, 1);
+#else
+        SOCKCP_ASSERT(false, std::invalid_argument("listener: SO_REUSEPORT unsupported"));
+#endif
+      }
+      if (options_.defer_accept.count() > 0) {
+#if defined(TCP_DEFER_ACCEPT)
+        sock_.set_option(IPPROTO_TCP, TCP_DEFER_ACCEPT, static_cast<int>(options_.defer_accept.count()));
+#else
+        SOCKCP_ASSERT(false, std::invalid_argument("listener: TCP_DEFER_ACCEPT unsupported"));
+#endif
+      }
+      if (options_.fastopen_queue > 0) {
+#if defined(TCP_FASTOPEN)
+        sock_.set_option(IPPROTO_TCP, TCP_FASTOPEN, options_.fastopen_queue);
+#else
+        SOCKCP_ASSERT(false, std::invalid_argument("listener: TCP_FASTOPEN unsupported"));
+#endif
+      }
+      sock_.bind(addr);
+      address_ = addr;
+      socklen_t len = address_.size();
+      SOCKCP_ASSERT(!::getsockname(sock_.fd(), address_.data(), &len), socket_error("getsockname"));
+      sock_.set_block(false);
+      sock_.listen(options_.backlog);
+    }
+
+    basic_socket<ProtocolFamily> sock_;
+    listener_options options_;
+    ProtocolFamily address_;
+  };
+
+  // Listeners sharing one address through SO_REUSEPORT. The kernel
+  // spreads incoming connections over the members by a hash of the
+  // connection, so each member can be accepted from by its own event
+  // loop with no shared accept queue or lock. See sharded_listener in
+  // steering.h to pick the member by receiving CPU instead.
+  template <typename ProtocolFamily>
+  class basic_listener_group final {
+   public:
+    using accept_handler = typename basic_listener<ProtocolFamily>::accept_handler;
+    using error_handler = typename basic_listener<ProtocolFamily>::error_handler;
+
+    basic_listener_group(const ProtocolFamily& addr, std::size_t count,
+                         const listener_options& options = listener_options()) {
+      SOCKCP_ASSERT(count, std::invalid_argument("listener_group: no members"));
+      members_.reserve(count);
+      ProtocolFamily bound = addr;
+      for (std::size_t i = 0; i < count; ++i) {
+        members_.push_back(std::unique_ptr<basic_listener<ProtocolFamily>>(
+          new basic_listener<ProtocolFamily>(bound, options, true)));
+        // The first member fixes the port for the rest
+        bound = members_.front()->address();
+      }
+    }
+
+    std::size_t size() const noexcept { return members_.size(); }
+
+    const ProtocolFamily& address() const noexcept { return members_.front()->address(); }
+
+    basic_listener<ProtocolFamily>& operator[](std::size_t member) noexcept { return *members_[member]; }
+
+    // Attaches member i to loops[i]; there must be one loop per member.
+    // on_accept runs on the thread of the loop that accepted.
+    void attach(const std::vector<event_loop*>& loops, const accept_handler& on_accept,
+                const error_handler& on_error = error_handler()) {
+      SOCKCP_ASSERT(loops.size() == members_.size(), std::invalid_argument("listener_group: one loop per member"));
+      for (std::size_t i = 0; i < members_.size(); ++i) {
+        members_[i]->attach(*loops[i], on_accept, on_error);
+      }
+    }
+
+   private:
+    // Held by pointer so the group can move while members stay attached
+    std::vector<std::unique_ptr<basic_listener<ProtocolFamily>>> members_;
+  };
+
+  using listener = basic_listener<ipv4>;
+  using listener_group = basic_listener_group<ipv4>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_LISTENER_H_
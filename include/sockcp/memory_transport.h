@@ -0,0 +1,663 @@
+#ifndef SOCKCP_SOCKCP_MEMORY_TRANSPORT_H_
+#define SOCKCP_SOCKCP_MEMORY_TRANSPORT_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "socket.h"
+#include "socket_buffer.h"
+#include "socket_observer.h"
+
+namespace sockcp {
+  // Faults injected by the in-memory transport. Every choice comes from
+  // a counter or a generator seeded with seed, so a run with the same
+  // calls and faults behaves the same every time.
+  struct memory_faults {
+    std::size_t max_read = 0;            // bytes one recv() returns at most, 0 for no cap
+    std::size_t max_write = 0;           // bytes one send() accepts at most, 0 for no cap
+    bool random_sizes = false;           // draw each cap uniformly from [1, max] instead
+    unsigned eagain_every = 0;           // every nth recv()/send() of a nonblocking socket
+                                         // fails with EAGAIN, 0 for never
+    uint64_t seed = 1;
+    std::size_t buffer_size = 1u << 18;  // bytes queued per direction before send() stalls
+  };
+
+  struct memory_stats {
+    uint64_t recv_calls = 0;
+    uint64_t send_calls = 0;
+    uint64_t bytes = 0;                  // moved from senders to receive queues
+    uint64_t short_reads = 0;            // cut by max_read
+    uint64_t short_writes = 0;           // cut by max_write
+    uint64_t eagains = 0;                // injected, not from empty or full queues
+  };
+
+  // Process wide in-memory stand-in for the kernel's stream sockets,
+  // reached through memory_calls. Connections are a pair of byte queues;
+  // bind, listen, connect and accept pair them up by address, and poll
+  // reports readiness from the queues. Blocking calls wait for another
+  // thread, so single threaded code should use nonblocking sockets or
+  // only read what it has written. Only SOCK_STREAM is modelled.
+  //
+  // Descriptors start at first_fd, far above typical kernel ones, and the
+  // lowest free one is reused first, as POSIX does.
+  class memory_network final {
+   public:
+    static constexpr fd_type first_fd = 1 << 20;
+
+    static memory_network& instance() {
+      static memory_network network;
+      return network;
+    }
+
+    memory_network(const memory_network&) = delete;
+    memory_network& operator=(const memory_network&) = delete;
+
+    // Applies to calls made from now on and restarts the fault sequence
+    void configure(const memory_faults& faults) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      faults_ = faults;
+      rng_ = faults.seed ? faults.seed : 1;
+      eagain_count_ = 0;
+    }
+
+    memory_faults faults() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return faults_;
+    }
+
+    memory_stats stats() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return stats_;
+    }
+
+    void reset_stats() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stats_ = memory_stats();
+    }
+
+    // Descriptors currently open
+    std::size_t open() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return endpoints_.size();
+    }
+
+    // A connected pair of family sockets without addresses, like
+    // socketpair(); adopt() them into basic_memory_socket.
+    std::pair<fd_type, fd_type> pair(int family) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      fd_type a = create(family, SOCK_STREAM);
+      fd_type b = create(family, SOCK_STREAM);
+      link(endpoints_[a], a, endpoints_[b], b);
+      return {a, b};
+    }
+
+    fd_type socket(int family, int type, int /*protocol*/) {
+      if (type != SOCK_STREAM) {
+        return fail<fd_type>(EPROTONOSUPPORT);
+      }
+      std::lock_guard<std::mutex> lock(mutex_);
+      return create(family, type);
+    }
+
+    int close(fd_type fd) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (!find(fd)) {
+        return fail(EBADF);
+      }
+      destroy(fd);
+      changed_.notify_all();
+      return 0;
+    }
+
+    int bind(fd_type fd, const ::sockaddr* addr, socklen_t len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      if (!ep->name.empty()) {
+        return fail(EINVAL);
+      }
+      std::string name(reinterpret_cast<const char*>(addr), static_cast<std::size_t>(len));
+      if (!assign_port(name)) {
+        return fail(EADDRNOTAVAIL);
+      }
+      if (bound_.count(name)) {
+        return fail(EADDRINUSE);
+      }
+      bound_.emplace(name, fd);
+      ep->name = std::move(name);
+      return 0;
+    }
+
+    int listen(fd_type fd, int /*backlog*/) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      if (ep->name.empty() || ep->connected) {
+        return fail(EINVAL);
+      }
+      ep->listening = true;
+      return 0;
+    }
+
+    // Completes at once: the connection sits in the listener's backlog
+    // and is writable before accept().
+    int connect(fd_type fd, const ::sockaddr* addr, socklen_t len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      if (ep->connected || ep->listening) {
+        return fail(EISCONN);
+      }
+      auto it = bound_.find(std::string(reinterpret_cast<const char*>(addr), static_cast<std::size_t>(len)));
+      endpoint* listener = it == bound_.end() ? nullptr : find(it->second);
+      if (!listener || !listener->listening) {
+        return fail(ECONNREFUSED);
+      }
+      fd_type server_fd = create(ep->family, ep->type);
+      endpoint& server = endpoints_[server_fd];
+      server.name = listener->name;
+      link(*ep, fd, server, server_fd);
+      listener->backlog.push_back(server_fd);
+      changed_.notify_all();
+      return 0;
+    }
+
+    fd_type accept(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail<fd_type>(EBADF);
+      }
+      if (!ep->listening) {
+        return fail<fd_type>(EINVAL);
+      }
+      uint64_t generation = ep->generation;
+      while (ep->backlog.empty()) {
+        if (ep->nonblocking) {
+          return fail<fd_type>(EAGAIN);
+        }
+        changed_.wait(lock);
+        if (!(ep = find(fd, generation))) {
+          return fail<fd_type>(EBADF);
+        }
+      }
+      fd_type conn = ep->backlog.front();
+      ep->backlog.pop_front();
+      if (addr && len) {
+        address(endpoints_[conn].peer_name, endpoints_[conn].family, addr, len);
+      }
+      return conn;
+    }
+
+    std::ptrdiff_t recv(fd_type fd, char* data, std::size_t count, int flags) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++stats_.recv_calls;
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail<std::ptrdiff_t>(EBADF);
+      }
+      if (!ep->connected) {
+        return fail<std::ptrdiff_t>(ENOTCONN);
+      }
+      bool nonblocking = ep->nonblocking || (flags & dontwait);
+      if (nonblocking && inject_eagain()) {
+        return fail<std::ptrdiff_t>(EAGAIN);
+      }
+      uint64_t generation = ep->generation;
+      while (!ep->queued() && !ep->eof && !ep->read_shut) {
+        if (nonblocking) {
+          return fail<std::ptrdiff_t>(EAGAIN);
+        }
+        changed_.wait(lock);
+        if (!(ep = find(fd, generation))) {
+          return fail<std::ptrdiff_t>(EBADF);
+        }
+      }
+      if (ep->read_shut || !count) {
+        return 0;
+      }
+      std::size_t avail = std::min(count, ep->queued());
+      std::size_t n = std::min(avail, cap(faults_.max_read));
+      stats_.short_reads += n < avail;
+      std::memcpy(data, ep->inbox.data() + ep->head, n);
+      if (!(flags & MSG_PEEK)) {
+        ep->head += n;
+        if (ep->head == ep->inbox.size()) {
+          ep->inbox.clear();
+          ep->head = 0;
+        } else if (ep->head >= ep->inbox.size()/2) {
+          ep->inbox.erase(ep->inbox.begin(), ep->inbox.begin() + static_cast<std::ptrdiff_t>(ep->head));
+          ep->head = 0;
+        }
+        changed_.notify_all();
+      }
+      return static_cast<std::ptrdiff_t>(n);
+    }
+
+    // Fails with EPIPE once the peer is gone; there is no SIGPIPE.
+    std::ptrdiff_t send(fd_type fd, const char* data, std::size_t count, int flags) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      ++stats_.send_calls;
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail<std::ptrdiff_t>(EBADF);
+      }
+      if (!ep->connected) {
+        return fail<std::ptrdiff_t>(ENOTCONN);
+      }
+      bool nonblocking = ep->nonblocking || (flags & dontwait);
+      if (nonblocking && inject_eagain()) {
+        return fail<std::ptrdiff_t>(EAGAIN);
+      }
+      uint64_t generation = ep->generation;
+      endpoint* peer;
+      for (;;) {
+        peer = find(ep->peer);
+        if (ep->write_shut || !peer || peer->read_shut) {
+          return fail<std::ptrdiff_t>(EPIPE);
+        }
+        if (!count || peer->queued() < faults_.buffer_size) {
+          break;
+        }
+        if (nonblocking) {
+          return fail<std::ptrdiff_t>(EAGAIN);
+        }
+        changed_.wait(lock);
+        if (!(ep = find(fd, generation))) {
+          return fail<std::ptrdiff_t>(EBADF);
+        }
+      }
+      std::size_t avail = std::min(count, faults_.buffer_size - peer->queued());
+      std::size_t n = std::min(avail, cap(faults_.max_write));
+      stats_.short_writes += n < avail;
+      stats_.bytes += n;
+      peer->inbox.insert(peer->inbox.end(), data, data + n);
+      changed_.notify_all();
+      return static_cast<std::ptrdiff_t>(n);
+    }
+
+    int shutdown(fd_type fd, int how) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      if (!ep->connected) {
+        return fail(ENOTCONN);
+      }
+      if (how != static_cast<int>(closeway::write)) {
+        ep->read_shut = true;
+      }
+      if (how != static_cast<int>(closeway::read)) {
+        ep->write_shut = true;
+        if (endpoint* peer = find(ep->peer)) {
+          peer->eof = true;
+        }
+      }
+      changed_.notify_all();
+      return 0;
+    }
+
+    // Options are accepted and ignored; reads report SO_TYPE and zeros
+    int setsockopt(fd_type fd, int /*level*/, int /*name*/, const void* /*value*/, socklen_t /*len*/) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      return find(fd) ? 0 : fail(EBADF);
+    }
+
+    int getsockopt(fd_type fd, int level, int name, void* value, socklen_t* len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      std::memset(value, 0, static_cast<std::size_t>(*len));
+      if (level == SOL_SOCKET && name == SO_TYPE && static_cast<std::size_t>(*len) >= sizeof(int)) {
+        std::memcpy(value, &ep->type, sizeof(int));
+      }
+      return 0;
+    }
+
+    int getsockname(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      address(ep->name, ep->family, addr, len);
+      return 0;
+    }
+
+    int getpeername(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      if (!ep->connected) {
+        return fail(ENOTCONN);
+      }
+      address(ep->peer_name, ep->family, addr, len);
+      return 0;
+    }
+
+    int set_nonblocking(fd_type fd, bool on) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return fail(EBADF);
+      }
+      ep->nonblocking = on;
+      return 0;
+    }
+
+    bool nonblocking(fd_type fd) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      endpoint* ep = find(fd);
+      return ep && ep->nonblocking;
+    }
+
+    int poll(pollfd_t* fds, std::size_t count, int timeout) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout, 0));
+      for (;;) {
+        int ready = 0;
+        for (std::size_t i = 0; i < count; ++i) {
+          short always = POLLERR | POLLHUP | POLLNVAL;
+          fds[i].revents = static_cast<short>(readiness(fds[i].fd) & (fds[i].events | always));
+          ready += fds[i].revents != 0;
+        }
+        if (ready || !timeout) {
+          return ready;
+        }
+        if (timeout < 0) {
+          changed_.wait(lock);
+        } else if (changed_.wait_until(lock, deadline) == std::cv_status::timeout) {
+          timeout = 0;
+        }
+      }
+    }
+
+   private:
+#if defined(MSG_DONTWAIT)
+    static constexpr int dontwait = MSG_DONTWAIT;
+#else
+    static constexpr int dontwait = 0;
+#endif
+
+    struct endpoint {
+      std::size_t queued() const noexcept { return inbox.size() - head; }
+
+      int family = 0;
+      int type = 0;
+      bool nonblocking = false;
+      bool listening = false;
+      bool connected = false;
+      bool eof = false;         // the peer will send nothing more
+      bool read_shut = false;
+      bool write_shut = false;
+      fd_type peer = fd_invalid;
+      std::string name;         // raw sockaddr, empty until bound
+      std::string peer_name;
+      std::deque<fd_type> backlog;
+      std::vector<char> inbox;  // received bytes from head on
+      std::size_t head = 0;
+      uint64_t generation = 0;  // tells apart sockets reusing one fd
+    };
+
+    memory_network() = default;
+
+    template <typename T = int>
+    static T fail(int error) noexcept {
+      errno = error;
+      return static_cast<T>(-1);
+    }
+
+    endpoint* find(fd_type fd) noexcept {
+      auto it = endpoints_.find(fd);
+      return it == endpoints_.end() ? nullptr : &it->second;
+    }
+
+    // Finds fd again after a wait, null if it was closed meanwhile, also
+    // when a new socket has taken the number since
+    endpoint* find(fd_type fd, uint64_t generation) noexcept {
+      endpoint* ep = find(fd);
+      return ep && ep->generation == generation ? ep : nullptr;
+    }
+
+    fd_type create(int family, int type) {
+      fd_type fd;
+      if (free_.empty()) {
+        fd = next_fd_++;
+      } else {
+        fd = free_.top();
+        free_.pop();
+      }
+      endpoint& ep = endpoints_[fd];
+      ep.family = family;
+      ep.type = type;
+      ep.generation = ++generation_;
+      return fd;
+    }
+
+    void link(endpoint& a, fd_type a_fd, endpoint& b, fd_type b_fd) {
+      a.connected = b.connected = true;
+      a.peer = b_fd;
+      b.peer = a_fd;
+      a.peer_name = b.name;
+      b.peer_name = a.name;
+    }
+
+    void destroy(fd_type fd) {
+      endpoint& ep = endpoints_[fd];
+      if (endpoint* peer = find(ep.peer)) {
+        peer->peer = fd_invalid;
+        peer->eof = true;
+      }
+      std::deque<fd_type> backlog = std::move(ep.backlog);
+      auto bound = bound_.find(ep.name);
+      if (bound != bound_.end() && bound->second == fd) {
+        bound_.erase(bound);
+      }
+      endpoints_.erase(fd);
+      free_.push(fd);
+      for (fd_type conn : backlog) {
+        destroy(conn);
+      }
+    }
+
+    // Kernel style ephemeral port for inet addresses bound to port 0
+    bool assign_port(std::string& name) {
+      std::size_t offset;
+      auto family = reinterpret_cast<const ::sockaddr*>(name.data())->sa_family;
+      if (family == AF_INET && name.size() >= sizeof(::sockaddr_in)) {
+        offset = offsetof(::sockaddr_in, sin_port);
+      } else if (family == AF_INET6 && name.size() >= sizeof(::sockaddr_in6)) {
+        offset = offsetof(::sockaddr_in6, sin6_port);
+      } else {
+        return true;
+      }
+      uint16_t port;
+      std::memcpy(&port, &name[offset], sizeof(port));
+      for (unsigned tries = 0; !port && tries < 16384; ++tries) {
+        uint16_t candidate = htons(next_port_);
+        next_port_ = next_port_ == 65535 ? 49152 : next_port_ + 1;
+        std::memcpy(&name[offset], &candidate, sizeof(candidate));
+        if (!bound_.count(name)) {
+          port = candidate;
+        }
+      }
+      return port != 0;
+    }
+
+    // Copies a stored address out; unnamed sockets report their family only
+    static void address(const std::string& name, int family, ::sockaddr* addr, socklen_t* len) noexcept {
+      std::size_t size = static_cast<std::size_t>(*len);
+      std::memset(addr, 0, size);
+      if (name.empty()) {
+        addr->sa_family = static_cast<decltype(addr->sa_family)>(family);
+      } else {
+        std::memcpy(addr, name.data(), std::min(size, name.size()));
+        *len = static_cast<socklen_t>(name.size());
+      }
+    }
+
+    short readiness(fd_type fd) {
+      endpoint* ep = find(fd);
+      if (!ep) {
+        return POLLNVAL;
+      }
+      if (ep->listening) {
+        return ep->backlog.empty() ? 0 : POLLIN;
+      }
+      if (!ep->connected) {
+        return 0;
+      }
+      short res = ep->queued() || ep->eof || ep->read_shut ? POLLIN : 0;
+      endpoint* peer = find(ep->peer);
+      if (!peer) {
+        res |= POLLHUP;
+      } else if (!ep->write_shut && peer->queued() < faults_.buffer_size) {
+        res |= POLLOUT;
+      }
+      return res;
+    }
+
+    std::size_t cap(std::size_t limit) noexcept {
+      if (!limit) {
+        return std::numeric_limits<std::size_t>::max();
+      }
+      if (!faults_.random_sizes) {
+        return limit;
+      }
+      // xorshift64
+      rng_ ^= rng_ << 13;
+      rng_ ^= rng_ >> 7;
+      rng_ ^= rng_ << 17;
+      return 1 + static_cast<std::size_t>(rng_ % limit);
+    }
+
+    bool inject_eagain() noexcept {
+      if (!faults_.eagain_every || ++eagain_count_ % faults_.eagain_every) {
+        return false;
+      }
+      ++stats_.eagains;
+      return true;
+    }
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::unordered_map<fd_type, endpoint> endpoints_;
+    std::unordered_map<std::string, fd_type> bound_;
+    std::priority_queue<fd_type, std::vector<fd_type>, std::greater<fd_type>> free_;
+    fd_type next_fd_ = first_fd;
+    uint64_t generation_ = 0;
+    uint16_t next_port_ = 49152;
+    memory_faults faults_;
+    memory_stats stats_;
+    uint64_t rng_ = 1;
+    uint64_t eagain_count_ = 0;
+  };
+
+  // Syscall policy routing sockets to memory_network. Plug it into
+  // basic_socket, basic_socket_buffer or basic_socket_observer to run
+  // the library without the kernel, e.g. to measure its own overhead or
+  // replay short reads and EAGAIN deterministically.
+  struct memory_calls {
+    static constexpr bool native = false;
+
+    static fd_type socket(int family, int type, int protocol) {
+      return memory_network::instance().socket(family, type, protocol);
+    }
+
+    static int close(fd_type fd) { return memory_network::instance().close(fd); }
+
+    static int bind(fd_type fd, const ::sockaddr* addr, socklen_t len) {
+      return memory_network::instance().bind(fd, addr, len);
+    }
+
+    static int connect(fd_type fd, const ::sockaddr* addr, socklen_t len) {
+      return memory_network::instance().connect(fd, addr, len);
+    }
+
+    static int listen(fd_type fd, int backlog) { return memory_network::instance().listen(fd, backlog); }
+
+    static fd_type accept(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      return memory_network::instance().accept(fd, addr, len);
+    }
+
+    static std::ptrdiff_t recv(fd_type fd, char* data, std::size_t count, int flags) {
+      return memory_network::instance().recv(fd, data, count, flags);
+    }
+
+    static std::ptrdiff_t send(fd_type fd, const char* data, std::size_t count, int flags) {
+      return memory_network::instance().send(fd, data, count, flags);
+    }
+
+    static int shutdown(fd_type fd, int how) { return memory_network::instance().shutdown(fd, how); }
+
+    static int setsockopt(fd_type fd, int level, int name, const void* value, socklen_t len) {
+      return memory_network::instance().setsockopt(fd, level, name, value, len);
+    }
+
+    static int getsockopt(fd_type fd, int level, int name, void* value, socklen_t* len) {
+      return memory_network::instance().getsockopt(fd, level, name, value, len);
+    }
+
+    static int getsockname(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      return memory_network::instance().getsockname(fd, addr, len);
+    }
+
+    static int getpeername(fd_type fd, ::sockaddr* addr, socklen_t* len) {
+      return memory_network::instance().getpeername(fd, addr, len);
+    }
+
+    static int set_nonblocking(fd_type fd, bool on) {
+      return memory_network::instance().set_nonblocking(fd, on);
+    }
+
+    static bool nonblocking(fd_type fd) { return memory_network::instance().nonblocking(fd); }
+
+    static int poll(pollfd_t* fds, std::size_t count, int timeout) {
+      return memory_network::instance().poll(fds, count, timeout);
+    }
+  };
+
+  template <typename ProtocolFamily>
+  using basic_memory_socket = basic_socket<ProtocolFamily, memory_calls>;
+
+  template <typename ProtocolFamily>
+  using basic_memory_socket_buffer = basic_socket_buffer<ProtocolFamily, memory_calls>;
+
+  using memory_socket = basic_memory_socket<ipv4>;
+  using memory_socket_buffer = basic_memory_socket_buffer<ipv4>;
+  using memory_observer = basic_socket_observer<memory_calls>;
+
+  // Connected pair of memory sockets, like socketpair()
+  template <typename ProtocolFamily = ipv4>
+  std::pair<basic_memory_socket<ProtocolFamily>, basic_memory_socket<ProtocolFamily>> memory_socket_pair() {
+    auto fds = memory_network::instance().pair(ProtocolFamily::family);
+    return {basic_memory_socket<ProtocolFamily>::adopt(fds.first), basic_memory_socket<ProtocolFamily>::adopt(fds.second)};
+  }
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_MEMORY_TRANSPORT_H_
@@ -0,0 +1,231 @@
+#ifndef SOCKCP_SOCKCP_MULTICAST_H_
+#define SOCKCP_SOCKCP_MULTICAST_H_
+
+#if !defined(__linux__)
+#error Multicast batching is only supported on Linux
+#endif
+
+#include <cstddef>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "socket.h"
+
+namespace sockcp {
+  namespace detail {
+    template <typename ProtocolFamily>
+    constexpr int ip_level() noexcept {
+      static_assert(std::is_same_v<ProtocolFamily, ipv4> || std::is_same_v<ProtocolFamily, ipv6>,
+                    "multicast requires ipv4 or ipv6 sockets");
+      return std::is_same_v<ProtocolFamily, ipv4> ? IPPROTO_IP : IPPROTO_IPV6;
+    }
+
+    template <typename ProtocolFamily>
+    void copy_address(::sockaddr_storage& out, const ProtocolFamily& addr) noexcept {
+      std::memset(&out, 0, sizeof(out));
+      std::memcpy(&out, addr.data(), static_cast<std::size_t>(addr.size()));
+    }
+  }  // namespace detail
+
+  // Group membership uses the protocol independent RFC 3678 options
+  // (MCAST_JOIN_GROUP and friends), the same call for IPv4 and IPv6.
+  // interface is an interface index, 0 lets the kernel pick by route;
+  // adapter_provider reports the indices. Ports in group and source are
+  // ignored: bind the socket to the group's port. Linux limits IPv4
+  // memberships per socket to net.ipv4.igmp_max_memberships (20 by
+  // default) and fails with ENOBUFS beyond it.
+  template <typename ProtocolFamily>
+  void join_group(basic_socket<ProtocolFamily>& sock, const ProtocolFamily& group, unsigned interface = 0) {
+    ::group_req req{};
+    req.gr_interface = interface;
+    detail::copy_address(req.gr_group, group);
+    SOCKCP_ASSERT(
+      !::setsockopt(sock.fd(), detail::ip_level<ProtocolFamily>(), MCAST_JOIN_GROUP, &req, sizeof(req)),
+      socket_error("join_group")
+    );
+  }
+
+  template <typename ProtocolFamily>
+  void leave_group(basic_socket<ProtocolFamily>& sock, const ProtocolFamily& group, unsigned interface = 0) {
+    ::group_req req{};
+    req.gr_interface = interface;
+    detail::copy_address(req.gr_group, group);
+    SOCKCP_ASSERT(
+      !::setsockopt(sock.fd(), detail::ip_level<ProtocolFamily>(), MCAST_LEAVE_GROUP, &req, sizeof(req)),
+      socket_error("leave_group")
+    );
+  }
+
+  // Source specific membership: only datagrams from source to group
+  template <typename ProtocolFamily>
+  void join_source_group(basic_socket<ProtocolFamily>& sock, const ProtocolFamily& group,
+                         const ProtocolFamily& source, unsigned interface = 0) {
+    ::group_source_req req{};
+    req.gsr_interface = interface;
+    detail::copy_address(req.gsr_group, group);
+    detail::copy_address(req.gsr_source, source);
+    SOCKCP_ASSERT(
+      !::setsockopt(sock.fd(), detail::ip_level<ProtocolFamily>(), MCAST_JOIN_SOURCE_GROUP, &req, sizeof(req)),
+      socket_error("join_source_group")
+    );
+  }
+
+  template <typename ProtocolFamily>
+  void leave_source_group(basic_socket<ProtocolFamily>& sock, const ProtocolFamily& group,
+                          const ProtocolFamily& source, unsigned interface = 0) {
+    ::group_source_req req{};
+    req.gsr_interface = interface;
+    detail::copy_address(req.gsr_group, group);
+    detail::copy_address(req.gsr_source, source);
+    SOCKCP_ASSERT(
+      !::setsockopt(sock.fd(), detail::ip_level<ProtocolFamily>(), MCAST_LEAVE_SOURCE_GROUP, &req, sizeof(req)),
+      socket_error("leave_source_group")
+    );
+  }
+
+  // Whether this host's own multicast sends are looped back to its
+  // sockets that joined the group. On by default.
+  template <typename ProtocolFamily>
+  void set_multicast_loop(basic_socket<ProtocolFamily>& sock, bool loop) {
+    constexpr bool v4 = std::is_same_v<ProtocolFamily, ipv4>;
+    sock.set_option(detail::ip_level<ProtocolFamily>(), v4 ? IP_MULTICAST_LOOP : IPV6_MULTICAST_LOOP, int(loop));
+  }
+
+  // Hop limit of outgoing multicast, 1 (the default) stays on the link
+  template <typename ProtocolFamily>
+  void set_multicast_ttl(basic_socket<ProtocolFamily>& sock, int hops) {
+    constexpr bool v4 = std::is_same_v<ProtocolFamily, ipv4>;
+    sock.set_option(detail::ip_level<ProtocolFamily>(), v4 ? IP_MULTICAST_TTL : IPV6_MULTICAST_HOPS, hops);
+  }
+
+  // Interface index outgoing multicast leaves through, 0 to route
+  template <typename ProtocolFamily>
+  void set_multicast_interface(basic_socket<ProtocolFamily>& sock, unsigned interface) {
+    if constexpr (std::is_same_v<ProtocolFamily, ipv4>) {
+      ::ip_mreqn req{};
+      req.imr_ifindex = static_cast<int>(interface);
+      sock.set_option(IPPROTO_IP, IP_MULTICAST_IF, req);
+    } else {
+      sock.set_option(detail::ip_level<ProtocolFamily>(), IPV6_MULTICAST_IF, static_cast<int>(interface));
+    }
+  }
+
+  // Received datagram with the address it was sent to, which for
+  // multicast is the group, and the interface it arrived on.
+  template <typename ProtocolFamily>
+  struct datagram {
+    const char* data;
+    std::size_t size;  // bytes stored, at most datagram_size
+    ProtocolFamily source;
+    ProtocolFamily destination;  // port 0; unset without pktinfo
+    unsigned interface;
+    bool truncated;
+  };
+
+  // Fan-in receiver: one recvmmsg() fills up to capacity datagrams from a
+  // socket that may have joined many groups, each tagged with its group
+  // through IP_PKTINFO / IPV6_PKTINFO. Buffers are allocated once and
+  // reused; entries stay valid until the next receive().
+  template <typename ProtocolFamily>
+  class basic_datagram_batch final {
+    static constexpr bool v4 = std::is_same_v<ProtocolFamily, ipv4>;
+    using pktinfo = std::conditional_t<v4, ::in_pktinfo, ::in6_pktinfo>;
+    static constexpr std::size_t control_size = CMSG_SPACE(sizeof(pktinfo));
+
+   public:
+    explicit basic_datagram_batch(std::size_t capacity = 32, std::size_t datagram_size = 2048)
+        : size_(datagram_size), buffers_(capacity*datagram_size), control_(capacity*control_size),
+          iovs_(capacity), sources_(capacity), headers_(capacity), received_(capacity) {
+      SOCKCP_ASSERT(capacity && datagram_size, std::invalid_argument("datagram_batch: empty batch"));
+      for (std::size_t i = 0; i < capacity; ++i) {
+        iovs_[i].iov_base = &buffers_[i*size_];
+        iovs_[i].iov_len = size_;
+      }
+    }
+
+    basic_datagram_batch(const basic_datagram_batch&) = delete;
+    basic_datagram_batch& operator=(const basic_datagram_batch&) = delete;
+
+    // Asks the kernel to attach destination and interface to datagrams
+    static void enable_pktinfo(basic_socket<ProtocolFamily>& sock) {
+      sock.set_option(detail::ip_level<ProtocolFamily>(), v4 ? IP_PKTINFO : IPV6_RECVPKTINFO, 1);
+    }
+
+    // Receives what is queued, up to capacity. A blocking socket waits for
+    // the first datagram only. Returns the number received.
+    std::size_t receive(basic_socket<ProtocolFamily>& sock) {
+      count_ = 0;
+      for (std::size_t i = 0; i < headers_.size(); ++i) {
+        ::msghdr& msg = headers_[i].msg_hdr;
+        msg = ::msghdr{};
+        msg.msg_name = sources_[i].data();
+        msg.msg_namelen = sources_[i].size();
+        msg.msg_iov = &iovs_[i];
+        msg.msg_iovlen = 1;
+        msg.msg_control = &control_[i*control_size];
+        msg.msg_controllen = control_size;
+      }
+      int flags = sock.blocking() ? MSG_WAITFORONE : MSG_DONTWAIT;
+      int n = ::recvmmsg(sock.fd(), headers_.data(), static_cast<unsigned>(headers_.size()), flags, nullptr);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      SOCKCP_ASSERT(n >= 0, socket_error("recvmmsg"));
+      count_ = static_cast<std::size_t>(n);
+      for (std::size_t i = 0; i < count_; ++i) {
+        ::msghdr& msg = headers_[i].msg_hdr;
+        datagram<ProtocolFamily>& d = received_[i];
+        d.data = &buffers_[i*size_];
+        d.size = headers_[i].msg_len;
+        d.source = sources_[i];
+        d.destination = ProtocolFamily();
+        d.interface = 0;
+        d.truncated = msg.msg_flags & MSG_TRUNC;
+        for (::cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+          if (c->cmsg_level != detail::ip_level<ProtocolFamily>()
+              || c->cmsg_type != (v4 ? IP_PKTINFO : IPV6_PKTINFO)) {
+            continue;
+          }
+          pktinfo info;
+          std::memcpy(&info, CMSG_DATA(c), sizeof(info));
+          if constexpr (v4) {
+            d.destination.addr.sin_addr = info.ipi_addr;
+            d.interface = static_cast<unsigned>(info.ipi_ifindex);
+          } else {
+            d.destination.addr.sin6_addr = info.ipi6_addr;
+            d.interface = info.ipi6_ifindex;
+          }
+        }
+      }
+      return count_;
+    }
+
+    std::size_t size() const noexcept { return count_; }
+
+    std::size_t capacity() const noexcept { return headers_.size(); }
+
+    const datagram<ProtocolFamily>& operator[](std::size_t i) const noexcept { return received_[i]; }
+
+    const datagram<ProtocolFamily>* begin() const noexcept { return received_.data(); }
+
+    const datagram<ProtocolFamily>* end() const noexcept { return received_.data() + count_; }
+
+   private:
+    std::size_t size_;
+    std::size_t count_ = 0;
+    std::vector<char> buffers_;
+    std::vector<char> control_;
+    std::vector<::iovec> iovs_;
+    std::vector<ProtocolFamily> sources_;
+    std::vector<::mmsghdr> headers_;
+    std::vector<datagram<ProtocolFamily>> received_;
+  };
+
+  using datagram_batch = basic_datagram_batch<ipv4>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_MULTICAST_H_
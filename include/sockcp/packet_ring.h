@@ -0,0 +1,275 @@
+#ifndef SOCKCP_SOCKCP_PACKET_RING_H_
+#define SOCKCP_SOCKCP_PACKET_RING_H_
+
+#if !defined(__linux__)
+#error Packet rings are only supported on Linux
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <linux/filter.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "socket.h"
+
+namespace sockcp {
+  // Link layer address of an AF_PACKET socket: interface index and
+  // ethertype. Interface 0 means every interface.
+  struct packet_addr final {
+    static constexpr int family = AF_PACKET;
+
+    packet_addr() noexcept : addr(::sockaddr_ll{}) {
+      addr.sll_family = family;
+    }
+
+    packet_addr(const ::sockaddr_ll& addr_data) noexcept : addr(addr_data) {}
+
+    explicit packet_addr(unsigned interface, uint16_t protocol = ETH_P_ALL) noexcept : packet_addr() {
+      addr.sll_ifindex = static_cast<int>(interface);
+      addr.sll_protocol = htons(protocol);
+    }
+
+    std::string to_string() const {
+      char name[IF_NAMESIZE] = "any";
+      if (addr.sll_ifindex) {
+        ::if_indextoname(static_cast<unsigned>(addr.sll_ifindex), name);
+      }
+      return std::string(name);
+    }
+
+    constexpr int size() const noexcept {
+      return sizeof(::sockaddr_ll);
+    }
+
+    unsigned interface() const noexcept { return static_cast<unsigned>(addr.sll_ifindex); }
+
+    uint16_t protocol() const noexcept { return ntohs(addr.sll_protocol); }
+
+    const ::sockaddr* data() const noexcept {
+      return reinterpret_cast<const sockaddr*>(&addr);
+    }
+
+    ::sockaddr* data() noexcept {
+      return reinterpret_cast<sockaddr*>(&addr);
+    }
+
+    ::sockaddr_ll addr;
+  };
+
+  using packet_socket = basic_socket<packet_addr>;
+
+  // Geometry of the TPACKET_V3 receive ring. The kernel fills one block
+  // at a time with variable sized frames and hands it over when it is
+  // full or retire_timeout has passed, so one wakeup covers many packets.
+  // block_size must be a multiple of the page size.
+  struct packet_ring_config {
+    std::size_t block_size = 1u << 20;
+    std::size_t block_count = 64;
+    std::size_t frame_size = 2048;  // bookkeeping unit, not a packet limit
+    std::chrono::milliseconds retire_timeout{10};
+  };
+
+  // One captured packet, pointing into the ring. Valid only inside the
+  // callback that received it.
+  struct packet_view {
+    const char* data;                 // link layer header onwards
+    std::size_t size;                 // bytes captured
+    std::size_t wire_size;            // bytes on the wire
+    std::chrono::nanoseconds timestamp;
+    unsigned interface;
+    uint16_t protocol;                // ethertype, host order
+    uint8_t direction;                // PACKET_HOST, PACKET_OUTGOING, ...
+  };
+
+  struct packet_ring_stats {
+    uint64_t packets = 0;
+    uint64_t drops = 0;               // ring full
+    uint64_t freezes = 0;             // times the ring filled up
+  };
+
+  // How the kernel spreads packets over the rings of one fanout group
+  enum class fanout {
+    hash = PACKET_FANOUT_HASH,        // by flow, keeps flows on one ring
+    load_balance = PACKET_FANOUT_LB,  // round robin
+    cpu = PACKET_FANOUT_CPU,          // by receiving CPU
+    rollover = PACKET_FANOUT_ROLLOVER,
+    queue = PACKET_FANOUT_QM          // by NIC receive queue
+  };
+
+  // Classic BPF accepting IPv4 UDP packets to port on Ethernet framing,
+  // which loopback uses too. A starting point for attach_filter(); other
+  // programs can come from `tcpdump -dd`.
+  inline std::vector<::sock_filter> udp_port_filter(uint16_t port) {
+    return {
+      BPF_STMT(BPF_LD | BPF_H | BPF_ABS, 12),                // ethertype
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, ETH_P_IP, 0, 6),
+      BPF_STMT(BPF_LD | BPF_B | BPF_ABS, 23),                // IP protocol
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, IPPROTO_UDP, 0, 4),
+      BPF_STMT(BPF_LDX | BPF_B | BPF_MSH, 14),               // IP header length
+      BPF_STMT(BPF_LD | BPF_H | BPF_IND, 16),                // UDP destination port
+      BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, port, 0, 1),
+      BPF_STMT(BPF_RET | BPF_K, 0xffffffffu),
+      BPF_STMT(BPF_RET | BPF_K, 0)
+    };
+  }
+
+  // AF_PACKET capture through a memory mapped TPACKET_V3 ring. read()
+  // walks the blocks the kernel has retired and hands out packets in
+  // place, without a syscall or copy per packet. Several rings, e.g. one
+  // per thread, share the traffic when they join the same fanout group.
+  // Needs CAP_NET_RAW.
+  class packet_ring final {
+   public:
+    explicit packet_ring(unsigned interface = 0, packet_ring_config config = packet_ring_config(),
+                         uint16_t protocol = ETH_P_ALL)
+        : sock_(socktype::raw, htons(protocol)), config_(config) {
+      SOCKCP_ASSERT(
+        config_.block_count && config_.frame_size
+          && config_.block_size % static_cast<std::size_t>(::getpagesize()) == 0
+          && config_.block_size % config_.frame_size == 0,
+        std::invalid_argument("packet_ring: bad ring geometry")
+      );
+      sock_.set_option(SOL_PACKET, PACKET_VERSION, static_cast<int>(TPACKET_V3));
+      ::tpacket_req3 req{};
+      req.tp_block_size = static_cast<unsigned>(config_.block_size);
+      req.tp_block_nr = static_cast<unsigned>(config_.block_count);
+      req.tp_frame_size = static_cast<unsigned>(config_.frame_size);
+      req.tp_frame_nr = static_cast<unsigned>(config_.block_size/config_.frame_size*config_.block_count);
+      req.tp_retire_blk_tov = static_cast<unsigned>(config_.retire_timeout.count());
+      sock_.set_option(SOL_PACKET, PACKET_RX_RING, req);
+      std::size_t length = config_.block_size*config_.block_count;
+      void* map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_LOCKED, sock_.fd(), 0);
+      if (map == MAP_FAILED) {
+        // MAP_LOCKED is best effort, RLIMIT_MEMLOCK may forbid it
+        map = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, sock_.fd(), 0);
+      }
+      SOCKCP_ASSERT(map != MAP_FAILED, socket_error("packet_ring"));
+      ring_ = static_cast<char*>(map);
+      try {
+        sock_.bind(packet_addr(interface, protocol));
+      } catch (...) {
+        // No destructor runs for a throwing constructor
+        ::munmap(ring_, length);
+        throw;
+      }
+    }
+
+    packet_ring(const packet_ring&) = delete;
+    packet_ring& operator=(const packet_ring&) = delete;
+
+    ~packet_ring() noexcept {
+      ::munmap(ring_, config_.block_size*config_.block_count);
+    }
+
+    fd_type fd() const noexcept { return sock_.fd(); }
+
+    packet_socket& socket() noexcept { return sock_; }
+
+    // Shares the interface's traffic with every ring of this process that
+    // joins group with the same mode.
+    void join_fanout(uint16_t group, fanout mode, bool defragment = false) {
+      int arg = group | (static_cast<int>(mode) | (defragment ? PACKET_FANOUT_FLAG_DEFRAG : 0)) << 16;
+      sock_.set_option(SOL_PACKET, PACKET_FANOUT, arg);
+    }
+
+    // Drops packets the classic BPF program returns 0 for in the kernel,
+    // before they take ring space. Packets queued earlier stay.
+    void attach_filter(const std::vector<::sock_filter>& code) {
+      ::sock_fprog prog{static_cast<unsigned short>(code.size()), const_cast<::sock_filter*>(code.data())};
+      sock_.set_option(SOL_SOCKET, SO_ATTACH_FILTER, prog);
+    }
+
+    // Waits until a block is ready or timeout passes
+    bool wait(std::chrono::milliseconds timeout) {
+      if (ready()) {
+        return true;
+      }
+      ::pollfd pfd{sock_.fd(), POLLIN, 0};
+      int r = ::poll(&pfd, 1, static_cast<int>(timeout.count()));
+      SOCKCP_ASSERT(r >= 0 || errno == EINTR, socket_error("poll"));
+      return ready();
+    }
+
+    // Calls on_packet(const packet_view&) for every packet in the retired
+    // blocks, up to max_blocks of them, returning each block to the kernel
+    // after its last packet. Returns the number of packets. If on_packet
+    // throws, the rest of that block is skipped.
+    template <typename Func>
+    std::size_t read(Func&& on_packet, std::size_t max_blocks = std::size_t(-1)) {
+      std::size_t packets = 0;
+      for (; max_blocks && ready(); --max_blocks) {
+        block_release release{this, block()};
+        const auto& bh = release.desc->hdr.bh1;
+        auto* hdr = reinterpret_cast<const ::tpacket3_hdr*>(
+          reinterpret_cast<const char*>(release.desc) + bh.offset_to_first_pkt);
+        for (uint32_t i = 0; i < bh.num_pkts; ++i) {
+          auto* ll = reinterpret_cast<const ::sockaddr_ll*>(
+            reinterpret_cast<const char*>(hdr) + TPACKET_ALIGN(sizeof(::tpacket3_hdr)));
+          packet_view view{
+            reinterpret_cast<const char*>(hdr) + hdr->tp_mac,
+            hdr->tp_snaplen,
+            hdr->tp_len,
+            std::chrono::seconds(hdr->tp_sec) + std::chrono::nanoseconds(hdr->tp_nsec),
+            static_cast<unsigned>(ll->sll_ifindex),
+            ntohs(ll->sll_protocol),
+            ll->sll_pkttype
+          };
+          ++packets;
+          on_packet(view);
+          hdr = reinterpret_cast<const ::tpacket3_hdr*>(reinterpret_cast<const char*>(hdr) + hdr->tp_next_offset);
+        }
+      }
+      return packets;
+    }
+
+    // Kernel counters since the ring was opened
+    packet_ring_stats stats() {
+      auto delta = sock_.get_option<::tpacket_stats_v3>(SOL_PACKET, PACKET_STATISTICS);
+      // Reading the counters resets them
+      stats_.packets += delta.tp_packets;
+      stats_.drops += delta.tp_drops;
+      stats_.freezes += delta.tp_freeze_q_cnt;
+      return stats_;
+    }
+
+   private:
+    // Returns the block to the kernel and moves to the next one
+    struct block_release {
+      ~block_release() {
+        __atomic_store_n(&desc->hdr.bh1.block_status, TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+        ring->current_ = (ring->current_ + 1) % ring->config_.block_count;
+      }
+
+      packet_ring* ring;
+      ::tpacket_block_desc* desc;
+    };
+
+    ::tpacket_block_desc* block() const noexcept {
+      return reinterpret_cast<::tpacket_block_desc*>(ring_ + current_*config_.block_size);
+    }
+
+    bool ready() const noexcept {
+      return __atomic_load_n(&block()->hdr.bh1.block_status, __ATOMIC_ACQUIRE) & TP_STATUS_USER;
+    }
+
+    packet_socket sock_;
+    packet_ring_config config_;
+    char* ring_ = nullptr;
+    std::size_t current_ = 0;
+    packet_ring_stats stats_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_PACKET_RING_H_
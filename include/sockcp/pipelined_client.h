@@ -0,0 +1,312 @@
+#ifndef SOCKCP_SOCKCP_PIPELINED_CLIENT_H_
+#define SOCKCP_SOCKCP_PIPELINED_CLIENT_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "error.h"
+#include "socket.h"
+#include "socket_observer.h"
+#include "trace_points.h"
+
+namespace sockcp {
+  namespace detail {
+    inline uint32_t load_le32(const char* p) noexcept {
+      auto u = reinterpret_cast<const unsigned char*>(p);
+      return uint32_t(u[0]) | uint32_t(u[1]) << 8 | uint32_t(u[2]) << 16 | uint32_t(u[3]) << 24;
+    }
+
+    inline void store_le32(char* p, uint32_t v) noexcept {
+      for (int i = 0; i < 4; ++i) {
+        p[i] = static_cast<char>(v >> (8*i));
+      }
+    }
+  }  // namespace detail
+
+  // Frames carrying a correlation id:
+  //   [payload size: uint32 LE][id: uint32 LE][payload]
+  // The peer echoes the id of the request it answers, in any order.
+  struct tagged_frame_codec {
+    static constexpr bool correlated = true;
+    static constexpr std::size_t overhead = 8;
+
+    static void encode(uint32_t id, const char* payload, std::size_t size, char* out) noexcept {
+      detail::store_le32(out, static_cast<uint32_t>(size));
+      detail::store_le32(out + 4, id);
+      std::memcpy(out + overhead, payload, size);
+    }
+
+    // Returns the size of the complete frame at data, or 0 while more
+    // bytes are needed
+    static std::size_t decode(const char* data, std::size_t avail, std::size_t max_payload,
+                              uint32_t& id, const char*& payload, std::size_t& size) {
+      if (avail < overhead) {
+        return 0;
+      }
+      size = detail::load_le32(data);
+      SOCKCP_ASSERT(size <= max_payload, protocol_error("Response exceeds the maximum size", typeid(tagged_frame_codec)));
+      if (avail < overhead + size) {
+        return 0;
+      }
+      id = detail::load_le32(data + 4);
+      payload = data + overhead;
+      return overhead + size;
+    }
+  };
+
+  // Length prefixed frames without ids, [payload size: uint32 LE][payload];
+  // the peer answers in request order.
+  struct length_prefix_codec {
+    static constexpr bool correlated = false;
+    static constexpr std::size_t overhead = 4;
+
+    static void encode(uint32_t /*id*/, const char* payload, std::size_t size, char* out) noexcept {
+      detail::store_le32(out, static_cast<uint32_t>(size));
+      std::memcpy(out + overhead, payload, size);
+    }
+
+    static std::size_t decode(const char* data, std::size_t avail, std::size_t max_payload,
+                              uint32_t& id, const char*& payload, std::size_t& size) {
+      if (avail < overhead) {
+        return 0;
+      }
+      size = detail::load_le32(data);
+      SOCKCP_ASSERT(size <= max_payload, protocol_error("Response exceeds the maximum size", typeid(length_prefix_codec)));
+      if (avail < overhead + size) {
+        return 0;
+      }
+      id = 0;
+      payload = data + overhead;
+      return overhead + size;
+    }
+  };
+
+  struct pipelined_client_config {
+    std::size_t max_in_flight = 1024;    // requests queued or awaiting a response
+    std::size_t batch_bytes = 64*1024;   // request() flushes by itself beyond this
+    std::size_t read_buffer = 64*1024;
+    std::size_t max_response = 1u << 20;
+  };
+
+  struct pipelined_client_stats {
+    uint64_t requests = 0;
+    uint64_t responses = 0;
+    uint64_t writes = 0;                 // send() calls
+    uint64_t reads = 0;                  // recv() calls that returned data
+  };
+
+  // Keeps many requests outstanding on one stream connection instead of
+  // waiting a round trip for each. request() encodes into one contiguous
+  // output buffer and flush() sends everything queued with a single
+  // send(), so a burst of requests costs one syscall. receive() decodes
+  // every complete response of one recv() in place and matches it to its
+  // request, by correlation id with a correlated Codec, by order
+  // otherwise. Each request carries a caller chosen tag that comes back
+  // with its response through the one completion handler, so nothing is
+  // allocated per request once the buffers have grown.
+  //
+  // Works with blocking and nonblocking sockets; with a nonblocking one,
+  // watch interest() and call flush() and receive() on readiness.
+  template <typename ProtocolFamily, typename Codec = tagged_frame_codec, typename Syscalls = system_calls>
+  class basic_pipelined_client final {
+    struct pending {
+      uint32_t id = 0;
+      bool busy = false;
+      uint64_t tag = 0;
+    };
+
+   public:
+    // on_response(uint64_t tag, const char* data, std::size_t size); data
+    // points into the receive buffer and is valid during the call only.
+    // The handler may issue requests but must not call receive().
+    using completion = std::function<void(uint64_t, const char*, std::size_t)>;
+
+    basic_pipelined_client(basic_socket<ProtocolFamily, Syscalls>& sock, completion on_response,
+                           pipelined_client_config config = pipelined_client_config())
+        : sock_(sock), on_response_(std::move(on_response)), config_(config),
+          in_capacity_(std::max(config_.read_buffer, config_.max_response + Codec::overhead)),
+          in_(new char[in_capacity_]) {
+      SOCKCP_ASSERT(config_.max_in_flight, std::invalid_argument("pipelined_client: no requests allowed"));
+      std::size_t slots = 1;
+      for (; slots < config_.max_in_flight; slots <<= 1, ++slot_bits_) {
+      }
+      SOCKCP_ASSERT(slot_bits_ < 24, std::invalid_argument("pipelined_client: too many requests in flight"));
+      pending_.resize(slots);
+      if constexpr (Codec::correlated) {
+        free_.reserve(slots);
+        for (std::size_t i = slots; i--;) {
+          free_.push_back(static_cast<uint32_t>(i));
+        }
+      }
+    }
+
+    basic_pipelined_client(const basic_pipelined_client&) = delete;
+    basic_pipelined_client& operator=(const basic_pipelined_client&) = delete;
+
+    // Queues a request. Returns false, queuing nothing, while
+    // max_in_flight requests are outstanding.
+    bool request(std::string_view payload, uint64_t tag = 0) {
+      if (in_flight_ == config_.max_in_flight) {
+        return false;
+      }
+      uint32_t slot;
+      uint32_t id = 0;
+      if constexpr (Codec::correlated) {
+        slot = free_.back();
+        free_.pop_back();
+        // The upper bits count the slot's uses, so a late duplicate
+        // response cannot complete a newer request in the same slot
+        id = ((pending_[slot].id >> slot_bits_) + 1) << slot_bits_ | slot;
+        pending_[slot].id = id;
+        pending_[slot].busy = true;
+      } else {
+        slot = static_cast<uint32_t>(sent_++ & (pending_.size() - 1));
+      }
+      pending_[slot].tag = tag;
+      std::size_t pos = out_.size();
+      out_.resize(pos + Codec::overhead + payload.size());
+      Codec::encode(id, payload.data(), payload.size(), out_.data() + pos);
+      ++in_flight_;
+      ++stats_.requests;
+      if (out_.size() - out_pos_ >= config_.batch_bytes) {
+        flush();
+      }
+      return true;
+    }
+
+    // Sends the queued requests, as much as the socket takes. Returns
+    // true once nothing is left.
+    bool flush() {
+      while (out_pos_ < out_.size()) {
+        errno = 0;
+        SOCKCP_TRACE(span, io, "send", sock_.fd());
+        auto sent = Syscalls::send(sock_.fd(), out_.data() + out_pos_, out_.size() - out_pos_, send_flags);
+        SOCKCP_TRACE_RESULT(span, sent);
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        }
+        SOCKCP_ASSERT(sent >= 0, socket_error("flush"));
+        ++stats_.writes;
+        out_pos_ += static_cast<std::size_t>(sent);
+      }
+      if (out_pos_ == out_.size()) {
+        out_.clear();
+        out_pos_ = 0;
+      }
+      return out_.empty();
+    }
+
+    // One recv() followed by the completion of every response it made
+    // whole. Returns the number completed, 0 when a nonblocking socket
+    // had nothing. Throws disconnect_error at end of stream and
+    // protocol_error on a response matching no request.
+    std::size_t receive() {
+      errno = 0;
+      SOCKCP_TRACE(span, io, "recv", sock_.fd());
+      auto rd = Syscalls::recv(sock_.fd(), in_.get() + in_end_, in_capacity_ - in_end_, 0);
+      SOCKCP_TRACE_RESULT(span, rd);
+      if (rd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      SOCKCP_ASSERT(rd >= 0, socket_error("receive"));
+      SOCKCP_ASSERT(rd > 0, disconnect_error());
+      ++stats_.reads;
+      in_end_ += static_cast<std::size_t>(rd);
+      std::size_t completed = 0;
+      compactor consumed{this, 0};
+      for (;;) {
+        uint32_t id = 0;
+        const char* payload = nullptr;
+        std::size_t size = 0;
+        std::size_t n = Codec::decode(in_.get() + consumed.pos, in_end_ - consumed.pos, config_.max_response,
+                                      id, payload, size);
+        if (!n) {
+          return completed;
+        }
+        consumed.pos += n;
+        complete(id, payload, size);
+        ++completed;
+      }
+    }
+
+    // Requests queued or awaiting their response
+    std::size_t in_flight() const noexcept { return in_flight_; }
+
+    // Request bytes not yet sent
+    std::size_t queued() const noexcept { return out_.size() - out_pos_; }
+
+    // Events to watch the socket for
+    event interest() const noexcept {
+      return (in_flight_ ? event::in : event::no_event) | (queued() ? event::out : event::no_event);
+    }
+
+    const pipelined_client_stats& stats() const noexcept { return stats_; }
+
+   private:
+#if defined(MSG_NOSIGNAL)
+    static constexpr int send_flags = MSG_NOSIGNAL;
+#else
+    static constexpr int send_flags = 0;
+#endif
+
+    // Drops the responses handled so far from the receive buffer, also
+    // when a handler throws
+    struct compactor {
+      ~compactor() {
+        client->in_end_ -= pos;
+        if (client->in_end_ && pos) {
+          std::memmove(client->in_.get(), client->in_.get() + pos, client->in_end_);
+        }
+      }
+
+      basic_pipelined_client* client;
+      std::size_t pos;
+    };
+
+    void complete(uint32_t id, const char* payload, std::size_t size) {
+      uint32_t slot;
+      if constexpr (Codec::correlated) {
+        slot = id & static_cast<uint32_t>(pending_.size() - 1);
+        SOCKCP_ASSERT(
+          pending_[slot].busy && pending_[slot].id == id,
+          protocol_error("Response to an unknown request", typeid(Codec))
+        );
+        pending_[slot].busy = false;
+        free_.push_back(slot);
+      } else {
+        SOCKCP_ASSERT(in_flight_, protocol_error("Response to an unknown request", typeid(Codec)));
+        slot = static_cast<uint32_t>(done_++ & (pending_.size() - 1));
+      }
+      --in_flight_;
+      ++stats_.responses;
+      on_response_(pending_[slot].tag, payload, size);
+    }
+
+    basic_socket<ProtocolFamily, Syscalls>& sock_;
+    completion on_response_;
+    pipelined_client_config config_;
+    std::vector<pending> pending_;
+    std::vector<uint32_t> free_;
+    unsigned slot_bits_ = 0;
+    std::size_t in_flight_ = 0;
+    uint64_t sent_ = 0;
+    uint64_t done_ = 0;
+    std::vector<char> out_;
+    std::size_t out_pos_ = 0;
+    std::size_t in_capacity_;
+    std::unique_ptr<char[]> in_;
+    std::size_t in_end_ = 0;
+    pipelined_client_stats stats_;
+  };
+
+  using pipelined_client = basic_pipelined_client<ipv4>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_PIPELINED_CLIENT_H_
@@ -0,0 +1,203 @@
+#ifndef SOCKCP_SOCKCP_PREFIX_TABLE_H_
+#define SOCKCP_SOCKCP_PREFIX_TABLE_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+
+#include "inet_address.h"
+#include "rcu_pointer.h"
+
+namespace sockcp {
+  namespace detail {
+    template <typename ProtocolFamily>
+    struct prefix_key;
+
+    template <>
+    struct prefix_key<ipv4> {
+      static constexpr unsigned bits = 32;
+
+      static void bytes(const ipv4& ip, uint8_t* out) noexcept {
+        std::memcpy(out, &ip.addr.sin_addr, 4);
+      }
+    };
+
+    template <>
+    struct prefix_key<ipv6> {
+      static constexpr unsigned bits = 128;
+
+      static void bytes(const ipv6& ip, uint8_t* out) noexcept {
+        std::memcpy(out, ip.addr.sin6_addr.s6_addr, 16);
+      }
+    };
+  }  // namespace detail
+
+  // Immutable longest prefix match table mapping ipv4 or ipv6 prefixes to
+  // values. Prefixes are compiled into a multibit trie with a 16 bit root
+  // stride followed by 8 bit strides and leaf pushing, so an ipv4 lookup is
+  // at most three dependent loads from one flat array and never branches
+  // on prefix lengths. Build with prefix_table::builder.
+  template <typename ProtocolFamily, typename T = bool>
+  class prefix_table final {
+    using key = detail::prefix_key<ProtocolFamily>;
+    static constexpr unsigned key_bytes = key::bits/8;
+    static constexpr uint32_t child_bit = 0x80000000u;
+
+   public:
+    class builder final {
+      struct node {
+        int child[2] = {-1, -1};
+        int value = -1;
+      };
+
+     public:
+      builder() : nodes_(1) {}
+
+      // Later additions of the same prefix replace earlier ones. Host bits
+      // beyond length are ignored.
+      builder& add(const ProtocolFamily& prefix, unsigned length, T value) {
+        SOCKCP_ASSERT(
+          length <= key::bits,
+          protocol_error("Prefix length out of range", typeid(ProtocolFamily))
+        );
+        uint8_t bytes[key_bytes];
+        key::bytes(prefix, bytes);
+        int n = 0;
+        for (unsigned i = 0; i < length; ++i) {
+          int bit = (bytes[i/8] >> (7 - i % 8)) & 1;
+          if (nodes_[n].child[bit] < 0) {
+            nodes_[n].child[bit] = static_cast<int>(nodes_.size());
+            nodes_.emplace_back();
+          }
+          n = nodes_[n].child[bit];
+        }
+        if (nodes_[n].value < 0) {
+          nodes_[n].value = static_cast<int>(values_.size());
+          values_.push_back(std::move(value));
+        } else {
+          values_[nodes_[n].value] = std::move(value);
+        }
+        return *this;
+      }
+
+      // "10.0.0.0/8", "fd00::/8"; a bare address is a full length prefix.
+      builder& add(std::string_view cidr, T value) {
+        std::size_t slash = cidr.find('/');
+        uint32_t length = key::bits;
+        SOCKCP_ASSERT(
+          slash == std::string_view::npos
+            || detail::parse_decimal(cidr.substr(slash + 1), key::bits, length),
+          protocol_error("Invalid prefix provided", typeid(ProtocolFamily))
+        );
+        return add(ProtocolFamily::from_string(cidr.substr(0, slash)), length, std::move(value));
+      }
+
+      std::unique_ptr<const prefix_table> build() const {
+        std::unique_ptr<prefix_table> table(new prefix_table());
+        table->values_.reset(new T[values_.size()]);
+        table->value_count_ = values_.size();
+        std::copy(values_.begin(), values_.end(), table->values_.get());
+        table->compile(*this, 0, 0, nodes_[0].value);
+        return table;
+      }
+
+     private:
+      friend class prefix_table;
+
+      std::vector<node> nodes_;
+      std::vector<T> values_;
+    };
+
+    // Value of the longest prefix covering addr, nullptr if none does.
+    const T* match(const ProtocolFamily& addr) const noexcept {
+      uint8_t bytes[key_bytes];
+      key::bytes(addr, bytes);
+      uint32_t entry = entries_[(uint32_t(bytes[0]) << 8) | bytes[1]];
+      for (unsigned i = 2; entry & child_bit; ++i) {
+        entry = entries_[(entry & ~child_bit) + bytes[i]];
+      }
+      return entry ? &values_[entry - 1] : nullptr;
+    }
+
+    std::size_t memory_usage() const noexcept {
+      return entries_.size()*sizeof(uint32_t) + value_count_*sizeof(T);
+    }
+
+   private:
+    prefix_table() = default;
+
+    // Emits the table for the stride starting below trie node n at depth
+    // and returns its offset. Entries hold a value index + 1, 0 for no
+    // match, or child_bit | offset of the next level table.
+    uint32_t compile(const builder& src, int n, unsigned depth, int inherited) {
+      const auto& nodes = src.nodes_;
+      unsigned stride = depth ? 8 : 16;
+      std::size_t offset = entries_.size();
+      SOCKCP_ASSERT(
+        offset + (std::size_t(1) << stride) < child_bit,
+        std::length_error("prefix_table: too many prefixes")
+      );
+      entries_.resize(offset + (std::size_t(1) << stride));
+      for (uint32_t slot = 0; slot < (1u << stride); ++slot) {
+        int cur = n;
+        int best = inherited;
+        for (int b = stride - 1; b >= 0 && cur >= 0; --b) {
+          cur = nodes[cur].child[(slot >> b) & 1];
+          if (cur >= 0 && nodes[cur].value >= 0) {
+            best = nodes[cur].value;
+          }
+        }
+        bool deeper = cur >= 0 && depth + stride < key::bits
+          && (nodes[cur].child[0] >= 0 || nodes[cur].child[1] >= 0);
+        uint32_t entry = deeper
+          ? child_bit | compile(src, cur, depth + stride, best)
+          : static_cast<uint32_t>(best + 1);
+        entries_[offset + slot] = entry;
+      }
+      return static_cast<uint32_t>(offset);
+    }
+
+    std::vector<uint32_t> entries_;
+    std::unique_ptr<T[]> values_;
+    std::size_t value_count_ = 0;
+  };
+
+  // Allow/deny filter for accepted connections. Rule sets are replaced
+  // atomically with update() while reactor threads keep matching lock free.
+  // Addresses no rule covers get the default verdict.
+  template <typename ProtocolFamily>
+  class prefix_filter final {
+   public:
+    using table_type = prefix_table<ProtocolFamily, bool>;
+
+    explicit prefix_filter(bool default_allow = true)
+        : default_allow_(default_allow) {}
+
+    void update(std::unique_ptr<const table_type> rules) {
+      rules_.store(std::move(rules));
+    }
+
+    bool allowed(const ProtocolFamily& addr) const {
+      return rules_.read([&](const table_type* rules) {
+        const bool* verdict = rules ? rules->match(addr) : nullptr;
+        return verdict ? *verdict : default_allow_;
+      });
+    }
+
+    bool operator()(const ProtocolFamily& addr) const {
+      return allowed(addr);
+    }
+
+   private:
+    bool default_allow_;
+    rcu_pointer<table_type> rules_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_PREFIX_TABLE_H_
@@ -0,0 +1,130 @@
+#ifndef SOCKCP_SOCKCP_RCU_POINTER_H_
+#define SOCKCP_SOCKCP_RCU_POINTER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "error.h"
+
+namespace sockcp {
+  namespace detail {
+    static constexpr std::size_t rcu_max_readers = 128;
+
+    // Small dense id per live thread, recycled when the thread exits, so
+    // every rcu_pointer can keep one reader slot per thread.
+    class rcu_thread_id final {
+     public:
+      rcu_thread_id() {
+        std::lock_guard<std::mutex> lock(registry_mtx());
+        auto& free_ids = registry();
+        if (free_ids.empty()) {
+          SOCKCP_ASSERT(
+            next_id() < rcu_max_readers,
+            std::length_error("rcu_pointer: too many reader threads")
+          );
+          id_ = next_id()++;
+        } else {
+          id_ = free_ids.back();
+          free_ids.pop_back();
+        }
+      }
+
+      ~rcu_thread_id() {
+        std::lock_guard<std::mutex> lock(registry_mtx());
+        registry().push_back(id_);
+      }
+
+      std::size_t get() const noexcept { return id_; }
+
+      static std::size_t current() {
+        thread_local rcu_thread_id id;
+        return id.get();
+      }
+
+     private:
+      static std::mutex& registry_mtx() {
+        static std::mutex mtx;
+        return mtx;
+      }
+
+      static std::vector<std::size_t>& registry() {
+        static std::vector<std::size_t> free_ids;
+        return free_ids;
+      }
+
+      static std::size_t& next_id() {
+        static std::size_t id = 0;
+        return id;
+      }
+
+      std::size_t id_;
+    };
+  }  // namespace detail
+
+  // Pointer to an immutable object which readers on any thread use without
+  // locks while a writer replaces it. Readers publish the epoch they
+  // started in; store() swaps the pointer, bumps the epoch and frees the
+  // old object once every reader that could have seen it has left.
+  // Writers are serialized, readers never wait.
+  template <typename T>
+  class rcu_pointer final {
+    struct alignas(64) reader_slot {
+      std::atomic<uint64_t> epoch{0};
+    };
+
+   public:
+    explicit rcu_pointer(std::unique_ptr<const T> init = nullptr)
+        : current_(init.release()) {}
+
+    rcu_pointer(const rcu_pointer&) = delete;
+    rcu_pointer& operator=(const rcu_pointer&) = delete;
+
+    ~rcu_pointer() noexcept {
+      delete current_.load(std::memory_order_relaxed);
+    }
+
+    // Calls func(const T*) with the current object pinned for the call.
+    // Reads may nest, but func must not call store() on the same pointer.
+    template <typename Func>
+    auto read(Func&& func) const {
+      reader_slot& slot = slots_[detail::rcu_thread_id::current()];
+      if (slot.epoch.load(std::memory_order_relaxed)) {
+        return func(current_.load(std::memory_order_seq_cst));
+      }
+      struct unpin {
+        reader_slot& slot;
+        ~unpin() { slot.epoch.store(0, std::memory_order_release); }
+      } guard{slot};
+      slot.epoch.store(epoch_.load(std::memory_order_relaxed), std::memory_order_seq_cst);
+      return func(current_.load(std::memory_order_seq_cst));
+    }
+
+    // Publishes next and blocks until the previous object is unreachable.
+    void store(std::unique_ptr<const T> next) {
+      std::lock_guard<std::mutex> lock(writer_mtx_);
+      const T* old = current_.exchange(next.release(), std::memory_order_seq_cst);
+      uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+      for (auto& slot : slots_) {
+        for (uint64_t seen = slot.epoch.load(std::memory_order_seq_cst);
+             seen && seen < epoch;
+             seen = slot.epoch.load(std::memory_order_seq_cst)) {
+          std::this_thread::yield();
+        }
+      }
+      delete old;
+    }
+
+   private:
+    std::atomic<const T*> current_;
+    std::atomic<uint64_t> epoch_{1};
+    mutable reader_slot slots_[detail::rcu_max_readers];
+    std::mutex writer_mtx_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_RCU_POINTER_H_
@@ -0,0 +1,186 @@
+#ifndef SOCKCP_SOCKCP_RECORD_BATCH_H_
+#define SOCKCP_SOCKCP_RECORD_BATCH_H_
+
+#if !(defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__))
+#error Record batches are not supported on Windows
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "socket.h"
+#include "unix_address.h"
+
+namespace sockcp {
+  // One message of a SOCK_SEQPACKET or SOCK_DGRAM socket. size bytes were
+  // stored; a record longer than the receive buffer is cut and the rest of
+  // it is lost, which truncated reports. full_size is the length the peer
+  // sent where the kernel reports it (Linux), size otherwise.
+  struct record {
+    char* data = nullptr;
+    std::size_t size = 0;
+    std::size_t full_size = 0;
+    bool truncated = false;
+  };
+
+  namespace detail {
+#if defined(__linux__)
+    // Linux returns the untruncated length when asked with MSG_TRUNC
+    constexpr int record_flags = MSG_TRUNC;
+#else
+    constexpr int record_flags = 0;
+#endif
+
+#if defined(MSG_NOSIGNAL)
+    constexpr int record_send_flags = MSG_NOSIGNAL;
+#else
+    constexpr int record_send_flags = 0;
+#endif
+
+    inline void fill_record(record& rec, char* data, std::size_t capacity, std::size_t received, int msg_flags) {
+      rec.data = data;
+      rec.size = std::min(received, capacity);
+      rec.full_size = std::max(received, rec.size);
+      rec.truncated = (msg_flags & MSG_TRUNC) || received > capacity;
+    }
+  }  // namespace detail
+
+  // Sends data as one record. Records are never split: a nonblocking
+  // socket without room for the whole record returns false and sends
+  // nothing. Records above the socket's send buffer fail with EMSGSIZE.
+  template <typename ProtocolFamily>
+  bool send_record(basic_socket<ProtocolFamily>& sock, const char* data, std::size_t count) {
+    ssize_t sent = ::send(sock.fd(), data, count, detail::record_send_flags);
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    SOCKCP_ASSERT(sent >= 0, socket_error("send_record"));
+    return true;
+  }
+
+  // Receives exactly one record into data. Returns false when a
+  // nonblocking socket has none queued. An empty record reads as end of
+  // stream on seqpacket sockets and throws disconnect_error, as the kernel
+  // reports both the same way.
+  template <typename ProtocolFamily>
+  bool recv_record(basic_socket<ProtocolFamily>& sock, char* data, std::size_t count, record& out) {
+    ::iovec iov{data, count};
+    ::msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    ssize_t n = ::recvmsg(sock.fd(), &msg, detail::record_flags);
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return false;
+    }
+    SOCKCP_ASSERT(n >= 0, socket_error("recv_record"));
+    SOCKCP_ASSERT(n > 0 || sock.type() == SOCK_DGRAM, disconnect_error());
+    detail::fill_record(out, data, count, static_cast<std::size_t>(n), msg.msg_flags);
+    return true;
+  }
+
+  // Receives up to capacity records per call into a preallocated arena of
+  // capacity slots of record_size bytes each: one recvmmsg() on Linux, a
+  // recvmsg() per record elsewhere. Records stay valid until the next
+  // receive(); nothing is allocated after construction.
+  template <typename ProtocolFamily>
+  class basic_record_batch final {
+   public:
+    explicit basic_record_batch(std::size_t capacity = 64, std::size_t record_size = 4096)
+        : record_size_(record_size), arena_(new char[capacity*record_size]),
+          iovs_(capacity), records_(capacity) {
+      SOCKCP_ASSERT(capacity && record_size, std::invalid_argument("record_batch: empty batch"));
+      for (std::size_t i = 0; i < capacity; ++i) {
+        iovs_[i].iov_base = arena_.get() + i*record_size_;
+        iovs_[i].iov_len = record_size_;
+      }
+#if defined(__linux__)
+      headers_.resize(capacity);
+#endif
+    }
+
+    basic_record_batch(const basic_record_batch&) = delete;
+    basic_record_batch& operator=(const basic_record_batch&) = delete;
+
+    // Receives the records already queued, up to capacity; a blocking
+    // socket waits for the first one only. Returns the number received.
+    // End of stream on a seqpacket socket ends the batch early; the next
+    // receive() throws disconnect_error.
+    std::size_t receive(basic_socket<ProtocolFamily>& sock) {
+      count_ = 0;
+      bool stream_end = sock.type() != SOCK_DGRAM;
+#if defined(__linux__)
+      for (std::size_t i = 0; i < headers_.size(); ++i) {
+        headers_[i].msg_hdr = ::msghdr{};
+        headers_[i].msg_hdr.msg_iov = &iovs_[i];
+        headers_[i].msg_hdr.msg_iovlen = 1;
+      }
+      int flags = detail::record_flags | (sock.blocking() ? MSG_WAITFORONE : MSG_DONTWAIT);
+      int n = ::recvmmsg(sock.fd(), headers_.data(), static_cast<unsigned>(headers_.size()), flags, nullptr);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      SOCKCP_ASSERT(n >= 0, socket_error("recvmmsg"));
+      for (int i = 0; i < n; ++i) {
+        if (stream_end && !headers_[i].msg_len) {
+          break;
+        }
+        detail::fill_record(records_[count_], arena_.get() + i*record_size_, record_size_,
+                            headers_[i].msg_len, headers_[i].msg_hdr.msg_flags);
+        ++count_;
+      }
+      SOCKCP_ASSERT(count_ || !n, disconnect_error());
+#else
+      for (std::size_t i = 0; i < records_.size(); ++i) {
+        ::msghdr msg{};
+        msg.msg_iov = &iovs_[i];
+        msg.msg_iovlen = 1;
+        int flags = detail::record_flags | (i || !sock.blocking() ? MSG_DONTWAIT : 0);
+        ssize_t n = ::recvmsg(sock.fd(), &msg, flags);
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        }
+        SOCKCP_ASSERT(n >= 0, socket_error("recvmsg"));
+        if (stream_end && !n) {
+          SOCKCP_ASSERT(count_, disconnect_error());
+          break;
+        }
+        detail::fill_record(records_[count_++], arena_.get() + i*record_size_, record_size_,
+                            static_cast<std::size_t>(n), msg.msg_flags);
+      }
+#endif
+      return count_;
+    }
+
+    std::size_t size() const noexcept { return count_; }
+
+    std::size_t capacity() const noexcept { return records_.size(); }
+
+    std::size_t record_size() const noexcept { return record_size_; }
+
+    const record& operator[](std::size_t i) const noexcept { return records_[i]; }
+
+    const record* begin() const noexcept { return records_.data(); }
+
+    const record* end() const noexcept { return records_.data() + count_; }
+
+   private:
+    std::size_t record_size_;
+    std::size_t count_ = 0;
+    std::unique_ptr<char[]> arena_;
+    std::vector<::iovec> iovs_;
+    std::vector<record> records_;
+#if defined(__linux__)
+    std::vector<::mmsghdr> headers_;
+#endif
+  };
+
+  using record_batch = basic_record_batch<unix_addr>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_RECORD_BATCH_H_
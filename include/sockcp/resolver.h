@@ -0,0 +1,326 @@
+#ifndef SOCKCP_SOCKCP_RESOLVER_H_
+#define SOCKCP_SOCKCP_RESOLVER_H_
+
+#if !(defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__))
+#error Resolver is not supported on Windows
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+
+#include "inet_address.h"
+#include "socket.h"
+
+namespace sockcp {
+  struct resolve_result {
+    std::string host;
+    int error = 0;  // EAI_* code from getaddrinfo, 0 on success
+    bool cached = false;
+    std::vector<ipv4> v4;
+    std::vector<ipv6> v6;
+
+    bool ok() const noexcept { return !error; }
+
+    const char* what() const noexcept { return error ? ::gai_strerror(error) : "Success"; }
+  };
+
+  // Default lookup policy, a blocking getaddrinfo. Anything callable with the
+  // same signature can be plugged into basic_resolver, e.g. a test stub.
+  struct system_lookup {
+    int operator()(const std::string& host, std::vector<ipv4>& v4, std::vector<ipv6>& v6) const {
+      ::addrinfo hints{};
+      hints.ai_family = AF_UNSPEC;
+      hints.ai_socktype = SOCK_STREAM;
+      ::addrinfo* res = nullptr;
+      int r = ::getaddrinfo(host.c_str(), nullptr, &hints, &res);
+      if (r) {
+        return r;
+      }
+      for (::addrinfo* p = res; p; p = p->ai_next) {
+        if (p->ai_family == AF_INET) {
+          v4.emplace_back(*reinterpret_cast<const ::sockaddr_in*>(p->ai_addr));
+        } else if (p->ai_family == AF_INET6) {
+          v6.emplace_back(*reinterpret_cast<const ::sockaddr_in6*>(p->ai_addr));
+        }
+      }
+      ::freeaddrinfo(res);
+      return 0;
+    }
+  };
+
+  // Resolves host names on a small thread pool and caches the answers.
+  // Completions are queued for the owning event loop: attach the resolver to
+  // socket_observer with event::in and call dispatch() when fd() is readable.
+  // Callbacks run only inside dispatch(), never on the pool threads.
+  // Concurrent lookups of one host share a single getaddrinfo call.
+  // The cache holds at most cache_limit hosts; expired entries are dropped
+  // when looked up or when the cache fills.
+  template <typename Lookup = system_lookup>
+  class basic_resolver final {
+    using clock = std::chrono::steady_clock;
+
+   public:
+    using callback = std::function<void(const resolve_result&)>;
+
+    explicit basic_resolver(std::size_t threads = 2, Lookup lookup = Lookup(), std::size_t cache_limit = 4096)
+        : lookup_(std::move(lookup)), cache_limit_(cache_limit) {
+      int fds[2];
+      SOCKCP_ASSERT(!::pipe(fds), socket_error("resolver"));
+      wake_rd_ = fds[0];
+      wake_wr_ = fds[1];
+      for (int fd : fds) {
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+        ::fcntl(fd, F_SETFD, FD_CLOEXEC);
+      }
+      for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+        workers_.emplace_back([this]() { work(); });
+      }
+    }
+
+    basic_resolver(const basic_resolver&) = delete;
+    basic_resolver& operator=(const basic_resolver&) = delete;
+
+    ~basic_resolver() noexcept {
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        stop_ = true;
+      }
+      cv_.notify_all();
+      for (auto& worker : workers_) {
+        worker.join();
+      }
+      ::close(wake_rd_);
+      ::close(wake_wr_);
+    }
+
+    fd_type fd() const noexcept { return wake_rd_; }
+
+    // Negative entries cover names that do not exist (EAI_NONAME,
+    // EAI_NODATA); other failures, transient or local, are never cached.
+    void set_ttl(std::chrono::seconds positive, std::chrono::seconds negative) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      positive_ttl_ = positive;
+      negative_ttl_ = negative;
+    }
+
+    void resolve(const std::string& host, uint16_t port, callback cb) {
+      resolve_result numeric;
+      if (parse_numeric(host, numeric)) {
+        numeric.cached = true;
+        complete(std::move(numeric), port, std::move(cb));
+        return;
+      }
+      std::unique_lock<std::mutex> lock(mtx_);
+      auto cached = cache_.find(host);
+      if (cached != cache_.end()) {
+        if (cached->second.expires > clock::now()) {
+          resolve_result res = cached->second.result;
+          res.cached = true;
+          lock.unlock();
+          complete(std::move(res), port, std::move(cb));
+          return;
+        }
+        cache_.erase(cached);
+      }
+      auto& waiters = inflight_[host];
+      waiters.push_back(waiter{port, std::move(cb)});
+      if (waiters.size() == 1) {
+        jobs_.push_back(host);
+        lock.unlock();
+        cv_.notify_one();
+      }
+    }
+
+    // Runs queued completions on the calling thread, returns how many ran.
+    std::size_t dispatch() {
+      char drain[64];
+      for (; ::read(wake_rd_, drain, sizeof(drain)) > 0;);
+      std::vector<completion> ready;
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        ready.swap(completions_);
+      }
+      for (auto& done : ready) {
+        done.cb(done.result);
+      }
+      return ready.size();
+    }
+
+    std::size_t pending() const {
+      std::lock_guard<std::mutex> lock(mtx_);
+      std::size_t n = completions_.size();
+      for (const auto& entry : inflight_) {
+        n += entry.second.size();
+      }
+      return n;
+    }
+
+    void clear_cache() {
+      std::lock_guard<std::mutex> lock(mtx_);
+      cache_.clear();
+    }
+
+    std::size_t cache_size() const {
+      std::lock_guard<std::mutex> lock(mtx_);
+      return cache_.size();
+    }
+
+   private:
+    struct waiter {
+      uint16_t port;
+      callback cb;
+    };
+
+    struct completion {
+      resolve_result result;
+      callback cb;
+    };
+
+    struct entry {
+      resolve_result result;
+      clock::time_point expires;
+    };
+
+    static bool parse_numeric(const std::string& host, resolve_result& res) {
+      ::in_addr a4;
+      ::in6_addr a6;
+      res.host = host;
+      if (::inet_pton(AF_INET, host.c_str(), &a4) > 0) {
+        ::sockaddr_in sin{};
+        sin.sin_family = AF_INET;
+        sin.sin_addr = a4;
+        res.v4.emplace_back(sin);
+        return true;
+      }
+      if (::inet_pton(AF_INET6, host.c_str(), &a6) > 0) {
+        ::sockaddr_in6 sin6{};
+        sin6.sin6_family = AF_INET6;
+        sin6.sin6_addr = a6;
+        res.v6.emplace_back(sin6);
+        return true;
+      }
+      return false;
+    }
+
+    // Answers worth remembering: addresses, or a name that does not exist
+    static bool cacheable(int error) noexcept {
+      switch (error) {
+        case 0:
+        case EAI_NONAME:
+#if defined(EAI_NODATA) && EAI_NODATA != EAI_NONAME
+        case EAI_NODATA:
+#endif
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    // Makes room for one more host, first by dropping expired entries, then
+    // the entry closest to expiry. Called with mtx_ held.
+    void make_room(const std::string& host) {
+      if (cache_.size() < cache_limit_ || cache_.count(host)) {
+        return;
+      }
+      auto now = clock::now();
+      for (auto it = cache_.begin(); it != cache_.end();) {
+        it = it->second.expires > now ? std::next(it) : cache_.erase(it);
+      }
+      if (cache_.size() >= cache_limit_) {
+        cache_.erase(std::min_element(cache_.begin(), cache_.end(), [](const auto& a, const auto& b) {
+          return a.second.expires < b.second.expires;
+        }));
+      }
+    }
+
+    static void apply_port(resolve_result& res, uint16_t port) noexcept {
+      for (auto& addr : res.v4) {
+        addr.set_port(port);
+      }
+      for (auto& addr : res.v6) {
+        addr.set_port(port);
+      }
+    }
+
+    void complete(resolve_result res, uint16_t port, callback cb) {
+      apply_port(res, port);
+      {
+        std::lock_guard<std::mutex> lock(mtx_);
+        completions_.push_back(completion{std::move(res), std::move(cb)});
+      }
+      wake();
+    }
+
+    void wake() noexcept {
+      char c = 0;
+      (void) !::write(wake_wr_, &c, 1);
+    }
+
+    void work() {
+      std::unique_lock<std::mutex> lock(mtx_);
+      for (;;) {
+        cv_.wait(lock, [this]() { return stop_ || !jobs_.empty(); });
+        if (stop_) {
+          return;
+        }
+        std::string host = std::move(jobs_.front());
+        jobs_.pop_front();
+        lock.unlock();
+
+        resolve_result res;
+        res.host = host;
+        try {
+          res.error = lookup_(host, res.v4, res.v6);
+        } catch (...) {
+          res.error = EAI_FAIL;
+        }
+
+        lock.lock();
+        if (cacheable(res.error) && cache_limit_) {
+          auto ttl = res.error ? negative_ttl_ : positive_ttl_;
+          make_room(host);
+          cache_[host] = entry{res, clock::now() + ttl};
+        }
+        auto waiters = std::move(inflight_[host]);
+        inflight_.erase(host);
+        for (auto& w : waiters) {
+          completions_.push_back(completion{res, std::move(w.cb)});
+          apply_port(completions_.back().result, w.port);
+        }
+        wake();
+      }
+    }
+
+    Lookup lookup_;
+    mutable std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<std::string> jobs_;
+    std::unordered_map<std::string, std::vector<waiter>> inflight_;
+    std::unordered_map<std::string, entry> cache_;
+    std::size_t cache_limit_;
+    std::vector<completion> completions_;
+    std::chrono::seconds positive_ttl_ = std::chrono::seconds(60);
+    std::chrono::seconds negative_ttl_ = std::chrono::seconds(5);
+    bool stop_ = false;
+    fd_type wake_rd_ = fd_invalid;
+    fd_type wake_wr_ = fd_invalid;
+    std::vector<std::thread> workers_;
+  };
+
+  using resolver = basic_resolver<>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_RESOLVER_H_
@@ -0,0 +1,231 @@
+#ifndef SOCKCP_SOCKCP_SEND_QUEUE_H_
+#define SOCKCP_SOCKCP_SEND_QUEUE_H_
+
+#if !(defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__))
+#error Send queue is not supported on Windows
+#endif
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "buffer_pool.h"
+#include "socket.h"
+#include "socket_observer.h"
+
+namespace sockcp {
+  // Outgoing queue for one nonblocking socket. write() sends straight
+  // through while the kernel buffer has room and parks the rest in blocks
+  // borrowed from a buffer_pool; flush() drains them with gathered sendmsg
+  // calls when socket_observer reports event::out.
+  //
+  // Once more than high_watermark bytes are queued the queue is paused:
+  // write() returns false and the producer should stop until the resume
+  // callback fires, which happens when flush() drains below low_watermark.
+  // A write that could leave more than limit bytes queued throws
+  // std::length_error, so neither a producer ignoring backpressure nor
+  // one oversized write can grow a slow reader's queue without bound. Idle
+  // queues hold no blocks, so memory follows the connections actually
+  // waiting on slow readers.
+  //
+  // All I/O goes through the socket's Syscalls policy. One without
+  // native descriptors (memory_calls) has no gathered send, so there
+  // flush() sends one block per call.
+  template <typename ProtocolFamily, typename Syscalls = system_calls>
+  class basic_send_queue final {
+    struct chunk {
+      char* data;
+      std::size_t begin;
+      std::size_t end;
+    };
+
+    static constexpr std::size_t max_iov = 64;
+
+   public:
+    basic_send_queue(basic_socket<ProtocolFamily, Syscalls>& sock, buffer_pool& pool,
+                     std::size_t high_watermark = 64*1024, std::size_t low_watermark = 16*1024,
+                     std::size_t limit = 0)
+        : sock_(sock), pool_(pool),
+          high_(high_watermark), low_(std::min(low_watermark, high_watermark)),
+          limit_(limit ? std::max(limit, high_watermark) : 2*high_watermark) {}
+
+    basic_send_queue(const basic_send_queue&) = delete;
+    basic_send_queue& operator=(const basic_send_queue&) = delete;
+
+    ~basic_send_queue() noexcept {
+      clear();
+    }
+
+    // Queues data and returns whether the producer may keep writing.
+    // Writes that could exceed limit, counting all of data as unsent, are
+    // refused before anything is sent, so a write is taken whole or not
+    // at all; split messages larger than limit.
+    bool write(const char* data, std::size_t count) {
+      SOCKCP_ASSERT(
+        queued_ + count <= limit_,
+        std::length_error("send_queue: limit exceeded")
+      );
+      if (empty()) {
+        std::size_t sent = send_some(data, count);
+        data += sent;
+        count -= sent;
+      }
+      append(data, count);
+      if (queued_ > high_) {
+        paused_ = true;
+      }
+      return !paused_;
+    }
+
+    bool write(std::string_view data) {
+      return write(data.data(), data.size());
+    }
+
+    // Sends as much as the kernel takes. Returns true once everything
+    // queued is sent; fires the resume callback when crossing low_watermark.
+    bool flush() {
+      while (!empty()) {
+        errno = 0;
+        std::ptrdiff_t sent = send_queued();
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+          break;
+        }
+        SOCKCP_ASSERT(sent >= 0, socket_error("flush"));
+        consume(static_cast<std::size_t>(sent));
+      }
+      if (paused_ && queued_ <= low_) {
+        paused_ = false;
+        if (on_resume_) {
+          on_resume_();
+        }
+      }
+      return empty();
+    }
+
+    void on_resume(std::function<void()> callback) {
+      on_resume_ = std::move(callback);
+    }
+
+    // Events to watch the socket for: event::out only while data waits
+    event interest() const noexcept {
+      return empty() ? event::no_event : event::out;
+    }
+
+    bool paused() const noexcept { return paused_; }
+
+    bool empty() const noexcept { return head_ == chunks_.size(); }
+
+    std::size_t queued() const noexcept { return queued_; }
+
+    // Drops everything queued, e.g. before closing the connection.
+    void clear() noexcept {
+      for (std::size_t i = head_; i < chunks_.size(); ++i) {
+        pool_.release(chunks_[i].data);
+      }
+      chunks_.clear();
+      head_ = queued_ = 0;
+      paused_ = false;
+    }
+
+   private:
+#if defined(MSG_NOSIGNAL)
+    static constexpr int send_flags = MSG_NOSIGNAL | MSG_DONTWAIT;
+#else
+    static constexpr int send_flags = MSG_DONTWAIT;
+#endif
+
+    // One gathered sendmsg() over up to max_iov blocks, or a send() of the
+    // head block where the policy has no sendmsg()
+    std::ptrdiff_t send_queued() {
+      if constexpr (Syscalls::native) {
+        ::iovec iov[max_iov];
+        std::size_t n = 0;
+        for (std::size_t i = head_; i < chunks_.size() && n < max_iov; ++i, ++n) {
+          iov[n].iov_base = chunks_[i].data + chunks_[i].begin;
+          iov[n].iov_len = chunks_[i].end - chunks_[i].begin;
+        }
+        ::msghdr msg{};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n;
+        return ::sendmsg(sock_.fd(), &msg, send_flags);
+      } else {
+        const chunk& head = chunks_[head_];
+        return Syscalls::send(sock_.fd(), head.data + head.begin, head.end - head.begin, send_flags);
+      }
+    }
+
+    std::size_t send_some(const char* data, std::size_t count) {
+      if (!count) {
+        return 0;
+      }
+      errno = 0;
+      std::ptrdiff_t sent = Syscalls::send(sock_.fd(), data, count, send_flags);
+      if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return 0;
+      }
+      SOCKCP_ASSERT(sent >= 0, socket_error("write"));
+      return static_cast<std::size_t>(sent);
+    }
+
+    // Fills the tail block before borrowing new ones
+    void append(const char* data, std::size_t count) {
+      std::size_t block = pool_.block_size();
+      while (count) {
+        if (empty() || chunks_.back().end == block) {
+          chunks_.push_back(chunk{pool_.acquire(), 0, 0});
+        }
+        chunk& tail = chunks_.back();
+        std::size_t n = std::min(count, block - tail.end);
+        std::memcpy(tail.data + tail.end, data, n);
+        tail.end += n;
+        queued_ += n;
+        data += n;
+        count -= n;
+      }
+    }
+
+    void consume(std::size_t sent) {
+      queued_ -= sent;
+      while (sent) {
+        chunk& head = chunks_[head_];
+        std::size_t n = std::min(sent, head.end - head.begin);
+        head.begin += n;
+        sent -= n;
+        if (head.begin == head.end) {
+          pool_.release(head.data);
+          ++head_;
+        }
+      }
+      if (empty()) {
+        chunks_.clear();
+        head_ = 0;
+      } else if (head_ >= max_iov && head_*2 >= chunks_.size()) {
+        chunks_.erase(chunks_.begin(), chunks_.begin() + head_);
+        head_ = 0;
+      }
+    }
+
+    basic_socket<ProtocolFamily, Syscalls>& sock_;
+    buffer_pool& pool_;
+    std::size_t high_;
+    std::size_t low_;
+    std::size_t limit_;
+    std::size_t queued_ = 0;
+    bool paused_ = false;
+    std::size_t head_ = 0;
+    std::vector<chunk> chunks_;
+    std::function<void()> on_resume_;
+  };
+
+  using send_queue = basic_send_queue<ipv4>;
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_SEND_QUEUE_H_
@@ -0,0 +1,389 @@
+#ifndef SOCKCP_SOCKCP_SHM_SOCKET_H_
+#define SOCKCP_SOCKCP_SHM_SOCKET_H_
+
+#if !defined(__linux__)
+#error Shared memory sockets require memfd and eventfd, which are Linux only
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "socket.h"
+#include "unix_address.h"
+
+namespace sockcp {
+  // Same-host stream transport over a pair of single-producer single-consumer
+  // rings in a memfd mapping. Each endpoint owns an eventfd doorbell which the
+  // peer rings only when this endpoint announced it is about to sleep, so a
+  // busy connection moves data without any syscalls.
+  //
+  // The mapping and doorbells are exchanged over a unix_addr socket with
+  // create() on one side and open() on the other. fd() returns the doorbell:
+  // attach it to socket_observer with event::in, it becomes readable both
+  // when data arrives and when the peer frees space after a write returned
+  // EAGAIN. A new socket is armed for the first data; afterwards a read()
+  // that finds the ring empty, or a write() failing with EAGAIN, clears
+  // the doorbell and arms it again, so a level triggered observer only
+  // wakes when there is something to do.
+  class shm_socket final {
+    struct alignas(64) ring_header {
+      alignas(64) std::atomic<uint64_t> head;  // written by the producer
+      alignas(64) std::atomic<uint64_t> tail;  // written by the consumer
+      alignas(64) std::atomic<uint32_t> reader_waiting;
+      std::atomic<uint32_t> writer_waiting;
+      std::atomic<uint32_t> closed;
+      uint64_t capacity;
+    };
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared rings need lock free atomics");
+
+   public:
+    static constexpr std::size_t default_capacity = 1u << 20;
+
+    // Allocates the rings and hands them to the peer over channel.
+    // Capacity is rounded up to a power of two.
+    static shm_socket create(basic_socket<unix_addr>& channel,
+                             std::size_t capacity = default_capacity) {
+      std::size_t cap = 4096;
+      for (; cap < capacity; cap <<= 1);
+
+      shm_socket res;
+      res.memfd_ = ::memfd_create("sockcp_shm", MFD_CLOEXEC);
+      SOCKCP_ASSERT(res.memfd_ >= 0, socket_error("shm_socket"));
+      SOCKCP_ASSERT(
+        !::ftruncate(res.memfd_, mapping_size(cap)),
+        socket_error("shm_socket")
+      );
+      res.own_bell_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      res.peer_bell_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+      SOCKCP_ASSERT(res.own_bell_ >= 0 && res.peer_bell_ >= 0, socket_error("shm_socket"));
+      res.map(cap, 0);
+      // Readers start out waiting, so the first write rings the doorbell
+      new (res.tx_) ring_header{{0}, {0}, {1}, {0}, {0}, cap};
+      new (res.rx_) ring_header{{0}, {0}, {1}, {0}, {0}, cap};
+
+      // The peer's doorbell goes first: from its side the roles are swapped.
+      fd_type fds[3] = {res.memfd_, res.peer_bell_, res.own_bell_};
+      uint64_t announced = cap;
+      channel.send_fds(fds, 3, reinterpret_cast<const char*>(&announced), sizeof(announced));
+      return res;
+    }
+
+    // Accepts the rings offered by create() on the other end of channel.
+    static shm_socket open(basic_socket<unix_addr>& channel) {
+      fd_type fds[3] = {fd_invalid, fd_invalid, fd_invalid};
+      std::size_t nfds = 3;
+      uint64_t cap = 0;
+      std::size_t rd = channel.recv_fds(fds, nfds, reinterpret_cast<char*>(&cap), sizeof(cap));
+
+      shm_socket res;
+      res.memfd_ = fds[0];
+      res.own_bell_ = fds[1];
+      res.peer_bell_ = fds[2];
+      SOCKCP_ASSERT(
+        nfds == 3 && rd == sizeof(cap),
+        std::runtime_error("shm_socket: malformed handshake")
+      );
+      // The announced capacity must describe the segment actually shared
+      struct ::stat st{};
+      SOCKCP_ASSERT(!::fstat(res.memfd_, &st), socket_error("shm_socket"));
+      SOCKCP_ASSERT(
+        cap && cap <= static_cast<uint64_t>(st.st_size)/2 && mapping_size(cap) <= static_cast<uint64_t>(st.st_size),
+        std::runtime_error("shm_socket: ring capacity exceeds the shared segment")
+      );
+      res.map(cap, 1);
+      SOCKCP_ASSERT(
+        res.tx_->capacity == cap && res.rx_->capacity == cap,
+        std::runtime_error("shm_socket: malformed handshake")
+      );
+      return res;
+    }
+
+    shm_socket(const shm_socket&) = delete;
+    shm_socket(shm_socket&& other) noexcept { *this = std::move(other); }
+
+    shm_socket& operator=(const shm_socket&) = delete;
+    shm_socket& operator=(shm_socket&& other) noexcept {
+      if (this != &other) {
+        close();
+        std::swap(memfd_, other.memfd_);
+        std::swap(own_bell_, other.own_bell_);
+        std::swap(peer_bell_, other.peer_bell_);
+        std::swap(mapping_, other.mapping_);
+        std::swap(mapping_size_, other.mapping_size_);
+        std::swap(tx_, other.tx_);
+        std::swap(rx_, other.rx_);
+        std::swap(capacity_, other.capacity_);
+        blocking_ = other.blocking_;
+        spin_ = other.spin_;
+      }
+      return *this;
+    }
+
+    ~shm_socket() noexcept {
+      close();
+    }
+
+    fd_type fd() const noexcept { return own_bell_; }
+
+    bool blocking() const noexcept {
+      return blocking_;
+    }
+
+    void set_block(bool val) noexcept {
+      blocking_ = val;
+    }
+
+    // Number of empty ring checks to spin through, yielding in between,
+    // before a blocking call goes to sleep on the doorbell. Trades CPU for
+    // wakeup latency.
+    void set_spin(std::size_t iterations) noexcept {
+      spin_ = iterations;
+    }
+
+    // Returns 0 instead of blocking when the socket is nonblocking and no
+    // data is available, and at once when count is 0. Throws
+    // disconnect_error once the peer closed and the ring is drained.
+    std::size_t read(char* mem, std::size_t count) {
+      if (!count) {
+        return 0;
+      }
+      for (std::size_t spins = 0;; ++spins) {
+        std::size_t rd = pop(mem, count);
+        if (rd) {
+          return rd;
+        }
+        if (rx_->closed.load(std::memory_order_acquire)) {
+          rd = pop(mem, count);
+          SOCKCP_ASSERT(rd, disconnect_error());
+          return rd;
+        }
+        if (spins < spin_) {
+          std::this_thread::yield();
+          continue;
+        }
+        rx_->reader_waiting.store(1, std::memory_order_seq_cst);
+        // Rings before this point are stale: their data is seen below
+        drain_bell();
+        if ((rd = pop(mem, count))) {
+          if (!rx_->reader_waiting.exchange(0)) {
+            // The writer took the flag and rang, or is about to
+            drain_bell();
+          }
+          return rd;
+        }
+        if (!blocking_) {
+          return 0;
+        }
+        wait();
+      }
+    }
+
+    std::vector<char> read(std::size_t count = std::size_t(-1)) {
+      static constexpr std::size_t kBufLen = 255;
+      if (!count) {
+        return {};
+      }
+      std::vector<char> res(std::min(kBufLen, count));
+      res.resize(read(res.data(), res.size()));
+      for (std::size_t rd = res.size(); rd && res.size() < count;) {
+        std::size_t at = res.size();
+        res.resize(std::min(at + kBufLen, count));
+        rd = pop(res.data() + at, res.size() - at);
+        res.resize(at + rd);
+      }
+      return res;
+    }
+
+    void write(const char* data, std::size_t count, std::size_t chunk = 0) {
+      (void) chunk;
+      for (std::size_t spins = 0; count;) {
+        SOCKCP_ASSERT(!tx_->closed.load(std::memory_order_relaxed), disconnect_error());
+        std::size_t wr = push(data, count);
+        count -= wr;
+        data += wr;
+        if (wr || !count) {
+          spins = 0;
+          continue;
+        }
+        if (++spins < spin_) {
+          std::this_thread::yield();
+          continue;
+        }
+        tx_->writer_waiting.store(1, std::memory_order_seq_cst);
+        drain_bell();
+        if (space()) {
+          if (!tx_->writer_waiting.exchange(0)) {
+            drain_bell();
+          }
+          continue;
+        }
+        if (!blocking_) {
+          errno = EAGAIN;
+          throw socket_error("write");
+        }
+        wait();
+      }
+    }
+
+    void write(const std::string& data, std::size_t chunk = 0) {
+      write(data.data(), data.size(), chunk);
+    }
+
+    void write(const std::string_view& data, std::size_t chunk = 0) {
+      write(data.data(), data.size(), chunk);
+    }
+
+    void write(const std::vector<char>& data, std::size_t chunk = 0) {
+      write(data.data(), data.size(), chunk);
+    }
+
+    void shutdown(closeway how) noexcept {
+      if (!tx_) {
+        return;
+      }
+      if (how != closeway::read) {
+        tx_->closed.store(1, std::memory_order_release);
+      }
+      if (how != closeway::write) {
+        rx_->closed.store(1, std::memory_order_release);
+      }
+      ring(peer_bell_);
+    }
+
+    void close() noexcept {
+      shutdown(closeway::readwrite);
+      if (mapping_) {
+        ::munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+        tx_ = rx_ = nullptr;
+      }
+      for (fd_type* fd : {&memfd_, &own_bell_, &peer_bell_}) {
+        if (*fd != fd_invalid) {
+          ::close(*fd);
+          *fd = fd_invalid;
+        }
+      }
+    }
+
+   private:
+    shm_socket() noexcept = default;
+
+    static std::size_t mapping_size(std::size_t capacity) noexcept {
+      return 2*(sizeof(ring_header) + capacity);
+    }
+
+    static char* ring_data(ring_header* ring) noexcept {
+      return reinterpret_cast<char*>(ring + 1);
+    }
+
+    // Side 0 produces into the first ring, side 1 into the second. The
+    // capacity is kept locally, the shared headers are writable by the peer.
+    void map(std::size_t capacity, int side) {
+      SOCKCP_ASSERT(
+        capacity && !(capacity & (capacity - 1)),
+        std::runtime_error("shm_socket: ring capacity is not a power of two")
+      );
+      mapping_size_ = mapping_size(capacity);
+      void* mem = ::mmap(nullptr, mapping_size_, PROT_READ | PROT_WRITE, MAP_SHARED, memfd_, 0);
+      SOCKCP_ASSERT(mem != MAP_FAILED, socket_error("shm_socket"));
+      mapping_ = mem;
+      auto* first = static_cast<ring_header*>(mem);
+      auto* second = reinterpret_cast<ring_header*>(ring_data(first) + capacity);
+      tx_ = side ? second : first;
+      rx_ = side ? first : second;
+      capacity_ = capacity;
+    }
+
+    std::size_t space() const noexcept {
+      std::size_t used = tx_->head.load(std::memory_order_relaxed) - tx_->tail.load(std::memory_order_acquire);
+      return used < capacity_ ? capacity_ - used : 0;
+    }
+
+    std::size_t push(const char* data, std::size_t count) noexcept {
+      uint64_t head = tx_->head.load(std::memory_order_relaxed);
+      std::size_t n = std::min(count, space());
+      if (!n) {
+        return 0;
+      }
+      std::size_t mask = capacity_ - 1;
+      std::size_t at = head & mask;
+      std::size_t first = std::min(n, capacity_ - at);
+      std::memcpy(ring_data(tx_) + at, data, first);
+      std::memcpy(ring_data(tx_), data + first, n - first);
+      tx_->head.store(head + n, std::memory_order_seq_cst);
+      if (tx_->reader_waiting.load(std::memory_order_seq_cst)
+          && tx_->reader_waiting.exchange(0)) {
+        ring(peer_bell_);
+      }
+      return n;
+    }
+
+    std::size_t pop(char* mem, std::size_t count) noexcept {
+      uint64_t tail = rx_->tail.load(std::memory_order_relaxed);
+      std::size_t avail = rx_->head.load(std::memory_order_acquire) - tail;
+      std::size_t n = std::min({count, avail, capacity_});
+      if (!n) {
+        return 0;
+      }
+      std::size_t mask = capacity_ - 1;
+      std::size_t at = tail & mask;
+      std::size_t first = std::min(n, capacity_ - at);
+      std::memcpy(mem, ring_data(rx_) + at, first);
+      std::memcpy(mem + first, ring_data(rx_), n - first);
+      rx_->tail.store(tail + n, std::memory_order_seq_cst);
+      if (rx_->writer_waiting.load(std::memory_order_seq_cst)
+          && rx_->writer_waiting.exchange(0)) {
+        ring(peer_bell_);
+      }
+      return n;
+    }
+
+    static void ring(fd_type bell) noexcept {
+      uint64_t one = 1;
+      if (bell != fd_invalid) {
+        (void) !::write(bell, &one, sizeof(one));
+      }
+    }
+
+    // Clears the doorbell without blocking, it is nonblocking
+    void drain_bell() noexcept {
+      uint64_t counter;
+      (void) !::read(own_bell_, &counter, sizeof(counter));
+    }
+
+    void wait() {
+      ::pollfd pfd{own_bell_, POLLIN, 0};
+      errno = 0;
+      SOCKCP_ASSERT(::poll(&pfd, 1, -1) >= 0 || errno == EINTR, socket_error("shm_socket"));
+      uint64_t counter;
+      (void) !::read(own_bell_, &counter, sizeof(counter));
+    }
+
+    fd_type memfd_ = fd_invalid;
+    fd_type own_bell_ = fd_invalid;
+    fd_type peer_bell_ = fd_invalid;
+    void* mapping_ = nullptr;
+    std::size_t mapping_size_ = 0;
+    ring_header* tx_ = nullptr;
+    ring_header* rx_ = nullptr;
+    std::size_t capacity_ = 0;
+    bool blocking_ = true;
+    std::size_t spin_ = 0;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_SHM_SOCKET_H_
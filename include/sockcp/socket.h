@@ -1,6 +1,9 @@
 #ifndef SOCKCP_SOCKCP_SOCKET_H_
 #define SOCKCP_SOCKCP_SOCKET_H_
 
+#include <algorithm>
+#include <cstddef>
+#include <stdexcept>
 #include <vector>
 #include <string>
 #include <string_view>
@@ -24,12 +27,14 @@
 #endif
 
 #include "inet_address.h"
+#include "trace_points.h"
 
 namespace sockcp {
 #if defined (__unix__) || (defined (__APPLE__) && defined (__MACH__)) || defined(__CYGWIN__)
 
   using socklen_t = ::socklen_t;
   using fd_type = int;
+  using pollfd_t = ::pollfd;
 
   static constexpr fd_type fd_invalid = -1;  
 
@@ -45,6 +50,7 @@ namespace sockcp {
 
   using socklen_t = int;
   using fd_type = ::SOCKET;
+  using pollfd_t = WSAPOLLFD;
   
   static constexpr fd_type fd_invalid = INVALID_SOCKET;  
 
@@ -66,23 +72,108 @@ namespace sockcp {
     rdm = SOCK_RDM
   };
 
-  template <typename ProtocolFamily>
+  // Syscall policy of basic_socket, basic_socket_buffer and
+  // basic_socket_observer: the operating system's socket API, called
+  // directly. Another policy (see memory_transport.h) provides the same
+  // static members with the same return values and errno conventions,
+  // so the library code above it runs unchanged over a different
+  // transport. native tells whether descriptors are kernel descriptors.
+  struct system_calls {
+    static constexpr bool native = true;
+
+    static fd_type socket(int family, int type, int protocol) noexcept {
+      return ::socket(family, type, protocol);
+    }
+
+    static int close(fd_type fd) noexcept { return sock_close(fd); }
+
+    static int bind(fd_type fd, const ::sockaddr* addr, socklen_t len) noexcept {
+      return ::bind(fd, addr, len);
+    }
+
+    static int connect(fd_type fd, const ::sockaddr* addr, socklen_t len) noexcept {
+      return ::connect(fd, addr, len);
+    }
+
+    static int listen(fd_type fd, int backlog) noexcept { return ::listen(fd, backlog); }
+
+    static fd_type accept(fd_type fd, ::sockaddr* addr, socklen_t* len) noexcept {
+      return ::accept(fd, addr, len);
+    }
+
+    static std::ptrdiff_t recv(fd_type fd, char* data, std::size_t count, int flags) noexcept {
+      return ::recv(fd, data, count, flags);
+    }
+
+    static std::ptrdiff_t send(fd_type fd, const char* data, std::size_t count, int flags) noexcept {
+      return ::send(fd, data, count, flags);
+    }
+
+    static int shutdown(fd_type fd, int how) noexcept { return ::shutdown(fd, how); }
+
+    static int setsockopt(fd_type fd, int level, int name, const void* value, socklen_t len) noexcept {
+      return ::setsockopt(fd, level, name, static_cast<const char*>(value), len);
+    }
+
+    static int getsockopt(fd_type fd, int level, int name, void* value, socklen_t* len) noexcept {
+      return ::getsockopt(fd, level, name, static_cast<char*>(value), len);
+    }
+
+    static int getsockname(fd_type fd, ::sockaddr* addr, socklen_t* len) noexcept {
+      return ::getsockname(fd, addr, len);
+    }
+
+    static int getpeername(fd_type fd, ::sockaddr* addr, socklen_t* len) noexcept {
+      return ::getpeername(fd, addr, len);
+    }
+
+    static int set_nonblocking(fd_type fd, bool on) noexcept {
+#if defined(_WIN32)
+      unsigned long opt = on;
+      return ::ioctlsocket(fd, FIONBIO, &opt);
+#else
+      return ::fcntl(fd, F_SETFL, on ? O_NONBLOCK : 0);
+#endif  // _WIN32
+    }
+
+    // Windows cannot query the mode and reports blocking
+    static bool nonblocking(fd_type fd) noexcept {
+#if defined(_WIN32)
+      (void)fd;
+      return false;
+#else
+      return ::fcntl(fd, F_GETFL) & O_NONBLOCK;
+#endif  // _WIN32
+    }
+
+    static int poll(pollfd_t* fds, std::size_t count, int timeout) noexcept {
+#if defined(_WIN32)
+      return ::WSAPoll(fds, static_cast<ULONG>(count), timeout);
+#else
+      return ::poll(fds, static_cast<::nfds_t>(count), timeout);
+#endif  // _WIN32
+    }
+  };
+
+  template <typename ProtocolFamily, typename Syscalls = system_calls>
   class basic_socket final {
    public:
     
     static constexpr int protocol_family = ProtocolFamily::family;
 
+    using syscalls = Syscalls;
+
     basic_socket(socktype type, int protocol = 0) 
-        : type_(static_cast<int>(type)), blocking_(false) {
+        : type_(static_cast<int>(type)), blocking_(true) {
 #if defined(_WIN32)
       wsa_ = wsadata_allocator().allocate();
 #endif  // _WIN32
-      fd_ = ::socket(protocol_family, type_, protocol);
+      fd_ = Syscalls::socket(protocol_family, type_, protocol);
       SOCKCP_ASSERT(fd_ >= 0, socket_error("basic_socket"));
     }
 
     basic_socket(basic_socket&) = delete;
-    basic_socket(basic_socket&& other) noexcept {
+    basic_socket(basic_socket&& other) noexcept : fd_(fd_invalid) {
 #if defined(_WIN32)
       wsa_ = wsadata_allocator().allocate();
 #endif  // _WIN32
@@ -91,6 +182,10 @@ namespace sockcp {
 
     basic_socket& operator=(basic_socket&) = delete;
     basic_socket& operator=(basic_socket&& other) noexcept {
+      if (this == &other) {
+        return *this;
+      }
+      close();
       fd_ = other.fd_;
       type_ = other.type_;
       blocking_ = other.blocking_;
@@ -121,18 +216,32 @@ namespace sockcp {
     }
 
     void set_block(bool val) {
-      unsigned long opt = static_cast<int>(val);
       blocking_ = val;
-#if defined(_WIN32)
-      SOCKCP_ASSERT(!ioctlsocket(fd_, FIONBIO, &opt), socket_error("block"));      
-#else
-      SOCKCP_ASSERT(!::fcntl(fd_, F_SETFL, O_NONBLOCK*opt), socket_error("block"));
-#endif  // _WIN32 
+      SOCKCP_ASSERT(!Syscalls::set_nonblocking(fd_, !val), socket_error("block"));
+    }
+
+    template <typename T>
+    void set_option(int level, int name, const T& value) {
+      SOCKCP_ASSERT(
+        Syscalls::setsockopt(fd_, level, name, &value, sizeof(T)) == 0,
+        socket_error("set_option")
+      );
+    }
+
+    template <typename T>
+    T get_option(int level, int name) const {
+      T value{};
+      socklen_t len = sizeof(T);
+      SOCKCP_ASSERT(
+        Syscalls::getsockopt(fd_, level, name, &value, &len) == 0,
+        socket_error("get_option")
+      );
+      return value;
     }
 
     void bind(ProtocolFamily addr) {
       SOCKCP_ASSERT(
-        ::bind(fd_, addr.data(), addr.size()) == 0, 
+        Syscalls::bind(fd_, addr.data(), addr.size()) == 0, 
         socket_error("bind")
       );
       name_ = addr;
@@ -144,13 +253,13 @@ namespace sockcp {
 
     void connect(ProtocolFamily addr) {
       errno = 0;
-      ::connect(fd_, addr.data(), addr.size());
+      Syscalls::connect(fd_, addr.data(), addr.size());
       SOCKCP_ASSERT(!errno || errno == EINPROGRESS, socket_error("connect"));
     }
 
     void listen(int backlog = 0) {
       SOCKCP_ASSERT(
-        ::listen(fd_, backlog) == 0, 
+        Syscalls::listen(fd_, backlog) == 0, 
         socket_error("listen")
       );
     }
@@ -159,18 +268,66 @@ namespace sockcp {
       errno = 0;
       ProtocolFamily addr{};
       socklen_t len = addr.size();
-      int newfd = ::accept(fd_, addr.data(), &len);
+      SOCKCP_TRACE(span, io, "accept", fd_);
+      fd_type newfd = Syscalls::accept(fd_, addr.data(), &len);
+      SOCKCP_TRACE_RESULT(span, newfd);
       SOCKCP_ASSERT(
         !errno || errno == EAGAIN || errno == EWOULDBLOCK,
         socket_error("accept")
       );
-      return basic_socket(newfd, addr);
+      return basic_socket(newfd, addr, type_);
+    }
+
+    // accept() for event driven servers: the new socket starts out
+    // nonblocking, set by accept4() in the same call on Linux instead of
+    // two more fcntl() calls per connection.
+    basic_socket accept_nonblocking() {
+#if defined(__linux__)
+      if constexpr (Syscalls::native) {
+        errno = 0;
+        ProtocolFamily addr{};
+        socklen_t len = addr.size();
+        SOCKCP_TRACE(span, io, "accept", fd_);
+        fd_type newfd = ::accept4(fd_, addr.data(), &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        SOCKCP_TRACE_RESULT(span, newfd);
+        SOCKCP_ASSERT(
+          !errno || errno == EAGAIN || errno == EWOULDBLOCK,
+          socket_error("accept")
+        );
+        basic_socket res(newfd, addr, type_);
+        res.blocking_ = false;
+        return res;
+      }
+#endif
+      basic_socket res = accept();
+      if (res.fd_ != fd_invalid) {
+        res.set_block(false);
+      }
+      return res;
+    }
+
+    // Accepts the next connection whose peer address allow(const
+    // ProtocolFamily&) approves. Rejected peers are reset (SO_LINGER with
+    // zero timeout) and closed before any data is read, so denied clients
+    // cost one accept and one close. Returns an invalid socket once the
+    // backlog is drained on a nonblocking listener.
+    template <typename Filter>
+    basic_socket accept(Filter&& allow) {
+      for (;;) {
+        basic_socket sock = accept();
+        if (sock.fd() == fd_invalid || allow(sock.name())) {
+          return sock;
+        }
+        ::linger reset{1, 0};
+        sock.set_option(SOL_SOCKET, SO_LINGER, reset);
+        sock.close();
+      }
     }
 
     char peek() {
       char c = -1;
       errno = 0;
-      ::recv(fd_, &c, 1, MSG_PEEK);
+      Syscalls::recv(fd_, &c, 1, MSG_PEEK);
       if (errno == EAGAIN || errno == EWOULDBLOCK) {
         return -1;
       }
@@ -181,7 +338,9 @@ namespace sockcp {
     std::size_t read(char* mem, std::size_t count) {
       std::size_t rdbytes = -1;
       errno = 0;
-      rdbytes = ::recv(fd_, mem, count, 0);
+      SOCKCP_TRACE(span, io, "recv", fd_);
+      rdbytes = Syscalls::recv(fd_, mem, count, 0);
+      SOCKCP_TRACE_RESULT(span, rdbytes);
       SOCKCP_ASSERT(
         !errno || errno == EAGAIN || errno == EWOULDBLOCK,
         socket_error("read")
@@ -196,9 +355,10 @@ namespace sockcp {
       std::vector<char> buf;
       buf.resize(kBufLen);
       std::size_t rdbytes = kBufLen;
+      SOCKCP_TRACE(span, io, "recv", fd_);
       for (; count && rdbytes == kBufLen;) {
         errno = 0;
-        rdbytes = ::recv(fd_, buf.data(), kBufLen, 0);
+        rdbytes = Syscalls::recv(fd_, buf.data(), kBufLen, 0);
         if (errno == EAGAIN || errno == EWOULDBLOCK) {
           return res;
         }
@@ -208,6 +368,7 @@ namespace sockcp {
         );
         res.insert(res.end(), buf.begin(), buf.begin() + rdbytes);
         count -= rdbytes;
+        SOCKCP_TRACE_RESULT(span, res.size());
       }
       SOCKCP_ASSERT(!res.empty(), disconnect_error());
       return res;
@@ -217,9 +378,11 @@ namespace sockcp {
       if (!chunk) {
         chunk = count;
       }
+      SOCKCP_TRACE(span, io, "send", fd_);
+      SOCKCP_TRACE_RESULT(span, count);
       for (;count;) {
         errno = 0;
-        std::size_t wrbytes = ::send(fd_, data, chunk, 0);
+        std::size_t wrbytes = Syscalls::send(fd_, data, std::min(chunk, count), 0);
         SOCKCP_ASSERT(!errno, socket_error("write"));
         count -= wrbytes;
         data += wrbytes;
@@ -239,17 +402,180 @@ namespace sockcp {
     }
 
     void shutdown(closeway how) {
-      ::shutdown(fd_, static_cast<int>(how));
+      Syscalls::shutdown(fd_, static_cast<int>(how));
     }
 
     void close() noexcept {
-      SOCKCP_WRAP_NOEXCEPT(sock_close(fd_);)
+      if (fd_ != fd_invalid) {
+        SOCKCP_WRAP_NOEXCEPT(Syscalls::close(fd_);)
+        fd_ = fd_invalid;
+      }
     }
 
-    
+    // Gives up ownership of the descriptor without closing it.
+    fd_type release() noexcept {
+      fd_type fd = fd_;
+      fd_ = fd_invalid;
+      return fd;
+    }
+
+    // Takes ownership of a descriptor obtained elsewhere, e.g. via recv_fds.
+    // Like accept(), name() reports the peer for connected sockets. The
+    // descriptor must belong to ProtocolFamily, else invalid_argument is
+    // thrown. Ownership passes even on failure: the descriptor is closed.
+    static basic_socket adopt(fd_type fd) {
+      struct closer {
+        ~closer() {
+          if (fd != fd_invalid) {
+            Syscalls::close(fd);
+          }
+        }
+
+        fd_type fd;
+      } guard{fd};
+      ProtocolFamily addr{};
+      socklen_t len = addr.size();
+      if (Syscalls::getpeername(fd, addr.data(), &len)) {
+        len = addr.size();
+        SOCKCP_ASSERT(!Syscalls::getsockname(fd, addr.data(), &len), socket_error("adopt"));
+      }
+      SOCKCP_ASSERT(
+        static_cast<std::size_t>(len) >= sizeof(addr.data()->sa_family)
+          && static_cast<std::size_t>(len) <= static_cast<std::size_t>(addr.size())
+          && addr.data()->sa_family == protocol_family,
+        std::invalid_argument("adopt: descriptor of another address family")
+      );
+      int type = 0;
+      len = sizeof(type);
+      SOCKCP_ASSERT(!Syscalls::getsockopt(fd, SOL_SOCKET, SO_TYPE, &type, &len), socket_error("adopt"));
+      bool blocking = !Syscalls::nonblocking(fd);
+      basic_socket res(fd, addr, type);
+      res.blocking_ = blocking;
+      guard.fd = fd_invalid;
+      return res;
+    }
+
+#if !defined(_WIN32)
+    static constexpr std::size_t max_passed_fds = 253;  // SCM_MAX_FD
+
+    // Passes descriptors to the peer as SCM_RIGHTS ancillary data along with
+    // an optional payload. Stream sockets need at least one byte of data to
+    // carry the control message, so an empty payload is sent as a single 0.
+    std::size_t send_fds(const fd_type* fds, std::size_t nfds,
+                         const char* data = nullptr, std::size_t count = 0) {
+      static_assert(protocol_family == AF_UNIX, "descriptor passing requires unix_addr sockets");
+      static_assert(Syscalls::native, "descriptor passing requires kernel sockets");
+      SOCKCP_ASSERT(
+        nfds && nfds <= max_passed_fds,
+        std::length_error("send_fds: descriptor count out of range")
+      );
+      char filler = 0;
+      ::iovec iov{};
+      iov.iov_base = count ? const_cast<char*>(data) : &filler;
+      iov.iov_len = count ? count : 1;
+
+      std::vector<char> control(CMSG_SPACE(nfds*sizeof(fd_type)));
+      ::msghdr msg{};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.data();
+      msg.msg_controllen = control.size();
+      ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+      cmsg->cmsg_level = SOL_SOCKET;
+      cmsg->cmsg_type = SCM_RIGHTS;
+      cmsg->cmsg_len = CMSG_LEN(nfds*sizeof(fd_type));
+      std::memcpy(CMSG_DATA(cmsg), fds, nfds*sizeof(fd_type));
+
+      ssize_t sent = ::sendmsg(fd_, &msg, MSG_NOSIGNAL);
+      SOCKCP_ASSERT(sent >= 0, socket_error("send_fds"));
+      return count ? static_cast<std::size_t>(sent) : 0;
+    }
+
+    template <typename OtherFamily>
+    std::size_t send_fd(const basic_socket<OtherFamily>& sock,
+                        const char* data = nullptr, std::size_t count = 0) {
+      fd_type fd = sock.fd();
+      return send_fds(&fd, 1, data, count);
+    }
+
+    // Receives up to nfds descriptors into fds and the accompanying payload
+    // into data. On return nfds holds the number of descriptors received;
+    // they are close-on-exec and owned by the caller. Returns payload size.
+    // Descriptors beyond nfds are closed. When the kernel truncated the
+    // control data, all received descriptors are closed and length_error
+    // is thrown.
+    std::size_t recv_fds(fd_type* fds, std::size_t& nfds,
+                         char* data = nullptr, std::size_t count = 0) {
+      static_assert(protocol_family == AF_UNIX, "descriptor passing requires unix_addr sockets");
+      static_assert(Syscalls::native, "descriptor passing requires kernel sockets");
+      char filler = 0;
+      ::iovec iov{};
+      iov.iov_base = count ? data : &filler;
+      iov.iov_len = count ? count : 1;
+
+      std::vector<char> control(CMSG_SPACE(std::min(nfds, max_passed_fds)*sizeof(fd_type)));
+      ::msghdr msg{};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      msg.msg_control = control.data();
+      msg.msg_controllen = control.size();
+
+      errno = 0;
+      ssize_t received = ::recvmsg(fd_, &msg, MSG_CMSG_CLOEXEC);
+      SOCKCP_ASSERT(
+        received >= 0 || errno == EAGAIN || errno == EWOULDBLOCK,
+        socket_error("recv_fds")
+      );
+      std::size_t max_fds = nfds;
+      nfds = 0;
+      if (received < 0) {
+        return 0;
+      }
+      SOCKCP_ASSERT(received > 0, disconnect_error());
+      for (::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+          continue;
+        }
+        std::size_t n = (cmsg->cmsg_len - CMSG_LEN(0))/sizeof(fd_type);
+        for (std::size_t i = 0; i < n; ++i) {
+          fd_type fd;
+          std::memcpy(&fd, CMSG_DATA(cmsg) + i*sizeof(fd_type), sizeof(fd_type));
+          if (nfds < max_fds) {
+            fds[nfds++] = fd;
+          } else {
+            sock_close(fd);
+          }
+        }
+      }
+      if (msg.msg_flags & MSG_CTRUNC) {
+        for (std::size_t i = 0; i < nfds; ++i) {
+          sock_close(fds[i]);
+          fds[i] = fd_invalid;
+        }
+        nfds = 0;
+        throw std::length_error("recv_fds: descriptors truncated");
+      }
+      return count ? static_cast<std::size_t>(received) : 0;
+    }
+
+    template <typename OtherFamily>
+    basic_socket<OtherFamily> recv_fd(char* data = nullptr, std::size_t count = 0,
+                                      std::size_t* received = nullptr) {
+      fd_type fd = fd_invalid;
+      std::size_t nfds = 1;
+      std::size_t rd = recv_fds(&fd, nfds, data, count);
+      if (received) {
+        *received = rd;
+      }
+      SOCKCP_ASSERT(nfds == 1, std::runtime_error("recv_fd: no descriptor received"));
+      // Closes fd if it cannot be adopted
+      return basic_socket<OtherFamily>::adopt(fd);
+    }
+#endif  // _WIN32
+
    private:
-    basic_socket(fd_type fd, ProtocolFamily addr) noexcept
-        : fd_(fd), name_(addr) {}
+    basic_socket(fd_type fd, ProtocolFamily addr, int type) noexcept
+        : fd_(fd), type_(type), blocking_(true), name_(addr) {}
 
     fd_type fd_;
     int type_;
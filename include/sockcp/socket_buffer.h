@@ -1,16 +1,21 @@
 #ifndef SOCKCP_SOCKCP_SOCKET_BUFFER_H_
 #define SOCKCP_SOCKCP_SOCKET_BUFFER_H_
 
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <memory>
+#include <string>
 #include <vector>
 
+#include "buffer_pool.h"
 #include "socket.h"
 
 namespace sockcp {
-  template <typename ProtocolFamily>
+  template <typename ProtocolFamily, typename Syscalls = system_calls>
   class basic_socket_buffer final {
    public:
-    basic_socket_buffer(basic_socket<ProtocolFamily>&& socket, std::size_t buffer_size = 512u) 
+    basic_socket_buffer(basic_socket<ProtocolFamily, Syscalls>&& socket, std::size_t buffer_size = 512u) 
       : sock_(std::move(socket)),
         buf_size_(buffer_size),
         buf_(new char[buf_size_]),
@@ -20,74 +25,127 @@ namespace sockcp {
       fill_buffer();
     }
 
+    // Lazy mode: the buffer holds no receive memory until the socket is
+    // readable, then borrows a block from pool and returns it once drained.
+    basic_socket_buffer(basic_socket<ProtocolFamily, Syscalls>&& socket, buffer_pool& pool) 
+      : sock_(std::move(socket)),
+        buf_size_(pool.block_size()),
+        buf_(nullptr),
+        end_(nullptr),
+        pos_(nullptr),
+        pool_(&pool) {}
+
     basic_socket_buffer(const basic_socket_buffer&) = delete;
     basic_socket_buffer(basic_socket_buffer&& other)
       noexcept : sock_(std::move(other.sock_)),
         buf_size_(other.buf_size_),
         buf_(other.buf_),
         end_(other.end_),
-        pos_(other.pos_) {
+        pos_(other.pos_),
+        pool_(other.pool_),
+        partial_(std::move(other.partial_)),
+        blocked_(other.blocked_) {
       other.pos_ = other.end_ = other.buf_ = nullptr;
-      fill_buffer();
     }
     
     basic_socket_buffer& operator=(const basic_socket_buffer&) = delete;
     basic_socket_buffer& operator=(basic_socket_buffer&& other) noexcept {
+      if (this == &other) {
+        return *this;
+      }
+      // Gives back the buffer held so far, as the destructor does
+      if (buf_) {
+        SOCKCP_WRAP_NOEXCEPT(flush();)
+      }
+      release_buffer();
       sock_ = std::move(other.sock_);
       buf_size_ = other.buf_size_;
       buf_ = other.buf_;
       end_ = other.end_;
       pos_ = other.pos_;
+      pool_ = other.pool_;
+      partial_ = std::move(other.partial_);
+      blocked_ = other.blocked_;
+      other.partial_.clear();
       other.pos_ = other.end_ = other.buf_ = nullptr;
-      fill_buffer();
+      return *this;
     }
 
     ~basic_socket_buffer() noexcept {
       if (buf_) {
-        flush();
+        SOCKCP_WRAP_NOEXCEPT(flush();)
       }
-      delete buf_;
+      release_buffer();
     }
 
-    const basic_socket<ProtocolFamily>& bound_socket() const noexcept {
+    const basic_socket<ProtocolFamily, Syscalls>& bound_socket() const noexcept {
       return sock_;
     }
 
+    bool lazy() const noexcept { return pool_ != nullptr; }
+
+    bool attached() const noexcept { return buf_ != nullptr; }
+
+    // Receive memory currently held by this buffer, excluding the object itself.
+    std::size_t resident_bytes() const noexcept {
+      return buf_ ? buf_size_ : 0;
+    }
+
+    // Whether the last read_until() or >> stopped because a nonblocking
+    // socket had no more data. The bytes read so far are kept and the
+    // next call carries on from them.
+    bool would_block() const noexcept { return blocked_; }
+
     std::size_t read(char* mem, std::size_t count) {
-      std::memcpy(mem, pos_, end_ - pos_);
-      pos_ = end_;
-      return sock_.read(mem, count);
+      if (!partial_.empty()) {
+        std::size_t n = std::min(count, partial_.size());
+        std::memcpy(mem, partial_.data(), n);
+        partial_.erase(partial_.begin(), partial_.begin() + static_cast<std::ptrdiff_t>(n));
+        return n;
+      }
+      std::size_t buffered = std::min<std::size_t>(end_ - pos_, count);
+      if (!buffered) {
+        return sock_.read(mem, count);
+      }
+      std::memcpy(mem, pos_, buffered);
+      pos_ += buffered;
+      if (pool_ && pos_ == end_) {
+        release_buffer();
+      }
+      return buffered;
     }
 
     std::vector<char> read(std::size_t count = std::size_t(-1)) {
-      std::vector<char> data(pos_, end_);
+      std::vector<char> data = std::move(partial_);
+      partial_.clear();
+      data.insert(data.end(), pos_, end_);
       pos_ = end_;
+      if (pool_) {
+        release_buffer();
+      }
       std::vector<char> avail = sock_.read(count);
       data.insert(data.end(), avail.begin(), avail.end());
       return data;
     }
 
+    // Reads up to and including c. Returns an empty vector, with
+    // would_block() set, when a nonblocking socket runs dry first. Throws
+    // disconnect_error when the stream ends before c.
     std::vector<char> read_until(char c) {
       std::vector<char> res;
-      char* begin = pos_;
-      do {
-        for (;pos_ != end_ && *pos_ != c; ++pos_);
-        res.insert(res.end(), begin, pos_);
-        if (pos_ == end_) {
-          fill_buffer();
-          begin = pos_;
-        }
-      } while (*pos_ != c);
-      res.push_back(*pos_++);
-      if (pos_ == end_) {
-        fill_buffer();
+      if (extract_until(c)) {
+        res.swap(partial_);
       }
       return res;
     }
 
     void flush() {
       sock_.read();
+      partial_.clear();
       pos_ = end_ = buf_;
+      if (pool_) {
+        release_buffer();
+      }
     }
 
     basic_socket_buffer& operator>>(int& i) {
@@ -102,38 +160,106 @@ namespace sockcp {
 
     } 
 
+    // Reads a NUL terminated string; leaves i untouched and sets
+    // would_block() when a nonblocking socket runs dry first
     basic_socket_buffer& operator>>(std::string& i) {
-      std::string res;
-      char* begin = pos_;
-      do {
-        for (;pos_ != end_ && *pos_; ++pos_);
-        res.append(begin, pos_);
-        if (pos_ == end_) {
-          fill_buffer();
-          begin = pos_;
-        }
-      } while (*pos_);
-      ++pos_;
-      if (pos_ == end_) {
-        fill_buffer();
+      if (extract_until('\0')) {
+        i.assign(partial_.begin(), partial_.end() - 1);
+        partial_.clear();
       }
       return *this;
     } 
 
    private:
-    void fill_buffer() {
-      if (sock_.peek() > 0) {
-        std::size_t rd = sock_.read(buf_, buf_size_);
-        end_ = buf_ + rd;
-        pos_ = buf_;
+    // Moves bytes up to and including delim into partial_. Returns false
+    // when a nonblocking socket has nothing more.
+    bool extract_until(char delim) {
+      for (;;) {
+        if (pos_ == end_ && !fill_buffer()) {
+          blocked_ = true;
+          return false;
+        }
+        char* found = std::find(pos_, end_, delim);
+        bool complete = found != end_;
+        partial_.insert(partial_.end(), pos_, found + complete);
+        pos_ = found + complete;
+        if (pool_ && pos_ == end_) {
+          release_buffer();
+        }
+        if (complete) {
+          blocked_ = false;
+          return true;
+        }
+      }
+    }
+
+    // Refills a drained buffer with one read. Returns false when a
+    // nonblocking socket has no data, throws disconnect_error at end of
+    // stream. Unread bytes are never overwritten.
+    bool fill_buffer() {
+      if (pos_ != end_) {
+        return true;
+      }
+      if (!buf_) {
+        // Lazy mode borrows a block only once data is there
+        if (pool_ && !data_available()) {
+          return false;
+        }
+        buf_ = pool_ ? pool_->acquire() : new char[buf_size_];
+      }
+      errno = 0;
+      SOCKCP_TRACE(span, io, "recv", sock_.fd());
+      auto rd = Syscalls::recv(sock_.fd(), buf_, buf_size_, 0);
+      SOCKCP_TRACE_RESULT(span, rd);
+      if (rd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        pos_ = end_ = buf_;
+        if (pool_) {
+          release_buffer();
+        }
+        return false;
+      }
+      SOCKCP_ASSERT(rd >= 0, socket_error("read"));
+      if (!rd) {
+        if (pool_) {
+          release_buffer();
+        }
+        throw disconnect_error();
+      }
+      pos_ = buf_;
+      end_ = buf_ + rd;
+      return true;
+    }
+
+    // Whether a read would not block: data, whatever the value of its
+    // first byte, or the end of stream
+    bool data_available() {
+      char c;
+      errno = 0;
+      auto n = Syscalls::recv(sock_.fd(), &c, 1, MSG_PEEK);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return false;
+      }
+      SOCKCP_ASSERT(n >= 0, socket_error("peek"));
+      return true;
+    }
+
+    void release_buffer() noexcept {
+      if (pool_) {
+        pool_->release(buf_);
+      } else {
+        delete[] buf_;
       }
+      pos_ = end_ = buf_ = nullptr;
     }
 
-    basic_socket<ProtocolFamily> sock_;
+    basic_socket<ProtocolFamily, Syscalls> sock_;
     std::size_t buf_size_;
     char* buf_;
     char* end_;
     char* pos_;
+    buffer_pool* pool_ = nullptr;
+    std::vector<char> partial_;  // delimited read in progress
+    bool blocked_ = false;
   };
 
   using ipv4socket_buffer = basic_socket_buffer<ipv4>;  
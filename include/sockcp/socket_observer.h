@@ -5,12 +5,19 @@
 #include <vector>
 #include <unordered_map>
 #include <algorithm>
+#include <stdexcept>
+#include <type_traits>
 
 #if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__)) || defined(__CYGWIN__)
 
 #include <poll.h>
+#include <unistd.h>
 #define sockcp_poll(x, y, z) ::poll(x, y, z)
 
+#if defined(__linux__)
+#include <sys/epoll.h>
+#endif
+
 #elif defined(_WIN32)
 
 #include <winsock2.h>
@@ -23,16 +30,6 @@
 
 namespace sockcp
 {
-#if defined(__unix__) || (defined(__APPLE__) && defined(__MACH__)) || defined(__CYGWIN__)
-
-  using pollfd_t = ::pollfd;
-  s
-#elif defined(_WIN32)
-
-  using pollfd_t = WSAPOLLFD;
-
-#endif
-
       enum class event {
         in = POLLIN,
         pri = POLLPRI,
@@ -82,7 +79,20 @@ namespace sockcp
     return lhs;
   }
 
-  class socket_observer final
+  // Readiness notification style. Level reports a socket on every poll
+  // while it stays ready; edge reports it once per new readiness, so the
+  // owner must drain it (see drain_policy) before waiting again. Edge
+  // triggering is backed by epoll and only available on Linux.
+  enum class trigger
+  {
+    level,
+    edge
+  };
+
+  // Syscalls is the policy of the sockets watched (see system_calls).
+  // Edge triggering needs kernel descriptors.
+  template <typename Syscalls = system_calls>
+  class basic_socket_observer final
   {
     struct pollfd_comp
     {
@@ -95,19 +105,115 @@ namespace sockcp
     };
 
   public:
-    template <typename ProtocolFamily>
-    void attach_socket(const basic_socket<ProtocolFamily> &sock, event events)
+    explicit basic_socket_observer(trigger mode = trigger::level) : mode_(mode)
+    {
+      SOCKCP_ASSERT(
+        Syscalls::native || mode_ == trigger::level,
+        std::invalid_argument("Edge triggering requires kernel sockets")
+      );
+#if defined(__linux__)
+      if (mode_ == trigger::edge)
+      {
+        epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+        SOCKCP_ASSERT(epoll_fd_ >= 0, socket_error("epoll_create1"));
+      }
+#else
+      SOCKCP_ASSERT(mode_ == trigger::level, std::invalid_argument("Edge triggering requires epoll"));
+#endif
+    }
+
+    basic_socket_observer(const basic_socket_observer &) = delete;
+    basic_socket_observer &operator=(const basic_socket_observer &) = delete;
+
+    basic_socket_observer(basic_socket_observer &&other) noexcept
+        : mode_(other.mode_), socket_fds_(std::move(other.socket_fds_))
     {
+#if defined(__linux__)
+      epoll_fd_ = other.epoll_fd_;
+      epoll_count_ = other.epoll_count_;
+      ready_ = std::move(other.ready_);
+      other.epoll_fd_ = -1;
+      other.epoll_count_ = 0;
+#endif
+    }
+
+    basic_socket_observer &operator=(basic_socket_observer &&other) noexcept
+    {
+      if (this != &other)
+      {
+        mode_ = other.mode_;
+        socket_fds_ = std::move(other.socket_fds_);
+#if defined(__linux__)
+        if (epoll_fd_ >= 0)
+        {
+          ::close(epoll_fd_);
+        }
+        epoll_fd_ = other.epoll_fd_;
+        epoll_count_ = other.epoll_count_;
+        ready_ = std::move(other.ready_);
+        other.epoll_fd_ = -1;
+        other.epoll_count_ = 0;
+#endif
+      }
+      return *this;
+    }
+
+    ~basic_socket_observer() noexcept
+    {
+#if defined(__linux__)
+      if (epoll_fd_ >= 0)
+      {
+        ::close(epoll_fd_);
+      }
+#endif
+    }
+
+    trigger mode() const noexcept { return mode_; }
+
+    // Socket is anything exposing a pollable fd(): basic_socket, shm_socket.
+    template <typename Socket>
+    void attach_socket(const Socket &sock, event events)
+    {
+#if defined(__linux__)
+      if (mode_ == trigger::edge)
+      {
+        epoll_control(EPOLL_CTL_ADD, sock.fd(), events);
+        return;
+      }
+#endif
       auto pos = std::find_if(socket_fds_.begin(), socket_fds_.end(), pollfd_comp{sock.fd()});
       auto st = socket_fds_.emplace(pos, pollfd{});
       st->fd = sock.fd();
       st->events = static_cast<short>(events);
     }
 
-    template <typename ProtocolFamily>
-    void detach_socket(const basic_socket<ProtocolFamily> &sock)
+    // Replaces the events watched for an attached socket, e.g. adding
+    // event::out only while a send queue holds data.
+    template <typename Socket>
+    void modify_socket(const Socket &sock, event events)
+    {
+#if defined(__linux__)
+      if (mode_ == trigger::edge)
+      {
+        epoll_control(EPOLL_CTL_MOD, sock.fd(), events);
+        return;
+      }
+#endif
+      auto pos = std::find_if(socket_fds_.begin(), socket_fds_.end(), pollfd_comp{sock.fd()});
+      SOCKCP_ASSERT(pos != socket_fds_.end(), std::logic_error("No such socket"));
+      pos->events = static_cast<short>(events);
+    }
+
+    template <typename Socket>
+    void detach_socket(const Socket &sock)
     {
-      pollfd_comp kek{sock.fd()};
+#if defined(__linux__)
+      if (mode_ == trigger::edge)
+      {
+        epoll_control(EPOLL_CTL_DEL, sock.fd(), event::no_event);
+        return;
+      }
+#endif
       auto pos = std::find_if(socket_fds_.begin(), socket_fds_.end(), pollfd_comp{sock.fd()});
       SOCKCP_ASSERT(pos != socket_fds_.end(), std::logic_error("No such socket"));
       socket_fds_.erase(pos);
@@ -115,7 +221,15 @@ namespace sockcp
 
     std::unordered_map<fd_type, event> poll(std::chrono::milliseconds timeout)
     {
-      int r = sockcp_poll(socket_fds_.data(), socket_fds_.size(), timeout.count());
+#if defined(__linux__)
+      if (mode_ == trigger::edge)
+      {
+        return epoll_wait(timeout);
+      }
+#endif
+      SOCKCP_TRACE(span, poll, "poll", socket_fds_.size());
+      int r = Syscalls::poll(socket_fds_.data(), socket_fds_.size(), static_cast<int>(timeout.count()));
+      SOCKCP_TRACE_RESULT(span, r);
       std::unordered_map<fd_type, event> events;
       if (r < 0)
       {
@@ -136,16 +250,73 @@ namespace sockcp
     }
 
   private:
+#if defined(__linux__)
+    // EPOLL* and POLL* bits share values on Linux
+    void epoll_control(int op, fd_type fd, event events)
+    {
+      ::epoll_event ev{};
+      ev.events = static_cast<uint32_t>(events) | EPOLLET;
+      ev.data.fd = fd;
+      SOCKCP_ASSERT(!::epoll_ctl(epoll_fd_, op, fd, &ev), socket_error("epoll_ctl"));
+      if (op == EPOLL_CTL_ADD)
+      {
+        ++epoll_count_;
+      }
+      else if (op == EPOLL_CTL_DEL)
+      {
+        --epoll_count_;
+      }
+    }
+
+    std::unordered_map<fd_type, event> epoll_wait(std::chrono::milliseconds timeout)
+    {
+      ready_.resize(std::max<std::size_t>(epoll_count_, 1));
+      SOCKCP_TRACE(span, poll, "epoll_wait", epoll_count_);
+      int r = ::epoll_wait(epoll_fd_, ready_.data(), static_cast<int>(ready_.size()), timeout.count());
+      SOCKCP_TRACE_RESULT(span, r);
+      std::unordered_map<fd_type, event> events;
+      SOCKCP_ASSERT(r >= 0 || errno == EINTR, socket_error("poll"));
+      for (int i = 0; i < r; ++i)
+      {
+        fd_type fd = ready_[i].data.fd;
+        events.emplace(fd, static_cast<event>(ready_[i].events & ~EPOLLET));
+      }
+      return events;
+    }
+
+    int epoll_fd_ = -1;
+    std::size_t epoll_count_ = 0;
+    std::vector<::epoll_event> ready_;
+#endif
+    trigger mode_;
     std::vector<pollfd_t> socket_fds_;
   };
 
-  template <typename ProtocolFamily>
-  event poll(const basic_socket<ProtocolFamily> &sock, std::chrono::milliseconds timeout, event subs = event::all)
+  using socket_observer = basic_socket_observer<>;
+
+  namespace detail
+  {
+    // Syscall policy of a socket type, system_calls for those without one
+    template <typename Socket, typename = void>
+    struct syscalls_of
+    {
+      using type = system_calls;
+    };
+
+    template <typename Socket>
+    struct syscalls_of<Socket, std::void_t<typename Socket::syscalls>>
+    {
+      using type = typename Socket::syscalls;
+    };
+  } // namespace detail
+
+  template <typename Socket>
+  event poll(const Socket &sock, std::chrono::milliseconds timeout, event subs = event::all)
   {
     pollfd_t pfd{};
     pfd.fd = sock.fd();
     pfd.events = static_cast<short>(subs);
-    int r = sockcp_poll(&pfd, 1, timeout.count());
+    int r = detail::syscalls_of<Socket>::type::poll(&pfd, 1, static_cast<int>(timeout.count()));
     SOCKCP_ASSERT(r >= 0, socket_error("poll"));
     event res = static_cast<event>(pfd.revents);
     return res;
@@ -0,0 +1,169 @@
+#ifndef SOCKCP_SOCKCP_STEERING_H_
+#define SOCKCP_SOCKCP_STEERING_H_
+
+#if !defined(__linux__)
+#error Connection steering is only supported on Linux
+#endif
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/filter.h>
+
+#include "socket.h"
+
+namespace sockcp {
+  // Number of CPU ids on the host, whether or not they are online
+  inline unsigned cpu_count() {
+    long count = ::sysconf(_SC_NPROCESSORS_CONF);
+    return count > 0 ? static_cast<unsigned>(count) : 1;
+  }
+
+  // NUMA node of cpu, 0 on machines without NUMA information
+  inline int numa_node_of_cpu(unsigned cpu) {
+    std::string path = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+    ::DIR* dir = ::opendir(path.c_str());
+    if (!dir) {
+      return 0;
+    }
+    int node = 0;
+    while (::dirent* entry = ::readdir(dir)) {
+      std::string name = entry->d_name;
+      if (name.size() > 4 && name.compare(0, 4, "node") == 0
+          && name.find_first_not_of("0123456789", 4) == std::string::npos) {
+        node = std::stoi(name.substr(4));
+        break;
+      }
+    }
+    ::closedir(dir);
+    return node;
+  }
+
+  // Restricts the calling thread to one CPU
+  inline void pin_thread(unsigned cpu) {
+    ::cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    errno = ::pthread_setaffinity_np(::pthread_self(), sizeof(set), &set);
+    SOCKCP_ASSERT(!errno, socket_error("pin_thread"));
+  }
+
+  // CPU whose softirq last processed packets of sock, -1 if unknown
+  template <typename ProtocolFamily>
+  int incoming_cpu(const basic_socket<ProtocolFamily>& sock) {
+    return sock.template get_option<int>(SOL_SOCKET, SO_INCOMING_CPU);
+  }
+
+  // Maps every CPU to the worker pinned to it, or else to a worker on the
+  // same NUMA node, or else spreads it over all workers. worker_cpus[i] is
+  // the CPU worker i is pinned to.
+  inline std::vector<unsigned> steering_map(const std::vector<unsigned>& worker_cpus,
+                                            unsigned cpus = cpu_count()) {
+    SOCKCP_ASSERT(!worker_cpus.empty(), std::invalid_argument("steering_map: no workers"));
+    std::vector<unsigned> map(cpus);
+    std::vector<int> worker_nodes;
+    for (unsigned cpu : worker_cpus) {
+      worker_nodes.push_back(numa_node_of_cpu(cpu));
+    }
+    std::size_t next_remote = 0;
+    for (unsigned cpu = 0; cpu < cpus; ++cpu) {
+      std::size_t chosen = worker_cpus.size();
+      std::size_t same_node = worker_cpus.size();
+      int node = numa_node_of_cpu(cpu);
+      for (std::size_t w = 0; w < worker_cpus.size() && chosen == worker_cpus.size(); ++w) {
+        if (worker_cpus[w] == cpu) {
+          chosen = w;
+        } else if (same_node == worker_cpus.size() && worker_nodes[w] == node) {
+          same_node = w;
+        }
+      }
+      if (chosen == worker_cpus.size()) {
+        chosen = same_node != worker_cpus.size() ? same_node : next_remote++ % worker_cpus.size();
+      }
+      map[cpu] = static_cast<unsigned>(chosen);
+    }
+    return map;
+  }
+
+  // Installs a classic BPF program on a SO_REUSEPORT group that picks the
+  // listener by the CPU receiving the SYN: cpu_to_socket[cpu] is an index
+  // into the group in the order its sockets started listening. CPUs outside
+  // the map fall back to the kernel's flow hash.
+  template <typename ProtocolFamily>
+  void attach_reuseport_steering(const basic_socket<ProtocolFamily>& member,
+                                 const std::vector<unsigned>& cpu_to_socket) {
+    SOCKCP_ASSERT(
+      cpu_to_socket.size() < 2048,
+      std::length_error("attach_reuseport_steering: too many CPUs")
+    );
+    std::vector<::sock_filter> code;
+    code.push_back(BPF_STMT(BPF_LD | BPF_W | BPF_ABS, static_cast<uint32_t>(SKF_AD_OFF + SKF_AD_CPU)));
+    for (std::size_t cpu = 0; cpu < cpu_to_socket.size(); ++cpu) {
+      code.push_back(BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, static_cast<uint32_t>(cpu), 0, 1));
+      code.push_back(BPF_STMT(BPF_RET | BPF_K, cpu_to_socket[cpu]));
+    }
+    // Out of range index: the kernel falls back to hashing
+    code.push_back(BPF_STMT(BPF_RET | BPF_K, 0xffffffffu));
+    ::sock_fprog prog{static_cast<unsigned short>(code.size()), code.data()};
+    SOCKCP_ASSERT(
+      !::setsockopt(member.fd(), SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)),
+      socket_error("attach_reuseport_steering")
+    );
+  }
+
+  // One SO_REUSEPORT listener per worker on a shared address, so each
+  // event loop accepts its own connections. With steering enabled a new
+  // connection lands on the worker pinned to (or NUMA-near) the CPU that
+  // handles its packets, keeping the socket's cache lines on one core.
+  template <typename ProtocolFamily>
+  class sharded_listener final {
+   public:
+    sharded_listener(const ProtocolFamily& addr, const std::vector<unsigned>& worker_cpus,
+                     bool steer = true, int backlog = SOMAXCONN)
+        : worker_cpus_(worker_cpus) {
+      ProtocolFamily bound = addr;
+      for (std::size_t i = 0; i < worker_cpus.size(); ++i) {
+        basic_socket<ProtocolFamily> sock(socktype::stream);
+        sock.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+        sock.set_option(SOL_SOCKET, SO_REUSEPORT, 1);
+        sock.bind(bound);
+        if (!i) {
+          socklen_t len = bound.size();
+          SOCKCP_ASSERT(!::getsockname(sock.fd(), bound.data(), &len), socket_error("getsockname"));
+        }
+        sock.listen(backlog);
+        listeners_.push_back(std::move(sock));
+      }
+      if (steer && !listeners_.empty()) {
+        attach_reuseport_steering(listeners_.front(), steering_map(worker_cpus_));
+      }
+      address_ = bound;
+    }
+
+    std::size_t size() const noexcept { return listeners_.size(); }
+
+    // Bound address, with the port the kernel chose if addr had none
+    const ProtocolFamily& address() const noexcept { return address_; }
+
+    unsigned cpu(std::size_t worker) const noexcept { return worker_cpus_[worker]; }
+
+    basic_socket<ProtocolFamily>& operator[](std::size_t worker) noexcept {
+      return listeners_[worker];
+    }
+
+   private:
+    std::vector<unsigned> worker_cpus_;
+    std::vector<basic_socket<ProtocolFamily>> listeners_;
+    ProtocolFamily address_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_STEERING_H_
@@ -0,0 +1,226 @@
+#ifndef SOCKCP_SOCKCP_TIMESTAMPING_H_
+#define SOCKCP_SOCKCP_TIMESTAMPING_H_
+
+#if !defined(__linux__)
+#error Kernel timestamping is only supported on Linux
+#endif
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <deque>
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <linux/errqueue.h>
+#include <linux/net_tstamp.h>
+
+#include "latency_histogram.h"
+#include "socket.h"
+
+namespace sockcp {
+  enum class timestamping {
+    // Stamped by the kernel networking stack, works on loopback
+    software,
+    // Stamped by the NIC where the driver supports it, software otherwise.
+    // The device itself must have been configured (SIOCSHWTSTAMP).
+    hardware
+  };
+
+  // Kernel timestamps are CLOCK_REALTIME; compare them only against this
+  inline std::chrono::nanoseconds realtime_now() noexcept {
+    ::timespec ts;
+    ::clock_gettime(CLOCK_REALTIME, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+  }
+
+  struct rx_message {
+    std::size_t bytes = 0;                 // 0 when the read would block
+    std::chrono::nanoseconds kernel{0};    // 0 when the kernel sent none
+    bool hardware = false;
+  };
+
+  struct tx_timestamp {
+    // Stage the packet reached: SCM_TSTAMP_SCHED (entered the qdisc),
+    // SCM_TSTAMP_SND (handed to the driver) or SCM_TSTAMP_ACK (acked by
+    // the peer, TCP only)
+    uint32_t stage = 0;
+    // Byte offset of the last stamped byte for streams, datagram counter
+    // otherwise, counted from enable_timestamping()
+    uint32_t id = 0;
+    std::chrono::nanoseconds time{0};
+    bool hardware = false;
+  };
+
+  // Per-connection time spent in each kernel stage. rx_queue runs from the
+  // kernel RX stamp to the read returning; tx stages run from the send()
+  // call to the kernel reporting that stage.
+  struct stage_latency {
+    latency_histogram rx_queue;
+    latency_histogram tx_sched;
+    latency_histogram tx_driver;
+    latency_histogram tx_ack;
+  };
+
+  namespace detail {
+    inline bool read_timestamp(const ::cmsghdr* cmsg, std::chrono::nanoseconds& time, bool& hardware) {
+      if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_TIMESTAMPING) {
+        return false;
+      }
+      ::scm_timestamping ts;
+      std::memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      // ts[0] is the software stamp, ts[2] the raw hardware one
+      const ::timespec& chosen = ts.ts[2].tv_sec || ts.ts[2].tv_nsec ? ts.ts[2] : ts.ts[0];
+      hardware = &chosen == &ts.ts[2];
+      time = std::chrono::seconds(chosen.tv_sec) + std::chrono::nanoseconds(chosen.tv_nsec);
+      return true;
+    }
+  }  // namespace detail
+
+  // Turns on kernel RX and TX timestamps for sock. TX stamps are queued on
+  // the socket's error queue, signalled by event::err, and read back with
+  // read_tx_timestamps(). Stream sockets also get SCM_TSTAMP_ACK.
+  template <typename ProtocolFamily>
+  void enable_timestamping(basic_socket<ProtocolFamily>& sock, timestamping mode = timestamping::software) {
+    int flags = SOF_TIMESTAMPING_RX_SOFTWARE | SOF_TIMESTAMPING_TX_SOFTWARE
+      | SOF_TIMESTAMPING_TX_SCHED | SOF_TIMESTAMPING_SOFTWARE
+      | SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (sock.type() == SOCK_STREAM) {
+      flags |= SOF_TIMESTAMPING_TX_ACK;
+    }
+    if (mode == timestamping::hardware) {
+      flags |= SOF_TIMESTAMPING_RX_HARDWARE | SOF_TIMESTAMPING_TX_HARDWARE
+        | SOF_TIMESTAMPING_RAW_HARDWARE;
+    }
+    sock.set_option(SOL_SOCKET, SO_TIMESTAMPING, flags);
+  }
+
+  // recv() that also returns the kernel RX timestamp of the data
+  template <typename ProtocolFamily>
+  rx_message recv_timestamped(basic_socket<ProtocolFamily>& sock, char* data, std::size_t count) {
+    ::iovec iov{data, count};
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(::scm_timestamping))];
+    ::msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    ssize_t n = ::recvmsg(sock.fd(), &msg, sock.blocking() ? 0 : MSG_DONTWAIT);
+    rx_message res;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return res;
+    }
+    SOCKCP_ASSERT(n >= 0, socket_error("read"));
+    SOCKCP_ASSERT(n > 0 || !count, disconnect_error());
+    res.bytes = static_cast<std::size_t>(n);
+    for (::cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+      detail::read_timestamp(c, res.kernel, res.hardware);
+    }
+    return res;
+  }
+
+  // Drains the error queue, calling on_stamp(const tx_timestamp&) for every
+  // TX timestamp. Returns how many were read.
+  template <typename ProtocolFamily, typename Func>
+  std::size_t read_tx_timestamps(basic_socket<ProtocolFamily>& sock, Func&& on_stamp) {
+    std::size_t read = 0;
+    for (;;) {
+      alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(::scm_timestamping))
+                                      + CMSG_SPACE(sizeof(::sock_extended_err) + sizeof(::sockaddr_in6))];
+      ::msghdr msg{};
+      msg.msg_control = control;
+      msg.msg_controllen = sizeof(control);
+      ssize_t n = ::recvmsg(sock.fd(), &msg, MSG_ERRQUEUE | MSG_DONTWAIT);
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return read;
+      }
+      SOCKCP_ASSERT(n >= 0, socket_error("read_tx_timestamps"));
+      tx_timestamp stamp;
+      bool have_time = false;
+      bool have_id = false;
+      for (::cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+        if (detail::read_timestamp(c, stamp.time, stamp.hardware)) {
+          have_time = true;
+        } else if ((c->cmsg_level == SOL_IP && c->cmsg_type == IP_RECVERR)
+                   || (c->cmsg_level == SOL_IPV6 && c->cmsg_type == IPV6_RECVERR)) {
+          ::sock_extended_err err;
+          std::memcpy(&err, CMSG_DATA(c), sizeof(err));
+          if (err.ee_errno == ENOMSG && err.ee_origin == SO_EE_ORIGIN_TIMESTAMPING) {
+            stamp.stage = err.ee_info;
+            stamp.id = err.ee_data;
+            have_id = true;
+          }
+        }
+      }
+      if (have_time && have_id) {
+        on_stamp(stamp);
+        ++read;
+      }
+    }
+  }
+
+  // Matches TX timestamps to the send() calls that produced them and feeds
+  // the per-stage latencies. Call sent() right after each successful send
+  // on a socket set up with enable_timestamping(), passing the time taken
+  // just before the call.
+  class tx_tracker final {
+    struct pending {
+      uint32_t id;
+      std::chrono::nanoseconds sent;
+    };
+
+   public:
+    explicit tx_tracker(bool stream = true) : stream_(stream) {}
+
+    // started is when the send() call began; on loopback the SCHED and SND
+    // stamps are taken before send() even returns.
+    void sent(std::size_t bytes, std::chrono::nanoseconds started = realtime_now()) {
+      if (!bytes) {
+        return;
+      }
+      next_ += stream_ ? static_cast<uint32_t>(bytes) : 1u;
+      pending_.push_back({next_ - 1, started});
+    }
+
+    void stamped(const tx_timestamp& stamp, stage_latency& stages) {
+      // Ids wrap at 2^32, so they are compared by signed distance
+      for (const auto& p : pending_) {
+        if (p.id == stamp.id) {
+          histogram(stamp.stage, stages).record(stamp.time - p.sent);
+          break;
+        }
+        if (static_cast<int32_t>(p.id - stamp.id) > 0) {
+          break;
+        }
+      }
+      // The last stage this socket reports retires every send it covers
+      if (stamp.stage == (stream_ ? SCM_TSTAMP_ACK : SCM_TSTAMP_SND)) {
+        while (!pending_.empty() && static_cast<int32_t>(stamp.id - pending_.front().id) >= 0) {
+          pending_.pop_front();
+        }
+      }
+    }
+
+    std::size_t outstanding() const noexcept { return pending_.size(); }
+
+   private:
+    static latency_histogram& histogram(uint32_t stage, stage_latency& stages) noexcept {
+      switch (stage) {
+        case SCM_TSTAMP_SCHED:
+          return stages.tx_sched;
+        case SCM_TSTAMP_ACK:
+          return stages.tx_ack;
+        default:
+          return stages.tx_driver;
+      }
+    }
+
+    bool stream_;
+    uint32_t next_ = 0;
+    std::deque<pending> pending_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_TIMESTAMPING_H_
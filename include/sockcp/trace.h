@@ -0,0 +1,355 @@
+#ifndef SOCKCP_SOCKCP_TRACE_H_
+#define SOCKCP_SOCKCP_TRACE_H_
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <cpuid.h>
+#include <x86intrin.h>
+#define SOCKCP_TRACE_TSC 1
+#endif
+
+#include "error.h"
+
+// trace_span works with or without SOCKCP_TRACING for spans of your own
+#include "trace_points.h"
+
+namespace sockcp {
+  // What a span covers; it decides the names of the two arguments
+  enum class trace_kind : uint8_t {
+    poll,     // watched descriptors, ready descriptors
+    handler,  // fd, events
+    task,
+    io,       // fd, bytes or result
+    user      // arg, result
+  };
+
+  struct trace_event {
+    const char* name;   // must outlive the recorder, e.g. a literal
+    uint64_t start;     // trace_recorder::now() ticks
+    uint64_t duration;  // ticks
+    int64_t args[2];
+    trace_kind kind;
+  };
+
+  // Events of one thread, the oldest overwritten once capacity is reached.
+  // Only the owning thread writes. Readers copy what is there and then
+  // drop whatever the writer may have overwritten during the copy, so
+  // neither side takes a lock.
+  class trace_ring final {
+   public:
+    trace_ring(std::size_t capacity, uint32_t thread_id)
+        : mask_(round_up(capacity) - 1), events_(mask_ + 1), thread_id_(thread_id) {}
+
+    trace_ring(const trace_ring&) = delete;
+    trace_ring& operator=(const trace_ring&) = delete;
+
+    void push(const trace_event& ev) noexcept {
+      uint64_t n = written_.load(std::memory_order_relaxed);
+      events_[n & mask_] = ev;
+      written_.store(n + 1, std::memory_order_release);
+    }
+
+    // Appends the events held since the last clear(), oldest first
+    void snapshot(std::vector<trace_event>& out) const {
+      uint64_t end = written_.load(std::memory_order_acquire);
+      uint64_t begin = std::max(oldest(end), cleared_.load(std::memory_order_relaxed));
+      std::size_t base = out.size();
+      for (uint64_t i = begin; i < end; ++i) {
+        out.push_back(events_[i & mask_]);
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      uint64_t overwritten = oldest(written_.load(std::memory_order_relaxed));
+      if (overwritten > begin) {
+        auto stale = static_cast<std::ptrdiff_t>(std::min(overwritten, end) - begin);
+        out.erase(out.begin() + static_cast<std::ptrdiff_t>(base), out.begin() + static_cast<std::ptrdiff_t>(base) + stale);
+      }
+    }
+
+    // Forgets the events recorded so far; callable from any thread
+    void clear() noexcept {
+      cleared_.store(written_.load(std::memory_order_acquire), std::memory_order_relaxed);
+    }
+
+    uint64_t written() const noexcept { return written_.load(std::memory_order_relaxed); }
+
+    // Events lost to overwriting
+    uint64_t dropped() const noexcept { return oldest(written()); }
+
+    std::size_t capacity() const noexcept { return events_.size(); }
+
+    uint32_t thread_id() const noexcept { return thread_id_; }
+
+   private:
+    static std::size_t round_up(std::size_t n) noexcept {
+      std::size_t res = 1;
+      while (res < n) {
+        res <<= 1;
+      }
+      return res;
+    }
+
+    uint64_t oldest(uint64_t written) const noexcept {
+      return written > events_.size() ? written - events_.size() : 0;
+    }
+
+    std::size_t mask_;
+    std::vector<trace_event> events_;
+    uint32_t thread_id_;
+    alignas(64) std::atomic<uint64_t> written_{0};
+    std::atomic<uint64_t> cleared_{0};
+  };
+
+  // Process wide owner of the per thread rings. A thread gets its ring on
+  // the first event it records; rings outlive their threads, so a dump
+  // still shows threads that have exited. Exports Chrome trace event
+  // JSON, which chrome://tracing and ui.perfetto.dev open directly.
+  class trace_recorder final {
+   public:
+    static trace_recorder& instance() {
+      static trace_recorder recorder;
+      return recorder;
+    }
+
+    trace_recorder(const trace_recorder&) = delete;
+    trace_recorder& operator=(const trace_recorder&) = delete;
+
+    // Timestamp in ticks of the cheapest clock that runs at a constant
+    // rate: the TSC on x86 CPUs with an invariant one, which reads in
+    // about half the time of steady_clock, and steady_clock nanoseconds
+    // elsewhere. Ticks become nanoseconds on export.
+    static uint64_t now() noexcept {
+#if defined(SOCKCP_TRACE_TSC)
+      if (tsc_usable()) {
+        return __rdtsc();
+      }
+#endif
+      return steady_ns();
+    }
+
+    // Pauses or resumes recording without recompiling; spans opened while
+    // paused are not recorded.
+    void enable(bool on) noexcept { enabled_.store(on, std::memory_order_relaxed); }
+
+    bool enabled() const noexcept { return enabled_.load(std::memory_order_relaxed); }
+
+    // Events kept per thread, for rings created from now on
+    void set_ring_capacity(std::size_t events) {
+      SOCKCP_ASSERT(events, std::invalid_argument("trace: empty ring"));
+      std::lock_guard<std::mutex> lock(mutex_);
+      capacity_ = events;
+    }
+
+    // Names the calling thread's track in the exported trace
+    void set_thread_name(std::string name) {
+      trace_ring& ring = local_ring();
+      std::lock_guard<std::mutex> lock(mutex_);
+      threads_[ring.thread_id() - 1].name = std::move(name);
+    }
+
+    trace_ring& local_ring() {
+      thread_local trace_ring* ring = nullptr;
+      if (!ring) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto id = static_cast<uint32_t>(threads_.size() + 1);
+        threads_.push_back(thread{std::make_unique<trace_ring>(capacity_, id), "thread " + std::to_string(id)});
+        ring = threads_.back().ring.get();
+      }
+      return *ring;
+    }
+
+    void record(const trace_event& ev) { local_ring().push(ev); }
+
+    // Drops every event recorded so far, on all threads
+    void clear() {
+      std::lock_guard<std::mutex> lock(mutex_);
+      for (auto& t : threads_) {
+        t.ring->clear();
+      }
+    }
+
+    // Events lost to full rings, all threads together
+    uint64_t dropped() const {
+      std::lock_guard<std::mutex> lock(mutex_);
+      uint64_t res = 0;
+      for (const auto& t : threads_) {
+        res += t.ring->dropped();
+      }
+      return res;
+    }
+
+    // Writes everything recorded as Chrome trace event JSON, complete
+    // ("X") events in microseconds. Safe while other threads record.
+    // Returns the number of events written.
+    std::size_t write_chrome_json(std::ostream& out) const {
+      double scale = tick_ns();
+      std::lock_guard<std::mutex> lock(mutex_);
+      std::vector<trace_event> events;
+      std::size_t count = 0;
+      out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+      const char* sep = "\n";
+      for (const auto& t : threads_) {
+        out << sep << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t.ring->thread_id()
+            << ",\"args\":{\"name\":";
+        write_string(out, t.name);
+        out << "}}";
+        sep = ",\n";
+        events.clear();
+        t.ring->snapshot(events);
+        for (const auto& ev : events) {
+          const auto& info = kinds[static_cast<std::size_t>(ev.kind)];
+          out << sep << "{\"name\":";
+          write_string(out, ev.name);
+          auto since = static_cast<double>(static_cast<int64_t>(ev.start - origin_ticks_));
+          auto start = static_cast<unsigned long long>(static_cast<double>(origin_ns_) + since*scale);
+          auto duration = static_cast<unsigned long long>(static_cast<double>(ev.duration)*scale);
+          char buf[256];
+          int n = std::snprintf(
+            buf, sizeof(buf), ",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%llu.%03u,\"dur\":%llu.%03u,\"args\":{",
+            info.category, static_cast<unsigned>(t.ring->thread_id()), start/1000, static_cast<unsigned>(start % 1000),
+            duration/1000, static_cast<unsigned>(duration % 1000));
+          out.write(buf, n);
+          if (info.arg0) {
+            n = std::snprintf(buf, sizeof(buf), "\"%s\":%lld,\"%s\":%lld", info.arg0,
+                              static_cast<long long>(ev.args[0]), info.arg1, static_cast<long long>(ev.args[1]));
+            out.write(buf, n);
+          }
+          out << "}}";
+        }
+        count += events.size();
+      }
+      out << "\n]}\n";
+      return count;
+    }
+
+    std::size_t dump(const std::string& path) const {
+      std::ofstream file(path, std::ios::binary | std::ios::trunc);
+      SOCKCP_ASSERT(file, std::runtime_error("trace: cannot open " + path));
+      std::size_t count = write_chrome_json(file);
+      file.flush();
+      SOCKCP_ASSERT(file, std::runtime_error("trace: cannot write " + path));
+      return count;
+    }
+
+   private:
+    struct thread {
+      std::unique_ptr<trace_ring> ring;
+      std::string name;
+    };
+
+    struct kind_info {
+      const char* category;
+      const char* arg0;
+      const char* arg1;
+    };
+
+    static constexpr kind_info kinds[] = {
+      {"poll", "watched", "ready"},
+      {"handler", "fd", "events"},
+      {"task", nullptr, nullptr},
+      {"io", "fd", "result"},
+      {"user", "arg", "result"}
+    };
+
+    trace_recorder() : origin_ticks_(now()), origin_ns_(steady_ns()) {}
+
+    static uint64_t steady_ns() noexcept {
+      return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+#if defined(SOCKCP_TRACE_TSC)
+    static bool tsc_usable() noexcept {
+      static const bool usable = [] {
+        unsigned a, b, c, d;
+        return __get_cpuid(0x80000007, &a, &b, &c, &d) && (d & (1u << 8));
+      }();
+      return usable;
+    }
+#endif
+
+    // Nanoseconds per tick, measured against steady_clock over the
+    // recorder's lifetime, at least a millisecond of it
+    double tick_ns() const noexcept {
+#if defined(SOCKCP_TRACE_TSC)
+      if (tsc_usable()) {
+        uint64_t ns = steady_ns();
+        while (ns - origin_ns_ < 1000000) {
+          ns = steady_ns();
+        }
+        return static_cast<double>(ns - origin_ns_)/static_cast<double>(now() - origin_ticks_);
+      }
+#endif
+      return 1.0;
+    }
+
+    static void write_string(std::ostream& out, std::string_view s) {
+      out.put('"');
+      std::size_t plain = 0;
+      for (std::size_t i = 0; i < s.size(); ++i) {
+        auto c = static_cast<unsigned char>(s[i]);
+        if (c != '"' && c != '\\' && c >= 0x20) {
+          continue;
+        }
+        out.write(s.data() + plain, static_cast<std::streamsize>(i - plain));
+        char buf[8];
+        int n = c < 0x20 ? std::snprintf(buf, sizeof(buf), "\\u%04x", c) : std::snprintf(buf, sizeof(buf), "\\%c", c);
+        out.write(buf, n);
+        plain = i + 1;
+      }
+      out.write(s.data() + plain, static_cast<std::streamsize>(s.size() - plain));
+      out.put('"');
+    }
+
+    mutable std::mutex mutex_;
+    std::vector<thread> threads_;
+    std::size_t capacity_ = 1u << 16;
+    std::atomic<bool> enabled_{true};
+    uint64_t origin_ticks_;
+    uint64_t origin_ns_;
+  };
+
+  // Records the time between its construction and destruction on the
+  // calling thread's ring: two clock reads and one ring write.
+  class trace_span final {
+   public:
+    trace_span(trace_kind kind, const char* name, int64_t arg = 0) {
+      trace_recorder& recorder = trace_recorder::instance();
+      if (recorder.enabled()) {
+        ring_ = &recorder.local_ring();
+        event_ = trace_event{name, trace_recorder::now(), 0, {arg, 0}, kind};
+      }
+    }
+
+    trace_span(const trace_span&) = delete;
+    trace_span& operator=(const trace_span&) = delete;
+
+    ~trace_span() noexcept {
+      if (ring_) {
+        event_.duration = trace_recorder::now() - event_.start;
+        ring_->push(event_);
+      }
+    }
+
+    void set_result(int64_t value) noexcept { event_.args[1] = value; }
+
+   private:
+    trace_ring* ring_ = nullptr;
+    trace_event event_;
+  };
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_TRACE_H_
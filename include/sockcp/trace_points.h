@@ -0,0 +1,18 @@
+#ifndef SOCKCP_SOCKCP_TRACE_POINTS_H_
+#define SOCKCP_SOCKCP_TRACE_POINTS_H_
+
+// Library instrumentation points. They record only when SOCKCP_TRACING
+// is defined, for every translation unit alike (the SOCKCP_TRACING entry
+// of project.cfg); otherwise they expand to nothing and their arguments
+// are never evaluated, and the recorder in trace.h is not even included.
+#if defined(SOCKCP_TRACING)
+#include "trace.h"
+#define SOCKCP_TRACE(var, kind, name, arg) \
+  ::sockcp::trace_span var(::sockcp::trace_kind::kind, name, static_cast<int64_t>(arg))
+#define SOCKCP_TRACE_RESULT(var, value) var.set_result(static_cast<int64_t>(value))
+#else
+#define SOCKCP_TRACE(var, kind, name, arg)
+#define SOCKCP_TRACE_RESULT(var, value)
+#endif
+
+#endif  // SOCKCP_SOCKCP_TRACE_POINTS_H_
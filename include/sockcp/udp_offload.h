@@ -0,0 +1,142 @@
+#ifndef SOCKCP_SOCKCP_UDP_OFFLOAD_H_
+#define SOCKCP_SOCKCP_UDP_OFFLOAD_H_
+
+#if !defined(__linux__)
+#error UDP segmentation offload is only supported on Linux
+#endif
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "socket.h"
+
+namespace sockcp {
+  // Limits of one GSO send: the kernel splits at most this many segments
+  // (UDP_MAX_SEGMENTS) out of one IP datagram's worth of payload.
+  static constexpr std::size_t gso_max_segments = 64;
+  static constexpr std::size_t gso_max_bytes = 65507;
+
+  struct gro_message {
+    std::size_t bytes = 0;          // 0 when the read would block
+    // Size of every coalesced datagram but the last, which may be shorter.
+    // 0 when the kernel delivered a single datagram.
+    std::size_t segment_size = 0;
+
+    std::size_t segments() const noexcept {
+      if (!bytes) {
+        return 0;
+      }
+      return segment_size ? (bytes + segment_size - 1)/segment_size : 1;
+    }
+  };
+
+  // Sends data as consecutive datagrams of segment_size bytes (the last
+  // may be shorter) with UDP_SEGMENT: one sendmsg and one trip down the
+  // stack per up to gso_max_segments datagrams instead of one per datagram.
+  // The socket must be connected unless to is given. Returns bytes sent,
+  // short only when a nonblocking socket runs out of buffer space.
+  template <typename ProtocolFamily>
+  std::size_t send_segmented(basic_socket<ProtocolFamily>& sock, const char* data, std::size_t count,
+                             std::size_t segment_size, const ProtocolFamily* to = nullptr) {
+    SOCKCP_ASSERT(
+      segment_size && segment_size <= gso_max_bytes,
+      std::invalid_argument("send_segmented: bad segment size")
+    );
+    std::size_t batch = std::min(gso_max_segments, gso_max_bytes/segment_size)*segment_size;
+    std::size_t sent = 0;
+    while (sent < count) {
+      std::size_t n = std::min(batch, count - sent);
+      ::iovec iov{const_cast<char*>(data + sent), n};
+      alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(uint16_t))] = {};
+      ::msghdr msg{};
+      msg.msg_iov = &iov;
+      msg.msg_iovlen = 1;
+      if (to) {
+        msg.msg_name = const_cast<::sockaddr*>(to->data());
+        msg.msg_namelen = to->size();
+      }
+      // A single segment needs no offload, and the kernel refuses GSO
+      // for payloads that fit one segment on some versions.
+      if (n > segment_size) {
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ::cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_UDP;
+        cmsg->cmsg_type = UDP_SEGMENT;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+        uint16_t size = static_cast<uint16_t>(segment_size);
+        std::memcpy(CMSG_DATA(cmsg), &size, sizeof(size));
+      }
+      ssize_t r = ::sendmsg(sock.fd(), &msg, MSG_NOSIGNAL);
+      if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        break;
+      }
+      SOCKCP_ASSERT(r >= 0, socket_error("send_segmented"));
+      sent += static_cast<std::size_t>(r);
+    }
+    return sent;
+  }
+
+  // Lets the kernel coalesce consecutive datagrams of one flow into a
+  // single read (UDP_GRO). Returns false where the kernel lacks it.
+  template <typename ProtocolFamily>
+  bool enable_gro(basic_socket<ProtocolFamily>& sock) {
+    int on = 1;
+    return !::setsockopt(sock.fd(), SOL_UDP, UDP_GRO, &on, sizeof(on));
+  }
+
+  // recv() that reports the segment size of coalesced datagrams. count
+  // should be gso_max_bytes or more, or the kernel will truncate trains.
+  template <typename ProtocolFamily>
+  gro_message recv_coalesced(basic_socket<ProtocolFamily>& sock, char* data, std::size_t count,
+                             ProtocolFamily* from = nullptr) {
+    ::iovec iov{data, count};
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+    ::msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (from) {
+      msg.msg_name = from->data();
+      msg.msg_namelen = from->size();
+    }
+    ssize_t n = ::recvmsg(sock.fd(), &msg, sock.blocking() ? 0 : MSG_DONTWAIT);
+    gro_message res;
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return res;
+    }
+    SOCKCP_ASSERT(n >= 0, socket_error("recv_coalesced"));
+    res.bytes = static_cast<std::size_t>(n);
+    for (::cmsghdr* c = CMSG_FIRSTHDR(&msg); c; c = CMSG_NXTHDR(&msg, c)) {
+      if (c->cmsg_level == SOL_UDP && c->cmsg_type == UDP_GRO) {
+        int size;
+        std::memcpy(&size, CMSG_DATA(c), sizeof(size));
+        res.segment_size = static_cast<std::size_t>(size);
+      }
+    }
+    // A train of one carries no information about its segment size
+    if (res.segment_size >= res.bytes) {
+      res.segment_size = 0;
+    }
+    return res;
+  }
+
+  // Calls on_datagram(const char*, std::size_t) for every datagram packed
+  // in a buffer filled by recv_coalesced().
+  template <typename Func>
+  void for_each_segment(const char* data, const gro_message& msg, Func&& on_datagram) {
+    std::size_t step = msg.segment_size ? msg.segment_size : msg.bytes;
+    for (std::size_t off = 0; off < msg.bytes; off += step) {
+      on_datagram(data + off, std::min(step, msg.bytes - off));
+    }
+  }
+}  // namespace sockcp
+
+#endif  // SOCKCP_SOCKCP_UDP_OFFLOAD_H_
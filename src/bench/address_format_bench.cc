@@ -0,0 +1,74 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sockcp/inet_address.h>
+
+// Parsing and formatting throughput of the constexpr parser and format_to()
+// against inet_pton and an inet_ntop + std::to_string formatter.
+namespace {
+  volatile std::size_t sink;
+
+  template <typename Func>
+  double measure(std::size_t iterations, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+      func(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/iterations;
+  }
+
+  std::string ntop_to_string(const sockcp::ipv4& ip) {
+    char buf[INET_ADDRSTRLEN];
+    ::inet_ntop(AF_INET, &ip.addr.sin_addr, buf, sizeof(buf));
+    return std::string(buf) + ":" + std::to_string(ip.port());
+  }
+
+  std::string ntop_to_string(const sockcp::ipv6& ip) {
+    char buf[INET6_ADDRSTRLEN];
+    ::inet_ntop(AF_INET6, &ip.addr.sin6_addr, buf, sizeof(buf));
+    return "[" + std::string(buf) + "]:" + std::to_string(ip.port());
+  }
+
+  template <typename ProtocolFamily>
+  void run(const char* name, const std::vector<std::string>& texts, std::size_t iterations) {
+    std::vector<ProtocolFamily> addrs;
+    for (const auto& text : texts) {
+      addrs.emplace_back(text, 4483);
+    }
+    std::size_t n = texts.size();
+    double pton = measure(iterations, [&](std::size_t i) {
+      ProtocolFamily ip(texts[i % n]);
+      sink = sink + ip.data()->sa_family;
+    });
+    double parse = measure(iterations, [&](std::size_t i) {
+      ProtocolFamily ip = ProtocolFamily::from_string(texts[i % n]);
+      sink = sink + ip.data()->sa_family;
+    });
+    double ntop = measure(iterations, [&](std::size_t i) {
+      sink = sink + ntop_to_string(addrs[i % n]).size();
+    });
+    double format = measure(iterations, [&](std::size_t i) {
+      char buf[ProtocolFamily::max_string_size];
+      sink = sink + (addrs[i % n].format_to(buf) - buf);
+    });
+    std::cout << name << ":\n"
+              << "  inet_pton:               " << pton << " ns\n"
+              << "  from_string:             " << parse << " ns\n"
+              << "  inet_ntop + to_string:   " << ntop << " ns\n"
+              << "  format_to:               " << format << " ns" << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::size_t iterations = 2000000;
+  if (argc > 1) {
+    iterations = std::stoul(std::string(argv[1]));
+  }
+  run<sockcp::ipv4>("ipv4", {"127.0.0.1", "192.168.11.253", "78.105.61.33", "255.255.255.0"}, iterations);
+  run<sockcp::ipv6>("ipv6", {"::1", "fd00::1", "2001:db8::ff00:42:8329", "::ffff:10.0.0.1"}, iterations);
+  return 0;
+}
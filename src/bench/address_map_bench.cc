@@ -0,0 +1,95 @@
+#include <chrono>
+#include <iostream>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sockcp/address_map.h>
+
+// Insert and lookup throughput of address_map against std::unordered_map
+// keyed by the address itself and by its to_string() form.
+namespace {
+  volatile std::size_t sink;
+
+  template <typename Func>
+  double measure(std::size_t count, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/count;
+  }
+
+  template <typename Map, typename Key>
+  void run(const char* name, const std::vector<Key>& keys, const std::vector<Key>& misses) {
+    Map map;
+    double insert = measure(keys.size(), [&](std::size_t i) { map[keys[i]] = i; });
+    double hit = measure(keys.size(), [&](std::size_t i) { sink = sink + map.count(keys[i]); });
+    double miss = measure(misses.size(), [&](std::size_t i) { sink = sink + map.count(misses[i]); });
+    std::cout << "  " << name << ": insert " << insert << " ns, hit " << hit
+              << " ns, miss " << miss << " ns" << std::endl;
+  }
+
+  template <typename ProtocolFamily>
+  void run_address_map(const std::vector<ProtocolFamily>& keys, const std::vector<ProtocolFamily>& misses) {
+    sockcp::address_map<ProtocolFamily, std::size_t> map;
+    double insert = measure(keys.size(), [&](std::size_t i) { map[keys[i]] = i; });
+    double hit = measure(keys.size(), [&](std::size_t i) { sink = sink + map.contains(keys[i]); });
+    double miss = measure(misses.size(), [&](std::size_t i) { sink = sink + map.contains(misses[i]); });
+    std::cout << "  address_map: insert " << insert << " ns, hit " << hit
+              << " ns, miss " << miss << " ns, " << map.memory_usage()/map.size()
+              << " bytes per entry" << std::endl;
+  }
+
+  template <typename ProtocolFamily>
+  void compare(const char* name, const std::vector<ProtocolFamily>& keys, const std::vector<ProtocolFamily>& misses) {
+    std::vector<std::string> str_keys;
+    std::vector<std::string> str_misses;
+    for (const auto& key : keys) {
+      str_keys.push_back(key.to_string());
+    }
+    for (const auto& key : misses) {
+      str_misses.push_back(key.to_string());
+    }
+    std::cout << name << ", " << keys.size() << " entries:" << std::endl;
+    run_address_map(keys, misses);
+    run<std::unordered_map<ProtocolFamily, std::size_t>>("unordered_map<addr>", keys, misses);
+    run<std::unordered_map<std::string, std::size_t>>("unordered_map<string>", str_keys, str_misses);
+    std::size_t to_string = 0;
+    double format = measure(keys.size(), [&](std::size_t i) { to_string += keys[i].to_string().size(); });
+    std::cout << "  (to_string() key conversion adds " << format << " ns per operation)" << std::endl;
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::size_t count = 1000000;
+  if (argc > 1) {
+    count = std::stoul(std::string(argv[1]));
+  }
+  std::mt19937_64 rng(4483);
+
+  std::vector<sockcp::ipv4> v4;
+  std::vector<sockcp::ipv4> v4_misses;
+  for (std::size_t i = 0; i < count; ++i) {
+    v4.emplace_back(static_cast<uint32_t>(rng()), static_cast<uint16_t>(rng()));
+    v4_misses.emplace_back(static_cast<uint32_t>(rng()), static_cast<uint16_t>(rng()));
+  }
+  compare("ipv4", v4, v4_misses);
+
+  std::vector<sockcp::ipv6> v6;
+  std::vector<sockcp::ipv6> v6_misses;
+  for (std::size_t i = 0; i < count; ++i) {
+    for (auto* vec : {&v6, &v6_misses}) {
+      uint8_t bytes[16] = {0x20, 0x01, 0x0d, 0xb8};
+      uint64_t low = rng();
+      for (int b = 0; b < 8; ++b) {
+        bytes[8 + b] = static_cast<uint8_t>(low >> (8*b));
+      }
+      vec->emplace_back(bytes, static_cast<uint16_t>(rng()));
+    }
+  }
+  compare("ipv6", v6, v6_misses);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <sys/socket.h>
+
+#include <sockcp/event_loop.h>
+#include <sockcp/latency_histogram.h>
+#include <sockcp/unix_address.h>
+
+// Ping-pong through an event_loop echoing on a socketpair, once sleeping
+// in poll() and once per spin budget. Prints round trip percentiles next
+// to the share of the loop thread's time that went into spinning.
+namespace {
+  using clock = std::chrono::steady_clock;
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  void run(std::chrono::microseconds spin, std::size_t rounds, std::chrono::microseconds gap) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+      throw sockcp::socket_error("socketpair");
+    }
+    unix_socket client = unix_socket::adopt(fds[0]);
+    unix_socket server = unix_socket::adopt(fds[1]);
+
+    sockcp::event_loop loop;
+    loop.set_busy_poll(sockcp::busy_poll{spin});
+    loop.attach(server, sockcp::event::in, [&](sockcp::event) {
+      char c;
+      if (::recv(server.fd(), &c, 1, MSG_DONTWAIT) == 1) {
+        ::send(server.fd(), &c, 1, 0);
+      }
+    });
+    auto start = clock::now();
+    std::thread runner([&] { loop.run(); });
+
+    sockcp::latency_histogram hist;
+    for (std::size_t i = 0; i < rounds; ++i) {
+      // Idle gaps are what make the loop fall asleep between messages
+      std::this_thread::sleep_for(gap);
+      char c = 'x';
+      auto sent = clock::now();
+      ::send(client.fd(), &c, 1, 0);
+      ::recv(client.fd(), &c, 1, 0);
+      hist.record(clock::now() - sent);
+    }
+    loop.stop();
+    runner.join();
+    auto elapsed = clock::now() - start;
+
+    const auto& stats = loop.stats();
+    std::cout << "spin " << spin.count() << " us: p50 " << hist.percentile(0.5).count()/1000.0
+              << " us, p99 " << hist.percentile(0.99).count()/1000.0
+              << " us, spinning " << 100.0*stats.spin_time.count()/elapsed.count() << "% of the loop thread ("
+              << 100.0*stats.idle_spin_time.count()/elapsed.count() << "% idle), "
+              << stats.hits << " hits, " << stats.fallbacks << " fallbacks" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 5000;
+  std::chrono::microseconds gap(argc > 2 ? std::stoul(argv[2]) : 20);
+  for (auto spin : {0, 10, 50, 200}) {
+    run(std::chrono::microseconds(spin), rounds, gap);
+  }
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include <sockcp/connection_registry.h>
+
+// One million connections in connection_registry against the usual
+// unordered_map<fd, shared_ptr<connection>>: memory, insertion, random
+// lookup, a full sweep over every connection and churn. The descriptors
+// are fake, so they are released rather than closed.
+namespace {
+  constexpr std::size_t connections = 1000000;
+
+  volatile uint64_t sink;
+
+  struct connection {
+    sockcp::fd_type fd;
+    sockcp::connection_state state;
+    sockcp::event readiness;
+    sockcp::ipv4 peer;
+    sockcp::connection_stats stats;
+  };
+
+  // Heap held by the map, counting one allocation per node and per
+  // shared_ptr control block plus the bucket array
+  std::size_t map_memory(const std::unordered_map<sockcp::fd_type, std::shared_ptr<connection>>& map) {
+    std::size_t node = sizeof(void*) + sizeof(std::size_t)
+      + sizeof(std::pair<const sockcp::fd_type, std::shared_ptr<connection>>);
+    std::size_t shared = sizeof(connection) + 16;  // make_shared control block
+    return map.size()*(node + shared) + map.bucket_count()*sizeof(void*);
+  }
+
+  template <typename Func>
+  double measure(std::size_t count, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/count;
+  }
+
+  void report(const char* name, std::size_t bytes, double add, double lookup, double sweep, double churn) {
+    std::cout << "  " << name << ": " << bytes/connections << " bytes per connection, add "
+              << add << " ns, lookup " << lookup << " ns, sweep " << sweep
+              << " ns per connection, churn " << churn << " ns" << std::endl;
+  }
+}
+
+int main() {
+  std::mt19937 rng(42);
+  std::vector<std::size_t> order(connections);
+  for (std::size_t i = 0; i < connections; ++i) {
+    order[i] = i;
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+  sockcp::ipv4 peer("10.0.0.1", 4000);
+  std::cout << connections << " connections:" << std::endl;
+
+  {
+    sockcp::connection_registry registry(connections);
+    std::vector<sockcp::connection_handle> handles(connections);
+    double add = measure(connections, [&](std::size_t i) {
+      handles[i] = registry.add(static_cast<sockcp::fd_type>(i + 3), peer);
+    });
+    double lookup = measure(connections, [&](std::size_t i) {
+      auto h = handles[order[i]];
+      sink = sink + registry.fd(h);
+    });
+    double sweep = measure(1, [&](std::size_t) {
+      registry.for_each([&](sockcp::connection_handle h) {
+        if (registry.state(h) == sockcp::connection_state::open) {
+          sink = sink + registry.fd(h);
+        }
+      });
+    })/connections;
+    double churn = measure(connections, [&](std::size_t i) {
+      auto& h = handles[order[i]];
+      sockcp::fd_type fd = registry.release(h);
+      h = registry.add(fd, peer);
+    });
+    report("connection_registry", registry.memory_usage(), add, lookup, sweep, churn);
+    registry.for_each([&](sockcp::connection_handle h) { registry.release(h); });
+  }
+
+  {
+    std::unordered_map<sockcp::fd_type, std::shared_ptr<connection>> map;
+    map.reserve(connections);
+    double add = measure(connections, [&](std::size_t i) {
+      auto fd = static_cast<sockcp::fd_type>(i + 3);
+      map.emplace(fd, std::make_shared<connection>(
+        connection{fd, sockcp::connection_state::open, sockcp::event::no_event, peer, {}}));
+    });
+    double lookup = measure(connections, [&](std::size_t i) {
+      sink = sink + map.find(static_cast<sockcp::fd_type>(order[i] + 3))->second->fd;
+    });
+    double sweep = measure(1, [&](std::size_t) {
+      for (const auto& entry : map) {
+        if (entry.second->state == sockcp::connection_state::open) {
+          sink = sink + entry.second->fd;
+        }
+      }
+    })/connections;
+    double churn = measure(connections, [&](std::size_t i) {
+      auto fd = static_cast<sockcp::fd_type>(order[i] + 3);
+      map.erase(fd);
+      map.emplace(fd, std::make_shared<connection>(
+        connection{fd, sockcp::connection_state::open, sockcp::event::no_event, peer, {}}));
+    });
+    report("unordered_map<fd, shared_ptr>", map_memory(map), add, lookup, sweep, churn);
+  }
+  return 0;
+}
@@ -0,0 +1,123 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <sockcp/drain_policy.h>
+#include <sockcp/socket_observer.h>
+#include <sockcp/unix_address.h>
+
+// One flooding peer and `light` quiet peers share a loop. A writer thread
+// keeps the flooder's socket full and sends timestamped messages round
+// robin to the quiet ones; the loop reports how long those messages waited.
+// Compared: level triggered poll reading until EAGAIN, level triggered
+// reading once per wakeup, and edge triggered epoll with drain_policy.
+namespace {
+  using clock = std::chrono::steady_clock;
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  constexpr std::size_t flood_message = 4096;
+
+  enum class mode { until_eagain, once, budget };
+
+  struct peers {
+    explicit peers(std::size_t light) {
+      for (std::size_t i = 0; i <= light; ++i) {
+        int fds[2];
+        if (::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+          throw sockcp::socket_error("socketpair");
+        }
+        writers.push_back(unix_socket::adopt(fds[0]));
+        readers.push_back(unix_socket::adopt(fds[1]));
+        writers.back().set_block(false);
+        readers.back().set_block(false);
+      }
+    }
+
+    // readers[0] and writers[0] are the flooder
+    std::vector<unix_socket> writers;
+    std::vector<unix_socket> readers;
+  };
+
+  void run(const char* name, mode m, std::size_t light, std::chrono::milliseconds duration) {
+    peers p(light);
+    sockcp::socket_observer observer(m == mode::budget ? sockcp::trigger::edge : sockcp::trigger::level);
+    for (auto& r : p.readers) {
+      observer.attach_socket(r, sockcp::event::in);
+    }
+
+    std::atomic<bool> stop{false};
+    std::thread writer([&] {
+      char flood[flood_message] = {};
+      for (std::size_t next = 1; !stop.load(std::memory_order_relaxed); next = next % light + 1) {
+        for (int i = 0; i < 8; ++i) {
+          ::send(p.writers[0].fd(), flood, sizeof(flood), MSG_DONTWAIT);
+        }
+        int64_t now = clock::now().time_since_epoch().count();
+        ::send(p.writers[next].fd(), &now, sizeof(now), MSG_DONTWAIT);
+        std::this_thread::yield();
+      }
+    });
+
+    std::vector<double> waits;
+    std::size_t flood_bytes = 0;
+    std::size_t wakeups = 0;
+    char buf[flood_message];
+    auto read = [&](sockcp::fd_type fd, std::size_t) -> long {
+      ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+      if (n == sizeof(int64_t) && fd != p.readers[0].fd()) {
+        int64_t sent;
+        std::memcpy(&sent, buf, sizeof(sent));
+        waits.push_back((clock::now().time_since_epoch().count() - sent)/1000.0);
+      } else if (n > 0) {
+        flood_bytes += static_cast<std::size_t>(n);
+      }
+      return n;
+    };
+
+    sockcp::drain_policy policy({64*1024, 16});
+    auto end = clock::now() + duration;
+    while (clock::now() < end) {
+      auto timeout = std::chrono::milliseconds(policy.pending() ? 0 : 10);
+      auto ready = observer.poll(timeout);
+      ++wakeups;
+      for (auto& [fd, ev] : ready) {
+        if (m == mode::budget) {
+          policy.ready(fd);
+        } else if (m == mode::once) {
+          read(fd, sizeof(buf));
+        } else {
+          while (read(fd, sizeof(buf)) > 0) {
+          }
+        }
+      }
+      if (m == mode::budget) {
+        policy.run(read);
+      }
+    }
+    stop = true;
+    writer.join();
+
+    std::sort(waits.begin(), waits.end());
+    auto pct = [&](double q) { return waits.empty() ? 0.0 : waits[static_cast<std::size_t>(q*(waits.size() - 1))]; };
+    double seconds = std::chrono::duration<double>(duration).count();
+    std::cout << name << ": quiet p50 " << pct(0.5) << " us, p99 " << pct(0.99)
+              << " us, max " << pct(1.0) << " us, " << waits.size()/seconds << " quiet msg/s, "
+              << flood_bytes/seconds/1e6 << " MB/s flood, " << wakeups/seconds << " wakeups/s" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t light = argc > 1 ? std::stoul(argv[1]) : 1000;
+  std::chrono::milliseconds duration(argc > 2 ? std::stoul(argv[2]) : 2000);
+  std::cout << light << " quiet peers, 1 flooder" << std::endl;
+  run("  level, read until EAGAIN", mode::until_eagain, light, duration);
+  run("  level, one read per wakeup", mode::once, light, duration);
+  run("  edge, drain_policy budget", mode::budget, light, duration);
+}
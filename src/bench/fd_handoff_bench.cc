@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sockcp/socket.h>
+#include <sockcp/unix_address.h>
+
+// Compares serving loopback connections through a front acceptor that
+// proxies the bytes to a worker over a unix socket against handing the
+// accepted descriptor itself to the worker with SCM_RIGHTS.
+namespace {
+  constexpr const char* kWorkerPath = "/tmp/sockcp_fd_handoff_bench.sock";
+
+  void consume(sockcp::socket& sock, std::vector<char>& buf, std::size_t total) {
+    for (std::size_t rd = 0; rd < total;) {
+      rd += sock.read(buf.data(), std::min(buf.size(), total - rd));
+    }
+  }
+
+  template <typename Front, typename Worker>
+  double run(uint16_t port, std::size_t connections, std::size_t bytes, Front front, Worker worker) {
+    ::unlink(kWorkerPath);
+    sockcp::basic_socket<sockcp::unix_addr> worker_listener(sockcp::socktype::stream);
+    worker_listener.bind(sockcp::unix_addr(kWorkerPath));
+    worker_listener.listen(1);
+
+    sockcp::socket sv_sock(sockcp::socktype::stream);
+    sv_sock.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+    sv_sock.bind(sockcp::ipv4("127.0.0.1", port));
+    sv_sock.listen(128);
+
+    std::thread worker_thread([&]() {
+      auto channel = worker_listener.accept();
+      worker(channel);
+    });
+    sockcp::basic_socket<sockcp::unix_addr> channel(sockcp::socktype::stream);
+    channel.connect(sockcp::unix_addr(kWorkerPath));
+
+    std::thread clients([&]() {
+      std::string payload(bytes, 'x');
+      for (std::size_t i = 0; i < connections; ++i) {
+        sockcp::socket cl(sockcp::socktype::stream);
+        cl.connect(sockcp::ipv4("127.0.0.1", port));
+        cl.write(payload);
+        cl.peek();  // wait for the worker to close the connection
+      }
+    });
+
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < connections; ++i) {
+      auto conn = sv_sock.accept();
+      front(channel, conn);
+    }
+    clients.join();
+    worker_thread.join();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    ::unlink(kWorkerPath);
+    return std::chrono::duration<double>(elapsed).count();
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  uint16_t port = 4485;
+  std::size_t connections = 2000;
+  std::size_t bytes = 64*1024;
+  if (argc > 1) {
+    connections = std::stoul(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    bytes = std::stoul(std::string(argv[2]));
+  }
+  if (argc > 3) {
+    port = std::stoi(std::string(argv[3]));
+  }
+
+  double proxy = run(port, connections, bytes,
+    [bytes](auto& channel, sockcp::socket& conn) {
+      std::vector<char> buf(16*1024);
+      for (std::size_t rd = 0; rd < bytes;) {
+        std::size_t n = conn.read(buf.data(), std::min(buf.size(), bytes - rd));
+        channel.write(buf.data(), n);
+        rd += n;
+      }
+    },
+    [connections, bytes](auto& channel) {
+      std::vector<char> buf(16*1024);
+      for (std::size_t rd = 0; rd < connections*bytes;) {
+        rd += channel.read(buf.data(), buf.size());
+      }
+    });
+
+  double handoff = run(port, connections, bytes,
+    [](auto& channel, sockcp::socket& conn) {
+      channel.send_fd(conn);
+    },
+    [connections, bytes](auto& channel) {
+      std::vector<char> buf(16*1024);
+      for (std::size_t i = 0; i < connections; ++i) {
+        auto conn = channel.template recv_fd<sockcp::ipv4>();
+        consume(conn, buf, bytes);
+      }
+    });
+
+  std::cout << connections << " connections x " << bytes << " bytes\n"
+            << "  proxy:   " << proxy << " s, " << connections/proxy << " conn/s\n"
+            << "  handoff: " << handoff << " s, " << connections/handoff << " conn/s" << std::endl;
+  return 0;
+}
@@ -0,0 +1,110 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sockcp/filter_pipeline.h>
+
+// Per stage throughput of the receive filter pipeline over frames already
+// in memory: CRC-32C alone (table driven and hardware), the framing stage,
+// and the framer followed by in-place stages. The last line layers the
+// same work by hand, copying each payload into a string per layer.
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  struct xor_stage {
+    std::size_t operator()(char* data, std::size_t size) noexcept {
+      for (std::size_t i = 0; i < size; ++i) {
+        data[i] ^= 0x5a;
+      }
+      return size;
+    }
+  };
+
+  struct count_stage {
+    std::size_t operator()(char*, std::size_t size) noexcept {
+      bytes += size;
+      return size;
+    }
+
+    uint64_t bytes = 0;
+  };
+
+  template <typename Func>
+  void report(const char* name, std::size_t bytes, std::size_t messages, std::size_t rounds, Func&& func) {
+    auto start = clock::now();
+    for (std::size_t r = 0; r < rounds; ++r) {
+      func();
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    std::cout << "  " << name << ": " << bytes*rounds/seconds/1e9 << " GB/s";
+    if (messages) {
+      std::cout << ", " << messages*rounds/seconds/1e6 << " M msgs/s";
+    }
+    std::cout << std::endl;
+  }
+
+  volatile uint64_t sink;
+}
+
+int main(int argc, char** argv) {
+  std::size_t total = argc > 1 ? std::stoul(argv[1]) : 8u << 20;
+  std::size_t rounds = argc > 2 ? std::stoul(argv[2]) : 20;
+  std::cout << "hardware crc32c: " << (sockcp::detail::crc32c_hardware_available() ? "yes" : "no") << std::endl;
+
+  for (std::size_t size : {64u, 1500u, 16384u}) {
+    std::string payload(size, 'p');
+    std::string stream;
+    std::size_t messages = total/(size + sockcp::crc32c_framer::overhead);
+    for (std::size_t i = 0; i < messages; ++i) {
+      stream += sockcp::crc32c_framer::encode(payload);
+    }
+    std::size_t bytes = messages*size;
+    std::cout << size << " byte payloads, " << messages << " frames" << std::endl;
+
+    report("crc32c table", bytes, 0, rounds, [&] {
+      sink = sockcp::crc32c_portable(stream.data(), bytes);
+    });
+    report("crc32c", bytes, 0, rounds, [&] {
+      sink = sockcp::crc32c(stream.data(), bytes);
+    });
+
+    sockcp::filter_pipeline<sockcp::crc32c_framer> framer;
+    report("framer", bytes, messages, rounds, [&] {
+      framer.process(&stream[0], stream.size(), [](char*, std::size_t n) { sink = n; });
+    });
+
+    sockcp::filter_pipeline<sockcp::crc32c_framer, count_stage> counted;
+    report("framer + count", bytes, messages, rounds, [&] {
+      counted.process(&stream[0], stream.size(), [](char*, std::size_t n) { sink = n; });
+    });
+
+    // xor twice leaves the payloads intact for the next round
+    sockcp::filter_pipeline<sockcp::crc32c_framer, xor_stage, xor_stage, count_stage> chained;
+    report("framer + xor + xor + count", bytes, messages, rounds, [&] {
+      chained.process(&stream[0], stream.size(), [](char*, std::size_t n) { sink = n; });
+    });
+
+    report("copying layers", bytes, messages, rounds, [&] {
+      std::size_t pos = 0;
+      uint64_t counted_bytes = 0;
+      while (pos < stream.size()) {
+        char* data;
+        std::size_t n;
+        pos += sockcp::crc32c_framer().frame(&stream[pos], stream.size() - pos, data, n);
+        std::string framed(data, n);
+        std::string masked(framed);
+        for (auto& c : masked) {
+          c ^= 0x5a;
+        }
+        std::string unmasked(masked);
+        for (auto& c : unmasked) {
+          c ^= 0x5a;
+        }
+        counted_bytes += unmasked.size();
+      }
+      sink = counted_bytes;
+    });
+  }
+}
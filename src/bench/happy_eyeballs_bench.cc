@@ -0,0 +1,116 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sockcp/happy_eyeballs.h>
+#include <sockcp/latency_histogram.h>
+#include <sockcp/socket.h>
+#include <sockcp/socket_observer.h>
+
+// Connection setup time when the preferred candidate is a black hole: an
+// IPv6 loopback listener whose full accept queue drops every SYN, ahead
+// of a working IPv4 listener. The baseline tries the candidates in turn,
+// a nonblocking connect and a poll() for writability with a per attempt
+// timeout as in the client_waiting demo; happy_eyeballs_connect races
+// them attempt_delay apart. With a healthy first candidate both cost the
+// same single connect.
+// Usage: happy_eyeballs_bench [connects] [attempt timeout ms]
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  template <typename Family>
+  Family bound_address(const sockcp::basic_socket<Family>& sock) {
+    Family addr;
+    socklen_t len = addr.size();
+    ::getsockname(sock.fd(), addr.data(), &len);
+    return addr;
+  }
+
+  template <typename Family>
+  bool try_connect(const Family& addr, std::chrono::milliseconds timeout) {
+    sockcp::basic_socket<Family> sock(sockcp::socktype::stream);
+    sock.set_block(false);
+    sock.connect(addr);
+    if (sockcp::poll(sock, timeout, sockcp::event::out) == sockcp::event::no_event) {
+      return false;
+    }
+    return !sock.template get_option<int>(SOL_SOCKET, SO_ERROR);
+  }
+
+  template <typename Connect>
+  sockcp::latency_histogram measure(std::size_t connects, Connect&& connect) {
+    sockcp::latency_histogram setup;
+    for (std::size_t i = 0; i < connects; ++i) {
+      auto start = clock::now();
+      connect();
+      setup.record(clock::now() - start);
+    }
+    return setup;
+  }
+
+  void report(const char* name, const sockcp::latency_histogram& h) {
+    std::cout << "  " << name << ": p50 " << h.percentile(0.5).count()/1000 << " us, max "
+              << h.max().count()/1000 << " us" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t connects = 10;
+  std::chrono::milliseconds attempt_timeout(1000);
+  if (argc > 1) {
+    connects = std::stoull(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    attempt_timeout = std::chrono::milliseconds(std::stoi(std::string(argv[2])));
+  }
+
+  sockcp::basic_socket<sockcp::ipv6> hole(sockcp::socktype::stream);
+  hole.bind(sockcp::ipv6("::1", 0));
+  hole.listen(0);
+  auto hole_addr = bound_address(hole);
+  sockcp::basic_socket<sockcp::ipv6> filler(sockcp::socktype::stream);
+  filler.connect(hole_addr);
+
+  sockcp::socket server(sockcp::socktype::stream);
+  server.bind(sockcp::ipv4("127.0.0.1", 0));
+  server.listen(SOMAXCONN);
+  auto server_addr = bound_address(server);
+  // Accepted connections are left queued; drained between rounds
+  auto drain = [&] {
+    server.set_block(false);
+    for (auto s = server.accept(); s.fd() != sockcp::fd_invalid; s = server.accept()) {
+    }
+  };
+
+  sockcp::happy_eyeballs_options options;
+  options.attempt_timeout = attempt_timeout;
+  std::cout << "black hole first, " << attempt_timeout.count() << " ms attempt timeout, " << connects
+            << " connects:" << std::endl;
+  report("sequential", measure(connects, [&] {
+    if (!try_connect(hole_addr, attempt_timeout)) {
+      try_connect(server_addr, attempt_timeout);
+    }
+    drain();
+  }));
+  for (int delay : {250, 50}) {
+    options.attempt_delay = std::chrono::milliseconds(delay);
+    std::string name = "happy eyeballs, " + std::to_string(delay) + " ms attempt delay";
+    report(name.c_str(), measure(connects, [&] {
+      sockcp::happy_eyeballs_connect({hole_addr}, {server_addr}, options);
+      drain();
+    }));
+  }
+
+  std::cout << "healthy first, " << connects*100 << " connects:" << std::endl;
+  report("sequential", measure(connects*100, [&] {
+    try_connect(server_addr, attempt_timeout);
+    drain();
+  }));
+  report("happy eyeballs", measure(connects*100, [&] {
+    sockcp::happy_eyeballs_connect({}, {server_addr}, options);
+    drain();
+  }));
+  return 0;
+}
@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sockcp/buffer_pool.h>
+#include <sockcp/socket.h>
+#include <sockcp/socket_buffer.h>
+
+// Opens `connections` loopback connections, wraps the accepted ends into
+// eager and lazy socket buffers and reports receive memory per idle
+// connection, then wakes `active` of them and reports it again.
+int main(int argc, char* argv[]) {
+  uint16_t port = 4484;
+  std::size_t connections = 512;
+  std::size_t active = 16;
+  if (argc > 1) {
+    connections = std::stoul(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    active = std::stoul(std::string(argv[2]));
+  }
+  if (argc > 3) {
+    port = std::stoi(std::string(argv[3]));
+  }
+  active = std::min(active, connections/2);
+
+  sockcp::socket sv_sock(sockcp::socktype::stream);
+  sv_sock.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  sv_sock.bind(sockcp::ipv4("127.0.0.1", port));
+  sv_sock.listen(128);
+
+  std::vector<sockcp::socket> clients;
+  std::vector<sockcp::socket> accepted;
+  clients.reserve(connections);
+  accepted.reserve(connections);
+  for (std::size_t i = 0; i < connections; ++i) {
+    clients.emplace_back(sockcp::socktype::stream);
+    clients.back().connect(sockcp::ipv4("127.0.0.1", port));
+    accepted.push_back(sv_sock.accept());
+    accepted.back().set_block(false);
+  }
+
+  sockcp::buffer_pool pool(512u);
+  std::vector<sockcp::socket_buffer> eager;
+  std::vector<sockcp::socket_buffer> lazy;
+  eager.reserve(connections/2);
+  lazy.reserve(connections - connections/2);
+  for (std::size_t i = 0; i < connections; ++i) {
+    if (i % 2) {
+      lazy.emplace_back(std::move(accepted[i]), pool);
+    } else {
+      eager.emplace_back(std::move(accepted[i]), 512u);
+    }
+  }
+
+  auto report = [&](const char* stage) {
+    std::size_t eager_bytes = 0;
+    for (const auto& buf : eager) {
+      eager_bytes += sizeof(buf) + 512u;
+    }
+    std::size_t lazy_bytes = lazy.size()*sizeof(sockcp::socket_buffer) + pool.resident_bytes();
+    std::cout << stage << ":\n"
+              << "  eager: " << eager_bytes/eager.size() << " bytes per connection\n"
+              << "  lazy:  " << lazy_bytes/lazy.size() << " bytes per connection ("
+              << pool.in_use() << " blocks borrowed)" << std::endl;
+  };
+
+  report("idle");
+
+  for (std::size_t i = 0; i < active; ++i) {
+    clients[2*i + 1].write(std::string("ping\n"));
+  }
+  for (std::size_t i = 0; i < active; ++i) {
+    lazy[i].read_until('i');
+  }
+  report("with active connections mid-message");
+  for (std::size_t i = 0; i < active; ++i) {
+    lazy[i].read_until('\n');
+  }
+  report("after draining active connections");
+  return 0;
+}
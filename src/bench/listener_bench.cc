@@ -0,0 +1,144 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <poll.h>
+
+#include <sockcp/event_loop.h>
+#include <sockcp/latency_histogram.h>
+#include <sockcp/listener.h>
+#include <sockcp/socket.h>
+
+// Connection storm against three servers on one thread: the plain
+// listen()/accept() loop with its default backlog, the same loop with a
+// SOMAXCONN backlog making each connection nonblocking afterwards as an
+// event driven server must, and listener on an event_loop, which
+// accepts in batches with accept4(). The client opens connections in
+// bursts of nonblocking connects and records each one's setup time; a
+// full accept queue shows up as SYN retransmits, a second or more, in
+// the tail.
+// Usage: listener_bench [connections] [burst] [port]
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  struct result {
+    double seconds;
+    sockcp::latency_histogram setup;
+  };
+
+  result storm(const sockcp::ipv4& addr, std::size_t connections, std::size_t burst) {
+    result res{};
+    auto start = clock::now();
+    for (std::size_t done = 0; done < connections;) {
+      std::size_t n = std::min(burst, connections - done);
+      std::vector<sockcp::socket> socks;
+      std::vector<pollfd> fds;
+      std::vector<clock::time_point> began;
+      for (std::size_t i = 0; i < n; ++i) {
+        socks.emplace_back(sockcp::socktype::stream);
+        socks.back().set_block(false);
+        began.push_back(clock::now());
+        socks.back().connect(addr);
+        fds.push_back(pollfd{socks.back().fd(), POLLOUT, 0});
+      }
+      for (std::size_t pending = n; pending;) {
+        ::poll(fds.data(), fds.size(), 5000);
+        auto now = clock::now();
+        for (std::size_t i = 0; i < n; ++i) {
+          if (fds[i].fd >= 0 && fds[i].revents) {
+            res.setup.record(now - began[i]);
+            fds[i].fd = -1;
+            --pending;
+          }
+        }
+      }
+      done += n;
+    }
+    res.seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return res;
+  }
+
+  void report(const char* name, std::size_t connections, const result& r) {
+    std::cout << "  " << name << ": " << static_cast<uint64_t>(connections/r.seconds) << " connections/s, setup p50 "
+              << r.setup.percentile(0.5).count()/1000 << " us, p99 " << r.setup.percentile(0.99).count()/1000
+              << " us, max " << r.setup.max().count()/1000 << " us" << std::endl;
+  }
+
+  // Runs serve on a thread while the storm lasts
+  result with_server(const sockcp::ipv4& addr, std::size_t connections, std::size_t burst,
+                     const std::function<void(std::atomic<bool>&)>& serve) {
+    std::atomic<bool> stop{false};
+    std::thread server(serve, std::ref(stop));
+    result r = storm(addr, connections, burst);
+    stop = true;
+    server.join();
+    return r;
+  }
+
+  void accept_loop(sockcp::socket& sock, bool make_nonblocking, std::atomic<bool>& stop) {
+    sock.set_block(false);
+    while (!stop) {
+      pollfd p{sock.fd(), POLLIN, 0};
+      if (::poll(&p, 1, 10) != 1) {
+        continue;
+      }
+      for (sockcp::socket conn = sock.accept(); conn.fd() != sockcp::fd_invalid; conn = sock.accept()) {
+        if (make_nonblocking) {
+          conn.set_block(false);
+        }
+      }
+    }
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t connections = 4096;
+  std::size_t burst = 128;
+  uint16_t port = 4506;
+  if (argc > 1) {
+    connections = std::stoull(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    burst = std::stoull(std::string(argv[2]));
+  }
+  if (argc > 3) {
+    port = static_cast<uint16_t>(std::stoi(std::string(argv[3])));
+  }
+
+  std::cout << connections << " connections in bursts of " << burst << ":" << std::endl;
+  {
+    sockcp::ipv4 addr("127.0.0.1", port);
+    sockcp::socket sock(sockcp::socktype::stream);
+    sock.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+    sock.bind(addr);
+    sock.listen();
+    report("accept(), listen() default backlog", connections,
+           with_server(addr, connections, burst, [&](std::atomic<bool>& stop) { accept_loop(sock, false, stop); }));
+  }
+  {
+    sockcp::ipv4 addr("127.0.0.1", static_cast<uint16_t>(port + 1));
+    sockcp::socket sock(sockcp::socktype::stream);
+    sock.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+    sock.bind(addr);
+    sock.listen(SOMAXCONN);
+    report("accept(), SOMAXCONN backlog", connections,
+           with_server(addr, connections, burst, [&](std::atomic<bool>& stop) { accept_loop(sock, true, stop); }));
+  }
+  {
+    sockcp::listener listener(sockcp::ipv4("127.0.0.1", static_cast<uint16_t>(port + 2)));
+    sockcp::event_loop loop;
+    std::size_t accepted = 0;
+    listener.attach(loop, [&](sockcp::socket&&) { ++accepted; });
+    report("listener on event_loop", connections, with_server(listener.address(), connections, burst, [&](std::atomic<bool>& stop) {
+      while (!stop) {
+        loop.run_once(std::chrono::milliseconds(10));
+      }
+    }));
+  }
+  return 0;
+}
@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sockcp/event_loop.h>
+
+// Cross-thread submission into a loop sleeping in poll(): round trip of a
+// posted task that signals back, and multi-producer throughput. The legacy
+// scheme, a mutex protected task vector checked after every poll() with a
+// short timeout, is measured alongside.
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  class mutex_loop final {
+   public:
+    void post(std::function<void()> func) {
+      std::lock_guard<std::mutex> lock(mtx_);
+      tasks_.push_back(std::move(func));
+    }
+
+    void run(std::chrono::milliseconds timeout) {
+      while (!stopped_) {
+        observer_.poll(timeout);
+        std::vector<std::function<void()>> tasks;
+        {
+          std::lock_guard<std::mutex> lock(mtx_);
+          tasks.swap(tasks_);
+        }
+        for (auto& t : tasks) {
+          t();
+        }
+      }
+    }
+
+    void stop() {
+      post([this] { stopped_ = true; });
+    }
+
+   private:
+    std::mutex mtx_;
+    std::vector<std::function<void()>> tasks_;
+    sockcp::socket_observer observer_;
+    bool stopped_ = false;
+  };
+
+  template <typename Loop>
+  double round_trip(Loop& loop, std::size_t iterations) {
+    std::atomic<std::size_t> done{0};
+    auto start = clock::now();
+    for (std::size_t i = 1; i <= iterations; ++i) {
+      loop.post([&done] { done.fetch_add(1, std::memory_order_release); });
+      while (done.load(std::memory_order_acquire) != i) {
+        std::this_thread::yield();
+      }
+    }
+    return std::chrono::duration<double, std::micro>(clock::now() - start).count()/iterations;
+  }
+
+  template <typename Loop>
+  double throughput(Loop& loop, std::size_t producers, std::size_t per_producer) {
+    std::atomic<std::size_t> done{0};
+    auto start = clock::now();
+    std::vector<std::thread> threads;
+    for (std::size_t p = 0; p < producers; ++p) {
+      threads.emplace_back([&] {
+        for (std::size_t i = 0; i < per_producer; ++i) {
+          loop.post([&done] { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+    while (done.load(std::memory_order_relaxed) != producers*per_producer) {
+      std::this_thread::yield();
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return producers*per_producer/seconds;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t iterations = argc > 1 ? std::stoul(argv[1]) : 20000;
+  std::size_t producers = argc > 2 ? std::stoul(argv[2]) : 4;
+  std::size_t per_producer = argc > 3 ? std::stoul(argv[3]) : 250000;
+
+  {
+    sockcp::event_loop loop;
+    std::thread runner([&] { loop.run(); });
+    std::cout << "event_loop (eventfd + mpsc queue):" << std::endl
+              << "  round trip " << round_trip(loop, iterations) << " us" << std::endl
+              << "  " << throughput(loop, producers, per_producer)/1e6 << " M tasks/s from "
+              << producers << " producers" << std::endl;
+    loop.stop();
+    runner.join();
+  }
+  for (int timeout : {1, 10}) {
+    mutex_loop loop;
+    std::thread runner([&] { loop.run(std::chrono::milliseconds(timeout)); });
+    std::cout << "mutex + " << timeout << " ms poll timeout:" << std::endl
+              << "  round trip " << round_trip(loop, iterations/100) << " us" << std::endl
+              << "  " << throughput(loop, producers, per_producer)/1e6 << " M tasks/s from "
+              << producers << " producers" << std::endl;
+    loop.stop();
+    runner.join();
+  }
+}
@@ -0,0 +1,100 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sockcp/memory_transport.h>
+#include <sockcp/socket.h>
+
+// Splits the cost of a write()/read() round trip into the library's part
+// and the kernel's: the same basic_socket code runs over memory_calls and
+// over loopback TCP. Then parses lines with socket_buffer::read_until
+// over random short reads, which only the in-memory transport can replay.
+// Usage: memory_transport_bench [memory bytes] [port]
+namespace {
+  template <typename Socket>
+  double round_trips(Socket& writer, Socket& reader, std::size_t chunk, std::size_t total) {
+    std::vector<char> out(chunk, 'x');
+    std::vector<char> in(chunk);
+    std::size_t rounds = total/chunk;
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < rounds; ++i) {
+      writer.write(out.data(), chunk);
+      for (std::size_t got = 0; got < chunk;) {
+        got += reader.read(in.data() + got, chunk - got);
+      }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/rounds;
+  }
+
+  void report(const char* name, std::size_t chunk, double ns) {
+    std::cout << "  " << name << ", " << chunk << " byte chunks: " << ns << " ns per round trip, "
+              << chunk/ns << " GB/s" << std::endl;
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t memory_bytes = std::size_t(1) << 32;
+  uint16_t port = 4504;
+  if (argc > 1) {
+    memory_bytes = std::stoull(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    port = static_cast<uint16_t>(std::stoi(std::string(argv[2])));
+  }
+
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", port));
+  listener.listen();
+  sockcp::socket kernel_writer(sockcp::socktype::stream);
+  kernel_writer.connect(sockcp::ipv4("127.0.0.1", port));
+  sockcp::socket kernel_reader = listener.accept();
+  auto memory = sockcp::memory_socket_pair();
+
+  std::cout << "write()/read() round trips:" << std::endl;
+  for (std::size_t chunk : {64u, 1024u, 16384u}) {
+    // Fewer rounds through the kernel, its cost per call is what matters
+    std::size_t memory_total = chunk == 16384u ? memory_bytes : memory_bytes/64;
+    report("memory", chunk, round_trips(memory.first, memory.second, chunk, memory_total));
+    report("kernel", chunk, round_trips(kernel_writer, kernel_reader, chunk, memory_total/64));
+  }
+  auto stats = sockcp::memory_network::instance().stats();
+  std::cout << "  " << stats.bytes << " bytes through memory_calls in "
+            << stats.send_calls + stats.recv_calls << " calls" << std::endl;
+
+  sockcp::memory_faults faults;
+  faults.max_read = 64;
+  faults.random_sizes = true;
+  sockcp::memory_network::instance().configure(faults);
+  std::string batch;
+  for (int i = 0; batch.size() < 60000; ++i) {
+    batch += "GET /index/" + std::to_string(i) + " HTTP/1.1\n";
+  }
+  std::size_t lines_per_batch = static_cast<std::size_t>(std::count(batch.begin(), batch.end(), '\n'));
+  std::size_t batches = 2000;
+  auto socks = sockcp::memory_socket_pair();
+  // The buffer refills after every line; nonblocking lets it stop at the end
+  socks.second.set_block(false);
+  socks.first.write(batch);
+  sockcp::memory_socket_buffer buffer(std::move(socks.second), 4096);
+  std::size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t b = 0; b < batches; ++b) {
+    for (std::size_t i = 0; i < lines_per_batch; ++i) {
+      bytes += buffer.read_until('\n').size();
+      if (b + 1 < batches && i == lines_per_batch/2) {
+        socks.first.write(batch);
+      }
+    }
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+  std::cout << "read_until over 1..64 byte reads: " << ns/(batches*lines_per_batch) << " ns per line, "
+            << bytes/ns << " GB/s" << std::endl;
+  return 0;
+}
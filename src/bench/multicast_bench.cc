@@ -0,0 +1,77 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <net/if.h>
+
+#include <sockcp/multicast.h>
+
+// Fan-in from many multicast groups into one socket over loopback: a
+// recvmsg() per datagram reading IP_PKTINFO against datagram_batch's
+// recvmmsg(). Each round sends one datagram to every group and reads them
+// all back, so the receive buffer never overflows. Only the receive side
+// is timed; the sends, one per datagram either way, are not.
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  double run(bool batched, std::size_t groups, std::size_t size, std::size_t rounds, uint16_t port) {
+    unsigned lo = ::if_nametoindex("lo");
+    sockcp::socket rx(sockcp::socktype::datagram);
+    rx.set_option(SOL_SOCKET, SO_RCVBUF, 4 << 20);
+    rx.bind(sockcp::ipv4("0.0.0.0", port));
+    sockcp::datagram_batch::enable_pktinfo(rx);
+    std::vector<sockcp::ipv4> targets;
+    for (std::size_t g = 0; g < groups; ++g) {
+      sockcp::ipv4 group(static_cast<uint32_t>(0xef010000u + g), port);  // 239.1.x.x
+      sockcp::join_group(rx, group, lo);
+      targets.push_back(group);
+    }
+    sockcp::socket tx(sockcp::socktype::datagram);
+    sockcp::set_multicast_interface(tx, lo);
+    sockcp::set_multicast_ttl(tx, 0);
+
+    std::string payload(size, 'x');
+    sockcp::datagram_batch batch(64, 2048);
+    std::vector<char> buf(2048);
+    alignas(::cmsghdr) char control[CMSG_SPACE(sizeof(::in_pktinfo))];
+    std::size_t per_group = 0;
+    clock::duration receiving{0};
+    for (std::size_t r = 0; r < rounds; ++r) {
+      for (auto& to : targets) {
+        ::sendto(tx.fd(), payload.data(), size, 0, to.data(), to.size());
+      }
+      auto start = clock::now();
+      for (std::size_t got = 0; got < groups;) {
+        if (batched) {
+          got += batch.receive(rx);
+          continue;
+        }
+        ::iovec iov{buf.data(), buf.size()};
+        ::msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if (::recvmsg(rx.fd(), &msg, 0) > 0) {
+          per_group += CMSG_FIRSTHDR(&msg) != nullptr;
+          ++got;
+        }
+      }
+      receiving += clock::now() - start;
+    }
+    double seconds = std::chrono::duration<double>(receiving).count();
+    (void)per_group;
+    return rounds*groups/seconds;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 5000;
+  std::size_t groups = argc > 2 ? std::stoul(argv[2]) : 16;
+  std::size_t size = argc > 3 ? std::stoul(argv[3]) : 256;
+  uint16_t port = 4498;
+  std::cout << groups << " groups, " << size << " byte datagrams, " << rounds << " rounds" << std::endl;
+  std::cout << "  recvmsg per datagram: " << run(false, groups, size, rounds, port)/1e6 << " M pps" << std::endl;
+  std::cout << "  datagram_batch:       " << run(true, groups, size, rounds, port + 1)/1e6 << " M pps" << std::endl;
+}
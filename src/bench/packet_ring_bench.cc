@@ -0,0 +1,97 @@
+#include <chrono>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <net/if.h>
+
+#include <sockcp/packet_ring.h>
+
+// Capture cost on lo: a recv() per packet from an AF_PACKET socket against
+// walking a TPACKET_V3 ring. Bursts of UDP datagrams are sent first (lo
+// captures them while sending) and then drained; the reader's CPU time per
+// captured packet is reported, since the ring also spends wall time
+// waiting for partly filled blocks to retire. Needs CAP_NET_RAW.
+namespace {
+  std::chrono::nanoseconds cpu_now() {
+    ::timespec ts;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return std::chrono::seconds(ts.tv_sec) + std::chrono::nanoseconds(ts.tv_nsec);
+  }
+
+  void send_burst(sockcp::socket& tx, const sockcp::ipv4& to, const std::string& payload, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) {
+      ::sendto(tx.fd(), payload.data(), payload.size(), 0, to.data(), to.size());
+    }
+  }
+
+  void report(const char* name, std::chrono::nanoseconds cpu, std::size_t packets, uint64_t drops) {
+    std::cout << "  " << name << ": " << static_cast<double>(cpu.count())/packets << " ns/packet, "
+              << packets*1e3/cpu.count() << " M packets/s of reader CPU, " << drops << " dropped" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 50;
+  std::size_t burst = argc > 2 ? std::stoul(argv[2]) : 2000;
+  std::size_t size = argc > 3 ? std::stoul(argv[3]) : 64;
+  uint16_t port = 4503;
+  unsigned lo = ::if_nametoindex("lo");
+  sockcp::ipv4 to("127.0.0.1", port);
+  sockcp::socket tx(sockcp::socktype::datagram);
+  std::string payload(size, 'p');
+  // Every datagram is seen leaving and arriving on lo
+  std::size_t expected = 2*burst;
+  std::cout << rounds << " bursts of " << burst << " " << size << " byte UDP datagrams on lo" << std::endl;
+
+  {
+    sockcp::packet_socket sock(sockcp::socktype::raw, htons(ETH_P_ALL));
+    ::sock_fprog prog;
+    auto code = sockcp::udp_port_filter(port);
+    prog.len = static_cast<unsigned short>(code.size());
+    prog.filter = code.data();
+    sock.set_option(SOL_SOCKET, SO_ATTACH_FILTER, prog);
+    sock.set_option(SOL_SOCKET, SO_RCVBUFFORCE, 64 << 20);
+    sock.bind(sockcp::packet_addr(lo));
+    std::vector<char> buf(65536);
+    std::chrono::nanoseconds cpu{0};
+    std::size_t packets = 0;
+    for (std::size_t r = 0; r < rounds; ++r) {
+      send_burst(tx, to, payload, burst);
+      auto start = cpu_now();
+      for (std::size_t got = 0; got < expected; ++got, ++packets) {
+        if (::recv(sock.fd(), buf.data(), buf.size(), MSG_DONTWAIT) < 0) {
+          break;
+        }
+      }
+      cpu += cpu_now() - start;
+    }
+    auto stats = sock.get_option<::tpacket_stats>(SOL_PACKET, PACKET_STATISTICS);
+    report("recv per packet", cpu, packets, stats.tp_drops);
+  }
+
+  {
+    sockcp::packet_ring_config config;
+    config.block_size = 1 << 16;
+    config.block_count = 512;
+    config.retire_timeout = std::chrono::milliseconds(1);
+    sockcp::packet_ring ring(lo, config);
+    ring.attach_filter(sockcp::udp_port_filter(port));
+    std::chrono::nanoseconds cpu{0};
+    std::size_t packets = 0;
+    uint64_t bytes = 0;
+    for (std::size_t r = 0; r < rounds; ++r) {
+      send_burst(tx, to, payload, burst);
+      // Polling for retired blocks counts as reader CPU too
+      auto start = cpu_now();
+      std::size_t got = 0;
+      while (got < expected && ring.wait(std::chrono::milliseconds(100))) {
+        got += ring.read([&](const sockcp::packet_view& p) { bytes += p.size; });
+      }
+      cpu += cpu_now() - start;
+      packets += got;
+    }
+    report("packet_ring", cpu, packets, ring.stats().drops);
+  }
+}
@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <netinet/tcp.h>
+
+#include <sockcp/pipelined_client.h>
+#include <sockcp/socket.h>
+
+// Request throughput over one loopback TCP connection as the number of
+// requests kept in flight grows. The echo server answers everything one
+// read() gave it with one write(), after an optional delay standing in
+// for network round trip and service time; at depth 1 every request
+// pays that delay and two syscalls on each side, deeper pipelines share
+// them.
+// Usage: pipelined_client_bench [requests] [port]
+namespace {
+  std::atomic<unsigned> server_delay_us{0};
+
+  void serve(sockcp::socket sock) {
+    std::vector<char> in(1 << 16);
+    std::size_t end = 0;
+    std::string out;
+    try {
+      for (;;) {
+        end += sock.read(in.data() + end, in.size() - end);
+        std::size_t pos = 0;
+        out.clear();
+        for (;;) {
+          uint32_t id = 0;
+          const char* payload = nullptr;
+          std::size_t size = 0;
+          std::size_t n = sockcp::tagged_frame_codec::decode(in.data() + pos, end - pos, in.size(), id, payload, size);
+          if (!n) {
+            break;
+          }
+          std::size_t at = out.size();
+          out.resize(at + n);
+          sockcp::tagged_frame_codec::encode(id, payload, size, &out[at]);
+          pos += n;
+        }
+        std::copy(in.begin() + static_cast<std::ptrdiff_t>(pos), in.begin() + static_cast<std::ptrdiff_t>(end), in.begin());
+        end -= pos;
+        if (unsigned delay = server_delay_us.load()) {
+          std::this_thread::sleep_for(std::chrono::microseconds(delay));
+        }
+        sock.write(out);
+      }
+    } catch (const disconnect_error&) {
+    }
+  }
+
+  double run(sockcp::pipelined_client& client, std::size_t depth, std::size_t requests) {
+    const std::string payload(32, 'r');
+    std::size_t issued = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (issued < requests || client.in_flight()) {
+      while (issued < requests && client.in_flight() < depth) {
+        client.request(payload, issued++);
+      }
+      client.flush();
+      client.receive();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return requests/std::chrono::duration<double>(elapsed).count();
+  }
+}
+
+int main(int argc, char* argv[]) {
+  std::size_t requests = 200000;
+  uint16_t port = 4505;
+  if (argc > 1) {
+    requests = std::stoull(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    port = static_cast<uint16_t>(std::stoi(std::string(argv[2])));
+  }
+
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", port));
+  listener.listen();
+  sockcp::socket sock(sockcp::socktype::stream);
+  sock.connect(sockcp::ipv4("127.0.0.1", port));
+  sock.set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+  std::thread server(serve, listener.accept());
+
+  std::size_t responses = 0;
+  sockcp::pipelined_client client(sock, [&](uint64_t, const char*, std::size_t) { ++responses; });
+  for (unsigned delay : {0u, 100u}) {
+    server_delay_us = delay;
+    std::cout << "server delay " << delay << " us:" << std::endl;
+    for (std::size_t depth = 1; depth <= 256; depth *= 4) {
+      // A delayed server takes far longer per batch at low depths
+      std::size_t count = delay ? std::min(requests, depth*2000) : requests;
+      auto before = client.stats();
+      double rate = run(client, depth, count);
+      auto after = client.stats();
+      std::cout << "  depth " << depth << ": " << static_cast<uint64_t>(rate) << " requests/s, "
+                << double(after.writes - before.writes)/count << " writes and "
+                << double(after.reads - before.reads)/count << " reads per request" << std::endl;
+    }
+  }
+  std::cout << responses << " responses" << std::endl;
+  sock.shutdown(sockcp::closeway::write);
+  server.join();
+  return 0;
+}
@@ -0,0 +1,109 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sockcp/prefix_table.h>
+
+// Longest prefix match over a routing-table shaped rule set: lookup cost of
+// prefix_table against a linear scan, build time, memory, and how long an
+// update() takes while another thread keeps filtering.
+namespace {
+  volatile std::size_t sink;
+
+  struct rule {
+    uint32_t prefix;
+    unsigned length;
+  };
+
+  uint32_t mask(unsigned length) {
+    return length ? ~uint32_t(0) << (32 - length) : 0;
+  }
+
+  // Roughly the length mix of a public BGP table, most rules being /24
+  std::vector<rule> make_rules(std::size_t count, std::mt19937& rng) {
+    static const unsigned lengths[] = {8, 12, 16, 19, 20, 21, 22, 22, 23, 23,
+                                       24, 24, 24, 24, 24, 24, 24, 24, 28, 32};
+    std::vector<rule> rules;
+    for (std::size_t i = 0; i < count; ++i) {
+      unsigned length = lengths[rng() % (sizeof(lengths)/sizeof(*lengths))];
+      rules.push_back({static_cast<uint32_t>(rng()) & mask(length), length});
+    }
+    return rules;
+  }
+
+  template <typename Func>
+  double measure(std::size_t count, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/count;
+  }
+
+  std::unique_ptr<const sockcp::prefix_table<sockcp::ipv4>> build(const std::vector<rule>& rules) {
+    sockcp::prefix_table<sockcp::ipv4>::builder builder;
+    for (std::size_t i = 0; i < rules.size(); ++i) {
+      builder.add(sockcp::ipv4(rules[i].prefix), rules[i].length, i % 2 == 0);
+    }
+    return builder.build();
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t count = argc > 1 ? std::stoul(argv[1]) : 50000;
+  std::size_t lookups = argc > 2 ? std::stoul(argv[2]) : 2000000;
+  std::mt19937 rng(4483);
+  std::vector<rule> rules = make_rules(count, rng);
+  std::vector<sockcp::ipv4> addrs;
+  for (std::size_t i = 0; i < lookups; ++i) {
+    addrs.emplace_back(i % 2 ? rules[rng() % rules.size()].prefix | (rng() & 0xff) : uint32_t(rng()));
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  auto table = build(rules);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << count << " prefixes: build "
+            << std::chrono::duration<double, std::milli>(elapsed).count() << " ms, "
+            << table->memory_usage()/1024 << " KiB" << std::endl;
+
+  double lpm = measure(lookups, [&](std::size_t i) { sink = sink + (table->match(addrs[i]) != nullptr); });
+  std::cout << "  prefix_table match: " << lpm << " ns" << std::endl;
+
+  sockcp::prefix_filter<sockcp::ipv4> filter(false);
+  filter.update(build(rules));
+  double filtered = measure(lookups, [&](std::size_t i) { sink = sink + filter(addrs[i]); });
+  std::cout << "  prefix_filter: " << filtered << " ns" << std::endl;
+
+  std::size_t scanned = std::min<std::size_t>(lookups, 2000);
+  double linear = measure(scanned, [&](std::size_t i) {
+    uint32_t addr = addrs[i].binary();
+    for (const auto& r : rules) {
+      if (((addr ^ r.prefix) & mask(r.length)) == 0) {
+        sink = sink + 1;
+      }
+    }
+  });
+  std::cout << "  linear scan: " << linear << " ns" << std::endl;
+
+  std::atomic<bool> done{false};
+  std::thread reader([&] {
+    for (std::size_t i = 0; !done.load(std::memory_order_relaxed); ++i) {
+      sink = sink + filter(addrs[i % addrs.size()]);
+    }
+  });
+  std::vector<std::unique_ptr<const sockcp::prefix_table<sockcp::ipv4>>> next;
+  for (int i = 0; i < 10; ++i) {
+    next.push_back(build(rules));
+  }
+  double swap = measure(next.size(), [&](std::size_t i) { filter.update(std::move(next[i])); });
+  done = true;
+  reader.join();
+  std::cout << "  update under load: " << swap/1000 << " us" << std::endl;
+}
@@ -0,0 +1,60 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <sockcp/record_batch.h>
+
+// Records per second received from a unix seqpacket socket: recv_record()
+// per record against record_batch. Each round queues a burst of records
+// and drains it, so the sender never blocks.
+namespace {
+  using clock = std::chrono::steady_clock;
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  double run(std::size_t batch_size, std::size_t size, std::size_t burst, std::size_t rounds) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_SEQPACKET, 0, fds)) {
+      throw sockcp::socket_error("socketpair");
+    }
+    unix_socket tx = unix_socket::adopt(fds[0]);
+    unix_socket rx = unix_socket::adopt(fds[1]);
+    rx.set_option(SOL_SOCKET, SO_RCVBUF, 4 << 20);
+    tx.set_option(SOL_SOCKET, SO_SNDBUF, 4 << 20);
+    rx.set_block(false);
+
+    std::string payload(size, 'r');
+    sockcp::record_batch batch(batch_size, 2048);
+    std::vector<char> buf(2048);
+    clock::duration receiving{0};
+    for (std::size_t r = 0; r < rounds; ++r) {
+      for (std::size_t i = 0; i < burst; ++i) {
+        sockcp::send_record(tx, payload.data(), payload.size());
+      }
+      auto start = clock::now();
+      for (std::size_t got = 0; got < burst;) {
+        if (batch_size > 1) {
+          got += batch.receive(rx);
+        } else {
+          sockcp::record rec;
+          got += sockcp::recv_record(rx, buf.data(), buf.size(), rec);
+        }
+      }
+      receiving += clock::now() - start;
+    }
+    return rounds*burst/std::chrono::duration<double>(receiving).count();
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 2000;
+  std::size_t size = argc > 2 ? std::stoul(argv[2]) : 128;
+  std::size_t burst = 256;
+  std::cout << size << " byte records, " << rounds << " bursts of " << burst << ", receive side only" << std::endl;
+  std::cout << "  recv_record:      " << run(1, size, burst, rounds)/1e6 << " M records/s" << std::endl;
+  for (std::size_t batch : {16u, 64u}) {
+    std::cout << "  record_batch(" << batch << "): " << run(batch, size, burst, rounds)/1e6 << " M records/s" << std::endl;
+  }
+}
@@ -0,0 +1,75 @@
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include <sockcp/send_queue.h>
+#include <sockcp/unix_address.h>
+
+// Producers stream to `connections` readers that never read until the end.
+// Each producer stops at its queue's high watermark, so resident queue
+// memory stays at roughly watermark + kernel buffer per slow reader. Then
+// every reader drains and the time to flush everything is reported.
+namespace {
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+  using queue_type = sockcp::basic_send_queue<sockcp::unix_addr>;
+}
+
+int main(int argc, char** argv) {
+  std::size_t connections = argc > 1 ? std::stoul(argv[1]) : 400;
+  std::size_t high = argc > 2 ? std::stoul(argv[2]) : 64*1024;
+  std::size_t message = argc > 3 ? std::stoul(argv[3]) : 1024;
+
+  sockcp::buffer_pool pool(4096, 256);
+  std::vector<unix_socket> writers;
+  std::vector<unix_socket> readers;
+  std::vector<std::unique_ptr<queue_type>> queues;
+  writers.reserve(connections);
+  for (std::size_t i = 0; i < connections; ++i) {
+    int fds[2];
+    if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds)) {
+      std::cerr << "socketpair failed after " << i << " connections" << std::endl;
+      connections = i;
+      break;
+    }
+    writers.push_back(unix_socket::adopt(fds[0]));
+    readers.push_back(unix_socket::adopt(fds[1]));
+    writers.back().set_block(false);
+    queues.push_back(std::make_unique<queue_type>(writers.back(), pool, high, high/4));
+  }
+
+  std::string payload(message, 'x');
+  std::size_t produced = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (auto& queue : queues) {
+    while (queue->write(payload)) {
+      produced += message;
+    }
+    produced += message;
+  }
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  std::size_t queued = 0;
+  for (auto& queue : queues) {
+    queued += queue->queued();
+  }
+  std::cout << connections << " slow readers, high watermark " << high << " bytes:" << std::endl
+            << "  produced " << produced/connections << " bytes per connection in "
+            << std::chrono::duration<double, std::milli>(elapsed).count() << " ms" << std::endl
+            << "  queued " << queued/connections << " bytes, pool resident "
+            << pool.resident_bytes()/connections << " bytes per connection" << std::endl;
+
+  char buf[65536];
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < connections; ++i) {
+    while (!queues[i]->flush()) {
+      while (::recv(readers[i].fd(), buf, sizeof(buf), MSG_DONTWAIT) > 0) {
+      }
+    }
+  }
+  elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "  drained in " << std::chrono::duration<double, std::milli>(elapsed).count()
+            << " ms, " << pool.in_use() << " blocks still in use" << std::endl;
+}
@@ -0,0 +1,87 @@
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <sockcp/shm_socket.h>
+#include <sockcp/socket.h>
+#include <sockcp/unix_address.h>
+
+// Round trip latency of the same templated echo loop over loopback TCP,
+// a unix stream socket and shm_socket with and without spinning.
+namespace {
+  constexpr const char* kPath = "/tmp/sockcp_shm_pingpong_bench.sock";
+
+  template <typename Socket>
+  void read_exact(Socket& sock, char* mem, std::size_t count) {
+    for (std::size_t rd = 0; rd < count;) {
+      rd += sock.read(mem + rd, count - rd);
+    }
+  }
+
+  template <typename Socket>
+  double pingpong(Socket& a, Socket& b, std::size_t iterations, std::size_t size) {
+    std::thread echo([&]() {
+      std::vector<char> buf(size);
+      for (std::size_t i = 0; i < iterations; ++i) {
+        read_exact(b, buf.data(), size);
+        b.write(buf.data(), size);
+      }
+    });
+    std::vector<char> msg(size, 'x');
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < iterations; ++i) {
+      a.write(msg.data(), size);
+      read_exact(a, msg.data(), size);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    echo.join();
+    return std::chrono::duration<double, std::micro>(elapsed).count()/iterations;
+  }
+
+  template <typename ProtocolFamily>
+  std::pair<sockcp::basic_socket<ProtocolFamily>, sockcp::basic_socket<ProtocolFamily>>
+  connected_pair(ProtocolFamily addr) {
+    sockcp::basic_socket<ProtocolFamily> listener(sockcp::socktype::stream);
+    listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+    listener.bind(addr);
+    listener.listen(1);
+    sockcp::basic_socket<ProtocolFamily> client(sockcp::socktype::stream);
+    client.connect(addr);
+    return {std::move(client), listener.accept()};
+  }
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::size_t iterations = 100000;
+  std::size_t size = 64;
+  uint16_t port = 4486;
+  if (argc > 1) {
+    iterations = std::stoul(std::string(argv[1]));
+  }
+  if (argc > 2) {
+    size = std::stoul(std::string(argv[2]));
+  }
+  if (argc > 3) {
+    port = std::stoi(std::string(argv[3]));
+  }
+
+  ::unlink(kPath);
+  auto tcp = connected_pair(sockcp::ipv4("127.0.0.1", port));
+  auto local = connected_pair(sockcp::unix_addr(kPath));
+  ::unlink(kPath);
+
+  sockcp::shm_socket shm_a = sockcp::shm_socket::create(local.first);
+  sockcp::shm_socket shm_b = sockcp::shm_socket::open(local.second);
+
+  std::cout << iterations << " round trips of " << size << " bytes\n";
+  std::cout << "  tcp loopback: " << pingpong(tcp.first, tcp.second, iterations, size) << " us\n";
+  std::cout << "  unix stream:  " << pingpong(local.first, local.second, iterations, size) << " us\n";
+  std::cout << "  shm:          " << pingpong(shm_a, shm_b, iterations, size) << " us\n";
+  shm_a.set_spin(100000);
+  shm_b.set_spin(100000);
+  std::cout << "  shm spinning: " << pingpong(shm_a, shm_b, iterations, size) << " us" << std::endl;
+  return 0;
+}
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <netinet/tcp.h>
+
+#include <sockcp/socket_observer.h>
+#include <sockcp/steering.h>
+
+// Request/response over loopback against a sharded listener with one
+// worker per CPU, first with kernel hashing and unpinned workers, then with
+// pinned workers and SO_INCOMING_CPU steering. Reports throughput, mean
+// round trip, and how many accepted sockets were served on the CPU that
+// processed their packets.
+namespace {
+  constexpr std::size_t message_size = 64;
+
+  struct result {
+    double seconds;
+    std::size_t local = 0;
+    std::size_t accepted = 0;
+  };
+
+  void worker(sockcp::sharded_listener<sockcp::ipv4>& group, std::size_t id, bool pin,
+              std::atomic<bool>& stop, std::atomic<std::size_t>& local, std::atomic<std::size_t>& accepted) {
+    if (pin) {
+      sockcp::pin_thread(group.cpu(id));
+    }
+    sockcp::socket& listener = group[id];
+    listener.set_block(false);
+    sockcp::socket_observer observer;
+    observer.attach_socket(listener, sockcp::event::in);
+    std::unordered_map<sockcp::fd_type, sockcp::socket> conns;
+    char buf[message_size];
+    while (!stop.load(std::memory_order_relaxed)) {
+      for (auto& [fd, ev] : observer.poll(std::chrono::milliseconds(10))) {
+        if (fd == listener.fd()) {
+          for (sockcp::socket sock = listener.accept(); sock.fd() != sockcp::fd_invalid; sock = listener.accept()) {
+            sock.set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+            ++accepted;
+            if (static_cast<unsigned>(sockcp::incoming_cpu(sock)) == group.cpu(id)) {
+              ++local;
+            }
+            observer.attach_socket(sock, sockcp::event::in);
+            conns.emplace(sock.fd(), std::move(sock));
+          }
+          continue;
+        }
+        ssize_t n = ::recv(fd, buf, sizeof(buf), 0);
+        if (n <= 0) {
+          observer.detach_socket(conns.at(fd));
+          conns.erase(fd);
+          continue;
+        }
+        ::send(fd, buf, n, MSG_NOSIGNAL);
+      }
+    }
+  }
+
+  result run(const std::vector<unsigned>& cpus, bool steer, std::size_t clients, std::size_t rounds) {
+    sockcp::sharded_listener<sockcp::ipv4> group(sockcp::ipv4("127.0.0.1", 0), cpus, steer);
+    std::atomic<bool> stop{false};
+    std::atomic<std::size_t> local{0};
+    std::atomic<std::size_t> accepted{0};
+    std::vector<std::thread> workers;
+    for (std::size_t i = 0; i < group.size(); ++i) {
+      workers.emplace_back(worker, std::ref(group), i, steer, std::ref(stop), std::ref(local), std::ref(accepted));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> senders;
+    for (std::size_t c = 0; c < clients; ++c) {
+      senders.emplace_back([&, c] {
+        if (steer) {
+          sockcp::pin_thread(cpus[c % cpus.size()]);
+        }
+        sockcp::socket sock(sockcp::socktype::stream);
+        sock.set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+        sock.connect(group.address());
+        char buf[message_size] = {};
+        for (std::size_t i = 0; i < rounds; ++i) {
+          ::send(sock.fd(), buf, sizeof(buf), MSG_NOSIGNAL);
+          for (std::size_t got = 0; got < sizeof(buf);) {
+            ssize_t n = ::recv(sock.fd(), buf + got, sizeof(buf) - got, 0);
+            if (n <= 0) {
+              return;
+            }
+            got += n;
+          }
+        }
+      });
+    }
+    for (auto& t : senders) {
+      t.join();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    stop = true;
+    for (auto& t : workers) {
+      t.join();
+    }
+    return {std::chrono::duration<double>(elapsed).count(), local, accepted};
+  }
+
+  void report(const char* name, const result& r, std::size_t clients, std::size_t rounds) {
+    double messages = static_cast<double>(clients*rounds);
+    std::cout << name << ": " << messages/r.seconds << " msg/s, "
+              << r.seconds*1e6*clients/messages << " us mean round trip, "
+              << r.local << "/" << r.accepted << " served on the receiving CPU" << std::endl;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t clients = argc > 1 ? std::stoul(argv[1]) : 16;
+  std::size_t rounds = argc > 2 ? std::stoul(argv[2]) : 5000;
+  std::size_t max_workers = argc > 3 ? std::stoul(argv[3]) : 8;
+
+  ::cpu_set_t set;
+  CPU_ZERO(&set);
+  ::sched_getaffinity(0, sizeof(set), &set);
+  std::vector<unsigned> cpus;
+  for (unsigned cpu = 0; cpu < CPU_SETSIZE && cpus.size() < max_workers; ++cpu) {
+    if (CPU_ISSET(cpu, &set)) {
+      cpus.push_back(cpu);
+    }
+  }
+  std::cout << cpus.size() << " workers, " << clients << " clients, "
+            << rounds << " round trips each" << std::endl;
+  report("  hashed", run(cpus, false, clients, rounds), clients, rounds);
+  report("  steered", run(cpus, true, clients, rounds), clients, rounds);
+}
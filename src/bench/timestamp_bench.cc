@@ -0,0 +1,92 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include <netinet/tcp.h>
+
+#include <sockcp/socket_observer.h>
+#include <sockcp/timestamping.h>
+
+// Loopback request/response with kernel timestamps on both ends. Splits
+// each round trip into kernel stages (TX sched, driver handoff, ack, RX
+// queue wait) and the time spent in the application between reading a
+// request and sending the reply.
+namespace {
+  void print(const char* name, const sockcp::latency_histogram& hist) {
+    std::cout << "  " << name << ": p50 " << hist.percentile(0.5).count()/1000.0
+              << " us, p99 " << hist.percentile(0.99).count()/1000.0
+              << " us, max " << hist.max().count()/1000.0 << " us (" << hist.count() << ")" << std::endl;
+  }
+
+  void drain_tx(sockcp::socket& sock, sockcp::tx_tracker& tracker, sockcp::stage_latency& stages) {
+    sockcp::read_tx_timestamps(sock, [&](const sockcp::tx_timestamp& stamp) {
+      tracker.stamped(stamp, stages);
+    });
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 20000;
+  std::size_t size = argc > 2 ? std::stoul(argv[2]) : 64;
+  uint16_t port = 4488;
+
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", port));
+  listener.listen(1);
+  sockcp::socket client(sockcp::socktype::stream);
+  client.connect(sockcp::ipv4("127.0.0.1", port));
+  sockcp::socket server = listener.accept();
+  for (auto* sock : {&client, &server}) {
+    sock->set_option(IPPROTO_TCP, TCP_NODELAY, 1);
+    sockcp::enable_timestamping(*sock);
+  }
+
+  sockcp::stage_latency client_stages;
+  sockcp::stage_latency server_stages;
+  sockcp::latency_histogram app;
+  sockcp::latency_histogram round_trip;
+  sockcp::tx_tracker client_tx;
+  sockcp::tx_tracker server_tx;
+  std::string buf(size, 'x');
+  std::string in(size, 0);
+
+  auto read_all = [&](sockcp::socket& sock, sockcp::stage_latency& stages) {
+    for (std::size_t got = 0; got < size;) {
+      auto rx = sockcp::recv_timestamped(sock, &in[got], size - got);
+      if (rx.kernel.count()) {
+        stages.rx_queue.record(sockcp::realtime_now() - rx.kernel);
+      }
+      got += rx.bytes;
+    }
+  };
+
+  for (std::size_t i = 0; i < rounds; ++i) {
+    auto start = sockcp::realtime_now();
+    ::send(client.fd(), buf.data(), size, 0);
+    client_tx.sent(size, start);
+
+    read_all(server, server_stages);
+    auto handled = sockcp::realtime_now();
+    ::send(server.fd(), buf.data(), size, 0);
+    server_tx.sent(size, handled);
+    app.record(sockcp::realtime_now() - handled);
+
+    read_all(client, client_stages);
+    round_trip.record(sockcp::realtime_now() - start);
+    drain_tx(client, client_tx, client_stages);
+    drain_tx(server, server_tx, server_stages);
+  }
+  drain_tx(client, client_tx, client_stages);
+  drain_tx(server, server_tx, server_stages);
+
+  std::cout << rounds << " round trips of " << size << " bytes" << std::endl;
+  print("round trip", round_trip);
+  print("client tx sched", client_stages.tx_sched);
+  print("client tx driver", client_stages.tx_driver);
+  print("client tx ack", client_stages.tx_ack);
+  print("server rx queue", server_stages.rx_queue);
+  print("server send call", app);
+  print("server tx driver", server_stages.tx_driver);
+  print("client rx queue", client_stages.rx_queue);
+}
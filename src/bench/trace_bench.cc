@@ -0,0 +1,70 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sockcp/memory_transport.h>
+#include <sockcp/trace.h>
+
+// Cost of tracing: a bare span, the library's traced I/O path over the
+// in-memory transport with recording on and paused, and exporting a full
+// ring as Chrome JSON. Built with SOCKCP_TRACING; compiled out, the hooks
+// cost nothing, see memory_transport_bench for that baseline.
+namespace {
+  template <typename Func>
+  double measure(std::size_t count, Func func) {
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < count; ++i) {
+      func(i);
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    return std::chrono::duration<double, std::nano>(elapsed).count()/count;
+  }
+}
+
+int main() {
+#if !defined(SOCKCP_TRACING)
+  std::cout << "built without SOCKCP_TRACING, library hooks are compiled out" << std::endl;
+#endif
+  auto& recorder = sockcp::trace_recorder::instance();
+  recorder.set_ring_capacity(1u << 20);
+  recorder.set_thread_name("bench");
+  std::size_t spans = 10000000;
+
+  double span = measure(spans, [](std::size_t i) {
+    sockcp::trace_span s(sockcp::trace_kind::user, "span", static_cast<int64_t>(i));
+  });
+  recorder.enable(false);
+  double paused = measure(spans, [](std::size_t i) {
+    sockcp::trace_span s(sockcp::trace_kind::user, "span", static_cast<int64_t>(i));
+  });
+  recorder.enable(true);
+  std::cout << "span: " << span << " ns recorded, " << paused << " ns paused" << std::endl;
+
+  auto socks = sockcp::memory_socket_pair();
+  char out[64] = {};
+  char in[64];
+  auto round_trip = [&](std::size_t) {
+    socks.first.write(out, sizeof(out));
+    for (std::size_t got = 0; got < sizeof(in);) {
+      got += socks.second.read(in + got, sizeof(in) - got);
+    }
+  };
+  std::size_t rounds = 2000000;
+  double traced = measure(rounds, round_trip);
+  recorder.enable(false);
+  double untraced = measure(rounds, round_trip);
+  recorder.enable(true);
+  std::cout << "64 byte memory round trip: " << traced << " ns traced, " << untraced << " ns paused" << std::endl;
+
+  std::ostringstream json;
+  auto start = std::chrono::steady_clock::now();
+  std::size_t events = recorder.write_chrome_json(json);
+  auto elapsed = std::chrono::steady_clock::now() - start;
+  std::cout << "export: " << events << " events, " << json.str().size()/events << " bytes each, "
+            << std::chrono::duration<double, std::nano>(elapsed).count()/events << " ns each, "
+            << recorder.dropped() << " dropped by the ring" << std::endl;
+  return 0;
+}
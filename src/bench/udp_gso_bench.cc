@@ -0,0 +1,54 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <sockcp/udp_offload.h>
+
+// Loopback UDP throughput in datagrams per second: one send() per
+// datagram against UDP_SEGMENT batches, received one recv() per datagram
+// or coalesced with UDP_GRO. Each round sends a burst that fits the
+// receive buffer and reads it back, so nothing is dropped.
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  double run(bool gso, bool gro, std::size_t size, std::size_t rounds, uint16_t port) {
+    sockcp::socket rx(sockcp::socktype::datagram);
+    sockcp::socket tx(sockcp::socktype::datagram);
+    rx.set_option(SOL_SOCKET, SO_RCVBUF, 4 << 20);
+    rx.bind(sockcp::ipv4("127.0.0.1", port));
+    tx.connect(sockcp::ipv4("127.0.0.1", port));
+    if (gro && !sockcp::enable_gro(rx)) {
+      return 0;
+    }
+
+    std::size_t burst = sockcp::gso_max_segments;
+    std::string data(size*burst, 'x');
+    std::vector<char> buf(sockcp::gso_max_bytes);
+    auto start = clock::now();
+    for (std::size_t r = 0; r < rounds; ++r) {
+      if (gso) {
+        sockcp::send_segmented(tx, data.data(), data.size(), size);
+      } else {
+        for (std::size_t i = 0; i < burst; ++i) {
+          ::send(tx.fd(), data.data(), size, 0);
+        }
+      }
+      for (std::size_t got = 0; got < burst;) {
+        got += sockcp::recv_coalesced(rx, buf.data(), buf.size()).segments();
+      }
+    }
+    double seconds = std::chrono::duration<double>(clock::now() - start).count();
+    return rounds*burst/seconds;
+  }
+}
+
+int main(int argc, char** argv) {
+  std::size_t rounds = argc > 1 ? std::stoul(argv[1]) : 5000;
+  std::size_t size = argc > 2 ? std::stoul(argv[2]) : 1200;
+  uint16_t port = 4492;
+  std::cout << size << " byte datagrams, " << rounds << " bursts of " << sockcp::gso_max_segments << std::endl;
+  std::cout << "  send per datagram, recv per datagram: " << run(false, false, size, rounds, port)/1e6 << " M pps" << std::endl;
+  std::cout << "  UDP_SEGMENT,       recv per datagram: " << run(true, false, size, rounds, port + 1)/1e6 << " M pps" << std::endl;
+  std::cout << "  UDP_SEGMENT,       UDP_GRO:           " << run(true, true, size, rounds, port + 2)/1e6 << " M pps" << std::endl;
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+
+#include <cstring>
+
+#include "sockcp/adapter.h"
+
+namespace
+{
+  // One rtnetlink message with a single attribute, as the kernel sends it
+  struct message
+  {
+    alignas(::nlmsghdr) char buf[256] = {};
+
+    template <typename Header>
+    Header &init(uint16_t type)
+    {
+      auto *h = reinterpret_cast<::nlmsghdr *>(buf);
+      h->nlmsg_type = type;
+      h->nlmsg_len = NLMSG_LENGTH(sizeof(Header));
+      return *static_cast<Header *>(NLMSG_DATA(h));
+    }
+
+    void attr(uint16_t type, const void *data, std::size_t len)
+    {
+      auto *h = reinterpret_cast<::nlmsghdr *>(buf);
+      auto *a = reinterpret_cast<::rtattr *>(buf + NLMSG_ALIGN(h->nlmsg_len));
+      a->rta_type = type;
+      a->rta_len = RTA_LENGTH(len);
+      std::memcpy(RTA_DATA(a), data, len);
+      h->nlmsg_len = NLMSG_ALIGN(h->nlmsg_len) + RTA_ALIGN(a->rta_len);
+    }
+
+    std::size_t size() const
+    {
+      return reinterpret_cast<const ::nlmsghdr *>(buf)->nlmsg_len;
+    }
+  };
+
+  message addr_message(uint16_t type, unsigned index, uint32_t addr, unsigned prefix)
+  {
+    message m;
+    auto &msg = m.init<::ifaddrmsg>(type);
+    msg.ifa_family = AF_INET;
+    msg.ifa_prefixlen = static_cast<uint8_t>(prefix);
+    msg.ifa_index = index;
+    uint32_t net = htonl(addr);
+    m.attr(IFA_LOCAL, &net, sizeof(net));
+    return m;
+  }
+
+  const sockcp::adapter<sockcp::ipv4> *find_addr(const sockcp::adapter_provider &provider, uint32_t addr)
+  {
+    for (const auto &a : provider.adapters<sockcp::ipv4>())
+    {
+      if (a.addr.binary() == addr)
+      {
+        return &a;
+      }
+    }
+    return nullptr;
+  }
+}
+
+TEST(AdapterTest, snapshot_has_loopback)
+{
+  sockcp::adapter_provider provider;
+  auto *lo = find_addr(provider, 0x7f000001);
+  ASSERT_NE(lo, nullptr);
+  ASSERT_EQ(lo->index, ::if_nametoindex(lo->name.c_str()));
+  ASSERT_EQ(lo->prefix_length, 8u);
+  ASSERT_GT(lo->mtu, 0u);
+  ASSERT_EQ(provider.find<sockcp::ipv4>(lo->name), lo);
+  ASSERT_EQ(provider.dispatch(), 0u);
+}
+
+TEST(AdapterTest, address_notifications)
+{
+  sockcp::adapter_provider provider;
+  unsigned index = find_addr(provider, 0x7f000001)->index;
+  uint64_t generation = provider.generation();
+
+  message add = addr_message(RTM_NEWADDR, index, 0x0a630001, 16);
+  ASSERT_EQ(provider.apply(add.buf, add.size()), 1u);
+  auto *a = find_addr(provider, 0x0a630001);
+  ASSERT_NE(a, nullptr);
+  ASSERT_EQ(a->prefix_length, 16u);
+  ASSERT_EQ(a->index, index);
+  ASSERT_GT(provider.generation(), generation);
+
+  ASSERT_EQ(provider.apply(add.buf, add.size()), 0u);
+
+  message del = addr_message(RTM_DELADDR, index, 0x0a630001, 16);
+  ASSERT_EQ(provider.apply(del.buf, del.size()), 1u);
+  ASSERT_EQ(find_addr(provider, 0x0a630001), nullptr);
+}
+
+TEST(AdapterTest, link_notifications)
+{
+  sockcp::adapter_provider provider;
+  unsigned index = find_addr(provider, 0x7f000001)->index;
+
+  message mtu;
+  mtu.init<::ifinfomsg>(RTM_NEWLINK).ifi_index = static_cast<int>(index);
+  uint32_t value = 1234;
+  mtu.attr(IFLA_MTU, &value, sizeof(value));
+  ASSERT_EQ(provider.apply(mtu.buf, mtu.size()), 1u);
+  ASSERT_EQ(find_addr(provider, 0x7f000001)->mtu, 1234u);
+
+  message gone;
+  gone.init<::ifinfomsg>(RTM_DELLINK).ifi_index = static_cast<int>(index);
+  ASSERT_EQ(provider.apply(gone.buf, gone.size()), 1u);
+  ASSERT_EQ(find_addr(provider, 0x7f000001), nullptr);
+
+  provider.refresh();
+  ASSERT_NE(find_addr(provider, 0x7f000001), nullptr);
+}
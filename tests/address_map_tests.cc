@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <random>
+#include <unordered_set>
+
+#include "sockcp/address_map.h"
+
+using namespace sockcp::literals;
+
+TEST(AddressTest, ipv4_ordering)
+{
+  static_assert("10.0.0.1:80"_ipv4 == "10.0.0.1:80"_ipv4);
+  static_assert("10.0.0.1:80"_ipv4 != "10.0.0.1:81"_ipv4);
+  static_assert("10.0.0.1:81"_ipv4 < "10.0.0.2:80"_ipv4);
+  static_assert("9.255.255.255:65535"_ipv4 < "10.0.0.0"_ipv4);
+  ASSERT_EQ(sockcp::ipv4("127.0.0.1", 4483), sockcp::ipv4((127u << 24) | 1u, 4483));
+  ASSERT_GE(sockcp::ipv4("192.168.11.253", 1), sockcp::ipv4("78.105.61.33", 1337));
+}
+
+TEST(AddressTest, ipv6_ordering)
+{
+  static_assert("[fd00::1]:80"_ipv6 == "[fd00::1]:80"_ipv6);
+  static_assert("[fd00::1]:80"_ipv6 != "[fd00::1]:81"_ipv6);
+  static_assert("[fd00::1]:81"_ipv6 < "[fd00::2]:80"_ipv6);
+  static_assert("::ffff:255.255.255.255"_ipv6 < "fd00::"_ipv6);
+  ASSERT_EQ(sockcp::ipv6("::1", 4483), "[::1]:4483"_ipv6);
+}
+
+TEST(AddressTest, hash_spreads)
+{
+  std::unordered_set<std::size_t> v4_hashes;
+  std::unordered_set<std::size_t> v6_hashes;
+  for (uint32_t i = 0; i < 4096; ++i)
+  {
+    v4_hashes.insert(std::hash<sockcp::ipv4>()(sockcp::ipv4((10u << 24) | i, 4483)));
+    v4_hashes.insert(std::hash<sockcp::ipv4>()(sockcp::ipv4((10u << 24), static_cast<uint16_t>(i))));
+    sockcp::ipv6 ip = "fd00::"_ipv6;
+    ip.addr.sin6_addr.s6_addr[14] = static_cast<uint8_t>(i >> 8);
+    ip.addr.sin6_addr.s6_addr[15] = static_cast<uint8_t>(i);
+    v6_hashes.insert(std::hash<sockcp::ipv6>()(ip));
+  }
+  ASSERT_EQ(v4_hashes.size(), 2 * 4096u);
+  ASSERT_EQ(v6_hashes.size(), 4096u);
+}
+
+template <typename ProtocolFamily, typename Generator>
+void random_ops(Generator make_addr)
+{
+  std::mt19937 rng(4483);
+  sockcp::address_map<ProtocolFamily, int> map;
+  std::map<ProtocolFamily, int> reference;
+  for (int i = 0; i < 200000; ++i)
+  {
+    ProtocolFamily addr = make_addr(rng);
+    switch (rng() % 4)
+    {
+    case 0:
+      ASSERT_EQ(map.erase(addr), reference.erase(addr) == 1);
+      break;
+    case 1:
+    {
+      const int *found = map.find(addr);
+      auto ref = reference.find(addr);
+      ASSERT_EQ(found != nullptr, ref != reference.end());
+      if (found)
+      {
+        ASSERT_EQ(*found, ref->second);
+      }
+      break;
+    }
+    default:
+      map[addr] = i;
+      reference[addr] = i;
+    }
+    ASSERT_EQ(map.size(), reference.size());
+  }
+  std::size_t visited = 0;
+  map.for_each([&](const ProtocolFamily &addr, int value)
+               {
+    ++visited;
+    ASSERT_EQ(reference.at(addr), value); });
+  ASSERT_EQ(visited, reference.size());
+}
+
+TEST(AddressMapTest, ipv4_random_ops)
+{
+  random_ops<sockcp::ipv4>([](std::mt19937 &rng)
+                           { return sockcp::ipv4((10u << 24) | (rng() % 4096), static_cast<uint16_t>(rng() % 4)); });
+}
+
+TEST(AddressMapTest, ipv6_random_ops)
+{
+  random_ops<sockcp::ipv6>([](std::mt19937 &rng)
+                           {
+    uint8_t bytes[16] = {0xfd};
+    bytes[9] = static_cast<uint8_t>(rng() % 64);
+    bytes[15] = static_cast<uint8_t>(rng() % 64);
+    return sockcp::ipv6(bytes, static_cast<uint16_t>(rng() % 4)); });
+}
+
+TEST(AddressMapTest, emplace_keeps_existing)
+{
+  sockcp::address_map<sockcp::ipv4, int> map(100);
+  ASSERT_TRUE(map.emplace("10.0.0.1:80"_ipv4, 1).second);
+  auto again = map.emplace("10.0.0.1:80"_ipv4, 2);
+  ASSERT_FALSE(again.second);
+  ASSERT_EQ(*again.first, 1);
+  ASSERT_TRUE(map.contains("10.0.0.1:80"_ipv4));
+  ASSERT_FALSE(map.contains("10.0.0.1:81"_ipv4));
+  map.clear();
+  ASSERT_TRUE(map.empty());
+  ASSERT_FALSE(map.contains("10.0.0.1:80"_ipv4));
+}
+
+TEST(AddressMapTest, moved_from_map_is_empty)
+{
+  sockcp::address_map<sockcp::ipv4, int> map(100);
+  map.emplace("10.0.0.1:80"_ipv4, 1);
+  map.emplace("10.0.0.2:80"_ipv4, 2);
+
+  sockcp::address_map<sockcp::ipv4, int> moved(std::move(map));
+  ASSERT_EQ(moved.size(), 2u);
+  ASSERT_EQ(*moved.find("10.0.0.2:80"_ipv4), 2);
+  ASSERT_TRUE(map.empty());
+  ASSERT_EQ(map.capacity(), 0u);
+  ASSERT_FALSE(map.contains("10.0.0.1:80"_ipv4));
+  // Still usable after the move
+  ASSERT_TRUE(map.emplace("10.0.0.3:80"_ipv4, 3).second);
+
+  map = std::move(moved);
+  ASSERT_EQ(map.size(), 2u);
+  ASSERT_EQ(*map.find("10.0.0.1:80"_ipv4), 1);
+  ASSERT_FALSE(map.contains("10.0.0.3:80"_ipv4));
+  ASSERT_TRUE(moved.empty());
+  ASSERT_EQ(moved.memory_usage(), 0u);
+  ASSERT_TRUE(moved.emplace("10.0.0.4:80"_ipv4, 4).second);
+}
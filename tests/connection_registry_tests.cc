@@ -0,0 +1,114 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <vector>
+
+#include "sockcp/connection_registry.h"
+
+namespace
+{
+  sockcp::fd_type open_fd()
+  {
+    sockcp::socket sock(sockcp::socktype::stream);
+    return sock.release();
+  }
+}
+
+TEST(ConnectionRegistryTest, add_and_lookup)
+{
+  sockcp::connection_registry registry(4);
+  sockcp::ipv4 peer("127.0.0.1", 4000);
+  sockcp::fd_type fd = open_fd();
+  auto h = registry.add(fd, peer, sockcp::connection_state::connecting);
+  ASSERT_TRUE(h);
+  EXPECT_TRUE(registry.contains(h));
+  EXPECT_EQ(1u, registry.size());
+  EXPECT_EQ(fd, registry.fd(h));
+  EXPECT_EQ(sockcp::connection_state::connecting, registry.state(h));
+  EXPECT_EQ(peer.to_string(), registry.peer(h).to_string());
+  EXPECT_EQ(h, registry.find(fd));
+  registry.set_state(h, sockcp::connection_state::open);
+  registry.set_readiness(h, sockcp::event::in);
+  registry.stats(h).bytes_in += 10;
+  EXPECT_EQ(sockcp::connection_state::open, registry.state(h));
+  EXPECT_EQ(sockcp::event::in, registry.readiness(h));
+  EXPECT_EQ(10u, registry.stats(h).bytes_in);
+  EXPECT_GT(registry.memory_usage(), 0u);
+}
+
+TEST(ConnectionRegistryTest, stale_handle_after_fd_reuse)
+{
+  sockcp::connection_registry registry;
+  sockcp::ipv4 peer("127.0.0.1", 4000);
+  sockcp::fd_type fd = open_fd();
+  auto old_handle = registry.add(fd, peer);
+  registry.remove(old_handle);
+  EXPECT_FALSE(registry.contains(old_handle));
+  EXPECT_FALSE(registry.find(fd));
+
+  // POSIX hands out the lowest free descriptor, so the new connection
+  // gets the same fd and the same slot
+  sockcp::fd_type reused = open_fd();
+  auto new_handle = registry.add(reused, peer);
+#if !defined(_WIN32)
+  EXPECT_EQ(fd, reused);
+#endif
+  EXPECT_EQ(old_handle.index, new_handle.index);
+  EXPECT_NE(old_handle, new_handle);
+  EXPECT_FALSE(registry.contains(old_handle));
+  EXPECT_TRUE(registry.contains(new_handle));
+  EXPECT_EQ(new_handle, registry.find(reused));
+  EXPECT_THROW(registry.fd(old_handle), std::out_of_range);
+  EXPECT_THROW(registry.remove(old_handle), std::out_of_range);
+  EXPECT_TRUE(registry.contains(new_handle));
+}
+
+TEST(ConnectionRegistryTest, release_keeps_descriptor_open)
+{
+  sockcp::connection_registry registry;
+  sockcp::socket sock(sockcp::socktype::stream);
+  auto h = registry.add(std::move(sock));
+  sockcp::fd_type fd = registry.release(h);
+  EXPECT_TRUE(registry.empty());
+  auto adopted = sockcp::socket::adopt(fd);
+  EXPECT_NO_THROW(adopted.set_option(SOL_SOCKET, SO_REUSEADDR, 1));
+}
+
+TEST(ConnectionRegistryTest, for_each_allows_removal)
+{
+  sockcp::connection_registry registry;
+  sockcp::ipv4 peer("127.0.0.1", 4000);
+  std::vector<sockcp::connection_handle> handles;
+  for (int i = 0; i < 8; ++i)
+  {
+    handles.push_back(registry.add(open_fd(), peer));
+  }
+  for (std::size_t i = 0; i < handles.size(); i += 2)
+  {
+    registry.set_state(handles[i], sockcp::connection_state::closing);
+  }
+
+  std::size_t visited = 0;
+  registry.for_each([&](sockcp::connection_handle h)
+  {
+    ++visited;
+    if (registry.state(h) == sockcp::connection_state::closing)
+    {
+      registry.remove(h);
+    }
+  });
+  EXPECT_EQ(8u, visited);
+  EXPECT_EQ(4u, registry.size());
+  for (std::size_t i = 0; i < handles.size(); ++i)
+  {
+    EXPECT_EQ(i % 2 == 1, registry.contains(handles[i]));
+  }
+
+  visited = 0;
+  registry.for_each([&](sockcp::connection_handle h)
+  {
+    ++visited;
+    EXPECT_EQ(sockcp::connection_state::open, registry.state(h));
+  });
+  EXPECT_EQ(4u, visited);
+}
@@ -0,0 +1,108 @@
+#include <gtest/gtest.h>
+
+#include <map>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "sockcp/drain_policy.h"
+#include "sockcp/socket_observer.h"
+#include "sockcp/unix_address.h"
+
+TEST(DrainPolicyTest, budget_requeues_flooder)
+{
+  sockcp::drain_policy policy({1000, 4});
+  std::map<sockcp::fd_type, std::size_t> available{{1, 100000}, {2, 50}, {3, 0}};
+  std::vector<sockcp::fd_type> order;
+  auto read = [&](sockcp::fd_type fd, std::size_t max) -> long
+  {
+    order.push_back(fd);
+    std::size_t n = std::min<std::size_t>({available[fd], max, 300});
+    available[fd] -= n;
+    return n ? static_cast<long>(n) : -1;
+  };
+
+  policy.ready(1);
+  policy.ready(2);
+  policy.ready(3);
+  policy.ready(1);
+  ASSERT_EQ(policy.size(), 3u);
+
+  ASSERT_EQ(policy.run(read), 4u + 2u + 1u);
+  ASSERT_EQ(available[1], 100000u - 1000u);
+  ASSERT_EQ(available[2], 0u);
+  ASSERT_EQ(policy.size(), 1u);
+  ASSERT_TRUE(policy.pending());
+
+  order.clear();
+  ASSERT_EQ(policy.run(read), 4u);
+  ASSERT_EQ(order, std::vector<sockcp::fd_type>(4, 1));
+
+  policy.remove(1);
+  ASSERT_FALSE(policy.pending());
+}
+
+TEST(DrainPolicyTest, callback_may_remove)
+{
+  sockcp::drain_policy policy;
+  policy.ready(7);
+  policy.run([&](sockcp::fd_type fd, std::size_t) -> long
+             {
+               policy.remove(fd);
+               return 0; });
+  ASSERT_FALSE(policy.pending());
+}
+
+TEST(SocketObserverTest, edge_trigger_reports_once)
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  unix_socket a = unix_socket::adopt(fds[0]);
+  unix_socket b = unix_socket::adopt(fds[1]);
+
+  sockcp::socket_observer level;
+  sockcp::socket_observer edge(sockcp::trigger::edge);
+  ASSERT_EQ(edge.mode(), sockcp::trigger::edge);
+  level.attach_socket(b, sockcp::event::in);
+  edge.attach_socket(b, sockcp::event::in);
+
+  a.write(std::string_view("data"));
+  ASSERT_EQ(level.poll(std::chrono::milliseconds(100)).size(), 1u);
+  ASSERT_EQ(level.poll(std::chrono::milliseconds(0)).size(), 1u);
+  auto first = edge.poll(std::chrono::milliseconds(100));
+  ASSERT_EQ(first.size(), 1u);
+  ASSERT_EQ(first.at(b.fd()) & sockcp::event::in, sockcp::event::in);
+  ASSERT_TRUE(edge.poll(std::chrono::milliseconds(0)).empty());
+
+  a.write(std::string_view("more"));
+  ASSERT_EQ(edge.poll(std::chrono::milliseconds(100)).size(), 1u);
+
+  edge.detach_socket(b);
+  a.write(std::string_view("gone"));
+  ASSERT_TRUE(edge.poll(std::chrono::milliseconds(0)).empty());
+}
+
+TEST(SocketObserverTest, edge_trigger_survives_move)
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  unix_socket a = unix_socket::adopt(fds[0]);
+  unix_socket b = unix_socket::adopt(fds[1]);
+
+  sockcp::socket_observer source(sockcp::trigger::edge);
+  source.attach_socket(b, sockcp::event::in);
+  sockcp::socket_observer moved(std::move(source));
+  a.write(std::string_view("data"));
+  ASSERT_EQ(moved.poll(std::chrono::milliseconds(100)).size(), 1u);
+
+  sockcp::socket_observer assigned(sockcp::trigger::edge);
+  assigned = std::move(moved);
+  assigned.detach_socket(b);
+  a.write(std::string_view("gone"));
+  ASSERT_TRUE(assigned.poll(std::chrono::milliseconds(0)).empty());
+  assigned.attach_socket(b, sockcp::event::in);
+  a.write(std::string_view("back"));
+  ASSERT_EQ(assigned.poll(std::chrono::milliseconds(100)).size(), 1u);
+}
@@ -0,0 +1,170 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "sockcp/event_loop.h"
+#include "sockcp/unix_address.h"
+
+TEST(MpscQueueTest, keeps_per_producer_order)
+{
+  constexpr int producers = 4;
+  constexpr int per_producer = 20000;
+  sockcp::mpsc_queue<int> queue;
+  std::vector<std::thread> threads;
+  for (int p = 0; p < producers; ++p)
+  {
+    threads.emplace_back([&queue, p]
+                         {
+                           for (int i = 0; i < per_producer; ++i)
+                           {
+                             queue.push(p * per_producer + i);
+                           } });
+  }
+  std::vector<int> last(producers, -1);
+  int received = 0;
+  while (received < producers * per_producer)
+  {
+    int value;
+    if (!queue.pop(value))
+    {
+      std::this_thread::yield();
+      continue;
+    }
+    int p = value / per_producer;
+    ASSERT_GT(value % per_producer, last[p]);
+    last[p] = value % per_producer;
+    ++received;
+  }
+  for (auto &t : threads)
+  {
+    t.join();
+  }
+  int value;
+  ASSERT_FALSE(queue.pop(value));
+}
+
+TEST(EventLoopTest, runs_posted_tasks)
+{
+  sockcp::event_loop loop;
+  std::atomic<int> count{0};
+  std::thread runner([&]
+                     { loop.run(); });
+  std::vector<std::thread> producers;
+  for (int p = 0; p < 4; ++p)
+  {
+    producers.emplace_back([&]
+                           {
+                             for (int i = 0; i < 1000; ++i)
+                             {
+                               loop.post([&]
+                                         { ++count; });
+                             } });
+  }
+  for (auto &t : producers)
+  {
+    t.join();
+  }
+  loop.stop();
+  runner.join();
+  ASSERT_EQ(count, 4000);
+}
+
+TEST(EventLoopTest, attach_from_other_thread)
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  unix_socket a = unix_socket::adopt(fds[0]);
+  unix_socket b = unix_socket::adopt(fds[1]);
+
+  sockcp::event_loop loop;
+  std::atomic<int> reads{0};
+  std::thread runner([&]
+                     { loop.run(); });
+  loop.attach(b, sockcp::event::in, [&](sockcp::event ready)
+              {
+                ASSERT_EQ(ready & sockcp::event::in, sockcp::event::in);
+                char c;
+                ASSERT_EQ(::recv(b.fd(), &c, 1, 0), 1);
+                if (++reads == 2)
+                {
+                  loop.detach(b);
+                  loop.stop();
+                } });
+  a.write(std::string_view("xy"));
+  runner.join();
+  ASSERT_EQ(reads, 2);
+}
+
+TEST(EventLoopTest, busy_poll_spins_before_blocking)
+{
+  using namespace std::chrono_literals;
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+  int fds[2];
+  ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+  unix_socket a = unix_socket::adopt(fds[0]);
+  unix_socket b = unix_socket::adopt(fds[1]);
+
+  sockcp::event_loop loop;
+  loop.set_busy_poll(sockcp::busy_poll{200us});
+  int reads = 0;
+  loop.attach(b, sockcp::event::in, [&](sockcp::event)
+              {
+                char c;
+                ASSERT_EQ(::recv(b.fd(), &c, 1, 0), 1);
+                ++reads; });
+  // Runs the attach task, found by the spin
+  ASSERT_EQ(loop.run_once(10ms), 1u);
+  ASSERT_EQ(loop.stats().hits, 1u);
+
+  // Nothing ready: the whole budget is spent, then poll() times out
+  ASSERT_EQ(loop.run_once(1ms), 0u);
+  ASSERT_EQ(loop.stats().fallbacks, 1u);
+  ASSERT_GE(loop.stats().idle_spin_time, 200us);
+  ASSERT_GE(loop.stats().spin_time, loop.stats().idle_spin_time);
+
+  a.write(std::string_view("x"));
+  ASSERT_EQ(loop.run_once(10ms), 1u);
+  ASSERT_EQ(reads, 1);
+  ASSERT_EQ(loop.stats().hits, 2u);
+  ASSERT_GE(loop.stats().polls, 3u);
+
+  // A zero timeout never spins
+  loop.reset_stats();
+  ASSERT_EQ(loop.run_once(0ms), 0u);
+  ASSERT_EQ(loop.stats().polls, 0u);
+}
+
+TEST(EventLoopTest, set_busy_poll_reports_refusal)
+{
+  sockcp::socket sock(sockcp::socktype::datagram);
+  // Zero never needs privileges; larger values may be refused
+  ASSERT_NO_THROW(sockcp::set_busy_poll(sock, std::chrono::microseconds(50)));
+#if defined(__linux__)
+  ASSERT_TRUE(sockcp::set_busy_poll(sock, std::chrono::microseconds(0), false));
+#endif
+}
+
+#if defined(SO_BUSY_POLL)
+TEST(EventLoopTest, set_busy_poll_refusal_keeps_previous_timeout)
+{
+  sockcp::socket sock(sockcp::socktype::datagram);
+  int previous = 10;
+  if (::setsockopt(sock.fd(), SOL_SOCKET, SO_BUSY_POLL, &previous, sizeof(previous)))
+  {
+    GTEST_SKIP() << "SO_BUSY_POLL refused";
+  }
+  if (!sockcp::set_busy_poll(sock, std::chrono::microseconds(20)))
+  {
+    ASSERT_EQ(sock.get_option<int>(SOL_SOCKET, SO_BUSY_POLL), previous);
+  }
+  else
+  {
+    ASSERT_EQ(sock.get_option<int>(SOL_SOCKET, SO_BUSY_POLL), 20);
+  }
+}
+#endif
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+
+#include <stdexcept>
+#include <string>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "sockcp/socket.h"
+#include "sockcp/unix_address.h"
+
+namespace
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  struct channel
+  {
+    unix_socket a;
+    unix_socket b;
+  };
+
+  channel make_channel()
+  {
+    int fds[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    return {unix_socket::adopt(fds[0]), unix_socket::adopt(fds[1])};
+  }
+
+  // Lowest free descriptor number, which grows if descriptors leak
+  int lowest_free_fd()
+  {
+    int fd = ::dup(0);
+    ::close(fd);
+    return fd;
+  }
+
+  bool is_open(int fd)
+  {
+    return ::fcntl(fd, F_GETFD) != -1;
+  }
+}
+
+TEST(FdPassingTest, passes_one_socket)
+{
+  auto ch = make_channel();
+  auto carried = make_channel();
+  EXPECT_EQ(4u, ch.a.send_fd(carried.a, "sock", 4));
+  char payload[8] = {};
+  std::size_t received = 0;
+  unix_socket got = ch.b.recv_fd<sockcp::unix_addr>(payload, sizeof(payload), &received);
+  EXPECT_EQ("sock", std::string(payload, received));
+  EXPECT_NE(got.fd(), carried.a.fd());
+  EXPECT_TRUE(::fcntl(got.fd(), F_GETFD) & FD_CLOEXEC);
+
+  got.write(std::string("via copy"));
+  EXPECT_EQ("via copy", std::string(carried.b.read(8).data(), 8));
+}
+
+TEST(FdPassingTest, passes_several_and_closes_extras)
+{
+  auto ch = make_channel();
+  int pipes[4][2];
+  int readers[4];
+  for (int i = 0; i < 4; ++i)
+  {
+    ASSERT_EQ(::pipe(pipes[i]), 0);
+    readers[i] = pipes[i][0];
+  }
+  ch.a.send_fds(readers, 4);
+
+  // Room for three: the fourth fits the control buffer's padding and is closed
+  int fds[3] = {-1, -1, -1};
+  std::size_t nfds = 3;
+  EXPECT_EQ(0u, ch.b.recv_fds(fds, nfds));
+  ASSERT_EQ(3u, nfds);
+  for (int i = 0; i < 3; ++i)
+  {
+    char c = static_cast<char>('0' + i);
+    ASSERT_EQ(1, ::write(pipes[i][1], &c, 1));
+    char r = 0;
+    ASSERT_EQ(1, ::read(fds[i], &r, 1));
+    EXPECT_EQ(c, r);
+    ::close(fds[i]);
+  }
+  for (auto &p : pipes)
+  {
+    ::close(p[0]);
+    ::close(p[1]);
+  }
+  EXPECT_THROW(ch.a.send_fds(readers, 0), std::length_error);
+  EXPECT_THROW(ch.a.send_fds(readers, unix_socket::max_passed_fds + 1), std::length_error);
+}
+
+TEST(FdPassingTest, truncated_descriptors_are_closed)
+{
+  auto ch = make_channel();
+  int pipe_fds[2];
+  ASSERT_EQ(::pipe(pipe_fds), 0);
+  int sent[3] = {pipe_fds[0], pipe_fds[0], pipe_fds[0]};
+  ch.a.send_fds(sent, 3);
+  int before = lowest_free_fd();
+
+  int fds[1] = {-1};
+  std::size_t nfds = 1;
+  EXPECT_THROW(ch.b.recv_fds(fds, nfds), std::length_error);
+  EXPECT_EQ(0u, nfds);
+  EXPECT_EQ(before, lowest_free_fd());
+  ::close(pipe_fds[0]);
+  ::close(pipe_fds[1]);
+}
+
+TEST(FdPassingTest, plain_data_carries_no_descriptor)
+{
+  auto ch = make_channel();
+  ch.a.write(std::string("x"));
+  int fd = -1;
+  std::size_t nfds = 1;
+  char c = 0;
+  EXPECT_EQ(1u, ch.b.recv_fds(&fd, nfds, &c, 1));
+  EXPECT_EQ(0u, nfds);
+  EXPECT_EQ('x', c);
+
+  ch.a.write(std::string("y"));
+  EXPECT_THROW(ch.b.recv_fd<sockcp::unix_addr>(), std::runtime_error);
+}
+
+TEST(FdPassingTest, adopt_checks_the_family)
+{
+  sockcp::socket tcp(sockcp::socktype::stream);
+  int fd = tcp.release();
+  EXPECT_THROW(unix_socket::adopt(fd), std::invalid_argument);
+  // Ownership passed: the descriptor is closed, not leaked
+  EXPECT_FALSE(is_open(fd));
+
+  auto ch = make_channel();
+  int raw = ch.a.release();
+  unix_socket again = unix_socket::adopt(raw);
+  EXPECT_EQ(raw, again.fd());
+  EXPECT_TRUE(again.blocking());
+}
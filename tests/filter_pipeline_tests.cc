@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+
+#include <cctype>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sockcp/filter_pipeline.h"
+#include "sockcp/memory_transport.h"
+
+namespace
+{
+  // Rewrites the payload in place
+  struct upper_stage
+  {
+    std::size_t operator()(char *data, std::size_t size)
+    {
+      for (std::size_t i = 0; i < size; ++i)
+      {
+        data[i] = static_cast<char>(std::toupper(static_cast<unsigned char>(data[i])));
+      }
+      ++calls;
+      return size;
+    }
+
+    int calls = 0;
+  };
+
+  // Drops a trailing newline
+  struct chomp_stage
+  {
+    std::size_t operator()(char *data, std::size_t size)
+    {
+      return size && data[size - 1] == '\n' ? size - 1 : size;
+    }
+  };
+
+  using pipeline = sockcp::filter_pipeline<sockcp::crc32c_framer, upper_stage, chomp_stage>;
+}
+
+TEST(Crc32cTest, known_values)
+{
+  ASSERT_EQ(sockcp::crc32c("123456789", 9), 0xe3069283u);
+  ASSERT_EQ(sockcp::crc32c_portable("123456789", 9), 0xe3069283u);
+  ASSERT_EQ(sockcp::crc32c("", 0), 0u);
+  std::string zeros(32, '\0');
+  ASSERT_EQ(sockcp::crc32c(zeros.data(), zeros.size()), 0x8a9136aau);
+  // Continuation over pieces equals one pass
+  ASSERT_EQ(sockcp::crc32c("56789", 5, sockcp::crc32c("1234", 4)), 0xe3069283u);
+}
+
+TEST(Crc32cTest, hardware_matches_portable)
+{
+  std::mt19937 rng(7);
+  std::vector<char> data(4096);
+  for (auto &c : data)
+  {
+    c = static_cast<char>(rng());
+  }
+  for (std::size_t offset = 0; offset < 8; ++offset)
+  {
+    for (std::size_t size : {0u, 1u, 3u, 7u, 8u, 9u, 63u, 1000u, 4000u})
+    {
+      ASSERT_EQ(sockcp::crc32c(data.data() + offset, size),
+                sockcp::crc32c_portable(data.data() + offset, size))
+          << offset << " " << size;
+    }
+  }
+}
+
+TEST(FilterPipelineTest, frames_split_at_every_byte)
+{
+  std::string stream = sockcp::crc32c_framer::encode("hello\n") + sockcp::crc32c_framer::encode("")
+                       + sockcp::crc32c_framer::encode("world");
+  for (std::size_t cut = 0; cut <= stream.size(); ++cut)
+  {
+    pipeline p;
+    std::vector<std::string> out;
+    auto collect = [&](char *data, std::size_t size)
+    { out.emplace_back(data, size); };
+    std::string buf = stream.substr(0, cut);
+    std::size_t consumed = p.process(&buf[0], buf.size(), collect);
+    buf = buf.substr(consumed) + stream.substr(cut);
+    ASSERT_EQ(p.process(&buf[0], buf.size(), collect), buf.size());
+    ASSERT_EQ(out, (std::vector<std::string>{"HELLO", "", "WORLD"})) << cut;
+    ASSERT_EQ(p.stage<0>().calls, 3);
+  }
+}
+
+TEST(FilterPipelineTest, rejects_corrupt_and_oversized_frames)
+{
+  std::string frame = sockcp::crc32c_framer::encode("payload");
+  frame[6] ^= 1;
+  pipeline p;
+  auto ignore = [](char *, std::size_t) {};
+  ASSERT_THROW(p.process(&frame[0], frame.size(), ignore), sockcp::protocol_error);
+
+  sockcp::filter_pipeline<sockcp::crc32c_framer> small(sockcp::crc32c_framer(4));
+  std::string big = sockcp::crc32c_framer::encode("too long");
+  // Refused from the header alone, before the payload arrives
+  ASSERT_THROW(small.process(&big[0], 4, ignore), sockcp::protocol_error);
+}
+
+TEST(FilterPipelineTest, reader_delivers_frames_from_socket)
+{
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", 4499));
+  listener.listen(1);
+  sockcp::socket client(sockcp::socktype::stream);
+  client.connect(sockcp::ipv4("127.0.0.1", 4499));
+  sockcp::socket server = listener.accept();
+
+  std::string stream;
+  for (int i = 0; i < 100; ++i)
+  {
+    stream += sockcp::crc32c_framer::encode("message " + std::to_string(i));
+  }
+  // Odd sized writes leave frames straddling reads
+  for (std::size_t off = 0; off < stream.size(); off += 37)
+  {
+    client.write(std::string_view(stream).substr(off, 37));
+  }
+
+  sockcp::basic_frame_reader<sockcp::ipv4, pipeline> reader(server, pipeline(sockcp::crc32c_framer(64)));
+  std::vector<std::string> out;
+  while (out.size() < 100)
+  {
+    reader.read([&](char *data, std::size_t size)
+                { out.emplace_back(data, size); });
+  }
+  ASSERT_EQ(out.front(), "MESSAGE 0");
+  ASSERT_EQ(out.back(), "MESSAGE 99");
+  ASSERT_EQ(reader.buffered(), 0u);
+  ASSERT_THROW((sockcp::basic_frame_reader<sockcp::ipv4, pipeline>(server, pipeline(), 16)), std::invalid_argument);
+}
+
+TEST(FilterPipelineTest, reader_runs_over_the_memory_transport)
+{
+  sockcp::memory_faults faults;
+  faults.max_write = 11;
+  sockcp::memory_network::instance().configure(faults);
+  auto socks = sockcp::memory_socket_pair();
+  std::string stream;
+  for (int i = 0; i < 20; ++i)
+  {
+    stream += sockcp::crc32c_framer::encode("frame " + std::to_string(i));
+  }
+  socks.first.write(stream);
+  sockcp::memory_network::instance().configure(sockcp::memory_faults());
+
+  sockcp::basic_frame_reader<sockcp::ipv4, pipeline, sockcp::memory_calls> reader(
+      socks.second, pipeline(sockcp::crc32c_framer(64)));
+  std::vector<std::string> out;
+  while (out.size() < 20)
+  {
+    reader.read([&](char *data, std::size_t size)
+                { out.emplace_back(data, size); });
+  }
+  ASSERT_EQ(out.front(), "FRAME 0");
+  ASSERT_EQ(out.back(), "FRAME 19");
+  ASSERT_EQ(reader.buffered(), 0u);
+}
+
+TEST(FilterPipelineTest, reader_drops_frames_handled_before_a_throw)
+{
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", 4498));
+  listener.listen(1);
+  sockcp::socket client(sockcp::socktype::stream);
+  client.connect(sockcp::ipv4("127.0.0.1", 4498));
+  sockcp::socket server = listener.accept();
+
+  client.write(sockcp::crc32c_framer::encode("one") + sockcp::crc32c_framer::encode("two")
+               + sockcp::crc32c_framer::encode("three"));
+  sockcp::basic_frame_reader<sockcp::ipv4, pipeline> reader(server, pipeline(sockcp::crc32c_framer(64)));
+  std::vector<std::string> out;
+  auto reject_two = [&](char *data, std::size_t size)
+  {
+    out.emplace_back(data, size);
+    if (out.back() == "TWO")
+    {
+      throw std::runtime_error("rejected");
+    }
+  };
+  while (out.size() < 2)
+  {
+    try
+    {
+      reader.read(reject_two);
+    }
+    catch (const std::runtime_error &)
+    {
+    }
+  }
+  // The frames up to the failing one are gone, the rest is still queued
+  ASSERT_EQ(out, (std::vector<std::string>{"ONE", "TWO"}));
+  ASSERT_EQ(reader.buffered(), sockcp::crc32c_framer::encode("three").size());
+
+  client.write(sockcp::crc32c_framer::encode("four"));
+  while (out.size() < 4)
+  {
+    reader.read(reject_two);
+  }
+  ASSERT_EQ(out, (std::vector<std::string>{"ONE", "TWO", "THREE", "FOUR"}));
+  // Each payload went through the in-place stage exactly once
+  ASSERT_EQ(reader.pipeline().stage<0>().calls, 4);
+}
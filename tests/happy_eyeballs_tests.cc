@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <chrono>
+#include <variant>
+#include <vector>
+
+#include "sockcp/happy_eyeballs.h"
+
+namespace
+{
+  using clock = std::chrono::steady_clock;
+
+  // Listener whose accept queue is kept full, so the kernel drops
+  // further SYNs the way an unreachable host ignores them
+  struct stalled_listener
+  {
+    sockcp::socket sock{sockcp::socktype::stream};
+    sockcp::socket queued{sockcp::socktype::stream};
+    sockcp::ipv4 addr;
+
+    stalled_listener()
+    {
+      sock.bind(sockcp::ipv4("127.0.0.1", 0));
+      socklen_t len = addr.size();
+      ::getsockname(sock.fd(), addr.data(), &len);
+      sock.listen(0);
+      queued.connect(addr);
+    }
+  };
+
+  // Address nothing listens on, connects to it are refused
+  sockcp::ipv4 closed_port()
+  {
+    sockcp::socket sock(sockcp::socktype::stream);
+    sock.bind(sockcp::ipv4("127.0.0.1", 0));
+    sockcp::ipv4 addr;
+    socklen_t len = addr.size();
+    ::getsockname(sock.fd(), addr.data(), &len);
+    return addr;
+  }
+
+  struct open_listener
+  {
+    sockcp::socket sock{sockcp::socktype::stream};
+    sockcp::ipv4 addr;
+
+    open_listener()
+    {
+      sock.bind(sockcp::ipv4("127.0.0.1", 0));
+      socklen_t len = addr.size();
+      ::getsockname(sock.fd(), addr.data(), &len);
+      sock.listen(16);
+    }
+  };
+}
+
+TEST(HappyEyeballsTest, interleaves_families)
+{
+  std::vector<sockcp::ipv6> v6{sockcp::ipv6("::1", 1), sockcp::ipv6("::1", 2)};
+  std::vector<sockcp::ipv4> v4{sockcp::ipv4("127.0.0.1", 3)};
+  auto order = sockcp::detail::interleave(v6, v4, true);
+  ASSERT_EQ(3u, order.size());
+  EXPECT_EQ(1, std::get<sockcp::ipv6>(order[0]).port());
+  EXPECT_EQ(3, std::get<sockcp::ipv4>(order[1]).port());
+  EXPECT_EQ(2, std::get<sockcp::ipv6>(order[2]).port());
+  order = sockcp::detail::interleave(v6, v4, false);
+  EXPECT_EQ(3, std::get<sockcp::ipv4>(order[0]).port());
+}
+
+TEST(HappyEyeballsTest, refused_candidate_falls_through_at_once)
+{
+  open_listener server;
+  sockcp::happy_eyeballs_options options;
+  options.attempt_delay = std::chrono::milliseconds(2000);
+  sockcp::ipv6 refused("::1", closed_port().port());
+  auto start = clock::now();
+  auto sock = sockcp::happy_eyeballs_connect({refused}, {server.addr}, options);
+  EXPECT_LT(clock::now() - start, std::chrono::milliseconds(1000));
+  ASSERT_EQ(0u, sock.index());
+  EXPECT_EQ(server.addr, std::get<sockcp::socket>(sock).name());
+  EXPECT_TRUE(std::get<sockcp::socket>(sock).blocking());
+}
+
+TEST(HappyEyeballsTest, races_past_a_silent_candidate)
+{
+  stalled_listener silent;
+  open_listener server;
+  sockcp::happy_eyeballs_options options;
+  options.attempt_delay = std::chrono::milliseconds(50);
+  options.prefer_ipv6 = false;
+  options.nonblocking = true;
+  auto start = clock::now();
+  auto sock = sockcp::happy_eyeballs_connect({}, {silent.addr, server.addr}, options);
+  auto elapsed = clock::now() - start;
+  EXPECT_GE(elapsed, std::chrono::milliseconds(50));
+  EXPECT_LT(elapsed, std::chrono::milliseconds(900));
+  EXPECT_EQ(server.addr, std::get<sockcp::socket>(sock).name());
+  EXPECT_FALSE(std::get<sockcp::socket>(sock).blocking());
+}
+
+TEST(HappyEyeballsTest, reports_failures)
+{
+  sockcp::happy_eyeballs_options options;
+  try
+  {
+    sockcp::happy_eyeballs_connect({}, {closed_port(), closed_port()}, options);
+    FAIL() << "connected to a closed port";
+  }
+  catch (const sockcp::socket_error &e)
+  {
+    EXPECT_EQ(ECONNREFUSED, e.code());
+  }
+
+  stalled_listener silent;
+  options.attempt_timeout = std::chrono::milliseconds(50);
+  options.timeout = std::chrono::milliseconds(100);
+  auto start = clock::now();
+  try
+  {
+    sockcp::happy_eyeballs_connect({}, {silent.addr}, options);
+    FAIL() << "connected to a full accept queue";
+  }
+  catch (const sockcp::socket_error &e)
+  {
+    EXPECT_EQ(ETIMEDOUT, e.code());
+  }
+  EXPECT_LT(clock::now() - start, std::chrono::milliseconds(500));
+  EXPECT_THROW(sockcp::happy_eyeballs_connect({}, {}), std::invalid_argument);
+}
@@ -161,3 +161,39 @@ TEST(IPv4Test, str_invalid_no_digits)
 {
   ASSERT_THROW(sockcp::ipv4("....:"), sockcp::protocol_error);
 }
+
+TEST(IPv4Test, literal)
+{
+  using namespace sockcp::literals;
+  constexpr sockcp::ipv4 ip = "192.168.11.253:4483"_ipv4;
+  ASSERT_EQ(ip.binary(), ::ntohl(test_pool[1].sin_addr.s_addr));
+  ASSERT_EQ(ip.addr.sin_port, test_pool[1].sin_port);
+  ASSERT_EQ("78.105.61.33"_ipv4.binary(), ::ntohl(test_pool[3].sin_addr.s_addr));
+}
+
+TEST(IPv4Test, from_string_invalid)
+{
+  ASSERT_THROW(sockcp::ipv4::from_string(""), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168.2.23:70000"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168..23:223"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168.23:22"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168.23.44:94y"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168.22.1:"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string(":1337"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv4::from_string("192.168.022.1"), sockcp::protocol_error);
+}
+
+TEST(IPv4Test, format_to)
+{
+  for (const auto &el : test_pool)
+  {
+    sockcp::ipv4 ip(el);
+    char buf[sockcp::ipv4::max_string_size];
+    std::string formatted(buf, ip.format_to(buf));
+
+    char expected[INET_ADDRSTRLEN];
+    ::inet_ntop(AF_INET, &el.sin_addr, expected, sizeof(expected));
+    ASSERT_EQ(formatted, std::string(expected) + ":" + std::to_string(::ntohs(el.sin_port)));
+    ASSERT_EQ(ip.to_string(), formatted);
+  }
+}
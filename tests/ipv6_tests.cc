@@ -0,0 +1,85 @@
+#include <gtest/gtest.h>
+#include <cstring>
+
+#include "sockcp/inet_address.h"
+
+static const char *valid_pool[] = {
+    "::",
+    "::1",
+    "fd00::1",
+    "fe80::",
+    "2001:db8::ff00:42:8329",
+    "2001:0db8:0000:0000:0000:ff00:0042:8329",
+    "1:0:0:2:0:0:0:3",
+    "1:2:3:4:5:6:7:8",
+    "::ffff:10.0.0.1",
+    "::10.0.0.1",
+    "64:ff9b::192.0.2.33",
+    "ABCD:EF01::",
+};
+
+static const char *invalid_pool[] = {
+    "",
+    ":",
+    ":::",
+    "1:2:3:4:5:6:7:8:9",
+    "1:2:3:4:5:6:7",
+    "1::2::3",
+    "1:2:3:4:5:6:7::8",
+    "12345::",
+    "1:",
+    ":1",
+    "g::1",
+    "::1.2.3",
+    "::1.2.3.4:5",
+    "1:2:3:4:5:6:7:1.2.3.4",
+};
+
+TEST(IPv6Test, from_string_matches_pton)
+{
+  for (const char *text : valid_pool)
+  {
+    ::in6_addr expected;
+    ASSERT_EQ(::inet_pton(AF_INET6, text, &expected), 1) << text;
+    sockcp::ipv6 ip = sockcp::ipv6::from_string(text);
+    ASSERT_EQ(std::memcmp(&ip.addr.sin6_addr, &expected, sizeof(expected)), 0) << text;
+  }
+}
+
+TEST(IPv6Test, from_string_invalid)
+{
+  for (const char *text : invalid_pool)
+  {
+    ::in6_addr expected;
+    ASSERT_NE(::inet_pton(AF_INET6, text, &expected), 1) << text;
+    ASSERT_THROW(sockcp::ipv6::from_string(text), sockcp::protocol_error) << text;
+  }
+  ASSERT_THROW(sockcp::ipv6::from_string("[::1"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv6::from_string("[::1]:"), sockcp::protocol_error);
+  ASSERT_THROW(sockcp::ipv6::from_string("[::1]:65536"), sockcp::protocol_error);
+}
+
+TEST(IPv6Test, format_to_matches_ntop)
+{
+  for (const char *text : valid_pool)
+  {
+    sockcp::ipv6 ip(text, 4483);
+    char buf[sockcp::ipv6::max_string_size];
+    std::string formatted(buf, ip.format_to(buf));
+
+    char expected[INET6_ADDRSTRLEN];
+    ::inet_ntop(AF_INET6, &ip.addr.sin6_addr, expected, sizeof(expected));
+    ASSERT_EQ(formatted, "[" + std::string(expected) + "]:4483");
+    ASSERT_EQ(ip.to_string(), formatted);
+  }
+}
+
+TEST(IPv6Test, literal)
+{
+  using namespace sockcp::literals;
+  constexpr sockcp::ipv6 ip = "[fd00::1]:4483"_ipv6;
+  ASSERT_EQ(ip.port(), 4483);
+  ASSERT_EQ(ip.address()[0], 0xfd);
+  ASSERT_EQ(ip.address()[15], 1);
+  ASSERT_EQ("fd00::1"_ipv6.port(), 0);
+}
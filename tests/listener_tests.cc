@@ -0,0 +1,152 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "sockcp/listener.h"
+
+namespace
+{
+  bool readable(sockcp::fd_type fd, int timeout_ms)
+  {
+    ::pollfd p{fd, POLLIN, 0};
+    return ::poll(&p, 1, timeout_ms) == 1;
+  }
+
+  std::vector<sockcp::socket> connect_clients(const sockcp::ipv4 &addr, std::size_t count)
+  {
+    std::vector<sockcp::socket> clients;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+      clients.emplace_back(sockcp::socktype::stream);
+      clients.back().connect(addr);
+    }
+    return clients;
+  }
+
+  // Lowers the descriptor limit to the lowest free descriptor, so the next
+  // one allocated fails with EMFILE, and restores it afterwards
+  struct descriptor_limit
+  {
+    descriptor_limit()
+    {
+      ::getrlimit(RLIMIT_NOFILE, &saved);
+      int lowest = ::dup(0);
+      ::close(lowest);
+      ::rlimit lowered = saved;
+      lowered.rlim_cur = static_cast<rlim_t>(lowest);
+      ::setrlimit(RLIMIT_NOFILE, &lowered);
+    }
+
+    ~descriptor_limit()
+    {
+      ::setrlimit(RLIMIT_NOFILE, &saved);
+    }
+
+    ::rlimit saved{};
+  };
+}
+
+TEST(ListenerTest, accepts_in_batches)
+{
+  sockcp::listener_options options;
+  options.accept_batch = 2;
+  sockcp::listener listener(sockcp::ipv4("127.0.0.1", 0), options);
+  ASSERT_NE(0, listener.address().port());
+  auto clients = connect_clients(listener.address(), 3);
+  ASSERT_TRUE(readable(listener.fd(), 1000));
+
+  std::vector<sockcp::socket> accepted;
+  auto keep = [&](sockcp::socket &&sock)
+  { accepted.push_back(std::move(sock)); };
+  EXPECT_EQ(2u, listener.accept_all(keep));
+  EXPECT_EQ(1u, listener.accept_all(keep));
+  EXPECT_EQ(0u, listener.accept_all(keep));
+  ASSERT_EQ(3u, accepted.size());
+  for (auto &sock : accepted)
+  {
+    EXPECT_TRUE(::fcntl(sock.fd(), F_GETFL) & O_NONBLOCK);
+    EXPECT_NE(0, sock.name().port());
+  }
+}
+
+TEST(ListenerTest, reports_descriptor_exhaustion_without_throwing_from_the_loop)
+{
+  sockcp::listener listener(sockcp::ipv4("127.0.0.1", 0));
+  sockcp::event_loop loop;
+  int accepted = 0;
+  std::vector<int> errors;
+  listener.attach(
+      loop, [&](sockcp::socket &&)
+      { ++accepted; },
+      [&](const sockcp::socket_error &e)
+      { errors.push_back(e.code()); });
+  // Runs the posted attachment
+  loop.run_once(std::chrono::milliseconds(0));
+  auto clients = connect_clients(listener.address(), 1);
+  ASSERT_TRUE(readable(listener.fd(), 1000));
+  {
+    descriptor_limit limit;
+    EXPECT_THROW(listener.accept_all([](sockcp::socket &&) {}), sockcp::socket_error);
+    EXPECT_NO_THROW(loop.run_once(std::chrono::milliseconds(100)));
+  }
+  ASSERT_FALSE(errors.empty());
+  EXPECT_EQ(EMFILE, errors.front());
+  EXPECT_EQ(0, accepted);
+
+  // The connection is still queued once descriptors are available again
+  for (int i = 0; i < 10 && !accepted; ++i)
+  {
+    loop.run_once(std::chrono::milliseconds(100));
+  }
+  EXPECT_EQ(1, accepted);
+}
+
+#if defined(__linux__)
+TEST(ListenerTest, defers_accept_until_data)
+{
+  sockcp::listener_options options;
+  options.defer_accept = std::chrono::seconds(5);
+  options.fastopen_queue = 16;
+  sockcp::listener listener(sockcp::ipv4("127.0.0.1", 0), options);
+  EXPECT_GE(listener.socket().get_option<int>(IPPROTO_TCP, TCP_DEFER_ACCEPT), 5);
+  EXPECT_EQ(16, listener.socket().get_option<int>(IPPROTO_TCP, TCP_FASTOPEN));
+
+  auto clients = connect_clients(listener.address(), 1);
+  EXPECT_FALSE(readable(listener.fd(), 100));
+  clients[0].write(std::string("GET"));
+  ASSERT_TRUE(readable(listener.fd(), 1000));
+  std::size_t bytes = 0;
+  EXPECT_EQ(1u, listener.accept_all([&](sockcp::socket &&sock)
+                                    { bytes = sock.read().size(); }));
+  EXPECT_EQ(3u, bytes);
+}
+#endif
+
+TEST(ListenerGroupTest, members_share_the_address)
+{
+  sockcp::listener_group group(sockcp::ipv4("127.0.0.1", 0), 2);
+  ASSERT_EQ(2u, group.size());
+  EXPECT_EQ(group[0].address(), group[1].address());
+
+  sockcp::event_loop first, second;
+  std::vector<int> per_loop(2, 0);
+  first.attach(group[0].socket(), sockcp::event::in, [&](sockcp::event)
+               { per_loop[0] += static_cast<int>(group[0].accept_all([](sockcp::socket &&) {})); });
+  group[1].attach(second, [&](sockcp::socket &&)
+                  { ++per_loop[1]; });
+  EXPECT_THROW(group.attach({&first}, [](sockcp::socket &&) {}), std::invalid_argument);
+
+  auto clients = connect_clients(group.address(), 32);
+  for (int i = 0; i < 100 && per_loop[0] + per_loop[1] < 32; ++i)
+  {
+    first.run_once(std::chrono::milliseconds(10));
+    second.run_once(std::chrono::milliseconds(10));
+  }
+  EXPECT_EQ(32, per_loop[0] + per_loop[1]);
+}
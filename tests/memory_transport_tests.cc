@@ -0,0 +1,207 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "sockcp/memory_transport.h"
+
+namespace
+{
+  // Installs faults for one test and restores the defaults afterwards
+  struct scoped_faults
+  {
+    explicit scoped_faults(const sockcp::memory_faults &faults)
+    {
+      sockcp::memory_network::instance().configure(faults);
+      sockcp::memory_network::instance().reset_stats();
+    }
+
+    ~scoped_faults()
+    {
+      sockcp::memory_network::instance().configure(sockcp::memory_faults());
+    }
+  };
+
+  std::string read_exactly(sockcp::memory_socket &sock, std::size_t count)
+  {
+    std::string out(count, '\0');
+    for (std::size_t got = 0; got < count;)
+    {
+      got += sock.read(&out[got], count - got);
+    }
+    return out;
+  }
+}
+
+TEST(MemoryTransportTest, connect_and_accept)
+{
+  sockcp::memory_socket listener(sockcp::socktype::stream);
+  listener.bind(sockcp::ipv4("127.0.0.1", 5000));
+  listener.listen();
+  sockcp::memory_socket client(sockcp::socktype::stream);
+  client.bind(sockcp::ipv4("127.0.0.1", 0));
+  client.connect(sockcp::ipv4("127.0.0.1", 5000));
+  auto server = listener.accept();
+  ASSERT_NE(sockcp::fd_invalid, server.fd());
+  EXPECT_GE(server.fd(), sockcp::memory_network::first_fd);
+  EXPECT_NE(0, server.name().port());
+  EXPECT_EQ(SOCK_STREAM, server.get_option<int>(SOL_SOCKET, SO_TYPE));
+
+  client.write(std::string("ping"));
+  EXPECT_EQ("ping", read_exactly(server, 4));
+  server.write(std::string("pong"));
+  EXPECT_EQ("pong", read_exactly(client, 4));
+
+  sockcp::memory_socket refused(sockcp::socktype::stream);
+  EXPECT_THROW(refused.connect(sockcp::ipv4("127.0.0.1", 5001)), sockcp::socket_error);
+}
+
+TEST(MemoryTransportTest, short_reads_and_writes)
+{
+  sockcp::memory_faults faults;
+  faults.max_read = 3;
+  faults.max_write = 5;
+  scoped_faults scope(faults);
+  auto socks = sockcp::memory_socket_pair();
+
+  // write() keeps going after each short send
+  std::string message = "the quick brown fox jumps over the lazy dog";
+  socks.first.write(message);
+  char buf[64];
+  EXPECT_EQ(3u, socks.second.read(buf, sizeof(buf)));
+  EXPECT_EQ(message.substr(3), read_exactly(socks.second, message.size() - 3));
+
+  auto stats = sockcp::memory_network::instance().stats();
+  EXPECT_EQ(message.size(), stats.bytes);
+  EXPECT_EQ((message.size() + 4)/5, stats.send_calls);
+  EXPECT_GT(stats.short_reads, 0u);
+  EXPECT_GT(stats.short_writes, 0u);
+}
+
+TEST(MemoryTransportTest, random_sizes_repeat_with_seed)
+{
+  auto run = []
+  {
+    sockcp::memory_faults faults;
+    faults.max_read = 7;
+    faults.random_sizes = true;
+    faults.seed = 42;
+    scoped_faults scope(faults);
+    auto socks = sockcp::memory_socket_pair();
+    socks.first.write(std::string(100, 'x'));
+    std::string sizes;
+    char buf[100];
+    for (std::size_t got = 0; got < 100;)
+    {
+      std::size_t n = socks.second.read(buf, sizeof(buf));
+      EXPECT_GE(n, 1u);
+      EXPECT_LE(n, 7u);
+      sizes += std::to_string(n) + ",";
+      got += n;
+    }
+    return sizes;
+  };
+  EXPECT_EQ(run(), run());
+}
+
+TEST(MemoryTransportTest, injected_eagain)
+{
+  sockcp::memory_faults faults;
+  faults.eagain_every = 2;
+  scoped_faults scope(faults);
+  auto socks = sockcp::memory_socket_pair();
+  socks.first.set_block(false);
+  socks.second.set_block(false);
+  sockcp::fd_type writer = socks.first.fd();
+  sockcp::fd_type reader = socks.second.fd();
+
+  EXPECT_EQ(2, sockcp::memory_calls::send(writer, "ab", 2, 0));
+  EXPECT_EQ(-1, sockcp::memory_calls::send(writer, "cd", 2, 0));
+  EXPECT_EQ(EAGAIN, errno);
+  char buf[4];
+  EXPECT_EQ(2, sockcp::memory_calls::recv(reader, buf, sizeof(buf), 0));
+  EXPECT_EQ(-1, sockcp::memory_calls::recv(reader, buf, sizeof(buf), 0));
+  EXPECT_EQ(EAGAIN, errno);
+  // Empty queue, not injected
+  EXPECT_EQ(-1, sockcp::memory_calls::recv(reader, buf, sizeof(buf), 0));
+  EXPECT_EQ(EAGAIN, errno);
+  EXPECT_EQ(2u, sockcp::memory_network::instance().stats().eagains);
+}
+
+TEST(MemoryTransportTest, full_queue_blocks_writer)
+{
+  sockcp::memory_faults faults;
+  faults.buffer_size = 8;
+  scoped_faults scope(faults);
+  auto socks = sockcp::memory_socket_pair();
+  socks.first.set_block(false);
+  EXPECT_EQ(8, sockcp::memory_calls::send(socks.first.fd(), "0123456789", 10, 0));
+  EXPECT_EQ(sockcp::event::no_event, sockcp::poll(socks.first, std::chrono::milliseconds(0), sockcp::event::out));
+  EXPECT_EQ("0123", read_exactly(socks.second, 4));
+  EXPECT_EQ(sockcp::event::out, sockcp::poll(socks.first, std::chrono::milliseconds(0), sockcp::event::out));
+}
+
+TEST(MemoryTransportTest, blocked_recv_fails_when_its_fd_is_reused)
+{
+  auto first = sockcp::memory_socket_pair();
+  sockcp::fd_type fd = first.first.release();
+  std::ptrdiff_t result = 0;
+  int error = 0;
+  std::thread reader([&]
+                     {
+    char c;
+    result = sockcp::memory_calls::recv(fd, &c, 1, 0);
+    error = errno; });
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  // Close the blocked socket and hand its number to a new one with data
+  sockcp::memory_calls::close(fd);
+  auto second = sockcp::memory_socket_pair();
+  ASSERT_EQ(fd, second.first.fd());
+  second.second.write("x", 1);
+  reader.join();
+  EXPECT_EQ(-1, result);
+  EXPECT_EQ(EBADF, error);
+  // The byte stays with the new socket
+  EXPECT_EQ("x", read_exactly(second.first, 1));
+}
+
+TEST(MemoryTransportTest, observer_and_end_of_stream)
+{
+  auto socks = sockcp::memory_socket_pair();
+  sockcp::memory_observer observer;
+  observer.attach_socket(socks.second, sockcp::event::in);
+  EXPECT_TRUE(observer.poll(std::chrono::milliseconds(0)).empty());
+
+  socks.first.write(std::string("x"));
+  auto events = observer.poll(std::chrono::milliseconds(0));
+  ASSERT_EQ(1u, events.count(socks.second.fd()));
+  EXPECT_EQ(sockcp::event::in, events[socks.second.fd()]);
+  EXPECT_EQ("x", read_exactly(socks.second, 1));
+
+  socks.first.close();
+  events = observer.poll(std::chrono::milliseconds(0));
+  EXPECT_EQ(sockcp::event::in | sockcp::event::hup, events[socks.second.fd()]);
+  char c;
+  EXPECT_THROW(socks.second.read(&c, 1), disconnect_error);
+  EXPECT_THROW(sockcp::memory_observer(sockcp::trigger::edge), std::invalid_argument);
+}
+
+TEST(MemoryTransportTest, socket_buffer_over_short_reads)
+{
+  sockcp::memory_faults faults;
+  faults.max_read = 5;
+  faults.random_sizes = true;
+  scoped_faults scope(faults);
+  auto socks = sockcp::memory_socket_pair();
+  socks.first.write(std::string("first line\nsecond line\n"));
+  // The buffer refills after every line; nonblocking lets it stop at the end
+  socks.second.set_block(false);
+  sockcp::memory_socket_buffer buffer(std::move(socks.second), 16);
+  auto line = buffer.read_until('\n');
+  EXPECT_EQ("first line\n", std::string(line.begin(), line.end()));
+  line = buffer.read_until('\n');
+  EXPECT_EQ("second line\n", std::string(line.begin(), line.end()));
+}
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+
+#include <set>
+#include <string>
+
+#include <net/if.h>
+
+#include "sockcp/multicast.h"
+
+namespace
+{
+  unsigned loopback_index()
+  {
+    return ::if_nametoindex("lo");
+  }
+
+  sockcp::socket group_sender()
+  {
+    sockcp::socket tx(sockcp::socktype::datagram);
+    sockcp::set_multicast_interface(tx, loopback_index());
+    sockcp::set_multicast_loop(tx, true);
+    sockcp::set_multicast_ttl(tx, 0);
+    return tx;
+  }
+
+  void send_to(sockcp::socket &tx, const char *group, uint16_t port, const std::string &data)
+  {
+    sockcp::ipv4 to(group, port);
+    ASSERT_EQ(::sendto(tx.fd(), data.data(), data.size(), 0, to.data(), to.size()),
+              static_cast<ssize_t>(data.size()));
+  }
+}
+
+TEST(MulticastTest, batch_tags_datagrams_with_group)
+{
+  constexpr uint16_t port = 4495;
+  sockcp::socket rx(sockcp::socktype::datagram);
+  rx.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  rx.bind(sockcp::ipv4("0.0.0.0", port));
+  rx.set_block(false);
+  sockcp::datagram_batch::enable_pktinfo(rx);
+  sockcp::join_group(rx, sockcp::ipv4("239.1.2.3"), loopback_index());
+  sockcp::join_group(rx, sockcp::ipv4("239.1.2.4"), loopback_index());
+
+  sockcp::socket tx = group_sender();
+  send_to(tx, "239.1.2.3", port, "first");
+  send_to(tx, "239.1.2.4", port, "second");
+  send_to(tx, "239.1.2.5", port, "not joined");
+  send_to(tx, "239.1.2.3", port, "third");
+
+  sockcp::datagram_batch batch(8);
+  ASSERT_EQ(batch.receive(rx), 3u);
+  std::set<std::string> seen;
+  for (const auto &d : batch)
+  {
+    std::string payload(d.data, d.size);
+    seen.insert(payload);
+    ASSERT_EQ(d.destination.to_string(), payload == "second" ? "239.1.2.4:0" : "239.1.2.3:0");
+    ASSERT_EQ(d.interface, loopback_index());
+    ASSERT_FALSE(d.truncated);
+  }
+  ASSERT_EQ(seen, (std::set<std::string>{"first", "second", "third"}));
+  ASSERT_EQ(batch.receive(rx), 0u);
+
+  sockcp::leave_group(rx, sockcp::ipv4("239.1.2.4"), loopback_index());
+  send_to(tx, "239.1.2.4", port, "after leave");
+  send_to(tx, "239.1.2.3", port, "still joined");
+  ASSERT_EQ(batch.receive(rx), 1u);
+  ASSERT_EQ(std::string(batch[0].data, batch[0].size), "still joined");
+}
+
+TEST(MulticastTest, source_specific_membership)
+{
+  constexpr uint16_t port = 4496;
+  sockcp::socket rx(sockcp::socktype::datagram);
+  rx.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  rx.bind(sockcp::ipv4("0.0.0.0", port));
+  rx.set_block(false);
+  sockcp::join_source_group(rx, sockcp::ipv4("232.1.1.1"), sockcp::ipv4("127.0.0.1"), loopback_index());
+
+  sockcp::socket tx = group_sender();
+  tx.bind(sockcp::ipv4("127.0.0.1", 0));
+  send_to(tx, "232.1.1.1", port, "from source");
+
+  sockcp::datagram_batch batch(4, 16);
+  ASSERT_EQ(batch.receive(rx), 1u);
+  ASSERT_EQ(std::string(batch[0].data, batch[0].size), "from source");
+  ASSERT_EQ(batch[0].source.to_string().substr(0, 10), "127.0.0.1:");
+
+  sockcp::leave_source_group(rx, sockcp::ipv4("232.1.1.1"), sockcp::ipv4("127.0.0.1"), loopback_index());
+  send_to(tx, "232.1.1.1", port, "gone");
+  ASSERT_EQ(batch.receive(rx), 0u);
+}
+
+TEST(MulticastTest, truncation_is_reported)
+{
+  constexpr uint16_t port = 4497;
+  sockcp::socket rx(sockcp::socktype::datagram);
+  rx.bind(sockcp::ipv4("127.0.0.1", port));
+  rx.set_block(false);
+  sockcp::socket tx(sockcp::socktype::datagram);
+  send_to(tx, "127.0.0.1", port, std::string(100, 'z'));
+  sockcp::datagram_batch batch(2, 10);
+  ASSERT_EQ(batch.receive(rx), 1u);
+  ASSERT_TRUE(batch[0].truncated);
+  ASSERT_EQ(batch[0].size, 10u);
+}
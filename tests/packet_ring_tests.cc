@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+#include <net/if.h>
+#include <netinet/ip.h>
+#include <netinet/udp.h>
+
+#include "sockcp/packet_ring.h"
+
+using namespace std::chrono_literals;
+
+namespace
+{
+  std::unique_ptr<sockcp::packet_ring> open_ring(sockcp::packet_ring_config config = {})
+  {
+    try
+    {
+      return std::make_unique<sockcp::packet_ring>(::if_nametoindex("lo"), config);
+    }
+    catch (const sockcp::socket_error &e)
+    {
+      if (e.code() == EPERM || e.code() == EACCES)
+      {
+        return nullptr;
+      }
+      throw;
+    }
+  }
+
+  sockcp::packet_ring_config small_ring()
+  {
+    sockcp::packet_ring_config config;
+    config.block_size = 1 << 16;
+    config.block_count = 8;
+    config.retire_timeout = 1ms;
+    return config;
+  }
+
+  void send_udp(uint16_t port, const std::string &payload, uint16_t source_port = 0)
+  {
+    sockcp::socket tx(sockcp::socktype::datagram);
+    if (source_port)
+    {
+      tx.bind(sockcp::ipv4("127.0.0.1", source_port));
+    }
+    sockcp::ipv4 to("127.0.0.1", port);
+    ASSERT_EQ(::sendto(tx.fd(), payload.data(), payload.size(), 0, to.data(), to.size()),
+              static_cast<ssize_t>(payload.size()));
+  }
+
+  // UDP payload of an Ethernet/IPv4 frame
+  std::string payload_of(const sockcp::packet_view &p)
+  {
+    std::size_t ip = 14;
+    std::size_t udp = ip + (static_cast<unsigned char>(p.data[ip]) & 0xf) * 4;
+    return std::string(p.data + udp + 8, p.size - udp - 8);
+  }
+}
+
+TEST(PacketRingTest, captures_filtered_loopback_traffic)
+{
+  auto ring = open_ring(small_ring());
+  if (!ring)
+  {
+    GTEST_SKIP() << "needs CAP_NET_RAW";
+  }
+  ring->attach_filter(sockcp::udp_port_filter(4500));
+  // Whatever slipped in before the filter is drained first
+  ring->read([](const sockcp::packet_view &) {});
+
+  auto before = std::chrono::system_clock::now().time_since_epoch();
+  send_udp(4501, "other port");
+  for (int i = 0; i < 5; ++i)
+  {
+    send_udp(4500, "probe " + std::to_string(i));
+  }
+
+  std::vector<std::string> seen;
+  for (int i = 0; i < 100 && seen.size() < 5; ++i)
+  {
+    ring->wait(20ms);
+    ring->read([&](const sockcp::packet_view &p)
+               {
+                 // lo shows each packet leaving and arriving
+                 if (p.direction != PACKET_HOST)
+                 {
+                   return;
+                 }
+                 ASSERT_EQ(p.protocol, ETH_P_IP);
+                 ASSERT_EQ(p.interface, ::if_nametoindex("lo"));
+                 ASSERT_EQ(p.size, p.wire_size);
+                 ASSERT_GE(p.timestamp, before);
+                 seen.push_back(payload_of(p)); });
+  }
+  ASSERT_EQ(seen.size(), 5u);
+  ASSERT_EQ(seen.front(), "probe 0");
+  ASSERT_EQ(seen.back(), "probe 4");
+  ASSERT_GE(ring->stats().packets, 10u);
+  ASSERT_EQ(ring->stats().drops, 0u);
+}
+
+TEST(PacketRingTest, fanout_splits_traffic)
+{
+  auto a = open_ring(small_ring());
+  auto b = open_ring(small_ring());
+  if (!a || !b)
+  {
+    GTEST_SKIP() << "needs CAP_NET_RAW";
+  }
+  for (auto *ring : {a.get(), b.get()})
+  {
+    ring->attach_filter(sockcp::udp_port_filter(4502));
+    ring->read([](const sockcp::packet_view &) {});
+    ring->join_fanout(static_cast<uint16_t>(::getpid() & 0xffff), sockcp::fanout::load_balance);
+  }
+
+  constexpr int packets = 20;
+  for (int i = 0; i < packets; ++i)
+  {
+    send_udp(4502, "x");
+  }
+  std::size_t counts[2] = {0, 0};
+  for (int i = 0; i < 100 && counts[0] + counts[1] < 2 * packets; ++i)
+  {
+    a->wait(10ms);
+    counts[0] += a->read([](const sockcp::packet_view &) {});
+    counts[1] += b->read([](const sockcp::packet_view &) {});
+  }
+  // Outgoing and incoming copy of each, every one delivered to one ring
+  ASSERT_EQ(counts[0] + counts[1], 2u * packets);
+  ASSERT_GT(counts[0], 0u);
+  ASSERT_GT(counts[1], 0u);
+}
+
+TEST(PacketRingTest, failed_bind_unmaps_the_ring)
+{
+  auto mapped_kib = []
+  {
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    std::size_t kib = 0;
+    while (status >> key && key != "VmSize:")
+    {
+      status.ignore(256, '\n');
+    }
+    status >> kib;
+    return kib;
+  };
+  sockcp::packet_ring_config config = small_ring();
+  config.block_count = 256;  // 16 MiB a ring
+  std::size_t before = mapped_kib();
+  for (int i = 0; i < 4; ++i)
+  {
+    try
+    {
+      sockcp::packet_ring ring(0x7fffffff, config);
+      FAIL() << "bound to a missing interface";
+    }
+    catch (const sockcp::socket_error &e)
+    {
+      if (e.code() == EPERM || e.code() == EACCES)
+      {
+        GTEST_SKIP() << "needs CAP_NET_RAW";
+      }
+      ASSERT_EQ(e.code(), ENODEV);
+    }
+  }
+  ASSERT_LT(mapped_kib(), before + 16 * 1024);
+}
+
+TEST(PacketRingTest, rejects_bad_geometry)
+{
+  sockcp::packet_ring_config config;
+  config.block_size = 1000;
+  try
+  {
+    sockcp::packet_ring ring(0, config);
+    FAIL() << "accepted a block size that is not a page multiple";
+  }
+  catch (const std::invalid_argument &)
+  {
+  }
+  catch (const sockcp::socket_error &)
+  {
+    // Opening the socket needs CAP_NET_RAW
+  }
+}
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sockcp/memory_transport.h"
+#include "sockcp/pipelined_client.h"
+
+namespace
+{
+  using tagged_client = sockcp::basic_pipelined_client<sockcp::ipv4, sockcp::tagged_frame_codec, sockcp::memory_calls>;
+  using ordered_client = sockcp::basic_pipelined_client<sockcp::ipv4, sockcp::length_prefix_codec, sockcp::memory_calls>;
+
+  struct request
+  {
+    uint32_t id;
+    std::string payload;
+  };
+
+  // Reads count requests as the server sees them
+  template <typename Codec>
+  std::vector<request> read_requests(sockcp::memory_socket &sock, std::size_t count)
+  {
+    std::vector<request> out;
+    std::string buf;
+    char chunk[256];
+    while (out.size() < count)
+    {
+      buf.append(chunk, sock.read(chunk, sizeof(chunk)));
+      std::size_t pos = 0;
+      for (;;)
+      {
+        request req{};
+        const char *payload = nullptr;
+        std::size_t size = 0;
+        std::size_t n = Codec::decode(buf.data() + pos, buf.size() - pos, 1024, req.id, payload, size);
+        if (!n)
+        {
+          break;
+        }
+        req.payload.assign(payload, size);
+        out.push_back(std::move(req));
+        pos += n;
+      }
+      buf.erase(0, pos);
+    }
+    return out;
+  }
+
+  template <typename Codec>
+  std::string encode(uint32_t id, const std::string &payload)
+  {
+    std::string out(Codec::overhead + payload.size(), '\0');
+    Codec::encode(id, payload.data(), payload.size(), &out[0]);
+    return out;
+  }
+
+  struct completions
+  {
+    std::vector<std::pair<uint64_t, std::string>> seen;
+
+    tagged_client::completion handler()
+    {
+      return [this](uint64_t tag, const char *data, std::size_t size) { seen.emplace_back(tag, std::string(data, size)); };
+    }
+  };
+}
+
+TEST(PipelinedClientTest, batches_and_matches_out_of_order)
+{
+  sockcp::memory_network::instance().reset_stats();
+  auto socks = sockcp::memory_socket_pair();
+  completions done;
+  tagged_client client(socks.first, done.handler());
+
+  EXPECT_TRUE(client.request("alpha", 10));
+  EXPECT_TRUE(client.request("beta", 20));
+  EXPECT_TRUE(client.request("gamma", 30));
+  EXPECT_EQ(3u, client.in_flight());
+  EXPECT_EQ(sockcp::event::in | sockcp::event::out, client.interest());
+  EXPECT_TRUE(client.flush());
+  EXPECT_EQ(1u, client.stats().writes);
+  EXPECT_EQ(1u, sockcp::memory_network::instance().stats().send_calls);
+
+  auto requests = read_requests<sockcp::tagged_frame_codec>(socks.second, 3);
+  ASSERT_EQ(3u, requests.size());
+  EXPECT_EQ("alpha", requests[0].payload);
+  EXPECT_EQ("gamma", requests[2].payload);
+
+  // Answered newest first, in one write
+  std::string reply;
+  for (auto it = requests.rbegin(); it != requests.rend(); ++it)
+  {
+    reply += encode<sockcp::tagged_frame_codec>(it->id, it->payload + "!");
+  }
+  socks.second.write(reply);
+  while (client.in_flight())
+  {
+    client.receive();
+  }
+  ASSERT_EQ(3u, done.seen.size());
+  EXPECT_EQ(std::make_pair(uint64_t(30), std::string("gamma!")), done.seen[0]);
+  EXPECT_EQ(std::make_pair(uint64_t(20), std::string("beta!")), done.seen[1]);
+  EXPECT_EQ(std::make_pair(uint64_t(10), std::string("alpha!")), done.seen[2]);
+  EXPECT_EQ(sockcp::event::no_event, client.interest());
+
+  // A response nobody asked for, or a repeated one, is rejected
+  socks.second.write(encode<sockcp::tagged_frame_codec>(requests[0].id, "late"));
+  EXPECT_THROW(client.receive(), sockcp::protocol_error);
+}
+
+TEST(PipelinedClientTest, ordered_matching_and_partial_responses)
+{
+  auto socks = sockcp::memory_socket_pair();
+  completions done;
+  ordered_client client(socks.first, done.handler());
+  for (uint64_t tag = 1; tag <= 3; ++tag)
+  {
+    ASSERT_TRUE(client.request(std::to_string(tag), tag));
+  }
+  ASSERT_TRUE(client.flush());
+  auto requests = read_requests<sockcp::length_prefix_codec>(socks.second, 3);
+  ASSERT_EQ(3u, requests.size());
+
+  std::string reply;
+  for (auto &req : requests)
+  {
+    reply += encode<sockcp::length_prefix_codec>(0, "re" + req.payload);
+  }
+  // The first response split across writes completes only once whole
+  socks.second.write(reply.substr(0, 5));
+  EXPECT_EQ(0u, client.receive());
+  socks.second.write(reply.substr(5));
+  while (client.in_flight())
+  {
+    client.receive();
+  }
+  ASSERT_EQ(3u, done.seen.size());
+  for (uint64_t tag = 1; tag <= 3; ++tag)
+  {
+    EXPECT_EQ(tag, done.seen[tag - 1].first);
+    EXPECT_EQ("re" + std::to_string(tag), done.seen[tag - 1].second);
+  }
+
+  socks.second.write(encode<sockcp::length_prefix_codec>(0, "extra"));
+  EXPECT_THROW(client.receive(), sockcp::protocol_error);
+}
+
+TEST(PipelinedClientTest, limits_requests_in_flight)
+{
+  auto socks = sockcp::memory_socket_pair();
+  completions done;
+  sockcp::pipelined_client_config config;
+  config.max_in_flight = 2;
+  config.batch_bytes = 16;
+  tagged_client client(socks.first, done.handler(), config);
+
+  EXPECT_TRUE(client.request("one", 1));
+  EXPECT_EQ(11u, client.queued());
+  // Crossing batch_bytes sends without an explicit flush()
+  EXPECT_TRUE(client.request("two", 2));
+  EXPECT_EQ(0u, client.queued());
+  EXPECT_FALSE(client.request("three", 3));
+  EXPECT_EQ(2u, client.in_flight());
+
+  auto requests = read_requests<sockcp::tagged_frame_codec>(socks.second, 2);
+  socks.second.write(encode<sockcp::tagged_frame_codec>(requests[1].id, "two"));
+  EXPECT_EQ(1u, client.receive());
+  ASSERT_EQ(1u, done.seen.size());
+  EXPECT_EQ(2u, done.seen[0].first);
+  EXPECT_TRUE(client.request("three", 3));
+  ASSERT_TRUE(client.flush());
+
+  // The freed slot is reused under a new id
+  auto third = read_requests<sockcp::tagged_frame_codec>(socks.second, 1);
+  EXPECT_EQ("three", third[0].payload);
+  EXPECT_NE(requests[1].id, third[0].id);
+
+  socks.second.close();
+  EXPECT_THROW(client.receive(), disconnect_error);
+}
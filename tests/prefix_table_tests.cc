@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+#include "sockcp/prefix_table.h"
+
+namespace
+{
+  struct rule
+  {
+    uint32_t prefix;
+    unsigned length;
+    int value;
+  };
+
+  uint32_t mask(unsigned length)
+  {
+    return length ? ~uint32_t(0) << (32 - length) : 0;
+  }
+
+  // Linear scan over every rule, later rules winning ties like the builder
+  const int *reference(const std::vector<rule> &rules, uint32_t addr)
+  {
+    const rule *best = nullptr;
+    for (const auto &r : rules)
+    {
+      if (((addr ^ r.prefix) & mask(r.length)) == 0 && (!best || r.length >= best->length))
+      {
+        best = &r;
+      }
+    }
+    return best ? &best->value : nullptr;
+  }
+}
+
+TEST(PrefixTableTest, cidr_strings)
+{
+  auto table = sockcp::prefix_table<sockcp::ipv4, int>::builder()
+                   .add("10.0.0.0/8", 1)
+                   .add("10.1.0.0/16", 2)
+                   .add("10.1.2.0/24", 3)
+                   .add("10.1.2.3", 4)
+                   .add("192.168.0.0/17", 5)
+                   .build();
+  ASSERT_EQ(*table->match(sockcp::ipv4("10.200.0.1")), 1);
+  ASSERT_EQ(*table->match(sockcp::ipv4("10.1.9.9")), 2);
+  ASSERT_EQ(*table->match(sockcp::ipv4("10.1.2.4")), 3);
+  ASSERT_EQ(*table->match(sockcp::ipv4("10.1.2.3", 4483)), 4);
+  ASSERT_EQ(*table->match(sockcp::ipv4("192.168.127.1")), 5);
+  ASSERT_EQ(table->match(sockcp::ipv4("192.168.128.1")), nullptr);
+  ASSERT_EQ(table->match(sockcp::ipv4("11.0.0.1")), nullptr);
+}
+
+TEST(PrefixTableTest, default_route)
+{
+  auto table = sockcp::prefix_table<sockcp::ipv4, int>::builder()
+                   .add("0.0.0.0/0", 7)
+                   .add("127.0.0.0/8", 8)
+                   .build();
+  ASSERT_EQ(*table->match(sockcp::ipv4("1.2.3.4")), 7);
+  ASSERT_EQ(*table->match(sockcp::ipv4("127.0.0.1")), 8);
+}
+
+TEST(PrefixTableTest, invalid_prefix)
+{
+  sockcp::prefix_table<sockcp::ipv4>::builder builder;
+  ASSERT_THROW(builder.add("10.0.0.0/33", true), sockcp::protocol_error);
+  ASSERT_THROW(builder.add("10.0.0.0/", true), sockcp::protocol_error);
+  ASSERT_THROW(builder.add("10.0.0/8", true), sockcp::protocol_error);
+}
+
+TEST(PrefixTableTest, ipv6)
+{
+  auto table = sockcp::prefix_table<sockcp::ipv6, int>::builder()
+                   .add("2001:db8::/32", 1)
+                   .add("2001:db8:1::/48", 2)
+                   .add("2001:db8:1::1/128", 3)
+                   .add("fe80::/10", 4)
+                   .build();
+  ASSERT_EQ(*table->match(sockcp::ipv6("2001:db8:ffff::1")), 1);
+  ASSERT_EQ(*table->match(sockcp::ipv6("2001:db8:1::2")), 2);
+  ASSERT_EQ(*table->match(sockcp::ipv6("2001:db8:1::1")), 3);
+  ASSERT_EQ(*table->match(sockcp::ipv6("febf::1")), 4);
+  ASSERT_EQ(table->match(sockcp::ipv6("fec0::1")), nullptr);
+  ASSERT_EQ(table->match(sockcp::ipv6("::1")), nullptr);
+}
+
+TEST(PrefixTableTest, matches_linear_scan)
+{
+  std::mt19937 rng(4483);
+  std::vector<rule> rules;
+  sockcp::prefix_table<sockcp::ipv4, int>::builder builder;
+  for (int i = 0; i < 2000; ++i)
+  {
+    // Cluster prefixes under a few /8s so they overlap at every level
+    uint32_t prefix = (uint32_t(rng() % 4 + 10) << 24) | (rng() & 0xffffff);
+    unsigned length = rng() % 33;
+    prefix &= mask(length);
+    rules.push_back({prefix, length, i});
+    builder.add(sockcp::ipv4(prefix), length, i);
+  }
+  auto table = builder.build();
+  for (int i = 0; i < 20000; ++i)
+  {
+    uint32_t addr = i % 2 ? rules[rng() % rules.size()].prefix | (rng() & 0xff)
+                          : (uint32_t(rng() % 6 + 9) << 24) | (rng() & 0xffffff);
+    const int *expected = reference(rules, addr);
+    const int *actual = table->match(sockcp::ipv4(addr));
+    ASSERT_EQ(expected == nullptr, actual == nullptr) << sockcp::ipv4(addr).to_string();
+    if (expected)
+    {
+      ASSERT_EQ(*expected, *actual) << sockcp::ipv4(addr).to_string();
+    }
+  }
+}
+
+TEST(PrefixFilterTest, update_swaps_rules)
+{
+  sockcp::prefix_filter<sockcp::ipv4> filter(false);
+  ASSERT_FALSE(filter(sockcp::ipv4("10.0.0.1")));
+  filter.update(sockcp::prefix_table<sockcp::ipv4>::builder()
+                    .add("10.0.0.0/8", true)
+                    .add("10.66.0.0/16", false)
+                    .build());
+  ASSERT_TRUE(filter(sockcp::ipv4("10.0.0.1")));
+  ASSERT_FALSE(filter(sockcp::ipv4("10.66.0.1")));
+  ASSERT_FALSE(filter(sockcp::ipv4("11.0.0.1")));
+  filter.update(nullptr);
+  ASSERT_FALSE(filter(sockcp::ipv4("10.0.0.1")));
+}
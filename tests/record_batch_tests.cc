@@ -0,0 +1,122 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+
+#include "sockcp/record_batch.h"
+
+namespace
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  struct seqpacket_pair
+  {
+    seqpacket_pair(int type = SOCK_SEQPACKET)
+    {
+      int fds[2];
+      EXPECT_EQ(::socketpair(AF_UNIX, type, 0, fds), 0);
+      a = unix_socket::adopt(fds[0]);
+      b = unix_socket::adopt(fds[1]);
+    }
+
+    unix_socket a{sockcp::socktype::seqpacket};
+    unix_socket b{sockcp::socktype::seqpacket};
+  };
+
+  void send(unix_socket &sock, const std::string &data)
+  {
+    ASSERT_TRUE(sockcp::send_record(sock, data.data(), data.size()));
+  }
+}
+
+TEST(RecordTest, keeps_record_boundaries)
+{
+  seqpacket_pair pair;
+  send(pair.a, "one");
+  send(pair.a, "two two");
+  char buf[64];
+  sockcp::record rec;
+  ASSERT_TRUE(sockcp::recv_record(pair.b, buf, sizeof(buf), rec));
+  ASSERT_EQ(std::string(rec.data, rec.size), "one");
+  ASSERT_FALSE(rec.truncated);
+  ASSERT_TRUE(sockcp::recv_record(pair.b, buf, sizeof(buf), rec));
+  ASSERT_EQ(std::string(rec.data, rec.size), "two two");
+
+  pair.b.set_block(false);
+  ASSERT_FALSE(sockcp::recv_record(pair.b, buf, sizeof(buf), rec));
+}
+
+TEST(RecordTest, reports_truncation)
+{
+  seqpacket_pair pair;
+  send(pair.a, std::string(100, 'x'));
+  send(pair.a, "next");
+  char buf[10];
+  sockcp::record rec;
+  ASSERT_TRUE(sockcp::recv_record(pair.b, buf, sizeof(buf), rec));
+  ASSERT_TRUE(rec.truncated);
+  ASSERT_EQ(rec.size, 10u);
+#if defined(__linux__)
+  ASSERT_EQ(rec.full_size, 100u);
+#endif
+  // The rest of the cut record is gone, not read as the next one
+  ASSERT_TRUE(sockcp::recv_record(pair.b, buf, sizeof(buf), rec));
+  ASSERT_EQ(std::string(rec.data, rec.size), "next");
+  ASSERT_FALSE(rec.truncated);
+}
+
+TEST(RecordTest, batch_receives_many_records)
+{
+  seqpacket_pair pair;
+  for (int i = 0; i < 10; ++i)
+  {
+    send(pair.a, "record " + std::to_string(i));
+  }
+  send(pair.a, std::string(40, 'y'));
+  sockcp::record_batch batch(4, 32);
+  std::vector<std::string> out;
+  std::size_t last_full_size = 0;
+  pair.b.set_block(false);
+  while (std::size_t n = batch.receive(pair.b))
+  {
+    ASSERT_LE(n, 4u);
+    for (const auto &rec : batch)
+    {
+      out.emplace_back(rec.data, rec.size);
+      ASSERT_EQ(rec.truncated, rec.size == 32);
+      last_full_size = rec.full_size;
+    }
+  }
+  ASSERT_EQ(out.size(), 11u);
+  ASSERT_EQ(out[0], "record 0");
+  ASSERT_EQ(out[9], "record 9");
+  ASSERT_EQ(out[10], std::string(32, 'y'));
+#if defined(__linux__)
+  ASSERT_EQ(last_full_size, 40u);
+#endif
+}
+
+TEST(RecordTest, batch_stops_at_end_of_stream)
+{
+  seqpacket_pair pair;
+  send(pair.a, "last");
+  pair.a.close();
+  sockcp::record_batch batch(8, 16);
+  ASSERT_EQ(batch.receive(pair.b), 1u);
+  ASSERT_EQ(std::string(batch[0].data, batch[0].size), "last");
+  ASSERT_THROW(batch.receive(pair.b), disconnect_error);
+}
+
+TEST(RecordTest, empty_datagrams_are_records)
+{
+  seqpacket_pair pair(SOCK_DGRAM);
+  send(pair.a, "");
+  send(pair.a, "x");
+  sockcp::record_batch batch(8, 16);
+  pair.b.set_block(false);
+  ASSERT_EQ(batch.receive(pair.b), 2u);
+  ASSERT_EQ(batch[0].size, 0u);
+  ASSERT_EQ(batch[1].size, 1u);
+}
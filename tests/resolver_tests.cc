@@ -0,0 +1,151 @@
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+#include "sockcp/resolver.h"
+#include "sockcp/socket_observer.h"
+
+using namespace std::chrono_literals;
+
+struct stub_lookup
+{
+  int operator()(const std::string &host, std::vector<sockcp::ipv4> &v4, std::vector<sockcp::ipv6> &v6) const
+  {
+    ++*calls;
+    if (host == "service.test")
+    {
+      v4.emplace_back("10.0.0.1");
+      v4.emplace_back("10.0.0.2");
+      v6.emplace_back("fd00::1");
+      return 0;
+    }
+    if (host == "broken.test")
+    {
+      return EAI_FAIL;
+    }
+    if (host == "throws.test")
+    {
+      throw std::runtime_error("lookup failed");
+    }
+    if (host.compare(0, 4, "host") == 0)
+    {
+      v4.emplace_back("10.0.0.3");
+      return 0;
+    }
+    return EAI_NONAME;
+  }
+
+  std::shared_ptr<std::atomic<int>> calls = std::make_shared<std::atomic<int>>(0);
+};
+
+template <typename Resolver>
+sockcp::resolve_result wait_one(Resolver &res, const std::string &host, uint16_t port)
+{
+  sockcp::resolve_result out;
+  bool done = false;
+  res.resolve(host, port, [&](const sockcp::resolve_result &r)
+              { out = r; done = true; });
+  for (int i = 0; i < 100 && !done; ++i)
+  {
+    if (static_cast<bool>(sockcp::poll(res, 100ms, sockcp::event::in) & sockcp::event::in))
+    {
+      res.dispatch();
+    }
+  }
+  EXPECT_TRUE(done);
+  return out;
+}
+
+TEST(ResolverTest, stub_positive_is_cached)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(2, lookup);
+  auto first = wait_one(res, "service.test", 80);
+  ASSERT_TRUE(first.ok());
+  ASSERT_FALSE(first.cached);
+  ASSERT_EQ(first.v4.size(), 2u);
+  ASSERT_EQ(first.v6.size(), 1u);
+  ASSERT_EQ(first.v4[0].binary(), (10u << 24) | 1u);
+  ASSERT_EQ(first.v4[1].port(), 80);
+
+  auto second = wait_one(res, "service.test", 443);
+  ASSERT_TRUE(second.cached);
+  ASSERT_EQ(second.v4[0].port(), 443);
+  ASSERT_EQ(*lookup.calls, 1);
+}
+
+TEST(ResolverTest, stub_negative_is_cached)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(1, lookup);
+  ASSERT_EQ(wait_one(res, "missing.test", 0).error, EAI_NONAME);
+  auto again = wait_one(res, "missing.test", 0);
+  ASSERT_EQ(again.error, EAI_NONAME);
+  ASSERT_TRUE(again.cached);
+  ASSERT_EQ(*lookup.calls, 1);
+}
+
+TEST(ResolverTest, stub_failures_are_not_cached)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(1, lookup);
+  ASSERT_EQ(wait_one(res, "broken.test", 0).error, EAI_FAIL);
+  ASSERT_FALSE(wait_one(res, "broken.test", 0).cached);
+  ASSERT_EQ(wait_one(res, "throws.test", 0).error, EAI_FAIL);
+  ASSERT_FALSE(wait_one(res, "throws.test", 0).cached);
+  ASSERT_EQ(*lookup.calls, 4);
+  ASSERT_EQ(res.cache_size(), 0u);
+}
+
+TEST(ResolverTest, stub_cache_is_bounded)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(1, lookup, 4);
+  for (int i = 0; i < 10; ++i)
+  {
+    ASSERT_TRUE(wait_one(res, "host" + std::to_string(i) + ".test", 0).ok());
+  }
+  ASSERT_EQ(res.cache_size(), 4u);
+  // The latest hosts stay, the earliest were evicted
+  ASSERT_TRUE(wait_one(res, "host9.test", 0).cached);
+  ASSERT_FALSE(wait_one(res, "host0.test", 0).cached);
+  ASSERT_EQ(res.cache_size(), 4u);
+}
+
+TEST(ResolverTest, stub_expired_entry_is_refreshed)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(1, lookup);
+  res.set_ttl(0s, 0s);
+  wait_one(res, "service.test", 0);
+  wait_one(res, "service.test", 0);
+  ASSERT_EQ(*lookup.calls, 2);
+}
+
+TEST(ResolverTest, numeric_skips_lookup)
+{
+  stub_lookup lookup;
+  sockcp::basic_resolver<stub_lookup> res(1, lookup);
+  auto v4 = wait_one(res, "192.168.11.253", 4483);
+  ASSERT_EQ(v4.v4.size(), 1u);
+  ASSERT_EQ(v4.v4[0].binary(), (192u << 24) | (168u << 16) | (11u << 8) | 253u);
+  auto v6 = wait_one(res, "::1", 4483);
+  ASSERT_EQ(v6.v6.size(), 1u);
+  ASSERT_EQ(*lookup.calls, 0);
+}
+
+TEST(ResolverTest, localhost_from_hosts_file)
+{
+  sockcp::resolver res;
+  auto r = wait_one(res, "localhost", 4483);
+  ASSERT_TRUE(r.ok()) << r.what();
+  ASSERT_FALSE(r.v4.empty() && r.v6.empty());
+  for (auto &addr : r.v4)
+  {
+    ASSERT_EQ(addr.binary() >> 24, 127u);
+  }
+}
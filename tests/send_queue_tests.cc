@@ -0,0 +1,167 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <sys/socket.h>
+
+#include "sockcp/memory_transport.h"
+#include "sockcp/send_queue.h"
+#include "sockcp/unix_address.h"
+
+namespace
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  struct pair
+  {
+    pair()
+    {
+      int fds[2];
+      EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+      writer = unix_socket::adopt(fds[0]);
+      reader = unix_socket::adopt(fds[1]);
+      writer.set_block(false);
+      writer.set_option(SOL_SOCKET, SO_SNDBUF, 4096);
+    }
+
+    std::string drain()
+    {
+      std::string out;
+      char buf[4096];
+      for (ssize_t n; (n = ::recv(reader.fd(), buf, sizeof(buf), MSG_DONTWAIT)) > 0;)
+      {
+        out.append(buf, n);
+      }
+      return out;
+    }
+
+    unix_socket writer = unix_socket(sockcp::socktype::stream);
+    unix_socket reader = unix_socket(sockcp::socktype::stream);
+  };
+}
+
+TEST(SendQueueTest, writes_through_when_idle)
+{
+  pair p;
+  sockcp::buffer_pool pool(512);
+  sockcp::basic_send_queue<sockcp::unix_addr> queue(p.writer, pool);
+  ASSERT_TRUE(queue.write("hello"));
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(queue.interest(), sockcp::event::no_event);
+  ASSERT_EQ(pool.in_use(), 0u);
+  ASSERT_EQ(p.drain(), "hello");
+}
+
+TEST(SendQueueTest, watermarks_and_order)
+{
+  pair p;
+  sockcp::buffer_pool pool(512);
+  sockcp::basic_send_queue<sockcp::unix_addr> queue(p.writer, pool, 16 * 1024, 4 * 1024, 64 * 1024);
+  int resumed = 0;
+  queue.on_resume([&]
+                  { ++resumed; });
+
+  std::string sent;
+  std::string chunk(1000, 0);
+  for (int i = 0; !queue.paused(); ++i)
+  {
+    std::fill(chunk.begin(), chunk.end(), static_cast<char>('a' + i % 26));
+    queue.write(chunk);
+    sent += chunk;
+  }
+  ASSERT_GT(queue.queued(), 16u * 1024);
+  ASSERT_EQ(queue.interest(), sockcp::event::out);
+  ASSERT_FALSE(queue.write("x"));
+  sent += "x";
+  ASSERT_THROW(queue.write(std::string(64 * 1024, 'y')), std::length_error);
+
+  std::string received;
+  while (!queue.flush())
+  {
+    received += p.drain();
+  }
+  received += p.drain();
+  ASSERT_EQ(resumed, 1);
+  ASSERT_FALSE(queue.paused());
+  ASSERT_EQ(received, sent);
+  ASSERT_EQ(pool.in_use(), 0u);
+}
+
+TEST(SendQueueTest, oversized_write_to_stalled_peer_is_refused)
+{
+  pair p;
+  sockcp::buffer_pool pool(512);
+  sockcp::basic_send_queue<sockcp::unix_addr> queue(p.writer, pool, 16 * 1024, 4 * 1024, 64 * 1024);
+  // The reader never reads; one write far above the limit takes nothing
+  ASSERT_THROW(queue.write(std::string(1024 * 1024, 'o')), std::length_error);
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(pool.in_use(), 0u);
+  ASSERT_TRUE(p.drain().empty());
+
+  // Writes up to the limit still go through, queuing no more than it
+  ASSERT_FALSE(queue.write(std::string(64 * 1024, 'i')));
+  ASSERT_LE(queue.queued(), 64u * 1024);
+  ASSERT_GT(queue.queued(), 16u * 1024);
+}
+
+TEST(SendQueueTest, runs_over_the_memory_transport)
+{
+  sockcp::memory_faults faults;
+  faults.buffer_size = 4096;
+  faults.max_write = 700;
+  sockcp::memory_network::instance().configure(faults);
+  auto socks = sockcp::memory_socket_pair();
+  socks.first.set_block(false);
+  socks.second.set_block(false);
+  sockcp::buffer_pool pool(512);
+  sockcp::basic_send_queue<sockcp::ipv4, sockcp::memory_calls> queue(socks.first, pool, 16 * 1024, 4 * 1024);
+
+  std::string sent;
+  for (int i = 0; i < 16; ++i)
+  {
+    std::string chunk(1000, static_cast<char>('a' + i));
+    queue.write(chunk);
+    sent += chunk;
+  }
+  ASSERT_FALSE(queue.empty());
+  std::string received;
+  for (int i = 0; i < 1000 && received.size() < sent.size(); ++i)
+  {
+    queue.flush();
+    char buf[4096];
+    std::ptrdiff_t n = sockcp::memory_calls::recv(socks.second.fd(), buf, sizeof(buf), 0);
+    if (n > 0)
+    {
+      received.append(buf, static_cast<std::size_t>(n));
+    }
+  }
+  sockcp::memory_network::instance().configure(sockcp::memory_faults());
+  ASSERT_EQ(received, sent);
+  ASSERT_TRUE(queue.empty());
+  ASSERT_EQ(pool.in_use(), 0u);
+}
+
+TEST(SendQueueTest, clear_returns_blocks)
+{
+  pair p;
+  sockcp::buffer_pool pool(512);
+  sockcp::basic_send_queue<sockcp::unix_addr> queue(p.writer, pool);
+  while (queue.write(std::string(4096, 'z')))
+  {
+  }
+  ASSERT_GT(pool.in_use(), 0u);
+  queue.clear();
+  ASSERT_EQ(pool.in_use(), 0u);
+  ASSERT_TRUE(queue.empty());
+}
+
+TEST(SocketObserverTest, modify_socket)
+{
+  pair p;
+  sockcp::socket_observer observer;
+  observer.attach_socket(p.writer, sockcp::event::in);
+  ASSERT_TRUE(observer.poll(std::chrono::milliseconds(0)).empty());
+  observer.modify_socket(p.writer, sockcp::event::out);
+  auto ready = observer.poll(std::chrono::milliseconds(0));
+  ASSERT_EQ(ready.size(), 1u);
+  ASSERT_EQ(ready.begin()->second & sockcp::event::out, sockcp::event::out);
+}
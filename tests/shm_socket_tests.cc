@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <cerrno>
+#include <string>
+#include <utility>
+
+#include <sys/socket.h>
+
+#include "sockcp/shm_socket.h"
+#include "sockcp/socket_observer.h"
+
+namespace
+{
+  using unix_socket = sockcp::basic_socket<sockcp::unix_addr>;
+
+  std::pair<sockcp::shm_socket, sockcp::shm_socket> shm_pair(std::size_t capacity = 4096)
+  {
+    int fds[2];
+    EXPECT_EQ(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    unix_socket a = unix_socket::adopt(fds[0]);
+    unix_socket b = unix_socket::adopt(fds[1]);
+    auto first = sockcp::shm_socket::create(a, capacity);
+    auto second = sockcp::shm_socket::open(b);
+    return {std::move(first), std::move(second)};
+  }
+
+  std::string read_exactly(sockcp::shm_socket &sock, std::size_t count)
+  {
+    std::string out(count, '\0');
+    for (std::size_t got = 0; got < count;)
+    {
+      got += sock.read(&out[got], count - got);
+    }
+    return out;
+  }
+}
+
+TEST(ShmSocketTest, round_trip)
+{
+  auto socks = shm_pair();
+  socks.first.write(std::string("ping"));
+  EXPECT_EQ("ping", read_exactly(socks.second, 4));
+  socks.second.write(std::string("pong"));
+  EXPECT_EQ("pong", read_exactly(socks.first, 4));
+}
+
+TEST(ShmSocketTest, zero_byte_reads_return_at_once)
+{
+  // Blocking and with an empty ring, so a wait would never end
+  auto socks = shm_pair();
+  char c;
+  EXPECT_EQ(0u, socks.second.read(&c, 0));
+  EXPECT_TRUE(socks.second.read(0).empty());
+  socks.first.write(std::string("x"));
+  EXPECT_TRUE(socks.second.read(0).empty());
+  EXPECT_EQ("x", read_exactly(socks.second, 1));
+}
+
+TEST(ShmSocketTest, wraps_around)
+{
+  auto socks = shm_pair(4096);
+  for (int round = 0; round < 10; ++round)
+  {
+    std::string chunk(3000, static_cast<char>('a' + round));
+    chunk[0] = '<';
+    chunk.back() = '>';
+    socks.first.write(chunk);
+    ASSERT_EQ(chunk, read_exactly(socks.second, chunk.size()));
+  }
+}
+
+TEST(ShmSocketTest, nonblocking_calls_return_at_once)
+{
+  auto socks = shm_pair(4096);
+  socks.first.set_block(false);
+  socks.second.set_block(false);
+  char buf[16];
+  EXPECT_EQ(0u, socks.second.read(buf, sizeof(buf)));
+
+  socks.first.write(std::string(4096, 'x'));
+  try
+  {
+    socks.first.write(std::string("y"));
+    FAIL() << "wrote into a full ring";
+  }
+  catch (const sockcp::socket_error &e)
+  {
+    EXPECT_EQ(EAGAIN, e.code());
+  }
+  EXPECT_EQ(std::string(4096, 'x'), read_exactly(socks.second, 4096));
+  EXPECT_EQ(0u, socks.second.read(buf, sizeof(buf)));
+}
+
+TEST(ShmSocketTest, doorbell_follows_readiness)
+{
+  auto socks = shm_pair();
+  socks.second.set_block(false);
+  sockcp::socket_observer observer;
+  observer.attach_socket(socks.second, sockcp::event::in);
+  // A fresh socket is armed for the first data
+  EXPECT_TRUE(observer.poll(std::chrono::milliseconds(0)).empty());
+  socks.first.write(std::string("data"));
+  EXPECT_EQ(1u, observer.poll(std::chrono::milliseconds(100)).count(socks.second.fd()));
+
+  EXPECT_EQ("data", read_exactly(socks.second, 4));
+  char buf[16];
+  EXPECT_EQ(0u, socks.second.read(buf, sizeof(buf)));
+  // Drained by the empty read, armed for the next write
+  EXPECT_TRUE(observer.poll(std::chrono::milliseconds(0)).empty());
+  socks.first.write(std::string("more"));
+  EXPECT_EQ(1u, observer.poll(std::chrono::milliseconds(100)).count(socks.second.fd()));
+}
+
+TEST(ShmSocketTest, disconnects_after_peer_close)
+{
+  auto socks = shm_pair();
+  socks.first.write(std::string("last"));
+  socks.first.close();
+  EXPECT_EQ("last", read_exactly(socks.second, 4));
+  char c;
+  EXPECT_THROW(socks.second.read(&c, 1), disconnect_error);
+  EXPECT_THROW(socks.second.write(std::string("x")), disconnect_error);
+}
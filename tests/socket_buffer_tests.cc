@@ -0,0 +1,201 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sockcp/buffer_pool.h"
+#include "sockcp/memory_transport.h"
+#include "sockcp/socket_buffer.h"
+
+namespace
+{
+  // Connected pair whose reading end is nonblocking, so a buffer never
+  // waits in its constructor or when filling
+  std::pair<sockcp::memory_socket, sockcp::memory_socket> reader_writer()
+  {
+    auto pair = sockcp::memory_socket_pair();
+    pair.first.set_block(false);
+    return pair;
+  }
+
+  void write_all(sockcp::memory_socket &sock, const std::string &data)
+  {
+    sock.write(data.data(), data.size());
+  }
+
+  std::string as_string(const std::vector<char> &data)
+  {
+    return std::string(data.begin(), data.end());
+  }
+}
+
+TEST(SocketBufferTest, set_block_switches_the_descriptor_mode)
+{
+  auto pair = sockcp::memory_socket_pair();
+  pair.first.set_block(false);
+  EXPECT_FALSE(pair.first.blocking());
+  EXPECT_TRUE(sockcp::memory_calls::nonblocking(pair.first.fd()));
+  pair.first.set_block(true);
+  EXPECT_TRUE(pair.first.blocking());
+  EXPECT_FALSE(sockcp::memory_calls::nonblocking(pair.first.fd()));
+}
+
+TEST(SocketBufferTest, lazy_buffer_attaches_only_while_holding_data)
+{
+  sockcp::buffer_pool pool(64);
+  auto pair = reader_writer();
+  sockcp::memory_socket_buffer buffer(std::move(pair.first), pool);
+  EXPECT_TRUE(buffer.lazy());
+  EXPECT_FALSE(buffer.attached());
+  EXPECT_EQ(0u, buffer.resident_bytes());
+  EXPECT_EQ(0u, pool.in_use());
+
+  write_all(pair.second, "one\ntwo\n");
+  EXPECT_EQ("one\n", as_string(buffer.read_until('\n')));
+  EXPECT_TRUE(buffer.attached());
+  EXPECT_EQ(64u, buffer.resident_bytes());
+  EXPECT_EQ(1u, pool.in_use());
+
+  EXPECT_EQ("two\n", as_string(buffer.read_until('\n')));
+  EXPECT_FALSE(buffer.attached());
+  EXPECT_EQ(0u, pool.in_use());
+  EXPECT_EQ(1u, pool.cached());
+}
+
+TEST(SocketBufferTest, lazy_buffer_reads_any_byte_value)
+{
+  sockcp::buffer_pool pool(64);
+  auto pair = reader_writer();
+  sockcp::memory_socket_buffer buffer(std::move(pair.first), pool);
+  // Data starting with a NUL and with bytes above 0x7f counts as data
+  write_all(pair.second, std::string("\0\xff\x80|", 4));
+  EXPECT_EQ(std::string("\0\xff\x80|", 4), as_string(buffer.read_until('|')));
+  EXPECT_EQ(0u, pool.in_use());
+}
+
+TEST(SocketBufferTest, pool_allocates_past_its_cache_and_trims_on_release)
+{
+  sockcp::buffer_pool pool(32, 1);
+  auto first = reader_writer();
+  auto second = reader_writer();
+  sockcp::memory_socket_buffer a(std::move(first.first), pool);
+  sockcp::memory_socket_buffer b(std::move(second.first), pool);
+  write_all(first.second, "aa|aa|");
+  write_all(second.second, "bb|bb|");
+  a.read_until('|');
+  b.read_until('|');
+  EXPECT_EQ(2u, pool.in_use());
+  EXPECT_EQ(0u, pool.cached());
+  EXPECT_EQ(64u, pool.resident_bytes());
+
+  a.read_until('|');
+  b.read_until('|');
+  EXPECT_EQ(0u, pool.in_use());
+  // Only max_cached blocks stay behind
+  EXPECT_EQ(1u, pool.cached());
+  EXPECT_EQ(32u, pool.resident_bytes());
+}
+
+TEST(SocketBufferTest, move_assignment_gives_back_the_old_block)
+{
+  sockcp::buffer_pool pool(32);
+  auto first = reader_writer();
+  auto second = reader_writer();
+  sockcp::memory_socket_buffer a(std::move(first.first), pool);
+  sockcp::memory_socket_buffer b(std::move(second.first), pool);
+  write_all(first.second, "from a|rest of a|");
+  write_all(second.second, "from b|rest of b|");
+  a.read_until('|');
+  b.read_until('|');
+  ASSERT_EQ(2u, pool.in_use());
+
+  b = std::move(a);
+  EXPECT_EQ(1u, pool.in_use());
+  EXPECT_TRUE(b.attached());
+  EXPECT_FALSE(a.attached());
+  EXPECT_EQ("rest of a|", as_string(b.read_until('|')));
+  EXPECT_EQ(0u, pool.in_use());
+
+  // And back again
+  write_all(first.second, "again|");
+  a = std::move(b);
+  EXPECT_EQ("again|", as_string(a.read_until('|')));
+  EXPECT_EQ(0u, pool.in_use());
+}
+
+TEST(SocketBufferTest, read_returns_buffered_bytes_first)
+{
+  auto pair = reader_writer();
+  write_all(pair.second, "hello world");
+  sockcp::memory_socket_buffer buffer(std::move(pair.first), 64);
+  char out[32];
+  ASSERT_EQ(5u, buffer.read(out, 5));
+  EXPECT_EQ("hello", std::string(out, 5));
+  std::size_t rest = buffer.read(out, sizeof(out));
+  EXPECT_EQ(" world", std::string(out, rest));
+}
+
+TEST(SocketBufferTest, nonblocking_read_until_returns_when_dry)
+{
+  sockcp::buffer_pool pool(64);
+  auto pair = reader_writer();
+  sockcp::memory_socket_buffer buffer(std::move(pair.first), pool);
+  EXPECT_TRUE(buffer.read_until('\n').empty());
+  EXPECT_TRUE(buffer.would_block());
+  EXPECT_EQ(0u, pool.in_use());
+
+  // A line arriving in pieces is put together across calls
+  write_all(pair.second, "ab");
+  EXPECT_TRUE(buffer.read_until('\n').empty());
+  EXPECT_TRUE(buffer.would_block());
+  write_all(pair.second, "c\nd");
+  EXPECT_EQ("abc\n", as_string(buffer.read_until('\n')));
+  EXPECT_FALSE(buffer.would_block());
+
+  std::string word = "unchanged";
+  buffer >> word;
+  EXPECT_TRUE(buffer.would_block());
+  EXPECT_EQ("unchanged", word);
+  write_all(pair.second, std::string("ef\0", 3));
+  buffer >> word;
+  EXPECT_FALSE(buffer.would_block());
+  EXPECT_EQ("def", word);
+}
+
+TEST(SocketBufferTest, end_of_stream_inside_a_line_throws)
+{
+  sockcp::buffer_pool pool(64);
+  auto pair = reader_writer();
+  sockcp::memory_socket_buffer buffer(std::move(pair.first), pool);
+  write_all(pair.second, "complete\nhalf a li");
+  pair.second.close();
+  EXPECT_EQ("complete\n", as_string(buffer.read_until('\n')));
+  EXPECT_THROW(buffer.read_until('\n'), disconnect_error);
+  EXPECT_EQ(0u, pool.in_use());
+}
+
+TEST(SocketBufferTest, moves_keep_buffered_bytes_and_leave_the_socket_alone)
+{
+  auto pair = reader_writer();
+  write_all(pair.second, "one\ntwo\n");
+  sockcp::memory_socket_buffer a(std::move(pair.first), 64);
+  EXPECT_EQ("one\n", as_string(a.read_until('\n')));
+  write_all(pair.second, "three\n");
+
+  sockcp::memory_socket_buffer b(std::move(a));
+  EXPECT_EQ("two\n", as_string(b.read_until('\n')));
+  auto other = reader_writer();
+  sockcp::memory_socket_buffer c(std::move(other.first), 64);
+  c = std::move(b);
+  EXPECT_EQ("three\n", as_string(c.read_until('\n')));
+
+  // An idle lazy connection borrows no block when moved
+  sockcp::buffer_pool pool(32);
+  auto idle = reader_writer();
+  write_all(idle.second, "pending");
+  sockcp::memory_socket_buffer lazy(std::move(idle.first), pool);
+  sockcp::memory_socket_buffer moved(std::move(lazy));
+  EXPECT_EQ(0u, pool.in_use());
+  EXPECT_FALSE(moved.attached());
+}
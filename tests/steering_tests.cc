@@ -0,0 +1,53 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <thread>
+
+#include "sockcp/steering.h"
+
+TEST(SteeringTest, map_prefers_pinned_worker)
+{
+  auto map = sockcp::steering_map({3, 1}, 4);
+  ASSERT_EQ(map.size(), 4u);
+  ASSERT_EQ(map[3], 0u);
+  ASSERT_EQ(map[1], 1u);
+  for (unsigned worker : map)
+  {
+    ASSERT_LT(worker, 2u);
+  }
+  ASSERT_THROW(sockcp::steering_map({}, 4), std::invalid_argument);
+}
+
+TEST(SteeringTest, sharded_listener_accepts)
+{
+  sockcp::sharded_listener<sockcp::ipv4> group(sockcp::ipv4("127.0.0.1", 0), {0, 0});
+  ASSERT_EQ(group.size(), 2u);
+  ASSERT_NE(group.address().port(), 0);
+  for (std::size_t i = 0; i < group.size(); ++i)
+  {
+    group[i].set_block(false);
+  }
+
+  sockcp::socket client(sockcp::socktype::stream);
+  client.connect(group.address());
+  // Every CPU maps to worker 0, the first listener in the group
+  sockcp::socket accepted = group[0].accept();
+  for (int i = 0; i < 100 && accepted.fd() == sockcp::fd_invalid; ++i)
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    accepted = group[0].accept();
+  }
+  ASSERT_NE(accepted.fd(), sockcp::fd_invalid);
+  ASSERT_EQ(group[1].accept().fd(), sockcp::fd_invalid);
+  ASSERT_GE(sockcp::incoming_cpu(accepted), -1);
+}
+
+TEST(SteeringTest, pin_thread)
+{
+  unsigned cpu = static_cast<unsigned>(::sched_getcpu());
+  std::thread t([cpu]
+                {
+                  sockcp::pin_thread(cpu);
+                  ASSERT_EQ(static_cast<unsigned>(::sched_getcpu()), cpu); });
+  t.join();
+}
@@ -0,0 +1,97 @@
+#include <gtest/gtest.h>
+
+#include <chrono>
+#include <set>
+
+#include "sockcp/socket_observer.h"
+#include "sockcp/timestamping.h"
+
+using namespace std::chrono_literals;
+
+TEST(LatencyHistogramTest, percentiles_within_bucket_error)
+{
+  sockcp::latency_histogram hist;
+  for (int i = 1; i <= 10000; ++i)
+  {
+    hist.record(std::chrono::nanoseconds(i * 100));
+  }
+  ASSERT_EQ(hist.count(), 10000u);
+  ASSERT_EQ(hist.min(), 100ns);
+  ASSERT_EQ(hist.max(), 1000000ns);
+  ASSERT_EQ(hist.mean(), 500050ns);
+  for (double q : {0.01, 0.5, 0.9, 0.99})
+  {
+    double expected = q * 1000000;
+    double actual = static_cast<double>(hist.percentile(q).count());
+    ASSERT_GE(actual, expected * 0.999) << q;
+    ASSERT_LE(actual, expected * 1.0625) << q;
+  }
+  ASSERT_EQ(hist.percentile(1.0), 1000000ns);
+
+  sockcp::latency_histogram other;
+  other.record(5s);
+  hist.merge(other);
+  ASSERT_EQ(hist.count(), 10001u);
+  ASSERT_EQ(hist.max(), 5s);
+  hist.reset();
+  ASSERT_EQ(hist.count(), 0u);
+  ASSERT_EQ(hist.percentile(0.5), 0ns);
+}
+
+TEST(LatencyHistogramTest, small_and_huge_values)
+{
+  sockcp::latency_histogram hist;
+  hist.record(0ns);
+  hist.record(-5ns);
+  hist.record(15ns);
+  hist.record(std::chrono::hours(1));
+  ASSERT_EQ(hist.percentile(0.25), 0ns);
+  ASSERT_EQ(hist.percentile(0.75), 15ns);
+  ASSERT_EQ(hist.percentile(1.0), std::chrono::hours(1));
+}
+
+TEST(TimestampingTest, loopback_rx_and_tx)
+{
+  sockcp::socket listener(sockcp::socktype::stream);
+  listener.set_option(SOL_SOCKET, SO_REUSEADDR, 1);
+  listener.bind(sockcp::ipv4("127.0.0.1", 4487));
+  listener.listen(1);
+  sockcp::socket client(sockcp::socktype::stream);
+  client.connect(sockcp::ipv4("127.0.0.1", 4487));
+  sockcp::socket server = listener.accept();
+  sockcp::enable_timestamping(client);
+  sockcp::enable_timestamping(server);
+
+  sockcp::tx_tracker tracker;
+  sockcp::stage_latency stages;
+  auto before = sockcp::realtime_now();
+  ASSERT_EQ(::send(client.fd(), "hello", 5, 0), 5);
+  tracker.sent(5, before);
+
+  char buf[16];
+  auto rx = sockcp::recv_timestamped(server, buf, sizeof(buf));
+  auto after = sockcp::realtime_now();
+  ASSERT_EQ(rx.bytes, 5u);
+  ASSERT_FALSE(rx.hardware);
+  ASSERT_GE(rx.kernel, before);
+  ASSERT_LE(rx.kernel, after);
+  stages.rx_queue.record(after - rx.kernel);
+
+  std::set<uint32_t> seen;
+  for (int i = 0; i < 50 && seen.size() < 3; ++i)
+  {
+    sockcp::poll(client, 20ms, sockcp::event::err);
+    sockcp::read_tx_timestamps(client, [&](const sockcp::tx_timestamp &stamp)
+                               {
+                                 EXPECT_EQ(stamp.id, 4u);
+                                 EXPECT_GE(stamp.time, before);
+                                 seen.insert(stamp.stage);
+                                 tracker.stamped(stamp, stages); });
+  }
+  ASSERT_EQ(seen, (std::set<uint32_t>{SCM_TSTAMP_SCHED, SCM_TSTAMP_SND, SCM_TSTAMP_ACK}));
+  ASSERT_EQ(stages.tx_sched.count(), 1u);
+  ASSERT_EQ(stages.tx_driver.count(), 1u);
+  ASSERT_EQ(stages.tx_ack.count(), 1u);
+  ASSERT_EQ(stages.rx_queue.count(), 1u);
+  ASSERT_EQ(tracker.outstanding(), 0u);
+}
@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sockcp/trace.h"
+
+#if defined(SOCKCP_TRACING) && (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__)))
+#include "sockcp/event_loop.h"
+#endif
+
+namespace
+{
+  std::vector<sockcp::trace_event> local_events()
+  {
+    std::vector<sockcp::trace_event> events;
+    sockcp::trace_recorder::instance().local_ring().snapshot(events);
+    return events;
+  }
+}
+
+TEST(TraceTest, span_records_duration_and_args)
+{
+  auto &recorder = sockcp::trace_recorder::instance();
+  recorder.clear();
+  {
+    sockcp::trace_span span(sockcp::trace_kind::io, "recv", 7);
+    span.set_result(42);
+  }
+  auto events = local_events();
+  ASSERT_EQ(1u, events.size());
+  EXPECT_STREQ("recv", events[0].name);
+  EXPECT_EQ(sockcp::trace_kind::io, events[0].kind);
+  EXPECT_EQ(7, events[0].args[0]);
+  EXPECT_EQ(42, events[0].args[1]);
+  EXPECT_LE(events[0].start + events[0].duration, sockcp::trace_recorder::now());
+
+  recorder.enable(false);
+  {
+    sockcp::trace_span span(sockcp::trace_kind::user, "paused");
+  }
+  recorder.enable(true);
+  EXPECT_EQ(1u, local_events().size());
+}
+
+TEST(TraceTest, ring_keeps_newest_events)
+{
+  sockcp::trace_ring ring(5, 1);
+  EXPECT_EQ(8u, ring.capacity());
+  for (int i = 0; i < 20; ++i)
+  {
+    ring.push(sockcp::trace_event{"e", 0, 0, {i, 0}, sockcp::trace_kind::user});
+  }
+  std::vector<sockcp::trace_event> events;
+  ring.snapshot(events);
+  ASSERT_EQ(8u, events.size());
+  EXPECT_EQ(12, events.front().args[0]);
+  EXPECT_EQ(19, events.back().args[0]);
+  EXPECT_EQ(12u, ring.dropped());
+
+  ring.clear();
+  ring.push(sockcp::trace_event{"e", 0, 0, {20, 0}, sockcp::trace_kind::user});
+  events.clear();
+  ring.snapshot(events);
+  ASSERT_EQ(1u, events.size());
+  EXPECT_EQ(20, events[0].args[0]);
+}
+
+TEST(TraceTest, chrome_json_has_every_thread)
+{
+  auto &recorder = sockcp::trace_recorder::instance();
+  recorder.clear();
+  recorder.set_thread_name("main \"loop\"");
+  {
+    sockcp::trace_span span(sockcp::trace_kind::poll, "poll", 3);
+    span.set_result(1);
+  }
+  std::thread worker([&]
+  {
+    recorder.set_thread_name("worker");
+    sockcp::trace_span span(sockcp::trace_kind::handler, "handler", 9);
+  });
+  worker.join();
+
+  std::ostringstream out;
+  EXPECT_EQ(2u, recorder.write_chrome_json(out));
+  std::string json = out.str();
+  EXPECT_EQ(0u, json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"name\":\"main \\\"loop\\\"\"}"));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"name\":\"worker\"}"));
+  EXPECT_NE(std::string::npos, json.find("\"cat\":\"poll\""));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"watched\":3,\"ready\":1}"));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"fd\":9,\"events\":0}"));
+  EXPECT_EQ("]}\n", json.substr(json.size() - 3));
+}
+
+#if defined(SOCKCP_TRACING) && (defined(__unix__) || (defined(__APPLE__) && defined(__MACH__)))
+TEST(TraceTest, event_loop_is_instrumented)
+{
+  auto &recorder = sockcp::trace_recorder::instance();
+  recorder.clear();
+  sockcp::event_loop loop;
+  bool ran = false;
+  loop.post([&]
+  {
+    ran = true;
+  });
+  loop.run_once(std::chrono::milliseconds(100));
+  ASSERT_TRUE(ran);
+
+  bool polled = false;
+  bool task = false;
+  for (const auto &ev : local_events())
+  {
+    polled |= ev.kind == sockcp::trace_kind::poll && ev.args[1] == 1;
+    task |= ev.kind == sockcp::trace_kind::task;
+  }
+  EXPECT_TRUE(polled);
+  EXPECT_TRUE(task);
+}
+#endif
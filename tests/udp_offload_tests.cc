@@ -0,0 +1,94 @@
+#include <gtest/gtest.h>
+
+#include <string>
+#include <vector>
+
+#include "sockcp/udp_offload.h"
+
+namespace
+{
+  struct udp_pair
+  {
+    udp_pair(uint16_t port)
+        : rx(sockcp::socktype::datagram), tx(sockcp::socktype::datagram)
+    {
+      rx.bind(sockcp::ipv4("127.0.0.1", port));
+      tx.connect(sockcp::ipv4("127.0.0.1", port));
+    }
+
+    sockcp::socket rx;
+    sockcp::socket tx;
+  };
+}
+
+TEST(UdpOffloadTest, segments_arrive_as_datagrams)
+{
+  udp_pair pair(4489);
+  std::string data;
+  for (int i = 0; i < 10 * 1000 + 300; ++i)
+  {
+    data.push_back(static_cast<char>('a' + i % 26));
+  }
+  ASSERT_EQ(sockcp::send_segmented(pair.tx, data.data(), data.size(), 1000), data.size());
+
+  // Without GRO every segment is its own datagram, the last one short
+  std::vector<char> buf(sockcp::gso_max_bytes);
+  std::string received;
+  for (int i = 0; i < 11; ++i)
+  {
+    auto msg = sockcp::recv_coalesced(pair.rx, buf.data(), buf.size());
+    ASSERT_EQ(msg.bytes, i < 10 ? 1000u : 300u);
+    ASSERT_EQ(msg.segment_size, 0u);
+    ASSERT_EQ(msg.segments(), 1u);
+    received.append(buf.data(), msg.bytes);
+  }
+  ASSERT_EQ(received, data);
+}
+
+TEST(UdpOffloadTest, splits_batches_over_segment_limit)
+{
+  udp_pair pair(4490);
+  pair.rx.set_option(SOL_SOCKET, SO_RCVBUF, 1 << 20);
+  std::string data(200 * 100, 'x');
+  ASSERT_EQ(sockcp::send_segmented(pair.tx, data.data(), data.size(), 100), data.size());
+  std::vector<char> buf(sockcp::gso_max_bytes);
+  std::size_t datagrams = 0;
+  while (datagrams < 200)
+  {
+    auto msg = sockcp::recv_coalesced(pair.rx, buf.data(), buf.size());
+    ASSERT_EQ(msg.bytes, 100u);
+    ++datagrams;
+  }
+  ASSERT_THROW(sockcp::send_segmented(pair.tx, data.data(), data.size(), 0), std::invalid_argument);
+}
+
+TEST(UdpOffloadTest, gro_reports_segment_size)
+{
+  udp_pair pair(4491);
+  if (!sockcp::enable_gro(pair.rx))
+  {
+    GTEST_SKIP() << "UDP_GRO not supported";
+  }
+  std::string data(8 * 1200 + 100, 'y');
+  ASSERT_EQ(sockcp::send_segmented(pair.tx, data.data(), data.size(), 1200), data.size());
+
+  // Loopback hands the GSO train to a GRO socket whole, but split trains
+  // are still correct, so only the totals are checked strictly.
+  std::vector<char> buf(sockcp::gso_max_bytes);
+  std::size_t bytes = 0;
+  std::vector<std::size_t> sizes;
+  while (bytes < data.size())
+  {
+    auto msg = sockcp::recv_coalesced(pair.rx, buf.data(), buf.size());
+    ASSERT_GT(msg.bytes, 0u);
+    if (msg.segment_size)
+    {
+      ASSERT_EQ(msg.segment_size, 1200u);
+    }
+    sockcp::for_each_segment(buf.data(), msg, [&](const char *, std::size_t n)
+                             { sizes.push_back(n); });
+    bytes += msg.bytes;
+  }
+  ASSERT_EQ(bytes, data.size());
+  ASSERT_EQ(sizes, (std::vector<std::size_t>{1200, 1200, 1200, 1200, 1200, 1200, 1200, 1200, 100}));
+}